@@ -34,7 +34,30 @@ CalAnimation::CalAnimation(CalCoreAnimation *pCoreAnimation)
     m_lastCallbackTimes.push_back(0.0F);  // build up the last called list
 }
 
+ /*****************************************************************************/
+/** Resets the animation instance.
+  *
+  * This function turns the animation instance into a fresh instance of the
+  * given core animation, like the constructor does, but keeps the memory of
+  * its buffers. It lets the mixer recycle its animation instances.
+  *
+  * @param pCoreAnimation A pointer to the core animation.
+  *****************************************************************************/
 
+void CalAnimation::reset(CalCoreAnimation *pCoreAnimation)
+{
+  assert(pCoreAnimation);
+
+  m_pCoreAnimation = pCoreAnimation;
+  m_type = TYPE_NONE;
+  m_state = STATE_NONE;
+  m_time = 0.0f;
+  m_timeFactor = 1.0f;
+  m_weight = 0.0f;
+
+  m_lastCallbackTimes.assign(m_pCoreAnimation->getCallbackList().size(), 0.0F);
+  m_vectorKeyframeCursor.clear();
+}
 
 void CalAnimation::checkCallbacks(float animationTime, CalModel *model)
 {
@@ -66,3 +89,25 @@ void CalAnimation::completeCallbacks(CalModel *model)
   for (size_t i=0; i<list.size(); i++)
     list[i].callback->AnimationComplete(model, model->getUserData());
 }
+
+ /*****************************************************************************/
+/** Returns the keyframe cursors of the animation instance.
+  *
+  * This function returns one keyframe cursor per core track, in the order of
+  * the core track list, for CalCoreTrack::getState. The cursors are reset
+  * whenever the number of core tracks changes.
+  *
+  * @return A pointer to the first cursor.
+  *****************************************************************************/
+
+int *CalAnimation::getKeyframeCursors()
+{
+  size_t trackCount = m_pCoreAnimation->getTrackCount();
+  if(m_vectorKeyframeCursor.size() != trackCount + 1)
+  {
+    // one spare entry so that the pointer is valid even without tracks
+    m_vectorKeyframeCursor.assign(trackCount + 1, -1);
+  }
+
+  return &m_vectorKeyframeCursor[0];
+}
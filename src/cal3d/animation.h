@@ -83,11 +83,14 @@ namespace cal3d{
 		void checkCallbacks(float animationTime, CalModel *model);
 		void completeCallbacks(CalModel *model);
 
-	protected:
+		int *getKeyframeCursors();
 
+	protected:
+		void reset(CalCoreAnimation *pCoreAnimation);
 
 		CalCoreAnimation *m_pCoreAnimation;
 		std::vector<float> m_lastCallbackTimes;
+		std::vector<int> m_vectorKeyframeCursor;
 		Type m_type;
 		State m_state;
 		float m_time;
@@ -44,6 +44,25 @@ CalAnimationAction::CalAnimationAction(CalCoreAnimation *pCoreAnimation)
 }
 
 
+ /*****************************************************************************/
+/** Resets the animation action instance.
+  *
+  * This function turns the animation action instance into a fresh instance of
+  * the given core animation, see CalAnimation::reset.
+  *
+  * @param pCoreAnimation A pointer to the core animation.
+  *****************************************************************************/
+
+void CalAnimationAction::reset(CalCoreAnimation *pCoreAnimation)
+{
+  CalAnimation::reset(pCoreAnimation);
+  setType(TYPE_ACTION);
+
+  m_manualOn = false;
+  m_sequencingMode = SequencingModeNull;
+  m_scale = 1.0;
+}
+
  /*****************************************************************************/
 /** Executes the animation action instance.
   *
@@ -65,6 +65,7 @@ namespace cal3d{
 
 	protected:
 		friend class CalMixer;
+		void reset(CalCoreAnimation *pCoreAnimation);
 		/**Tells mixer whether the animation action is on, i.e., should it apply to bones.**/
 		bool isOn();
 
@@ -39,6 +39,26 @@ CalAnimationCycle::CalAnimationCycle(CalCoreAnimation *pCoreAnimation)
   m_targetWeight = 0.0f;
 }
 
+ /*****************************************************************************/
+/** Resets the animation cycle instance.
+  *
+  * This function turns the animation cycle instance into a fresh instance of
+  * the given core animation, see CalAnimation::reset.
+  *
+  * @param pCoreAnimation A pointer to the core animation.
+  *****************************************************************************/
+
+void CalAnimationCycle::reset(CalCoreAnimation *pCoreAnimation)
+{
+  CalAnimation::reset(pCoreAnimation);
+  setType(TYPE_CYCLE);
+  setState(STATE_SYNC);
+
+  setWeight(0.0f);
+  m_targetDelay = 0.0f;
+  m_targetWeight = 0.0f;
+}
+
  /*****************************************************************************/
 /** Interpolates the weight of the animation cycle instance.
   *
@@ -28,6 +28,10 @@ namespace cal3d{
 		void setAsync(float time, float duration);
 		bool update(float deltaTime);
 
+	protected:
+		friend class CalMixer;
+		void reset(CalCoreAnimation *pCoreAnimation);
+
 	private:
 		float m_targetDelay;
 		float m_targetWeight;
@@ -22,16 +22,155 @@
 #include "cal3d/skeleton.h"
 #include "cal3d/coreskeleton.h"
 
+#include <new>
+
 
 using namespace cal3d;
+
+ /*****************************************************************************/
+/** Constructs the bone state arrays.
+  *
+  * This function is the default constructor of the bone state arrays. The
+  * arrays are empty until resize is called.
+  *****************************************************************************/
+
+CalBoneStateArrays::CalBoneStateArrays()
+  : pTranslation(0)
+  , pRotation(0)
+  , pTranslationAbsolute(0)
+  , pRotationAbsolute(0)
+  , pTranslationBoneSpace(0)
+  , pRotationBoneSpace(0)
+  , pTransformMatrix(0)
+  , m_boneCount(0)
+  , m_version(0)
+  , m_pBuffer(0)
+{
+}
+
+ /*****************************************************************************/
+/** Destructs the bone state arrays.
+  *
+  * This function is the destructor of the bone state arrays.
+  *****************************************************************************/
+
+CalBoneStateArrays::~CalBoneStateArrays()
+{
+  delete [] m_pBuffer;
+}
+
+// size of a cache line, every array of the bone state starts on one
+static const size_t BoneStateAlignment = 64;
+
+static size_t AlignBoneStateOffset(size_t offset)
+{
+  return (offset + BoneStateAlignment - 1) & ~(BoneStateAlignment - 1);
+}
+
+ /*****************************************************************************/
+/** Resizes the bone state arrays.
+  *
+  * This function allocates the arrays for the given number of bones in a
+  * single block, every array starting on a cache line, and resets every state
+  * to the identity.
+  *
+  * @param boneCount The number of bones.
+  *****************************************************************************/
+
+void CalBoneStateArrays::resize(int boneCount)
+{
+  delete [] m_pBuffer;
+  m_pBuffer = 0;
+  m_boneCount = boneCount > 0 ? boneCount : 0;
+  ++m_version;
+
+  size_t offsetTranslation = 0;
+  size_t offsetRotation = AlignBoneStateOffset(offsetTranslation + m_boneCount * sizeof(CalVector));
+  size_t offsetTranslationAbsolute = AlignBoneStateOffset(offsetRotation + m_boneCount * sizeof(CalQuaternion));
+  size_t offsetRotationAbsolute = AlignBoneStateOffset(offsetTranslationAbsolute + m_boneCount * sizeof(CalVector));
+  size_t offsetTranslationBoneSpace = AlignBoneStateOffset(offsetRotationAbsolute + m_boneCount * sizeof(CalQuaternion));
+  size_t offsetRotationBoneSpace = AlignBoneStateOffset(offsetTranslationBoneSpace + m_boneCount * sizeof(CalVector));
+  size_t offsetTransformMatrix = AlignBoneStateOffset(offsetRotationBoneSpace + m_boneCount * sizeof(CalQuaternion));
+  size_t size = offsetTransformMatrix + m_boneCount * sizeof(CalMatrix);
+
+  m_pBuffer = new char[size + BoneStateAlignment];
+  char *pBase = (char *)AlignBoneStateOffset((size_t)m_pBuffer);
+
+  pTranslation = (CalVector *)(pBase + offsetTranslation);
+  pRotation = (CalQuaternion *)(pBase + offsetRotation);
+  pTranslationAbsolute = (CalVector *)(pBase + offsetTranslationAbsolute);
+  pRotationAbsolute = (CalQuaternion *)(pBase + offsetRotationAbsolute);
+  pTranslationBoneSpace = (CalVector *)(pBase + offsetTranslationBoneSpace);
+  pRotationBoneSpace = (CalQuaternion *)(pBase + offsetRotationBoneSpace);
+  pTransformMatrix = (CalMatrix *)(pBase + offsetTransformMatrix);
+
+  for(int boneId = 0; boneId < m_boneCount; ++boneId)
+  {
+    new(pTranslation + boneId) CalVector();
+    new(pRotation + boneId) CalQuaternion();
+    new(pTranslationAbsolute + boneId) CalVector();
+    new(pRotationAbsolute + boneId) CalQuaternion();
+    new(pTranslationBoneSpace + boneId) CalVector();
+    new(pRotationBoneSpace + boneId) CalQuaternion();
+    new(pTransformMatrix + boneId) CalMatrix();
+  }
+}
+
+ /*****************************************************************************/
+/** Constructs the bone instance.
+  *
+  * This function is the constructor of a bone instance that is not part of a
+  * skeleton. It keeps its state in arrays of its own.
+  *
+  * @param coreBone A pointer to the core bone of the bone instance.
+  *****************************************************************************/
+
 CalBone::CalBone(CalCoreBone *coreBone)
   : m_pSkeleton(0)
+  , m_stateId(0)
 {
   assert(coreBone);
   m_pCoreBone = coreBone;
+  m_pOwnState = new CalBoneStateArrays();
+  m_pOwnState->resize(1);
+  m_pState = m_pOwnState;
   clearState();
 }
 
+ /*****************************************************************************/
+/** Constructs the bone instance.
+  *
+  * This function is the constructor of a bone instance of a skeleton. The bone
+  * keeps its state in the given entry of the state arrays of the skeleton.
+  *
+  * @param coreBone A pointer to the core bone of the bone instance.
+  * @param pState A pointer to the state arrays of the skeleton.
+  * @param stateId The index of the bone in the state arrays.
+  *****************************************************************************/
+
+CalBone::CalBone(CalCoreBone *coreBone, CalBoneStateArrays *pState, int stateId)
+  : m_pSkeleton(0)
+  , m_pState(pState)
+  , m_stateId(stateId)
+  , m_pOwnState(0)
+{
+  assert(coreBone);
+  assert(pState && stateId >= 0 && stateId < pState->getBoneCount());
+  m_pCoreBone = coreBone;
+  clearState();
+}
+
+ /*****************************************************************************/
+/** Destructs the bone instance.
+  *
+  * This function is the destructor of the bone instance.
+  *****************************************************************************/
+
+CalBone::~CalBone()
+{
+  delete m_pOwnState;
+}
+
 
  /*****************************************************************************/
 /** Interpolates the current state to another state.
@@ -57,6 +196,12 @@ void CalBone::blendState(float unrampedWeight, const CalVector& translation,
   // "replacement" animation attenuates the weights of the subsequent animations by
   // the inverse of its rampValue, so that when a replacement animation ramps up to
   // full, all lesser priority animations automatically ramp down to zero.
+  m_pState->touch();
+
+  const CalVector& translationRelative = m_pState->pTranslation[m_stateId];
+  CalVector& translationAbsolute = m_pState->pTranslationAbsolute[m_stateId];
+  CalQuaternion& rotationAbsolute = m_pState->pRotationAbsolute[m_stateId];
+
   float rampedWeight = unrampedWeight * rampValue;
   float attenuatedWeight = rampedWeight * m_accumulatedReplacementAttenuation;
 
@@ -81,8 +226,8 @@ void CalBone::blendState(float unrampedWeight, const CalVector& translation,
     // to be blended onto a pose.  If we scale the first state, the skeleton will look like
     // a crumpled spider.
     m_accumulatedWeightAbsolute = attenuatedWeight;
-    m_translationAbsolute = absoluteTranslation ? translation : m_translation + translation;
-    m_rotationAbsolute = rotation;
+    translationAbsolute = absoluteTranslation ? translation : translationRelative + translation;
+    rotationAbsolute = rotation;
 
     // I would like to scale this blend, but I cannot since it is the initial pose.  Thus I
     // will store away this scale and compensate appropriately on the second blend.  See below.
@@ -153,9 +298,9 @@ void CalBone::blendState(float unrampedWeight, const CalVector& translation,
     //
     assert( factor <= 1.0f );
     factor = 1.0f - m_firstBlendScale * ( 1.0f - factor );
-    CalVector newTrans(absoluteTranslation ? translation : m_translation + translation);
-    m_translationAbsolute.blend(factor, newTrans);
-    m_rotationAbsolute.blend(factor, rotation);
+    CalVector newTrans(absoluteTranslation ? translation : translationRelative + translation);
+    translationAbsolute.blend(factor, newTrans);
+    rotationAbsolute.blend(factor, rotation);
     m_accumulatedWeightAbsolute += attenuatedWeight;
     m_firstBlendScale = 1.0;
   }
@@ -169,48 +314,92 @@ void CalBone::blendState(float unrampedWeight, const CalVector& translation,
   *
   * This function calculates the current state (absolute translation and
   * rotation, as well as the bone space transformation) of the bone instance
-  * and all its children.
+  * and all its children. Bones left out by the bone LOD mask of the skeleton
+  * follow their parent, see CalSkeleton::setBoneLodMask.
   *****************************************************************************/
 
 void CalBone::calculateState()
 {
+  // get the parent bone
+  int parentId = m_pCoreBone->getParentId();
+  if(parentId == -1)
+  {
+    calculateBoneState(0);
+  }
+  else
+  {
+    const CalBone *pParent = m_pSkeleton->getBone(parentId);
+    const unsigned char *pBoneActive = m_pSkeleton->getBoneLodMask();
+    if(pBoneActive != 0 && !pBoneActive[m_stateId])
+    {
+      calculateMaskedBoneState(pParent);
+    }
+    else
+    {
+      calculateBoneState(pParent);
+    }
+  }
+
+  // calculate all child bones
+  std::list<int>::iterator iteratorChildId;
+  for(iteratorChildId = m_pCoreBone->getListChildId().begin(); iteratorChildId != m_pCoreBone->getListChildId().end(); ++iteratorChildId)
+  {
+    CalBone * bo = m_pSkeleton->getBone(*iteratorChildId);
+    bo->calculateState();
+  }
+}
+
+ /*****************************************************************************/
+/** Calculates the current state of the bone only.
+  *
+  * This function calculates the current state (absolute translation and
+  * rotation, as well as the bone space transformation) of the bone instance,
+  * but not of its children. The state of the parent must be up to date.
+  *
+  * @param pParent A pointer to the parent bone, or 0 for a root bone.
+  *****************************************************************************/
+
+void CalBone::calculateBoneState(const CalBone *pParent)
+{
+  CalVector& translation = m_pState->pTranslation[m_stateId];
+  CalQuaternion& rotation = m_pState->pRotation[m_stateId];
+  CalVector& translationAbsolute = m_pState->pTranslationAbsolute[m_stateId];
+  CalQuaternion& rotationAbsolute = m_pState->pRotationAbsolute[m_stateId];
+  CalVector& translationBoneSpace = m_pState->pTranslationBoneSpace[m_stateId];
+  CalQuaternion& rotationBoneSpace = m_pState->pRotationBoneSpace[m_stateId];
+  CalMatrix& transformMatrix = m_pState->pTransformMatrix[m_stateId];
+
+  m_pState->touch();
+
   // check if the bone was not touched by any active animation
   if(m_accumulatedWeight == 0.0f)
   {
     // set the bone to the initial skeleton state
-    m_translation = m_pCoreBone->getTranslation();
-    m_rotation = m_pCoreBone->getRotation();
+    translation = m_pCoreBone->getTranslation();
+    rotation = m_pCoreBone->getRotation();
   }
 
-  // get parent bone id
-  int parentId;
-  parentId = m_pCoreBone->getParentId();
-
-  if(parentId == -1)
+  if(pParent == 0)
   {
     // no parent, this means absolute state == relative state
-    m_translationAbsolute = m_translation;
-    m_rotationAbsolute = m_rotation;
+    translationAbsolute = translation;
+    rotationAbsolute = rotation;
   }
   else
   {
-    // get the parent bone
-    const CalBone *pParent;
-    pParent = m_pSkeleton->getBone(parentId);
-
     // transform relative state with the absolute state of the parent
-    m_translationAbsolute = m_translation;
-    m_translationAbsolute *= pParent->getRotationAbsolute();
-    m_translationAbsolute += pParent->getTranslationAbsolute();
+    translationAbsolute = translation;
+    translationAbsolute *= pParent->getRotationAbsolute();
+    translationAbsolute += pParent->getTranslationAbsolute();
 
-    m_rotationAbsolute = m_rotation;
-    m_rotationAbsolute *= pParent->getRotationAbsolute();
+    rotationAbsolute = rotation;
+    rotationAbsolute *= pParent->getRotationAbsolute();
   }
 
   // calculate the bone space transformation
-  m_translationBoneSpace = m_pCoreBone->getTranslationBoneSpace();
+  translationBoneSpace = m_pCoreBone->getTranslationBoneSpace();
 
-  // Must go before the *= m_rotationAbsolute.
+  // Must go before the *= rotationAbsolute.
   bool meshScalingOn;
   if( m_meshScaleAbsolute.x != 1 || m_meshScaleAbsolute.y != 1 || m_meshScaleAbsolute.z != 1 ) {
     meshScalingOn = true;
@@ -282,48 +471,76 @@ void CalBone::calculateState()
 
     CalQuaternion coreBoneRotBoneSpaceInverse = m_pCoreBone->getRotationBoneSpace();
     coreBoneRotBoneSpaceInverse.invert();
-    m_translationBoneSpace *= coreBoneRotBoneSpaceInverse;
-    m_translationBoneSpace.x *= m_meshScaleAbsolute.x;
-    m_translationBoneSpace.y *= m_meshScaleAbsolute.y;
-    m_translationBoneSpace.z *= m_meshScaleAbsolute.z;
-    m_translationBoneSpace *= m_pCoreBone->getRotationBoneSpace();
+    translationBoneSpace *= coreBoneRotBoneSpaceInverse;
+    translationBoneSpace.x *= m_meshScaleAbsolute.x;
+    translationBoneSpace.y *= m_meshScaleAbsolute.y;
+    translationBoneSpace.z *= m_meshScaleAbsolute.z;
+    translationBoneSpace *= m_pCoreBone->getRotationBoneSpace();
 
   } else {
     meshScalingOn = false;
   }
-  m_translationBoneSpace *= m_rotationAbsolute;
-  m_translationBoneSpace += m_translationAbsolute;
+  translationBoneSpace *= rotationAbsolute;
+  translationBoneSpace += translationAbsolute;
 
-  m_rotationBoneSpace = m_pCoreBone->getRotationBoneSpace();
-  m_rotationBoneSpace *= m_rotationAbsolute;
+  rotationBoneSpace = m_pCoreBone->getRotationBoneSpace();
+  rotationBoneSpace *= rotationAbsolute;
 
-  m_transformMatrix = m_pCoreBone->getRotationBoneSpace();
+  transformMatrix = m_pCoreBone->getRotationBoneSpace();
   if( meshScalingOn ) {
 
     // By applying each scale component to the row, instead of the column, we
     // are effectively making the scale apply prior to the rotationBoneSpace.
-    m_transformMatrix.dxdx *= m_meshScaleAbsolute.x;
-    m_transformMatrix.dydx *= m_meshScaleAbsolute.x;
-    m_transformMatrix.dzdx *= m_meshScaleAbsolute.x;  
+    transformMatrix.dxdx *= m_meshScaleAbsolute.x;
+    transformMatrix.dydx *= m_meshScaleAbsolute.x;
+    transformMatrix.dzdx *= m_meshScaleAbsolute.x;  
 
-    m_transformMatrix.dxdy *= m_meshScaleAbsolute.y;
-    m_transformMatrix.dydy *= m_meshScaleAbsolute.y;
-    m_transformMatrix.dzdy *= m_meshScaleAbsolute.y;  
+    transformMatrix.dxdy *= m_meshScaleAbsolute.y;
+    transformMatrix.dydy *= m_meshScaleAbsolute.y;
+    transformMatrix.dzdy *= m_meshScaleAbsolute.y;  
 
-    m_transformMatrix.dxdz *= m_meshScaleAbsolute.z;
-    m_transformMatrix.dydz *= m_meshScaleAbsolute.z;
-    m_transformMatrix.dzdz *= m_meshScaleAbsolute.z;  
+    transformMatrix.dxdz *= m_meshScaleAbsolute.z;
+    transformMatrix.dydz *= m_meshScaleAbsolute.z;
+    transformMatrix.dzdz *= m_meshScaleAbsolute.z;  
   }
-  m_transformMatrix *= m_rotationAbsolute;
+  transformMatrix *= rotationAbsolute;
+}
 
-  // calculate all child bones
-  std::list<int>::iterator iteratorChildId;
-  int i = 0;
-  for(iteratorChildId = m_pCoreBone->getListChildId().begin(); iteratorChildId != m_pCoreBone->getListChildId().end(); ++iteratorChildId, i++ )
-  {
-    CalBone * bo = m_pSkeleton->getBone(*iteratorChildId);
-    bo->calculateState();
-  }
+ /*****************************************************************************/
+/** Calculates the current state of a bone left out by the bone LOD.
+  *
+  * This function resets the relative state of the bone instance to its core
+  * state and calculates its absolute state from the state of its parent. As
+  * the bone is then placed relative to its parent as in the core skeleton, its
+  * bone space transformation is the one of its parent, which is copied instead
+  * of being calculated. Mesh scaling of the bone is not applied. The state of
+  * the parent must be up to date.
+  *
+  * @param pParent A pointer to the parent bone.
+  *****************************************************************************/
+
+void CalBone::calculateMaskedBoneState(const CalBone *pParent)
+{
+  m_pState->touch();
+
+  CalVector& translation = m_pState->pTranslation[m_stateId];
+  CalQuaternion& rotation = m_pState->pRotation[m_stateId];
+  CalVector& translationAbsolute = m_pState->pTranslationAbsolute[m_stateId];
+  CalQuaternion& rotationAbsolute = m_pState->pRotationAbsolute[m_stateId];
+
+  translation = m_pCoreBone->getTranslation();
+  rotation = m_pCoreBone->getRotation();
+
+  translationAbsolute = translation;
+  translationAbsolute *= pParent->getRotationAbsolute();
+  translationAbsolute += pParent->getTranslationAbsolute();
+
+  rotationAbsolute = rotation;
+  rotationAbsolute *= pParent->getRotationAbsolute();
+
+  m_pState->pTranslationBoneSpace[m_stateId] = pParent->getTranslationBoneSpace();
+  m_pState->pRotationBoneSpace[m_stateId] = pParent->getRotationBoneSpace();
+  m_pState->pTransformMatrix[m_stateId] = pParent->getTransformMatrix();
 }
 
  /*****************************************************************************/
@@ -335,6 +552,7 @@ void CalBone::calculateState()
 
 void CalBone::clearState()
 {
+  m_pState->touch();
   m_accumulatedWeight = 0.0f;
   m_accumulatedWeightAbsolute = 0.0f;
   m_accumulatedReplacementAttenuation = 1.0f;
@@ -350,8 +568,9 @@ void CalBone::clearState()
   *****************************************************************************/
 void CalBone::setCoreTransformStateVariables()
 {
-   m_translation = m_pCoreBone->getTranslation();
-   m_rotation = m_pCoreBone->getRotation();
+   m_pState->touch();
+   m_pState->pTranslation[m_stateId] = m_pCoreBone->getTranslation();
+   m_pState->pRotation[m_stateId] = m_pCoreBone->getRotation();
 }
 
  /*****************************************************************************/
@@ -385,8 +604,9 @@ void CalBone::setCoreState()
 void CalBone::setCoreStateRecursive()
 {
   // set the bone to the initial skeleton state
-  m_translation = m_pCoreBone->getTranslation();
-  m_rotation = m_pCoreBone->getRotation();
+  m_pState->touch();
+  m_pState->pTranslation[m_stateId] = m_pCoreBone->getTranslation();
+  m_pState->pRotation[m_stateId] = m_pCoreBone->getRotation();
 
   // set the appropriate weights
   m_accumulatedWeightAbsolute = 1.0f;
@@ -429,6 +649,8 @@ void CalBone::setCoreStateRecursive()
 
 void CalBone::lockState()
 {
+  m_pState->touch();
+
   // clamp accumulated weight
   if(m_accumulatedWeightAbsolute > 1.0f - m_accumulatedWeight)
   {
@@ -440,8 +662,8 @@ void CalBone::lockState()
     if(m_accumulatedWeight == 0.0f)
     {
       // it is the first state, so we can just copy it into the bone state
-      m_translation = m_translationAbsolute;
-      m_rotation = m_rotationAbsolute;
+      m_pState->pTranslation[m_stateId] = m_pState->pTranslationAbsolute[m_stateId];
+      m_pState->pRotation[m_stateId] = m_pState->pRotationAbsolute[m_stateId];
 
       m_accumulatedWeight = m_accumulatedWeightAbsolute;
     }
@@ -451,8 +673,8 @@ void CalBone::lockState()
       float factor;
       factor = m_accumulatedWeightAbsolute / (m_accumulatedWeight + m_accumulatedWeightAbsolute);
 
-      m_translation.blend(factor, m_translationAbsolute);
-      m_rotation.blend(factor, m_rotationAbsolute);
+      m_pState->pTranslation[m_stateId].blend(factor, m_pState->pTranslationAbsolute[m_stateId]);
+      m_pState->pRotation[m_stateId].blend(factor, m_pState->pRotationAbsolute[m_stateId]);
 
       m_accumulatedWeight += m_accumulatedWeightAbsolute;
     }
@@ -25,11 +25,49 @@ namespace cal3d{
 	class CalCoreModel;
 
 
-	class CAL3D_API CalBone
+	/** The per-frame state of a set of bones, one array per attribute, indexed
+	  * by bone id. A skeleton keeps the state of all its bones in one such set,
+	  * every array starting on a cache line, and its bones only refer to it. **/
+	class CAL3D_API CalBoneStateArrays : NonCopyable
+	{
+	public:
+		CalBoneStateArrays();
+		~CalBoneStateArrays();
+
+		/** reallocates the arrays for the given number of bones, resetting all states**/
+		void resize(int boneCount);
+		/** returns the number of bones of the arrays**/
+		inline int getBoneCount() const                         { return m_boneCount; }
+		/** returns a counter that changes whenever the state of a bone changes**/
+		inline unsigned int getVersion() const                  { return m_version; }
+		/** marks the state of the bones as changed**/
+		inline void touch()                                     { ++m_version; }
+
+		CalVector     *pTranslation;
+		CalQuaternion *pRotation;
+		CalVector     *pTranslationAbsolute;
+		CalQuaternion *pRotationAbsolute;
+		CalVector     *pTranslationBoneSpace;
+		CalQuaternion *pRotationBoneSpace;
+		CalMatrix     *pTransformMatrix;
+
+	private:
+		int          m_boneCount;
+		unsigned int m_version;
+		char        *m_pBuffer;
+	};
+
+
+	/** A bone of a skeleton instance. Its per-frame state lives in the
+	  * CalBoneStateArrays of its skeleton, or in arrays of its own for a bone
+	  * constructed without a skeleton, so bones are not copyable: a copy would
+	  * share the state of the original. The state getters return references
+	  * into these arrays. **/
+	class CAL3D_API CalBone : NonCopyable
 	{
 	public:
 		CalBone(CalCoreBone *coreBone);
-		~CalBone() { }
+		~CalBone();
 
 		/**get the core bone model of this bone instance**/
 		CalCoreBone *getCoreBone()                              { return m_pCoreBone; }
@@ -47,27 +85,27 @@ namespace cal3d{
 		inline const CalBoundingBox & getBoundingBox()          { return m_boundingBox; }
 
 		/**get updated absolute transform matrix of the bone**/
-		inline const CalMatrix& getTransformMatrix() const      { return m_transformMatrix; }
+		inline const CalMatrix& getTransformMatrix() const      { return m_pState->pTransformMatrix[m_stateId]; }
 		/**get updated absolute translation of the bone**/
-		inline const CalVector& getTranslationAbsolute() const{ return m_translationAbsolute; }
+		inline const CalVector& getTranslationAbsolute() const{ return m_pState->pTranslationAbsolute[m_stateId]; }
 		/**returns the updated absolute rotation of the bone instance.**/
-		inline const CalQuaternion& getRotationAbsolute() const { return m_rotationAbsolute; }
+		inline const CalQuaternion& getRotationAbsolute() const { return m_pState->pRotationAbsolute[m_stateId]; }
 
 		/**get updated translation to bring a point into the bone instance space.**/
-		inline const CalVector& getTranslationBoneSpace() const { return m_translationBoneSpace; }
+		inline const CalVector& getTranslationBoneSpace() const { return m_pState->pTranslationBoneSpace[m_stateId]; }
 		/**returns the updated rotation to bring a point into the bone instance space.**/
-		inline const CalQuaternion& getRotationBoneSpace() const{ return m_rotationBoneSpace; }
+		inline const CalQuaternion& getRotationBoneSpace() const{ return m_pState->pRotationBoneSpace[m_stateId]; }
 
 
 		/** Caveat: For theses changes to appear, calculateState() must be called  afterwards.**/
 		/**sets the current relative translation of the bone instance.**/
-		inline void setTranslation(const CalVector& translation){ m_translation = translation;  m_accumulatedWeightAbsolute = 1.0f; m_accumulatedWeight = 1.0f; }
+		inline void setTranslation(const CalVector& translation){ m_pState->pTranslation[m_stateId] = translation;  m_accumulatedWeightAbsolute = 1.0f; m_accumulatedWeight = 1.0f; m_pState->touch(); }
 		/**get  translation of the bone relative**/
-		inline const CalVector& getTranslation() const          { return m_translation; }
+		inline const CalVector& getTranslation() const          { return m_pState->pTranslation[m_stateId]; }
 		/**sets the current relative rotation of the bone instance.**/
-		inline void setRotation(const CalQuaternion& rotation)  { m_rotation = rotation;        m_accumulatedWeightAbsolute = 1.0f;  m_accumulatedWeight = 1.0f; }
+		inline void setRotation(const CalQuaternion& rotation)  { m_pState->pRotation[m_stateId] = rotation;        m_accumulatedWeightAbsolute = 1.0f;  m_accumulatedWeight = 1.0f; m_pState->touch(); }
 		/**get  rotation of the bone relative**/
-		inline const CalQuaternion& getRotation() const         { return m_rotation; }
+		inline const CalQuaternion& getRotation() const         { return m_pState->pRotation[m_stateId]; }
 
 
 		/** updates AbsoluteTransformMatrix and BoneSpaceTransform of the bone instance and all its children.**/
@@ -84,8 +122,15 @@ namespace cal3d{
 		void lockState();
 	protected:
 		friend class CalMixer;
+		friend class CalSkeleton;
+		/** constructs a bone using the given entry of the state arrays of its skeleton**/
+		CalBone(CalCoreBone *coreBone, CalBoneStateArrays *pState, int stateId);
+		/** updates AbsoluteTransformMatrix and BoneSpaceTransform of the bone instance only, from the state of its parent.**/
+		void calculateBoneState(const CalBone *pParent);
+		/** resets the bone to its core state and gives it the bone space transformation of its parent.**/
+		void calculateMaskedBoneState(const CalBone *pParent);
 		// w.r.t. absolute coord system in 3dsMax (Z up), not local coord of bone.
-		inline void setMeshScaleAbsolute(CalVector const & sv) { m_meshScaleAbsolute = sv; }
+		inline void setMeshScaleAbsolute(CalVector const & sv) { m_meshScaleAbsolute = sv; m_pState->touch(); }
 		/** interpolates the current state (relative translation and
 		* rotation) of the bone instance to another state of a given weight.
 		*
@@ -109,13 +154,9 @@ namespace cal3d{
 		float          m_accumulatedReplacementAttenuation;
 		float          m_firstBlendScale;
 		CalVector      m_meshScaleAbsolute; // w.r.t. absolute coord system in 3dsMax (Z up), not local coord of bone.
-		CalVector      m_translation;
-		CalQuaternion  m_rotation;
-		CalVector      m_translationAbsolute;
-		CalQuaternion  m_rotationAbsolute;
-		CalVector      m_translationBoneSpace;
-		CalQuaternion  m_rotationBoneSpace;
-		CalMatrix      m_transformMatrix;
+		CalBoneStateArrays *m_pState;
+		int            m_stateId;
+		CalBoneStateArrays *m_pOwnState; // state of a bone that is not part of a skeleton
 		CalBoundingBox m_boundingBox;
 	};
 }
@@ -39,10 +39,12 @@
 #include "cal3d/mesh.h"
 #include "cal3d/mixer.h"
 #include "cal3d/model.h"
+#include "cal3d/modelbatch.h"
 #include "cal3d/morphtargetmixer.h"
 #include "cal3d/physique.h"
 #include "cal3d/physiquedualquaternion.h"
 #include "cal3d/platform.h"
+#include "cal3d/posecache.h"
 #include "cal3d/quaternion.h"
 #include "cal3d/renderer.h"
 #include "cal3d/saver.h"
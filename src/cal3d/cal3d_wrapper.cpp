@@ -1165,14 +1165,14 @@ int cal3d::CalCoreSubmesh_GetVertexCount(CalCoreSubmesh *self)
 
 int cal3d::CalCoreSubmesh_GetVertexInfluenceCount(struct CalCoreSubmesh *self, int vertID)
 {
-	return self->getVectorVertex()[ vertID ].vectorInfluence.size();
+	return self->getInfluenceCount( vertID );
 }
 
 int cal3d::CalCoreSubmesh_GetVertexInfluence(struct CalCoreSubmesh *self, int vertID,
 									int influenceID, float* outWeight )
 {
-	CalCoreSubmesh::Influence&	theInfluence =
-		self->getVectorVertex()[ vertID ].vectorInfluence[ influenceID ];
+	const CalCoreSubmesh::Influence&	theInfluence =
+		self->getInfluences( vertID )[ influenceID ];
 
 	*outWeight = theInfluence.weight;
 	return theInfluence.boneId;
@@ -1185,10 +1185,10 @@ CalCoreSubmesh *CalCoreSubmesh_New()
 
 void cal3d::CalCoreSubmesh_GetVertex(struct CalCoreSubmesh* self, int vertID, float* outPosition, float* outNormal)
 {
-	std::vector<CalCoreSubmesh::Vertex>&	vertices( self->getVectorVertex() );
+	const std::vector<CalCoreSubmesh::Vertex>&	vertices( self->getVectorVertex() );
 	if ( (vertID >= 0) && (vertID < vertices.size()) )
 	{
-		CalCoreSubmesh::Vertex&		theVertex( vertices[ vertID ] );
+		const CalCoreSubmesh::Vertex&	theVertex( vertices[ vertID ] );
 
 		outPosition[0] = theVertex.position.x;
 		outPosition[1] = theVertex.position.y;
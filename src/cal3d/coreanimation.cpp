@@ -16,6 +16,8 @@
 #include "cal3d/coretrack.h"
 #include "cal3d/coreskeleton.h"
 #include "cal3d/corebone.h"
+#include "cal3d/loader.h"
+#include "cal3d/error.h"
 
 using namespace cal3d;
 
@@ -50,13 +52,10 @@ bool CalCoreAnimation::removeCoreTrack(CalCoreTrack *pCoreTrack){
 	std::list<CalCoreTrack *>::iterator iteratorCoreTrack;
 	for (iteratorCoreTrack = m_listCoreTrack.begin(); iteratorCoreTrack != m_listCoreTrack.end(); ++iteratorCoreTrack)
 	{
-		// get the core bone
-		CalCoreTrack *pCoreTrack;
-		pCoreTrack = *iteratorCoreTrack;
-
-		// check if we found the matching core bone
-		if (pCoreTrack == pCoreTrack) {
+		// check if we found the matching core track
+		if (*iteratorCoreTrack == pCoreTrack) {
 			m_listCoreTrack.erase(iteratorCoreTrack);
+			m_vectorCoreTrack.assign(m_listCoreTrack.begin(), m_listCoreTrack.end());
 			return true;
 		}
 	}
@@ -65,6 +64,7 @@ bool CalCoreAnimation::removeCoreTrack(CalCoreTrack *pCoreTrack){
 bool CalCoreAnimation::addCoreTrack(CalCoreTrack *pCoreTrack)
 {
 	m_listCoreTrack.push_back(pCoreTrack);
+	m_vectorCoreTrack.push_back(pCoreTrack);
 
 	return true;
 }
@@ -133,6 +133,53 @@ tr->fillInvalidTranslations( trans );
 
 */
 
+/*****************************************************************************/
+/** Samples the pose of the core animation.
+  *
+  * This function samples every track of the core animation at the given time
+  * in a single pass over the tracks, and stores the states in arrays indexed
+  * by core bone id. The arrays must hold an entry for every bone of the
+  * skeleton; the entries of bones without a track are not changed. A track
+  * without keyframes stores the identity state.
+  *
+  * @param time The time in seconds at which the pose should be sampled.
+  * @param pTranslation A pointer to the translation array to fill.
+  * @param pRotation A pointer to the rotation array to fill.
+  * @param pKeyframeCursor A pointer to one keyframe cursor per track, in track
+  *                        order, see CalCoreTrack::getState, or 0.
+  * @param pBoneActive A pointer to one flag per core bone, the tracks of the
+  *                    bones with a zero flag being skipped, see
+  *                    CalSkeleton::setBoneLodMask, or 0 to sample all tracks.
+  *****************************************************************************/
+
+void CalCoreAnimation::samplePose(float time, CalVector *pTranslation, CalQuaternion *pRotation, int *pKeyframeCursor, const unsigned char *pBoneActive) const
+{
+	const int trackCount = (int)m_vectorCoreTrack.size();
+	for (int trackId = 0; trackId < trackCount; ++trackId)
+	{
+		const CalCoreTrack *pCoreTrack = m_vectorCoreTrack[trackId];
+		const int coreBoneId = pCoreTrack->getCoreBoneId();
+
+		if (pBoneActive != 0 && !pBoneActive[coreBoneId]) continue;
+
+		bool sampled;
+		if (pKeyframeCursor != 0)
+		{
+			sampled = pCoreTrack->getState(time, pTranslation[coreBoneId], pRotation[coreBoneId], pKeyframeCursor[trackId]);
+		}
+		else
+		{
+			sampled = pCoreTrack->getState(time, pTranslation[coreBoneId], pRotation[coreBoneId]);
+		}
+
+		if (!sampled)
+		{
+			pTranslation[coreBoneId] = CalVector();
+			pRotation[coreBoneId] = CalQuaternion();
+		}
+	}
+}
+
 /*****************************************************************************/
 /** Scale the core animation.
   *
@@ -154,6 +201,153 @@ void CalCoreAnimation::scale(float factor)
 
 
 
+/*****************************************************************************/
+/** Resamples the core animation.
+  *
+  * This function resamples every track of the core animation to evenly spaced
+  * keyframes over the duration of the animation, so that sampling a track
+  * computes the keyframe interval from the time instead of searching for it.
+  * Resampling is lossy; use checkFidelity against the original animation to
+  * verify the result.
+  *
+  * @param keyframeRate The number of keyframes per second.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if an error happened
+  *****************************************************************************/
+
+bool CalCoreAnimation::resample(float keyframeRate)
+{
+	std::list<CalCoreTrack *>::iterator iteratorCoreTrack;
+	for (iteratorCoreTrack = m_listCoreTrack.begin(); iteratorCoreTrack != m_listCoreTrack.end(); ++iteratorCoreTrack)
+	{
+		if (!(*iteratorCoreTrack)->resample(keyframeRate, m_duration)) return false;
+	}
+	return true;
+}
+
+/*****************************************************************************/
+/** Quantizes the core animation.
+  *
+  * This function quantizes the keyframes of every track of the core
+  * animation, see CalCoreTrack::quantize. Compare size() before and after to
+  * get the memory saved, and use checkFidelity against the original animation
+  * to verify the result.
+  *****************************************************************************/
+
+void CalCoreAnimation::quantize()
+{
+	std::list<CalCoreTrack *>::iterator iteratorCoreTrack;
+	for (iteratorCoreTrack = m_listCoreTrack.begin(); iteratorCoreTrack != m_listCoreTrack.end(); ++iteratorCoreTrack)
+	{
+		(*iteratorCoreTrack)->quantize();
+	}
+}
+
+/*****************************************************************************/
+/** Measures how far the core animation is from another one.
+  *
+  * This function compares the tracks of the two core animations bone by bone
+  * and returns the largest differences between their states.
+  *
+  * @param pCoreAnimation The core animation to compare with.
+  * @param maxTranslationError A reference to the largest translation distance.
+  * @param maxRotationErrorDegrees A reference to the largest rotation angle in
+  *                                degrees.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if the animations do not animate the same bones
+  *****************************************************************************/
+
+bool CalCoreAnimation::getStateError(const CalCoreAnimation *pCoreAnimation, float& maxTranslationError, float& maxRotationErrorDegrees) const
+{
+	maxTranslationError = 0.0f;
+	maxRotationErrorDegrees = 0.0f;
+
+	if (pCoreAnimation == 0 || pCoreAnimation->m_listCoreTrack.size() != m_listCoreTrack.size())
+	{
+		CalError::setLastError(CalError::INVALID_HANDLE, __FILE__, __LINE__);
+		return false;
+	}
+
+	std::list<CalCoreTrack *>::const_iterator iteratorCoreTrack;
+	for (iteratorCoreTrack = m_listCoreTrack.begin(); iteratorCoreTrack != m_listCoreTrack.end(); ++iteratorCoreTrack)
+	{
+		const CalCoreTrack *pCoreTrack = *iteratorCoreTrack;
+
+		// find the track of the same bone in the other animation
+		const CalCoreTrack *pOtherCoreTrack = 0;
+		std::list<CalCoreTrack *>::const_iterator iteratorOtherCoreTrack;
+		for (iteratorOtherCoreTrack = pCoreAnimation->m_listCoreTrack.begin(); iteratorOtherCoreTrack != pCoreAnimation->m_listCoreTrack.end(); ++iteratorOtherCoreTrack)
+		{
+			if ((*iteratorOtherCoreTrack)->getCoreBoneId() == pCoreTrack->getCoreBoneId())
+			{
+				pOtherCoreTrack = *iteratorOtherCoreTrack;
+				break;
+			}
+		}
+
+		if (pOtherCoreTrack == 0)
+		{
+			CalError::setLastError(CalError::INVALID_HANDLE, __FILE__, __LINE__);
+			return false;
+		}
+
+		float translationError, rotationErrorDegrees;
+		pCoreTrack->getStateError(*pOtherCoreTrack, m_duration, translationError, rotationErrorDegrees);
+		if (translationError > maxTranslationError) maxTranslationError = translationError;
+		if (rotationErrorDegrees > maxRotationErrorDegrees) maxRotationErrorDegrees = rotationErrorDegrees;
+	}
+
+	return true;
+}
+
+/*****************************************************************************/
+/** Checks the core animation against another one.
+  *
+  * This function checks that the states of the core animation stay within the
+  * animation tolerances of CalLoader of the states of another core animation,
+  * typically the original of a resampled animation.
+  *
+  * @param pCoreAnimation The core animation to compare with.
+  *
+  * @return One of the following values:
+  *         \li \b true if the animations are within the tolerances
+  *         \li \b false if they are not or if an error happened
+  *****************************************************************************/
+
+bool CalCoreAnimation::checkFidelity(const CalCoreAnimation *pCoreAnimation) const
+{
+	return checkFidelity(pCoreAnimation, CalLoader::getAnimationTranslationTolerance(), CalLoader::getAnimationRotationToleranceDegrees());
+}
+
+/*****************************************************************************/
+/** Checks the core animation against another one.
+  *
+  * This function checks that the states of the core animation stay within the
+  * given tolerances of the states of another core animation.
+  *
+  * @param pCoreAnimation The core animation to compare with.
+  * @param translationTolerance The largest allowed translation distance.
+  * @param rotationToleranceDegrees The largest allowed rotation angle in
+  *                                 degrees.
+  *
+  * @return One of the following values:
+  *         \li \b true if the animations are within the tolerances
+  *         \li \b false if they are not or if an error happened
+  *****************************************************************************/
+
+bool CalCoreAnimation::checkFidelity(const CalCoreAnimation *pCoreAnimation, double translationTolerance, double rotationToleranceDegrees) const
+{
+	float maxTranslationError, maxRotationErrorDegrees;
+	if (!getStateError(pCoreAnimation, maxTranslationError, maxRotationErrorDegrees)) return false;
+
+	return maxTranslationError <= translationTolerance && maxRotationErrorDegrees <= rotationToleranceDegrees;
+}
+
+
 /*****************************************************************************/
 /**
   * Add a callback to the current list of callbacks for this CoreAnim.
@@ -12,6 +12,7 @@
 #define CAL_COREANIMATION_H
 
 #include "cal3d/global.h"
+#include "cal3d/vector.h"
 #include "cal3d/quaternion.h"
 #include "cal3d/refcounted.h"
 #include "cal3d/refptr.h"
@@ -51,6 +52,11 @@ namespace cal3d{
 		CalCoreTrack *getCoreTrack(int coreBoneId);
 		/** return the list of tracks **/
 		inline const std::list<CalCoreTrack *>& getListCoreTrack() const { return m_listCoreTrack; }
+		/** return the tracks, in the same order as the list **/
+		inline const std::vector<CalCoreTrack *>& getVectorCoreTrack() const { return m_vectorCoreTrack; }
+
+		/** sample all the tracks at a time into arrays indexed by core bone id **/
+		void samplePose(float time, CalVector *pTranslation, CalQuaternion *pRotation, int *pKeyframeCursor = 0, const unsigned char *pBoneActive = 0) const;
 
 		/** return keyframe count of all tracks **/
 		unsigned int getTotalKeyframesCount() const;
@@ -59,6 +65,18 @@ namespace cal3d{
 		 * @param factor A float with the scale factor   **/
 		void scale(float factor);
 
+		/** resample all the tracks to evenly spaced keyframes
+		 * @param keyframeRate The number of keyframes per second   **/
+		bool resample(float keyframeRate);
+		/** quantize the keyframes of all the tracks, they are decoded when sampled **/
+		void quantize();
+		/** return the largest differences between the states of this and another core animation **/
+		bool getStateError(const CalCoreAnimation *pCoreAnimation, float& maxTranslationError, float& maxRotationErrorDegrees) const;
+		/** check that this core animation is within the CalLoader animation tolerances of another one **/
+		bool checkFidelity(const CalCoreAnimation *pCoreAnimation) const;
+		/** check that this core animation is within given tolerances of another one **/
+		bool checkFidelity(const CalCoreAnimation *pCoreAnimation, double translationTolerance, double rotationToleranceDegrees) const;
+
 		struct CallbackRecord
 		{
 			CalAnimationCallback *callback;
@@ -80,6 +98,7 @@ namespace cal3d{
 
 		float m_duration;
 		std::list<CalCoreTrack *> m_listCoreTrack;
+		std::vector<CalCoreTrack *> m_vectorCoreTrack;
 		std::string m_name;
 		std::string m_filename;
 	};
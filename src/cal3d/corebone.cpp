@@ -39,6 +39,27 @@ CalCoreBone::CalCoreBone(const std::string& name)
 {
 }
 
+ /*****************************************************************************/
+/** Adds a child ID.
+  *
+  * This function adds a core bone ID to the child ID list of the core bone
+  * instance. The bone order of the core skeleton owning the core bone is out
+  * of date afterwards, see CalCoreSkeleton::invalidateBoneOrder.
+  *
+  * @param childId The ID of the core bone that shoud be added to the child ID
+  *                list.
+  *****************************************************************************/
+
+void CalCoreBone::addChildId(int childId)
+{
+  m_listChildId.push_back(childId);
+
+  if(m_pCoreSkeleton != 0)
+  {
+    m_pCoreSkeleton->invalidateBoneOrder();
+  }
+}
+
  /*****************************************************************************/
 /** remove a child ID.
   *
@@ -57,12 +78,33 @@ bool CalCoreBone::removeChildId(int childId)
 	for (std::list<int>::iterator it = m_listChildId.begin(); it != m_listChildId.end(); it++){
 		if (*it == childId){
 			m_listChildId.erase(it);
+			if (m_pCoreSkeleton != 0) m_pCoreSkeleton->invalidateBoneOrder();
 			return true;
 		}
     }
 	return false;
 }
 
+ /*****************************************************************************/
+/** Sets the parent ID.
+  *
+  * This function sets the ID of the parent core bone of the core bone
+  * instance. The bone order of the core skeleton owning the core bone is out
+  * of date afterwards, see CalCoreSkeleton::invalidateBoneOrder.
+  *
+  * @param parentId The ID of the parent core bone, or -1 for a root bone.
+  *****************************************************************************/
+
+void CalCoreBone::setParentId(int parentId)
+{
+  m_parentId = parentId;
+
+  if(m_pCoreSkeleton != 0)
+  {
+    m_pCoreSkeleton->invalidateBoneOrder();
+  }
+}
+
  /*****************************************************************************/
 /** Calculates the current state.
   *
@@ -128,12 +170,14 @@ void CalCoreBone::calculateBoundingBox(CalCoreModel * pCoreModel)
 
          if(pCoreSubmesh->getSpringCount()==0)
          {
-            std::vector<CalCoreSubmesh::Vertex>& vectorVertex =  pCoreSubmesh->getVectorVertex();
+            const std::vector<CalCoreSubmesh::Vertex>& vectorVertex =  pCoreSubmesh->getVectorVertex();
             for(size_t vertexId=0;vertexId <vectorVertex.size(); ++vertexId)
             {
-               for(size_t influenceId=0;influenceId<vectorVertex[vertexId].vectorInfluence.size();++influenceId)
+               const CalCoreSubmesh::Influence *pInfluence = pCoreSubmesh->getInfluences((int)vertexId);
+               int influenceCount = pCoreSubmesh->getInfluenceCount((int)vertexId);
+               for(int influenceId=0;influenceId<influenceCount;++influenceId)
                {
-                  CalCoreSubmesh::Influence &influence = vectorVertex[vertexId].vectorInfluence[influenceId];
+                  const CalCoreSubmesh::Influence &influence = pInfluence[influenceId];
                   if(influence.boneId == boneId && influence.weight > 0.5f)
                   {
                      const bool updated = updateBoundingBox(vectorVertex[vertexId].position);
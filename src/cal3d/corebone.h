@@ -46,12 +46,12 @@ namespace cal3d{
 
 		/**add a core bone ID to the child ID list of the core bone
 		* @param childId The ID of the core bone (in the skel) that shoud be added to the child  **/
-		inline void addChildId(int childId)				{ m_listChildId.push_back(childId); }
+		void addChildId(int childId);
 		/**remove a core bone ID to the child ID list of the core bone
 		* @param childId The ID of the core bone (in the skel) that shoud be added to the child  **/
 		bool removeChildId(int childid);
 
-		/** return the list of children bones indices**/
+		/** return the list of children bones indices; call CalCoreSkeleton::invalidateBoneOrder after editing it**/
 		inline std::list<int>& getListChildId()				{ return m_listChildId; }
 		/** return the list of children bones indices**/
 		inline const std::list<int>& getListChildId() const		{ return m_listChildId; }
@@ -64,7 +64,7 @@ namespace cal3d{
 		/** get the index of the parent bone int the skeleton**/
 		inline int getParentId() const					{ return m_parentId; }
 		/** set the index of the parent bone int the skeleton**/
-		inline void setParentId(int parentId)				{ m_parentId = parentId; }
+		void setParentId(int parentId);
 
 		/**get the user data stored in the core bone instance.**/
 		inline Cal::UserData getUserData()				{ return m_userData; }
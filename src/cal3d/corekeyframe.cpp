@@ -17,6 +17,7 @@
 //****************************************************************************//
 
 #include "cal3d/corekeyframe.h"
+#include "cal3d/coretrack.h"
 
 using namespace cal3d;
 
@@ -28,9 +29,52 @@ using namespace cal3d;
 
 CalCoreKeyframe::CalCoreKeyframe()
   : m_time(0.0f)
+  , m_pCoreTrack(0)
+  , m_keyframeId(-1)
 {
 }
 
+ /*****************************************************************************/
+/** Copy-constructs the core keyframe instance.
+  *
+  * This function copies the state of a keyframe. The copy is not linked to the
+  * track of the original.
+  *
+  * @param other The keyframe to copy.
+  *****************************************************************************/
+
+CalCoreKeyframe::CalCoreKeyframe(const CalCoreKeyframe& other)
+  : m_time(other.m_time)
+  , m_translation(other.m_translation)
+  , m_rotation(other.m_rotation)
+  , m_pCoreTrack(0)
+  , m_keyframeId(-1)
+{
+}
+
+ /*****************************************************************************/
+/** Assigns the state of another keyframe.
+  *
+  * This function copies the state of a keyframe. If this keyframe is linked
+  * to a track, the state is written through to the track.
+  *
+  * @param other The keyframe to copy.
+  *
+  * @return This keyframe.
+  *****************************************************************************/
+
+CalCoreKeyframe& CalCoreKeyframe::operator=(const CalCoreKeyframe& other)
+{
+  if(this != &other)
+  {
+    setTime(other.m_time);
+    setTranslation(other.m_translation);
+    setRotation(other.m_rotation);
+  }
+
+  return *this;
+}
+
 unsigned int
 CalCoreKeyframe::size()
 {
@@ -47,3 +91,46 @@ CalCoreKeyframe::size()
 CalCoreKeyframe::~CalCoreKeyframe()
 {
 }
+
+ /*****************************************************************************/
+/** Sets the rotation.
+  *
+  * This function sets the rotation of the keyframe.
+  *
+  * @param rotation The rotation.
+  *****************************************************************************/
+
+void CalCoreKeyframe::setRotation(const CalQuaternion& rotation)
+{
+  m_rotation = rotation;
+  if(m_pCoreTrack) m_pCoreTrack->setKeyframeRotation(m_keyframeId, rotation);
+}
+
+ /*****************************************************************************/
+/** Sets the time.
+  *
+  * This function sets the time of the keyframe. It does not move a keyframe
+  * linked to a track to keep the track sorted.
+  *
+  * @param time The time in seconds.
+  *****************************************************************************/
+
+void CalCoreKeyframe::setTime(float time)
+{
+  m_time = time;
+  if(m_pCoreTrack) m_pCoreTrack->setKeyframeTime(m_keyframeId, time);
+}
+
+ /*****************************************************************************/
+/** Sets the translation.
+  *
+  * This function sets the translation of the keyframe.
+  *
+  * @param translation The translation.
+  *****************************************************************************/
+
+void CalCoreKeyframe::setTranslation(const CalVector& translation)
+{
+  m_translation = translation;
+  if(m_pCoreTrack) m_pCoreTrack->setKeyframeTranslation(m_keyframeId, translation);
+}
@@ -18,29 +18,44 @@
 
 /*****************************************************************************/
 /** The core keyframe class.
+  *
+  * Core tracks store their keyframes in flat arrays. A keyframe returned by
+  * CalCoreTrack::getCoreKeyframe is linked to its track, and its setters write
+  * through to the track.
   *****************************************************************************/
 namespace cal3d{
+	class CalCoreTrack;
+
 	class CAL3D_API CalCoreKeyframe
 	{
+		friend class CalCoreTrack;
+
 		// member variables
 
 	public:
 		// constructors/destructor
 		CalCoreKeyframe();
+		CalCoreKeyframe(const CalCoreKeyframe& other);
 		virtual ~CalCoreKeyframe();
 
+		CalCoreKeyframe& operator=(const CalCoreKeyframe& other);
+
 		unsigned int size();
 
-		inline void setRotation(const CalQuaternion& rotation)    { m_rotation = rotation; }
+		void setRotation(const CalQuaternion& rotation);
 		inline const CalQuaternion& getRotation() const           { return m_rotation; }
-		inline void setTime(float time)                           { m_time = time; }
+		void setTime(float time);
 		inline float getTime()const                               { return m_time; }
 		inline const CalVector& getTranslation() const            { return m_translation; }
-		inline void setTranslation(const CalVector& translation)  { m_translation = translation; }
+		void setTranslation(const CalVector& translation);
 	protected:
 		float m_time;
 		CalVector m_translation;
 		CalQuaternion m_rotation;
+
+		// the track this keyframe writes through to, if any
+		CalCoreTrack *m_pCoreTrack;
+		int m_keyframeId;
 	};
 }
 #endif
@@ -22,6 +22,7 @@
 #include "cal3d/coreskeleton.h"
 #include "cal3d/corebone.h"
 #include "cal3d/coremodel.h"
+#include "cal3d/coremesh.h"
 #include "cal3d/coresubmesh.h"
 #include <cstring>
 
@@ -70,6 +71,9 @@ int CalCoreSkeleton::addCoreBone(CalCoreBone *pCoreBone)
   // add a reference from the bone's name to its id
   mapCoreBoneName( boneId, pCoreBone->getName() );
 
+  // the bone order is rebuilt by calculateState
+  invalidateBoneOrder();
+
   return boneId;
 }
 
@@ -77,11 +81,14 @@ int CalCoreSkeleton::addCoreBone(CalCoreBone *pCoreBone)
 /** Calculates the current state.
   *
   * This function calculates the current state of the core skeleton instance by
-  * calculating all the core bone states.
+  * calculating all the core bone states. It also updates the bone order, see
+  * calculateBoneOrder.
   *****************************************************************************/
 
 void CalCoreSkeleton::calculateState()
 {
+  calculateBoneOrder();
+
   // calculate all bone states of the skeleton
   std::vector<int>::iterator iteratorRootCoreBoneId;
   for(iteratorRootCoreBoneId = m_vectorRootCoreBoneId.begin(); iteratorRootCoreBoneId != m_vectorRootCoreBoneId.end(); ++iteratorRootCoreBoneId)
@@ -90,6 +97,282 @@ void CalCoreSkeleton::calculateState()
   }
 }
 
+ /*****************************************************************************/
+/** Calculates the bone order.
+  *
+  * This function lists the bones reachable from the root bones through the
+  * child lists, in the order in which a recursive traversal visits them, so
+  * that every bone comes after its parent, and records the parent id of every
+  * bone. CalSkeleton::calculateState then updates the bones in a single loop
+  * over this order instead of recursing through the child lists. It is called
+  * by calculateState. Changing the bone hierarchy invalidates the order, see
+  * invalidateBoneOrder, until calculateState is called again.
+  *****************************************************************************/
+
+void CalCoreSkeleton::calculateBoneOrder()
+{
+  const int boneCount = (int)m_vectorCoreBone.size();
+
+  m_vectorParentId.resize(boneCount);
+  for(int boneId = 0; boneId < boneCount; ++boneId)
+  {
+    m_vectorParentId[boneId] = m_vectorCoreBone[boneId]->getParentId();
+  }
+
+  m_vectorBoneOrder.clear();
+  m_vectorBoneOrder.reserve(boneCount);
+
+  // depth first traversal, pushing the children in reverse so that they are
+  // visited in list order
+  std::vector<bool> vectorVisited(boneCount, false);
+  std::vector<int> vectorStack;
+  for(int rootId = (int)m_vectorRootCoreBoneId.size() - 1; rootId >= 0; --rootId)
+  {
+    vectorStack.push_back(m_vectorRootCoreBoneId[rootId]);
+  }
+
+  while(!vectorStack.empty())
+  {
+    int boneId = vectorStack.back();
+    vectorStack.pop_back();
+    if(boneId < 0 || boneId >= boneCount || vectorVisited[boneId]) continue;
+
+    vectorVisited[boneId] = true;
+    m_vectorBoneOrder.push_back(boneId);
+
+    const std::list<int>& listChildId = m_vectorCoreBone[boneId]->getListChildId();
+    std::list<int>::const_reverse_iterator iteratorChildId;
+    for(iteratorChildId = listChildId.rbegin(); iteratorChildId != listChildId.rend(); ++iteratorChildId)
+    {
+      vectorStack.push_back(*iteratorChildId);
+    }
+  }
+}
+
+ /*****************************************************************************/
+/** Invalidates the bone order.
+  *
+  * This function drops the bone order and the parent ids, so that
+  * CalSkeleton::calculateState falls back to recursing through the child lists
+  * until calculateState or calculateBoneOrder is called again. CalCoreBone
+  * calls it when the parent id or the child list of a core bone of the core
+  * skeleton changes; call it after editing a child list directly.
+  *****************************************************************************/
+
+void CalCoreSkeleton::invalidateBoneOrder()
+{
+  m_vectorBoneOrder.clear();
+  m_vectorParentId.clear();
+}
+
+ /*****************************************************************************/
+/** Builds a bone LOD mask by depth.
+  *
+  * This function builds a bone LOD mask, see CalSkeleton::setBoneLodMask,
+  * that keeps the bones whose depth in the hierarchy is at most the given
+  * depth, the root bones having depth 0. The root bones are always kept.
+  *
+  * @param maxDepth The depth of the deepest bones to keep.
+  * @param vectorBoneActive The mask, one entry per core bone, true for the
+  *                         bones to keep.
+  *****************************************************************************/
+
+void CalCoreSkeleton::calculateBoneLodMaskByDepth(int maxDepth, std::vector<bool>& vectorBoneActive) const
+{
+  const int boneCount = (int)m_vectorCoreBone.size();
+  vectorBoneActive.assign(boneCount, false);
+
+  for(int boneId = 0; boneId < boneCount; ++boneId)
+  {
+    // count the ancestors of the bone
+    int depth = 0;
+    int parentId = m_vectorCoreBone[boneId]->getParentId();
+    while(parentId != -1 && depth <= maxDepth)
+    {
+      ++depth;
+      parentId = m_vectorCoreBone[parentId]->getParentId();
+    }
+
+    vectorBoneActive[boneId] = (depth <= maxDepth);
+  }
+
+  keepRootBones(vectorBoneActive);
+}
+
+ /*****************************************************************************/
+/** Builds a bone LOD mask by name.
+  *
+  * This function builds a bone LOD mask, see CalSkeleton::setBoneLodMask,
+  * that drops the bones with the given names and all their descendants, for
+  * example the first bone of each finger. Names of unknown bones are ignored,
+  * and the root bones are always kept.
+  *
+  * @param vectorBoneName The names of the bones to drop.
+  * @param vectorBoneActive The mask, one entry per core bone, true for the
+  *                         bones to keep.
+  *****************************************************************************/
+
+void CalCoreSkeleton::calculateBoneLodMaskByName(const std::vector<std::string>& vectorBoneName, std::vector<bool>& vectorBoneActive) const
+{
+  std::vector<bool> vectorBoneInSubtree;
+  findSubtrees(vectorBoneName, vectorBoneInSubtree);
+
+  const int boneCount = (int)m_vectorCoreBone.size();
+  vectorBoneActive.assign(boneCount, true);
+  for(int boneId = 0; boneId < boneCount; ++boneId)
+  {
+    vectorBoneActive[boneId] = !vectorBoneInSubtree[boneId];
+  }
+
+  keepRootBones(vectorBoneActive);
+}
+
+ /*****************************************************************************/
+/** Builds a bone LOD mask by influence.
+  *
+  * This function builds a bone LOD mask, see CalSkeleton::setBoneLodMask,
+  * that keeps the bones influencing a vertex of the given meshes with at least
+  * the given weight, and all their ancestors. The root bones are always kept.
+  *
+  * @param vectorCoreMesh The core meshes, usually those attached to the model.
+  * @param minWeight The smallest influence weight of the bones to keep.
+  * @param vectorBoneActive The mask, one entry per core bone, true for the
+  *                         bones to keep.
+  *****************************************************************************/
+
+void CalCoreSkeleton::calculateBoneLodMaskByInfluence(const std::vector<CalCoreMesh *>& vectorCoreMesh, float minWeight, std::vector<bool>& vectorBoneActive) const
+{
+  const int boneCount = (int)m_vectorCoreBone.size();
+  vectorBoneActive.assign(boneCount, false);
+
+  std::vector<CalCoreMesh *>::const_iterator iteratorCoreMesh;
+  for(iteratorCoreMesh = vectorCoreMesh.begin(); iteratorCoreMesh != vectorCoreMesh.end(); ++iteratorCoreMesh)
+  {
+    const std::vector<CalCoreSubmesh *>& vectorCoreSubmesh = (*iteratorCoreMesh)->getVectorCoreSubmesh();
+
+    std::vector<CalCoreSubmesh *>::const_iterator iteratorCoreSubmesh;
+    for(iteratorCoreSubmesh = vectorCoreSubmesh.begin(); iteratorCoreSubmesh != vectorCoreSubmesh.end(); ++iteratorCoreSubmesh)
+    {
+      const CalCoreSubmesh *pCoreSubmesh = *iteratorCoreSubmesh;
+      const int vertexCount = pCoreSubmesh->getVertexCount();
+
+      for(int vertexId = 0; vertexId < vertexCount; ++vertexId)
+      {
+        const int influenceCount = pCoreSubmesh->getInfluenceCount(vertexId);
+        const CalCoreSubmesh::Influence *pInfluence = pCoreSubmesh->getInfluences(vertexId);
+
+        for(int influenceId = 0; influenceId < influenceCount; ++influenceId)
+        {
+          int boneId = pInfluence[influenceId].boneId;
+          if(boneId >= 0 && boneId < boneCount && pInfluence[influenceId].weight >= minWeight)
+          {
+            vectorBoneActive[boneId] = true;
+          }
+        }
+      }
+    }
+  }
+
+  // keep the ancestors of the kept bones, so that they get the right transforms
+  for(int boneId = 0; boneId < boneCount; ++boneId)
+  {
+    if(!vectorBoneActive[boneId]) continue;
+
+    int parentId = m_vectorCoreBone[boneId]->getParentId();
+    while(parentId != -1 && !vectorBoneActive[parentId])
+    {
+      vectorBoneActive[parentId] = true;
+      parentId = m_vectorCoreBone[parentId]->getParentId();
+    }
+  }
+
+  keepRootBones(vectorBoneActive);
+}
+
+ /*****************************************************************************/
+/** Builds an animation bone mask from subtrees.
+  *
+  * This function builds the bone weights of an animation bone mask, see
+  * CalMixer::setBoneMask, that keep the bones with the given names and all
+  * their descendants, for example the spine for an upper body animation.
+  * Names of unknown bones are ignored.
+  *
+  * @param vectorRootName The names of the first bones of the subtrees.
+  * @param weight The weight of the bones in the subtrees.
+  * @param vectorBoneWeight The bone weights, one entry per core bone, 0 for
+  *                         the bones outside of the subtrees.
+  *****************************************************************************/
+
+void CalCoreSkeleton::calculateBoneMaskBySubtree(const std::vector<std::string>& vectorRootName, float weight, std::vector<float>& vectorBoneWeight) const
+{
+  std::vector<bool> vectorBoneInSubtree;
+  findSubtrees(vectorRootName, vectorBoneInSubtree);
+
+  const int boneCount = (int)m_vectorCoreBone.size();
+  vectorBoneWeight.assign(boneCount, 0.0f);
+  for(int boneId = 0; boneId < boneCount; ++boneId)
+  {
+    if(vectorBoneInSubtree[boneId]) vectorBoneWeight[boneId] = weight;
+  }
+}
+
+ /*****************************************************************************/
+/** Finds the subtrees of named bones.
+  *
+  * This function marks the bones with the given names and all their
+  * descendants. Names of unknown bones are ignored.
+  *
+  * @param vectorRootName The names of the bones the subtrees start at.
+  * @param vectorBoneInSubtree One entry per core bone, true for the bones in
+  *                            one of the subtrees.
+  *****************************************************************************/
+
+void CalCoreSkeleton::findSubtrees(const std::vector<std::string>& vectorRootName, std::vector<bool>& vectorBoneInSubtree) const
+{
+  const int boneCount = (int)m_vectorCoreBone.size();
+
+  std::vector<bool> vectorBoneNamed(boneCount, false);
+  std::vector<std::string>::const_iterator iteratorRootName;
+  for(iteratorRootName = vectorRootName.begin(); iteratorRootName != vectorRootName.end(); ++iteratorRootName)
+  {
+    int boneId = getCoreBoneId(*iteratorRootName);
+    if(boneId >= 0 && boneId < boneCount) vectorBoneNamed[boneId] = true;
+  }
+
+  vectorBoneInSubtree.assign(boneCount, false);
+  for(int boneId = 0; boneId < boneCount; ++boneId)
+  {
+    // the bone is in a subtree if it or one of its ancestors is named
+    int ancestorId = boneId;
+    while(ancestorId != -1)
+    {
+      if(vectorBoneNamed[ancestorId])
+      {
+        vectorBoneInSubtree[boneId] = true;
+        break;
+      }
+      ancestorId = m_vectorCoreBone[ancestorId]->getParentId();
+    }
+  }
+}
+
+ /*****************************************************************************/
+/** Keeps the root bones in a bone LOD mask.
+  *
+  * This function turns the entries of the root bones of a bone LOD mask on:
+  * root bones have no parent to follow, so CalSkeleton always evaluates them.
+  *
+  * @param vectorBoneActive The mask, one entry per core bone.
+  *****************************************************************************/
+
+void CalCoreSkeleton::keepRootBones(std::vector<bool>& vectorBoneActive) const
+{
+  for(size_t boneId = 0; boneId < vectorBoneActive.size(); ++boneId)
+  {
+    if(m_vectorCoreBone[boneId]->getParentId() == -1) vectorBoneActive[boneId] = true;
+  }
+}
+
  /*****************************************************************************/
 /** Provides access to a core bone.
   *
@@ -297,18 +580,21 @@ void CalCoreSkeleton::calculateBoundingBoxes(CalCoreModel *pCoreModel)
 			
 			if(pCoreSubmesh->getSpringCount()==0)
 			{
-				std::vector<CalCoreSubmesh::Vertex>& vectorVertex =
+				const std::vector<CalCoreSubmesh::Vertex>& vectorVertex =
 					pCoreSubmesh->getVectorVertex();
 				
 				for(size_t vertexId=0;vertexId <vectorVertex.size(); ++vertexId)
 				{
-					for(size_t influenceId=0;
-						influenceId < vectorVertex[vertexId].vectorInfluence.size();
+					const CalCoreSubmesh::Influence *pInfluence =
+						pCoreSubmesh->getInfluences((int)vertexId);
+					int influenceCount = pCoreSubmesh->getInfluenceCount((int)vertexId);
+					for(int influenceId=0;
+						influenceId < influenceCount;
 						++influenceId)
 					{
-						if (vectorVertex[vertexId].vectorInfluence[influenceId].weight > 0.5f)
+						if (pInfluence[influenceId].weight > 0.5f)
 						{
-							boneId = vectorVertex[vertexId].vectorInfluence[influenceId].boneId;
+							boneId = pInfluence[influenceId].boneId;
 							
 							m_vectorCoreBone[boneId]->updateBoundingBox(
 								vectorVertex[vertexId].position );
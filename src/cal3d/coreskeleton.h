@@ -20,6 +20,7 @@
 namespace cal3d{
 	class CalCoreBone;
 	class CalCoreModel;
+	class CalCoreMesh;
 
 
 	class CAL3D_API CalCoreSkeleton : public cal3d::RefCounted
@@ -52,8 +53,25 @@ namespace cal3d{
 
 		/** returns the vector of ids of root core bones **/
 		inline const std::vector<int>& getVectorRootCoreBoneId() const{ return m_vectorRootCoreBoneId; }
+		/** returns the ids of the bones reachable from the roots, every parent before its children **/
+		inline const std::vector<int>& getVectorBoneOrder() const{ return m_vectorBoneOrder; }
+		/** returns the parent id of every core bone, -1 for root bones **/
+		inline const std::vector<int>& getVectorParentId() const{ return m_vectorParentId; }
 		/** calculates the current state of the core skeleton by calculating all the core bone states**/
 		void calculateState();
+		/** calculates the bone order and the parent ids from the bone hierarchy **/
+		void calculateBoneOrder();
+		/** drops the bone order after a change of the bone hierarchy, until the next calculateState **/
+		void invalidateBoneOrder();
+
+		/** builds a bone LOD mask keeping the bones up to a depth in the hierarchy **/
+		void calculateBoneLodMaskByDepth(int maxDepth, std::vector<bool>& vectorBoneActive) const;
+		/** builds a bone LOD mask dropping the named bones and all their descendants **/
+		void calculateBoneLodMaskByName(const std::vector<std::string>& vectorBoneName, std::vector<bool>& vectorBoneActive) const;
+		/** builds a bone LOD mask dropping the bones with little influence on the given meshes **/
+		void calculateBoneLodMaskByInfluence(const std::vector<CalCoreMesh *>& vectorCoreMesh, float minWeight, std::vector<bool>& vectorBoneActive) const;
+		/** builds animation bone weights keeping the named bones and all their descendants **/
+		void calculateBoneMaskBySubtree(const std::vector<std::string>& vectorRootName, float weight, std::vector<float>& vectorBoneWeight) const;
 		/** calculates the bounding box of the core skeleton **/
 		void calculateBoundingBoxes(CalCoreModel *pCoreModel);
 
@@ -70,9 +88,14 @@ namespace cal3d{
 		/** scale all the skeleton inner data by factor **/
 		void scale(float factor);
 	private:
+		void findSubtrees(const std::vector<std::string>& vectorRootName, std::vector<bool>& vectorBoneInSubtree) const;
+		void keepRootBones(std::vector<bool>& vectorBoneActive) const;
+
 		std::vector<CalCoreBone *>   m_vectorCoreBone;
 		std::map< std::string, int > m_mapCoreBoneNames;
 		std::vector<int>             m_vectorRootCoreBoneId;
+		std::vector<int>             m_vectorBoneOrder;
+		std::vector<int>             m_vectorParentId;
 		std::string                  m_name;
 	};
 	typedef cal3d::RefPtr<CalCoreSkeleton> CalCoreSkeletonPtr;
@@ -18,6 +18,9 @@
 
 #include "cal3d/coresubmesh.h"
 #include "cal3d/coresubmorphtarget.h"
+
+#include <algorithm>
+
 using namespace cal3d;
 
  /*****************************************************************************/
@@ -30,6 +33,8 @@ CalCoreSubmesh::CalCoreSubmesh()
   : m_coreMaterialThreadId(0), m_lodCount(0)
 {
   m_hasNonWhiteVertexColors = false;
+  m_vertexInfluencesReleased = false;
+  m_skinningLayout.vertexCount = 0;
 }
 
  /*****************************************************************************/
@@ -70,6 +75,10 @@ CalCoreSubmesh::sizeWithoutSubMorphTargets()
   r += sizeof( Face ) * m_vectorFace.size();
   r += sizeof( Spring ) * m_vectorSpring.size();
   r += sizeof( unsigned int ) * m_vectorSubMorphTargetGroupIndex.size();
+  r += sizeof( Influence ) * m_vectorInfluence.size();
+  r += sizeof( int ) * m_vectorInfluenceOffset.size();
+  r += ( sizeof( int ) + sizeof( float ) * 3 ) * m_skinningLayout.vertexId.size();
+  r += ( sizeof( int ) + sizeof( float ) ) * m_skinningLayout.weight.size();
   std::vector<std::vector<TangentSpace> >::iterator iter2;
   for( iter2 = m_vectorvectorTangentSpace.begin(); iter2 != m_vectorvectorTangentSpace.end(); ++iter2 ) {
     r += sizeof( TangentSpace ) * (*iter2).size();
@@ -171,7 +180,7 @@ bool CalCoreSubmesh::isTangentsEnabled(int mapId) const
 
 void CalCoreSubmesh::UpdateTangentVector(int v0, int v1, int v2, int mapId)
 {
-  std::vector<CalCoreSubmesh::Vertex> &vvtx = getVectorVertex();
+  const std::vector<CalCoreSubmesh::Vertex>&vvtx = getVectorVertex();
   std::vector<CalCoreSubmesh::TextureCoordinate> &vtex = m_vectorvectorTextureCoordinate[mapId];
 
   // Step 1. Compute the approximate tangent vector.
@@ -398,23 +407,11 @@ const std::vector<std::vector<CalCoreSubmesh::TangentSpace> >& CalCoreSubmesh::g
 /** Returns the vertex vector.
   *
   * This function returns the vector that contains all vertices of the core
-  * submesh instance.
-  *
-  * @return A reference to the vertex vector.
-  *****************************************************************************/
-
-std::vector<CalCoreSubmesh::Vertex>& CalCoreSubmesh::getVectorVertex()
-{
-  return m_vectorVertex;
-}
-
- /*****************************************************************************/
-/** Returns the vertex vector.
-  *
-  * This function returns the vector that contains all vertices of the core
-  * submesh instance.
+  * submesh instance. The vector is read-only; vertices are modified through
+  * setVertex, which keeps the influence stream and the packed skinning data
+  * consistent.
   *
-  * @return A reference to the vertex vector.
+  * @return A constant reference to the vertex vector.
   *****************************************************************************/
 
 const std::vector<CalCoreSubmesh::Vertex>& CalCoreSubmesh::getVectorVertex() const
@@ -464,6 +461,12 @@ bool CalCoreSubmesh::reserve(int vertexCount, int textureCoordinateCount, int fa
 		m_vectorVertex.reserve(vertexCount);
 		m_vectorVertex.resize(vertexCount);
 
+		// the flattened influences no longer match the vertices
+		m_vectorInfluence.clear();
+		m_vectorInfluenceOffset.clear();
+		m_vertexInfluencesReleased = false;
+		m_skinningLayout.vertexCount = 0;
+
 		m_vectorTangentsEnabled.reserve(textureCoordinateCount);
 		m_vectorTangentsEnabled.resize(textureCoordinateCount);
 
@@ -678,13 +681,45 @@ bool CalCoreSubmesh::setVertex(int vertexId, const Vertex& vertex)
 
   m_vectorVertex[vertexId] = vertex;
 
+  // keep the flattened influences in sync
+  if(!m_vectorInfluenceOffset.empty())
+  {
+    int influenceOffset = m_vectorInfluenceOffset[vertexId];
+    int oldInfluenceCount = m_vectorInfluenceOffset[vertexId + 1] - influenceOffset;
+    int newInfluenceCount = (int)vertex.vectorInfluence.size();
+
+    if(newInfluenceCount != oldInfluenceCount)
+    {
+      m_vectorInfluence.erase(m_vectorInfluence.begin() + influenceOffset,
+                              m_vectorInfluence.begin() + influenceOffset + oldInfluenceCount);
+      m_vectorInfluence.insert(m_vectorInfluence.begin() + influenceOffset, newInfluenceCount, Influence());
+
+      for(size_t offsetId = vertexId + 1; offsetId < m_vectorInfluenceOffset.size(); ++offsetId)
+      {
+        m_vectorInfluenceOffset[offsetId] += newInfluenceCount - oldInfluenceCount;
+      }
+    }
+    std::copy(vertex.vectorInfluence.begin(), vertex.vectorInfluence.end(), m_vectorInfluence.begin() + influenceOffset);
+
+    if(m_vertexInfluencesReleased)
+    {
+      std::vector<Influence>().swap(m_vectorVertex[vertexId].vectorInfluence);
+    }
+  }
+
+  // the packed skinning data holds a copy of the old vertex
+  m_skinningLayout.vertexCount = 0;
+
   return true;
 }
 
  /*****************************************************************************/
 /** Adds a core sub morph target.
   *
-  * This function adds a core sub morph target to the core sub mesh instance.
+  * This function adds a core sub morph target to the core sub mesh instance
+  * and builds its sparse blend vertices, see
+  * CalCoreSubMorphTarget::updateSparseBlendVertices, so its blend vertices
+  * should be set before it is added.
   *
   * @param pCoreSubMorphTarget A pointer to the core sub morph target that should be added.
   *
@@ -701,6 +736,7 @@ int CalCoreSubmesh::addCoreSubMorphTarget(CalCoreSubMorphTarget *pCoreSubMorphTa
   pCoreSubMorphTarget->setMorphID(subMorphTargetId);
   m_vectorCoreSubMorphTarget.push_back(pCoreSubMorphTarget);
   pCoreSubMorphTarget->setCoreSubmesh( this );
+  pCoreSubMorphTarget->updateSparseBlendVertices();
 
   return subMorphTargetId;
 }
@@ -809,16 +845,16 @@ void CalCoreSubmesh::scale(float factor)
     m_vectorVertex[vertexId].position*=factor;
   }
 
-  //also scale any morph target vertices that may be present
+  //also scale any morph target vertices that may be present, compressed or not
   for (size_t morphID = 0; morphID < m_vectorCoreSubMorphTarget.size(); morphID++)
   {
-     std::vector<CalCoreSubMorphTarget::BlendVertex> blendVertVec =
-        m_vectorCoreSubMorphTarget[morphID]->getVectorBlendVertex();
+     m_vectorCoreSubMorphTarget[morphID]->scale(factor);
+  }
 
-     for (size_t vertID = 0; vertID < blendVertVec.size(); vertID++)
-     {
-        blendVertVec[vertID].position *= factor;
-     }
+  // keep the packed skinning positions in sync
+  if(m_skinningLayout.vertexCount > 0)
+  {
+    updateSkinningLayout();
   }
 
 
@@ -860,6 +896,207 @@ void CalCoreSubmesh::scale(float factor)
 
 
 
+}
+
+ /*****************************************************************************/
+/** Builds the flattened influence stream.
+  *
+  * This function copies the influences of all vertices into one array,
+  * indexed by a per-vertex offset array, so that skinning does not have to
+  * follow one heap pointer per vertex. Once it is built, getInfluenceCount and
+  * getInfluences read from the stream and setVertex keeps it up to date. The
+  * loaders call it once the submesh is complete.
+  *****************************************************************************/
+
+void CalCoreSubmesh::updateInfluenceStream()
+{
+  if(m_vertexInfluencesReleased)
+  {
+    // the stream is the only copy left
+    return;
+  }
+
+  const int vertexCount = (int)m_vectorVertex.size();
+
+  int influenceTotal = 0;
+  int vertexId;
+  for(vertexId = 0; vertexId < vertexCount; ++vertexId)
+  {
+    influenceTotal += (int)m_vectorVertex[vertexId].vectorInfluence.size();
+  }
+
+  std::vector<Influence> vectorInfluence;
+  std::vector<int> vectorInfluenceOffset;
+  vectorInfluence.reserve(influenceTotal);
+  vectorInfluenceOffset.reserve(vertexCount + 1);
+
+  for(vertexId = 0; vertexId < vertexCount; ++vertexId)
+  {
+    const std::vector<Influence>& vertexInfluence = m_vectorVertex[vertexId].vectorInfluence;
+    vectorInfluenceOffset.push_back((int)vectorInfluence.size());
+    vectorInfluence.insert(vectorInfluence.end(), vertexInfluence.begin(), vertexInfluence.end());
+  }
+  vectorInfluenceOffset.push_back((int)vectorInfluence.size());
+
+  m_vectorInfluence.swap(vectorInfluence);
+  m_vectorInfluenceOffset.swap(vectorInfluenceOffset);
+}
+
+ /*****************************************************************************/
+/** Frees the per-vertex influence vectors.
+  *
+  * This function builds the influence stream if needed and then empties the
+  * vectorInfluence member of every vertex to save memory. Everything in the
+  * library reads influences through getInfluenceCount and getInfluences, so
+  * it keeps working; code that reads Vertex::vectorInfluence directly must be
+  * ported to these accessors before calling this function.
+  *****************************************************************************/
+
+void CalCoreSubmesh::releaseVertexInfluences()
+{
+  if(m_vertexInfluencesReleased) return;
+
+  if(m_vectorInfluenceOffset.empty())
+  {
+    updateInfluenceStream();
+  }
+
+  for(size_t vertexId = 0; vertexId < m_vectorVertex.size(); ++vertexId)
+  {
+    std::vector<Influence>().swap(m_vectorVertex[vertexId].vectorInfluence);
+  }
+
+  m_vertexInfluencesReleased = true;
+}
+
+ /*****************************************************************************/
+/** Builds the packed skinning data.
+  *
+  * This function copies the vertex positions and influences into the
+  * structure-of-arrays layout used by the vectorized skinning path, and
+  * rebuilds the sparse blend vertices of the morph targets that were changed
+  * since they were added. The loaders call it once
+  * the submesh is complete. reserve and setVertex invalidate the packed data,
+  * so code that builds or edits a core submesh by hand must call it again
+  * afterwards, or the physique keeps using the per-vertex path.
+  *****************************************************************************/
+
+void CalCoreSubmesh::updateSkinningLayout()
+{
+  const int vertexCount = (int)m_vectorVertex.size();
+  const int block = SkinningLayout::VertexBlock;
+  const int blockCount = (vertexCount + block - 1) / block;
+
+  // sort the vertices by influence count so that a block wastes few slots;
+  // vertices without influences use one identity slot
+  std::vector<std::pair<int, int> > vectorOrder(vertexCount);
+  std::map<int, int> mapPaletteIndex;
+  int vertexId;
+  for(vertexId = 0; vertexId < vertexCount; ++vertexId)
+  {
+    const Influence *pInfluence = getInfluences(vertexId);
+    int influenceCount = getInfluenceCount(vertexId);
+    vectorOrder[vertexId] = std::make_pair(influenceCount > 0 ? influenceCount : 1, vertexId);
+
+    for(int influenceId = 0; influenceId < influenceCount; ++influenceId)
+    {
+      mapPaletteIndex[pInfluence[influenceId].boneId] = 0;
+    }
+  }
+  std::sort(vectorOrder.begin(), vectorOrder.end());
+
+  // compact palette of the bones used by this submesh
+  m_skinningLayout.boneId.clear();
+  std::map<int, int>::iterator iteratorPaletteIndex;
+  for(iteratorPaletteIndex = mapPaletteIndex.begin(); iteratorPaletteIndex != mapPaletteIndex.end(); ++iteratorPaletteIndex)
+  {
+    m_skinningLayout.boneId.push_back(iteratorPaletteIndex->first);
+    iteratorPaletteIndex->second = (int)m_skinningLayout.boneId.size();
+  }
+
+  m_skinningLayout.vertexCount = vertexCount;
+  m_skinningLayout.vertexId.assign(blockCount * block, -1);
+  m_skinningLayout.packedId.assign(vertexCount, -1);
+  m_skinningLayout.positionX.assign(blockCount * block, 0.0f);
+  m_skinningLayout.positionY.assign(blockCount * block, 0.0f);
+  m_skinningLayout.positionZ.assign(blockCount * block, 0.0f);
+  m_skinningLayout.blockInfluenceCount.resize(blockCount);
+  m_skinningLayout.blockInfluenceOffset.resize(blockCount);
+
+  int influenceTotal = 0;
+  int blockId;
+  for(blockId = 0; blockId < blockCount; ++blockId)
+  {
+    // the last vertex of a block has the most influences
+    int last = std::min((blockId + 1) * block, vertexCount) - 1;
+    m_skinningLayout.blockInfluenceCount[blockId] = vectorOrder[last].first;
+    m_skinningLayout.blockInfluenceOffset[blockId] = influenceTotal;
+    influenceTotal += vectorOrder[last].first * block;
+  }
+  m_skinningLayout.paletteIndex.assign(influenceTotal, 0);
+  m_skinningLayout.weight.assign(influenceTotal, 0.0f);
+
+  int packedId;
+  for(packedId = 0; packedId < vertexCount; ++packedId)
+  {
+    vertexId = vectorOrder[packedId].second;
+    const Vertex& vertex = m_vectorVertex[vertexId];
+    blockId = packedId / block;
+    int lane = packedId % block;
+    int offset = m_skinningLayout.blockInfluenceOffset[blockId] + lane;
+
+    m_skinningLayout.vertexId[packedId] = vertexId;
+    m_skinningLayout.packedId[vertexId] = packedId;
+    m_skinningLayout.positionX[packedId] = vertex.position.x;
+    m_skinningLayout.positionY[packedId] = vertex.position.y;
+    m_skinningLayout.positionZ[packedId] = vertex.position.z;
+
+    const Influence *pInfluence = getInfluences(vertexId);
+    int influenceCount = getInfluenceCount(vertexId);
+    if(influenceCount == 0)
+    {
+      m_skinningLayout.weight[offset] = 1.0f;
+      continue;
+    }
+
+    for(int influenceId = 0; influenceId < influenceCount; ++influenceId)
+    {
+      m_skinningLayout.paletteIndex[offset + influenceId * block] = mapPaletteIndex[pInfluence[influenceId].boneId];
+      m_skinningLayout.weight[offset + influenceId * block] = pInfluence[influenceId].weight;
+    }
+  }
+
+  // the morph targets are blended vertex by vertex only where they move it
+  for(size_t morphTargetId = 0; morphTargetId < m_vectorCoreSubMorphTarget.size(); ++morphTargetId)
+  {
+    CalCoreSubMorphTarget *pCoreSubMorphTarget = m_vectorCoreSubMorphTarget[morphTargetId];
+    if(pCoreSubMorphTarget->getVectorBlendVertexSpan() == 0)
+    {
+      pCoreSubMorphTarget->updateSparseBlendVertices();
+    }
+  }
+}
+
+ /*****************************************************************************/
+/** Provides access to the packed skinning data.
+  *
+  * This function returns the structure-of-arrays skinning data built by
+  * updateSkinningLayout.
+  *
+  * @return One of the following values:
+  *         \li a pointer to the skinning layout
+  *         \li \b 0 if it was not built, or reserve or setVertex was called
+  *             since
+  *****************************************************************************/
+
+const CalCoreSubmesh::SkinningLayout *CalCoreSubmesh::getSkinningLayout() const
+{
+  if((m_skinningLayout.vertexCount == 0) || (m_skinningLayout.vertexCount != (int)m_vectorVertex.size()))
+  {
+    return 0;
+  }
+
+  return &m_skinningLayout;
 }
 
 //****************************************************************************//
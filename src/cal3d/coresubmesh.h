@@ -76,6 +76,35 @@ namespace cal3d{
 			float idleLength;
 		};
 
+		/// Structure-of-arrays copy of the vertex positions and influences,
+		/// read by the vectorized skinning path of CalPhysique.
+		///
+		/// Vertices are sorted by influence count and cut into blocks of
+		/// VertexBlock vertices; vertexId maps a packed position back to the
+		/// vertex (-1 for the padding of the last block). The influences of a
+		/// block start at blockInfluenceOffset and are stored slot by slot,
+		/// blockInfluenceCount slots of VertexBlock entries each.
+		///
+		/// Palette entry 0 is the identity transform, used with a weight of 1
+		/// for vertices without influences and a weight of 0 for unused slots;
+		/// entry i + 1 is the bone boneId[i].
+		struct SkinningLayout
+		{
+			enum { VertexBlock = 8 };
+
+			int vertexCount;
+			std::vector<int>   vertexId;
+			std::vector<int>   packedId;
+			std::vector<float> positionX;
+			std::vector<float> positionY;
+			std::vector<float> positionZ;
+			std::vector<int>   blockInfluenceCount;
+			std::vector<int>   blockInfluenceOffset;
+			std::vector<int>   paletteIndex;
+			std::vector<float> weight;
+			std::vector<int>   boneId;
+		};
+
 	public:
 		CalCoreSubmesh();
 		~CalCoreSubmesh();
@@ -97,7 +126,6 @@ namespace cal3d{
 		//vertex array
 		bool setVertex(int vertexId, const Vertex& vertex);
 		int getVertexCount() const;
-		std::vector<Vertex>& getVectorVertex();
 		const std::vector<Vertex>& getVectorVertex() const;
 
 		//faces array
@@ -152,6 +180,33 @@ namespace cal3d{
 		void setHasNonWhiteVertexColors(bool p) { m_hasNonWhiteVertexColors = p; }
 
 
+		//flattened vertex influences
+		void updateInfluenceStream();
+		void releaseVertexInfluences();
+		bool hasInfluenceStream() const								{ return !m_vectorInfluenceOffset.empty(); }
+		const std::vector<Influence>& getVectorInfluence() const		{ return m_vectorInfluence; }
+		const std::vector<int>& getVectorInfluenceOffset() const		{ return m_vectorInfluenceOffset; }
+		///number of influences of a vertex, read from the influence stream once it is built
+		inline int getInfluenceCount(int vertexId) const
+		{
+			if(m_vectorInfluenceOffset.empty()) return (int)m_vectorVertex[vertexId].vectorInfluence.size();
+			return m_vectorInfluenceOffset[vertexId + 1] - m_vectorInfluenceOffset[vertexId];
+		}
+		///influences of a vertex, read from the influence stream once it is built
+		inline const Influence *getInfluences(int vertexId) const
+		{
+			if(m_vectorInfluenceOffset.empty())
+			{
+				const std::vector<Influence>& vectorInfluence = m_vectorVertex[vertexId].vectorInfluence;
+				return vectorInfluence.empty() ? 0 : &vectorInfluence[0];
+			}
+			return m_vectorInfluence.empty() ? 0 : &m_vectorInfluence[0] + m_vectorInfluenceOffset[vertexId];
+		}
+
+		//packed skinning data
+		void updateSkinningLayout();
+		const SkinningLayout *getSkinningLayout() const;
+
 		bool reserve(int vertexCount, int textureCoordinateCount, int faceCount, int springCount);
 		///scale all the mesh inner data by factor
 		void scale(float factor);
@@ -171,6 +226,10 @@ namespace cal3d{
 		int                                          m_lodCount;
 		std::vector<unsigned int>                    m_vectorSubMorphTargetGroupIndex;
 		bool                                         m_hasNonWhiteVertexColors;
+		std::vector<Influence>                       m_vectorInfluence;
+		std::vector<int>                             m_vectorInfluenceOffset;
+		bool                                         m_vertexInfluencesReleased;
+		SkinningLayout                               m_skinningLayout;
 	};
 }
 #endif
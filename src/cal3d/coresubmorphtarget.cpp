@@ -15,11 +15,42 @@
 
 #include "cal3d/coresubmorphtarget.h"
 #include "cal3d/coresubmesh.h"
+#include "cal3d/error.h"
 #include <cstring>
+#include <cmath>
+#include <algorithm>
 
 using namespace cal3d;
+
+// number of unmoved vertices a span of moved vertices may cover before it is
+// split in two, see updateSparseBlendVertices
+static const int MaxBlendVertexSpanGap = 4;
+
+// largest magnitude of a quantized component
+static const float QuantizedMaximum = 32767.0f;
+
+static void getQuantizationRange(float minimum, float maximum, float& center, float& scale)
+{
+  center = 0.5f * minimum + 0.5f * maximum;
+  scale = (0.5f * maximum - 0.5f * minimum) / QuantizedMaximum;
+}
+
+static short quantize(float value, float center, float scale)
+{
+  if(!(scale > 0.0f)) return 0;
+
+  float quantized = std::floor((value - center) / scale + 0.5f);
+  if(quantized > QuantizedMaximum) quantized = QuantizedMaximum;
+  if(quantized < -QuantizedMaximum) quantized = -QuantizedMaximum;
+
+  return (short)quantized;
+}
+
 //////////////////////////////////////////////////////////////////////////
 CalCoreSubMorphTarget::CalCoreSubMorphTarget() :
+ m_sparseBlendVertexValid( false ),
+ m_compressedBlendVertexCount( 0 ),
+ m_compressed( false ),
  m_coreSubmesh( NULL ),
  m_morphTargetType(CalMorphTargetTypeAdditive)
 {
@@ -30,13 +61,15 @@ unsigned int
 CalCoreSubMorphTarget::size()
 {
   unsigned int r = sizeof( CalCoreSubMorphTarget );
-  r += sizeof( CalMorphTargetType );
 
-  // Assume single texture coordinate pair.
-  r += ( sizeof( BlendVertex ) + sizeof( CalCoreSubmesh::TextureCoordinate ) ) * m_vectorBlendVertex.size();
+  r += sizeof( BlendVertex ) * m_vectorBlendVertex.capacity();
+  for( size_t blendVertexId = 0; blendVertexId < m_vectorBlendVertex.size(); ++blendVertexId ) {
+    r += sizeof( CalCoreSubmesh::TextureCoordinate ) * m_vectorBlendVertex[blendVertexId].textureCoords.capacity();
+  }
+  r += sizeof( BlendVertexSpan ) * m_vectorBlendVertexSpan.capacity();
+  r += sizeof( float ) * ( m_vectorSpanPosition.capacity() + m_vectorSpanNormal.capacity() );
+  r += m_compressedBlendVertices.size() - sizeof( CompressedBlendVertices );
  // r += m_morphTargetName.size();
- std::cerr<<"CalCoreSubMorphTarget::size()"
- <<std::endl;
   return r;
 }
 
@@ -53,6 +86,8 @@ CalCoreSubMorphTarget::size()
 
 int CalCoreSubMorphTarget::getBlendVertexCount() const
 {
+  if(m_compressed) return m_compressedBlendVertexCount;
+
   return m_vectorBlendVertex.size();
 }
 
@@ -106,6 +141,12 @@ bool CalCoreSubMorphTarget::reserve(int blendVertexCount)
 		// reserve the space needed in all the vectors
 		m_vectorBlendVertex.reserve(blendVertexCount);
 		m_vectorBlendVertex.resize(blendVertexCount);
+		m_sparseBlendVertexValid = false;
+
+		// start over with full-precision blend vertices
+		m_compressedBlendVertices.clear();
+		m_compressedBlendVertexCount = 0;
+		m_compressed = false;
 	}
 	catch (...)
 	{
@@ -135,6 +176,8 @@ bool CalCoreSubMorphTarget::setBlendVertex(int blendVertexId, const BlendVertex&
 {
   if((blendVertexId < 0) || (blendVertexId >= (int)m_vectorBlendVertex.size())) return false;
 
+  m_sparseBlendVertexValid = false;
+
 /*  if( m_vectorBlendVertex[blendVertexId] == NULL ) {
     m_vectorBlendVertex[blendVertexId] = new BlendVertex();
   }*/
@@ -151,11 +194,36 @@ bool CalCoreSubMorphTarget::setBlendVertex(int blendVertexId, const BlendVertex&
 
 
 
+ /*****************************************************************************/
+/** Scales the sub morph target.
+  *
+  * This function scales the positions of the blend vertices, of their spans
+  * and of the compressed blend vertices, see CalCoreSubmesh::scale.
+  *
+  * @param factor The scale factor.
+  *****************************************************************************/
+
+void CalCoreSubMorphTarget::scale(float factor)
+{
+  for(size_t blendVertexId = 0; blendVertexId < m_vectorBlendVertex.size(); ++blendVertexId)
+  {
+    m_vectorBlendVertex[blendVertexId].position *= factor;
+  }
+
+  for(size_t componentId = 0; componentId < m_vectorSpanPosition.size(); ++componentId)
+  {
+    m_vectorSpanPosition[componentId] *= factor;
+  }
+
+  m_compressedBlendVertices.scale(factor);
+}
+
 
  /*****************************************************************************/
 /** Returns one blend vertex.
   *
-  * This function returns a blend vertex from this sub morph target.
+  * This function returns a blend vertex from this sub morph target. It also
+  * works once the morph target is compressed, see compress.
   *
   * @param vertexId  The ID of the vertex.
   * @param outVertex Receives the blend vertex.
@@ -163,11 +231,367 @@ bool CalCoreSubMorphTarget::setBlendVertex(int blendVertexId, const BlendVertex&
 
 void	CalCoreSubMorphTarget::getBlendVertex( int vertexId, BlendVertex& outVertex ) const
 {
+	if ( m_compressed )
+	{
+		if ( ! m_compressedBlendVertices.getBlendVertex( vertexId, outVertex ) )
+		{
+			outVertex.position.clear();
+			outVertex.normal.clear();
+			outVertex.textureCoords.clear();
+		}
+		return;
+	}
+
 	outVertex = m_vectorBlendVertex[ vertexId ];
 }
 
+ /*****************************************************************************/
+/** Builds the sparse blend vertices.
+  *
+  * This function collects the blend vertices with a non-zero position or
+  * normal delta into spans of consecutive vertices, so that the physique only
+  * touches the vertices the morph target moves and blends every span as one
+  * contiguous run. Short gaps between moved vertices are kept inside a span
+  * with zero deltas. CalCoreSubmesh::addCoreSubMorphTarget calls it, and
+  * CalCoreSubmesh::updateSkinningLayout calls it again for the morph targets
+  * changed since, through setBlendVertex or getVectorBlendVertex.
+  *****************************************************************************/
+
+void CalCoreSubMorphTarget::updateSparseBlendVertices()
+{
+  m_vectorBlendVertexSpan.clear();
+  m_vectorSpanPosition.clear();
+  m_vectorSpanNormal.clear();
+
+  // compressed blend vertices are read through getCompressedBlendVertices
+  if(m_compressed) return;
+
+  const CalVector zero(0.0f, 0.0f, 0.0f);
+  const int blendVertexCount = (int)m_vectorBlendVertex.size();
+  int vertexId = 0;
+  while(vertexId < blendVertexCount)
+  {
+    // find the next moved vertex
+    if(m_vectorBlendVertex[vertexId].position == zero && m_vectorBlendVertex[vertexId].normal == zero)
+    {
+      ++vertexId;
+      continue;
+    }
+
+    // extend the span up to the last moved vertex before a long gap
+    int endVertexId = vertexId + 1;
+    int scanVertexId = endVertexId;
+    while(scanVertexId < blendVertexCount && scanVertexId - endVertexId <= MaxBlendVertexSpanGap)
+    {
+      const BlendVertex& blendVertex = m_vectorBlendVertex[scanVertexId];
+      ++scanVertexId;
+      if(!(blendVertex.position == zero && blendVertex.normal == zero)) endVertexId = scanVertexId;
+    }
+
+    BlendVertexSpan span;
+    span.firstVertexId = vertexId;
+    span.vertexCount = endVertexId - vertexId;
+    span.offset = (int)m_vectorSpanPosition.size() / 3;
+    m_vectorBlendVertexSpan.push_back(span);
+
+    for(; vertexId < endVertexId; ++vertexId)
+    {
+      const BlendVertex& blendVertex = m_vectorBlendVertex[vertexId];
+      m_vectorSpanPosition.push_back(blendVertex.position.x);
+      m_vectorSpanPosition.push_back(blendVertex.position.y);
+      m_vectorSpanPosition.push_back(blendVertex.position.z);
+      m_vectorSpanNormal.push_back(blendVertex.normal.x);
+      m_vectorSpanNormal.push_back(blendVertex.normal.y);
+      m_vectorSpanNormal.push_back(blendVertex.normal.z);
+    }
+  }
+
+  m_sparseBlendVertexValid = true;
+}
+
+ /*****************************************************************************/
+/** Returns the spans of moved vertices.
+  *
+  * This function returns the spans of consecutive vertices the morph target
+  * moves, in increasing vertex order, see updateSparseBlendVertices. Their
+  * deltas are in getVectorSpanPosition and getVectorSpanNormal.
+  *
+  * @return One of the following values:
+  *         \li a pointer to the spans
+  *         \li \b 0 if they were not built or a blend vertex was set since
+  *****************************************************************************/
+
+const std::vector<CalCoreSubMorphTarget::BlendVertexSpan> *CalCoreSubMorphTarget::getVectorBlendVertexSpan() const
+{
+  if(!m_sparseBlendVertexValid) return 0;
+
+  return &m_vectorBlendVertexSpan;
+}
+
+ /*****************************************************************************/
+/** Compresses the blend vertices.
+  *
+  * This function replaces the blend vertices by a compressed copy, see
+  * CompressedBlendVertices, and releases the full-precision ones. Only the
+  * blend vertices with a non-zero position or normal or with texture
+  * coordinates are kept; the others read back as zero. The positions and
+  * normals lose precision, the texture coordinates do not.
+  *
+  * Once compressed, getBlendVertex(int) returns 0 and setBlendVertex fails;
+  * getBlendVertex(int, BlendVertex&) still works and the physique blends the
+  * compressed blend vertices directly. reserve starts over with
+  * full-precision blend vertices.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if an error happened
+  *****************************************************************************/
+
+bool CalCoreSubMorphTarget::compress()
+{
+  if(m_compressed) return true;
+
+  std::vector<int> vectorVertexId;
+  std::vector<const BlendVertex *> vectorBlendVertex;
+
+  const CalVector zero(0.0f, 0.0f, 0.0f);
+  const int blendVertexCount = (int)m_vectorBlendVertex.size();
+  for(int vertexId = 0; vertexId < blendVertexCount; ++vertexId)
+  {
+    const BlendVertex& blendVertex = m_vectorBlendVertex[vertexId];
+    if(blendVertex.position == zero && blendVertex.normal == zero && blendVertex.textureCoords.empty()) continue;
+
+    vectorVertexId.push_back(vertexId);
+    vectorBlendVertex.push_back(&blendVertex);
+  }
+
+  if(!m_compressedBlendVertices.compress(vectorVertexId, vectorBlendVertex)) return false;
+
+  // release the full-precision blend vertices
+  std::vector<BlendVertex>().swap(m_vectorBlendVertex);
+  std::vector<BlendVertexSpan>().swap(m_vectorBlendVertexSpan);
+  std::vector<float>().swap(m_vectorSpanPosition);
+  std::vector<float>().swap(m_vectorSpanNormal);
+  m_sparseBlendVertexValid = false;
+
+  m_compressedBlendVertexCount = blendVertexCount;
+  m_compressed = true;
+
+  return true;
+}
+
+ /*****************************************************************************/
+/** Constructs the compressed blend vertices.
+  *
+  * This function is the default constructor of the compressed blend vertices.
+  *****************************************************************************/
+
+CalCoreSubMorphTarget::CompressedBlendVertices::CompressedBlendVertices()
+  : m_textureCoordinateCount(0)
+  , m_positionCenter(0.0f, 0.0f, 0.0f)
+  , m_positionScale(0.0f, 0.0f, 0.0f)
+  , m_normalCenter(0.0f, 0.0f, 0.0f)
+  , m_normalScale(0.0f, 0.0f, 0.0f)
+{
+}
+
+ /*****************************************************************************/
+/** Compresses a set of blend vertices.
+  *
+  * This function quantizes every position and normal component to 16 bits
+  * against the bounding range of that component over the whole set, so the
+  * error of a component is at most half its range divided by 32767. The
+  * texture coordinates of all blend vertices go into one array, so every
+  * blend vertex must have the same number of them.
+  *
+  * @param vectorVertexId The vertex ids of the blend vertices, in increasing
+  *                       order.
+  * @param vectorBlendVertex The blend vertices, in the order of the ids.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if an error happened
+  *****************************************************************************/
+
+bool CalCoreSubMorphTarget::CompressedBlendVertices::compress(const std::vector<int>& vectorVertexId, const std::vector<const BlendVertex *>& vectorBlendVertex)
+{
+  const size_t blendVertexCount = vectorBlendVertex.size();
+  const int textureCoordinateCount = blendVertexCount > 0 ? (int)vectorBlendVertex[0]->textureCoords.size() : 0;
+
+  // check the input before touching the current data
+  if(vectorVertexId.size() != blendVertexCount)
+  {
+    CalError::setLastError(CalError::INVALID_HANDLE, __FILE__, __LINE__);
+    return false;
+  }
+
+  size_t blendVertexId;
+  for(blendVertexId = 0; blendVertexId < blendVertexCount; ++blendVertexId)
+  {
+    if((int)vectorBlendVertex[blendVertexId]->textureCoords.size() != textureCoordinateCount
+      || (blendVertexId > 0 && vectorVertexId[blendVertexId] <= vectorVertexId[blendVertexId - 1]))
+    {
+      CalError::setLastError(CalError::INVALID_HANDLE, __FILE__, __LINE__);
+      return false;
+    }
+  }
+
+  clear();
+
+  if(blendVertexCount == 0) return true;
+
+  // find the bounding range of every component
+  CalVector positionMinimum = vectorBlendVertex[0]->position;
+  CalVector positionMaximum = positionMinimum;
+  CalVector normalMinimum = vectorBlendVertex[0]->normal;
+  CalVector normalMaximum = normalMinimum;
+
+  int axis;
+  for(blendVertexId = 1; blendVertexId < blendVertexCount; ++blendVertexId)
+  {
+    const BlendVertex& blendVertex = *vectorBlendVertex[blendVertexId];
+    for(axis = 0; axis < 3; ++axis)
+    {
+      positionMinimum[axis] = std::min(positionMinimum[axis], blendVertex.position[axis]);
+      positionMaximum[axis] = std::max(positionMaximum[axis], blendVertex.position[axis]);
+      normalMinimum[axis] = std::min(normalMinimum[axis], blendVertex.normal[axis]);
+      normalMaximum[axis] = std::max(normalMaximum[axis], blendVertex.normal[axis]);
+    }
+  }
+
+  for(axis = 0; axis < 3; ++axis)
+  {
+    getQuantizationRange(positionMinimum[axis], positionMaximum[axis], m_positionCenter[axis], m_positionScale[axis]);
+    getQuantizationRange(normalMinimum[axis], normalMaximum[axis], m_normalCenter[axis], m_normalScale[axis]);
+  }
+
+  // quantize the blend vertices
+  m_vectorEntry.resize(blendVertexCount);
+  m_textureCoordinateCount = textureCoordinateCount;
+  m_vectorTextureCoordinate.reserve(blendVertexCount * textureCoordinateCount);
+
+  for(blendVertexId = 0; blendVertexId < blendVertexCount; ++blendVertexId)
+  {
+    const BlendVertex& blendVertex = *vectorBlendVertex[blendVertexId];
+    Entry& entry = m_vectorEntry[blendVertexId];
+
+    entry.vertexId = vectorVertexId[blendVertexId];
+    for(axis = 0; axis < 3; ++axis)
+    {
+      entry.position[axis] = quantize(blendVertex.position[axis], m_positionCenter[axis], m_positionScale[axis]);
+      entry.normal[axis] = quantize(blendVertex.normal[axis], m_normalCenter[axis], m_normalScale[axis]);
+    }
+
+    m_vectorTextureCoordinate.insert(m_vectorTextureCoordinate.end(), blendVertex.textureCoords.begin(), blendVertex.textureCoords.end());
+  }
+
+  return true;
+}
+
+ /*****************************************************************************/
+/** Clears the compressed blend vertices.
+  *
+  * This function removes all compressed blend vertices and releases their
+  * memory.
+  *****************************************************************************/
+
+void CalCoreSubMorphTarget::CompressedBlendVertices::clear()
+{
+  std::vector<Entry>().swap(m_vectorEntry);
+  std::vector<CalCoreSubmesh::TextureCoordinate>().swap(m_vectorTextureCoordinate);
+  m_textureCoordinateCount = 0;
+  m_positionCenter.clear();
+  m_positionScale.clear();
+  m_normalCenter.clear();
+  m_normalScale.clear();
+}
+
+ /*****************************************************************************/
+/** Retrieves one compressed blend vertex.
+  *
+  * This function looks a vertex id up with a binary search and decompresses
+  * its blend vertex.
+  *
+  * @param vertexId  The ID of the vertex.
+  * @param outVertex Receives the blend vertex.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if the vertex has no compressed blend vertex
+  *****************************************************************************/
+
+bool CalCoreSubMorphTarget::CompressedBlendVertices::getBlendVertex(int vertexId, BlendVertex& outVertex) const
+{
+  int lowerId = 0;
+  int upperId = (int)m_vectorEntry.size();
+  while(lowerId < upperId)
+  {
+    int middleId = (lowerId + upperId) / 2;
+    if(m_vectorEntry[middleId].vertexId < vertexId) lowerId = middleId + 1;
+    else upperId = middleId;
+  }
+
+  if(lowerId == (int)m_vectorEntry.size() || m_vectorEntry[lowerId].vertexId != vertexId) return false;
+
+  decompress(m_vectorEntry[lowerId], outVertex.position, outVertex.normal);
+
+  std::vector<CalCoreSubmesh::TextureCoordinate>::const_iterator iteratorTextureCoordinate =
+    m_vectorTextureCoordinate.begin() + lowerId * m_textureCoordinateCount;
+  outVertex.textureCoords.assign(iteratorTextureCoordinate, iteratorTextureCoordinate + m_textureCoordinateCount);
+
+  return true;
+}
+ /*****************************************************************************/
+/** Scales the compressed blend vertices.
+  *
+  * This function scales the decompressed positions by scaling their range,
+  * so the quantized positions are not touched.
+  *
+  * @param factor The scale factor.
+  *****************************************************************************/
+
+void CalCoreSubMorphTarget::CompressedBlendVertices::scale(float factor)
+{
+  m_positionCenter *= factor;
+  m_positionScale *= factor;
+}
+
+ /*****************************************************************************/
+/** Returns the memory size of the compressed blend vertices.
+  *
+  * This function returns the number of bytes taken by the compressed blend
+  * vertices, including this object.
+  *
+  * @return The size in bytes.
+  *****************************************************************************/
+
+unsigned int CalCoreSubMorphTarget::CompressedBlendVertices::size() const
+{
+  return sizeof(CompressedBlendVertices)
+    + sizeof(Entry) * m_vectorEntry.capacity()
+    + sizeof(CalCoreSubmesh::TextureCoordinate) * m_vectorTextureCoordinate.capacity();
+}
+
 //#pragma mark -
 
+ /*****************************************************************************/
+/** Copies a difference map.
+  *
+  * This function copies the blend vertices of another difference map. The copy
+  * starts unreferenced.
+  *
+  * @param inOther The difference map to copy.
+  *****************************************************************************/
+
+CalSharedDifferenceMap::CalSharedDifferenceMap( const CalSharedDifferenceMap& inOther )
+	: RefCounted()
+	, m_vectorBlendVertex( inOther.m_vectorBlendVertex )
+	, m_vectorVertexIndex( inOther.m_vectorVertexIndex )
+	, m_compressedBlendVertices( inOther.m_compressedBlendVertices )
+	, m_compressed( inOther.m_compressed )
+{
+}
+
  /*****************************************************************************/
 /** Reserves memory for the blend vertices.
  *
@@ -232,10 +656,10 @@ bool CalSharedDifferenceMap::appendBlendVertex(int vertexID,
 /** Retrieve one blend vertex.
   *
   * This function gets a blend vertex from the difference map if it is present.
-  *
-  * If we were supporting random access, we would look up the vertex ID using
-  * binary search.  But actually, the physique calls getBlendVertex
-  * sequentially, so we optimize for that access.
+  * It looks the vertex ID up with a binary search and keeps no state, so it
+  * can be called from several threads at once. Code that visits the vertices
+  * in order should rather walk getVectorVertexIndex and getVectorBlendVertex
+  * in lockstep with its vertex loop.
   *
   * @param vertexId  The ID of the vertex.
   * @param outVertex A blend vertex.
@@ -247,41 +671,103 @@ bool CalSharedDifferenceMap::appendBlendVertex(int vertexID,
 bool	CalSharedDifferenceMap::getBlendVertex( int vertexId,
 									CalCoreSubMorphTarget::BlendVertex& outVertex ) const
 {
-	// I assume that we do not call getBlendVertex until after we are done
-	// appending vertices, so at this point we can cache direct access values
-	// for the vectors.
-	if (m_vectorVertexIndexPtr == NULL)
+	if ( m_compressed )
 	{
-		m_vectorVertexIndexPtr = &m_vectorVertexIndex[0];
-		m_vectorVertexIndexSize = m_vectorVertexIndex.size();
-		m_vectorBlendVertexPtr = &m_vectorBlendVertex[0];
+		return m_compressedBlendVertices.getBlendVertex( vertexId, outVertex );
 	}
 
-	// With sequential access, the normal situation will be that
-	// (m_NextIndex == m_vectorVertexIndexSize) or (vertexId <= m_vectorVertexIndex[ m_NextIndex ])
-	// and
-	// either m_NextIndex == 0 or vertexId > m_vectorVertexIndex[ m_NextIndex - 1 ].
-	// Make sure that condition holds.
-	while ( (m_NextIndex < m_vectorVertexIndexSize) &&
-		(vertexId > m_vectorVertexIndexPtr[ m_NextIndex ]) )
+	std::vector<int>::const_iterator iteratorVertexIndex =
+		std::lower_bound( m_vectorVertexIndex.begin(), m_vectorVertexIndex.end(), vertexId );
+
+	if ( (iteratorVertexIndex == m_vectorVertexIndex.end()) || (*iteratorVertexIndex != vertexId) )
 	{
-		m_NextIndex += 1;
+		return false;
 	}
-	while ( (m_NextIndex > 0) && (vertexId <= m_vectorVertexIndexPtr[ m_NextIndex - 1 ]) )
+
+	outVertex = m_vectorBlendVertex[ iteratorVertexIndex - m_vectorVertexIndex.begin() ];
+	return true;
+}
+
+ /*****************************************************************************/
+/** Compresses the blend vertices.
+  *
+  * This function replaces the blend vertices of the difference map by a
+  * compressed copy, see CalCoreSubMorphTarget::CompressedBlendVertices, and
+  * releases the full-precision ones. No blend vertex can be appended
+  * afterwards. As the difference map is shared, compress it before it is used
+  * from several threads.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if an error happened
+  *****************************************************************************/
+
+bool CalSharedDifferenceMap::compress()
+{
+	if ( m_compressed )
+	{
+		return true;
+	}
+
+	std::vector<const CalCoreSubMorphTarget::BlendVertex *> vectorBlendVertex( m_vectorBlendVertex.size() );
+	for (size_t blendVertexId = 0; blendVertexId < m_vectorBlendVertex.size(); ++blendVertexId)
+	{
+		vectorBlendVertex[blendVertexId] = &m_vectorBlendVertex[blendVertexId];
+	}
+
+	if ( ! m_compressedBlendVertices.compress( m_vectorVertexIndex, vectorBlendVertex ) )
+	{
+		return false;
+	}
+
+	// release the full-precision blend vertices
+	std::vector<CalCoreSubMorphTarget::BlendVertex>().swap( m_vectorBlendVertex );
+	std::vector<int>().swap( m_vectorVertexIndex );
+	m_compressed = true;
+
+	return true;
+}
+
+ /*****************************************************************************/
+/** Scales the difference map.
+  *
+  * This function scales the position offsets of the blend vertices, whether
+  * they are compressed or not.
+  *
+  * @param factor The scale factor.
+  *****************************************************************************/
+
+void CalSharedDifferenceMap::scale( float factor )
+{
+	for (size_t blendVertexId = 0; blendVertexId < m_vectorBlendVertex.size(); ++blendVertexId)
 	{
-		m_NextIndex -= 1;
+		m_vectorBlendVertex[blendVertexId].position *= factor;
 	}
 
-	bool	didFind = false;
+	m_compressedBlendVertices.scale( factor );
+}
+
+ /*****************************************************************************/
+/** Returns the memory size of the difference map.
+  *
+  * This function returns the number of bytes taken by the difference map.
+  *
+  * @return The size in bytes.
+  *****************************************************************************/
+
+unsigned int CalSharedDifferenceMap::size() const
+{
+	unsigned int r = sizeof( CalSharedDifferenceMap );
 
-	if ( (m_NextIndex < m_vectorVertexIndexSize) &&
-		(vertexId == m_vectorVertexIndexPtr[ m_NextIndex ] ) )
+	r += sizeof( CalCoreSubMorphTarget::BlendVertex ) * m_vectorBlendVertex.capacity();
+	for (size_t blendVertexId = 0; blendVertexId < m_vectorBlendVertex.size(); ++blendVertexId)
 	{
-		outVertex = m_vectorBlendVertexPtr[ m_NextIndex ];
-		didFind = true;
-		m_NextIndex += 1;
+		r += sizeof( CalCoreSubmesh::TextureCoordinate ) * m_vectorBlendVertex[blendVertexId].textureCoords.capacity();
 	}
-	return didFind;
+	r += sizeof( int ) * m_vectorVertexIndex.capacity();
+	r += m_compressedBlendVertices.size() - sizeof( CalCoreSubMorphTarget::CompressedBlendVertices );
+
+	return r;
 }
 
 //#pragma mark -
@@ -316,6 +802,28 @@ bool CalCoreSubMorphTargetDiffMap::reserve(int blendVertexCount)
 		CalCoreSubMorphTarget::reserve( blendVertexCount );
 }
 
+ /*****************************************************************************/
+/** Scales the sub morph target.
+  *
+  * This function scales the cached blend vertices and the difference map. A
+  * difference map shared with other copies of this morph target is copied
+  * first, so that the copies, which may belong to other meshes, keep their
+  * scale.
+  *
+  * @param factor The scale factor.
+  *****************************************************************************/
+
+void CalCoreSubMorphTargetDiffMap::scale( float factor )
+{
+	CalCoreSubMorphTarget::scale( factor );
+
+	if ( m_diffMap->getRefCount() > 1 )
+	{
+		m_diffMap = new CalSharedDifferenceMap( *m_diffMap );
+	}
+	m_diffMap->scale( factor );
+}
+
 
  /*****************************************************************************/
 /** Record the core submesh that this morph applies to.
@@ -331,21 +839,43 @@ void	CalCoreSubMorphTargetDiffMap::setCoreSubmesh( CalCoreSubmesh* inCoreSubmesh
 	CalCoreSubMorphTarget::setCoreSubmesh( inCoreSubmesh );
 
 	// Cache the blend vertices computed from the core vertices and the
-	// difference map.
+	// difference map. The difference map is shared with other copies of this
+	// morph target, which may be doing the same on other threads, so walk its
+	// sorted vertex ids in lockstep with the vertices instead of keeping a
+	// cursor in the map.
 	const std::vector<CalCoreSubmesh::Vertex>&	coreVerts(
 		inCoreSubmesh->getVectorVertex() );
+	const std::vector<int>& vectorVertexIndex( m_diffMap->getVectorVertexIndex() );
+	const std::vector<BlendVertex>& vectorOffset( m_diffMap->getVectorBlendVertex() );
+	const CompressedBlendVertices& compressedOffsets( m_diffMap->getCompressedBlendVertices() );
+	const std::vector<CompressedBlendVertices::Entry>& vectorCompressedOffset( compressedOffsets.getVectorEntry() );
+	const bool isCompressed = m_diffMap->isCompressed();
 	const unsigned int kNumVerts = coreVerts.size();
+	const unsigned int kNumOffsets = isCompressed ? vectorCompressedOffset.size() : vectorVertexIndex.size();
 	CalCoreSubMorphTarget::reserve( kNumVerts );
 	unsigned int vertexId;
-	BlendVertex	theVert, offset;
+	unsigned int offsetId = 0;
+	BlendVertex	theVert;
+	CalVector	offsetPosition, offsetNormal;
 	for (vertexId = 0; vertexId < kNumVerts; ++vertexId)
 	{
 		theVert.position = coreVerts[vertexId].position;
 		theVert.normal = coreVerts[vertexId].normal;
-		if (m_diffMap->getBlendVertex( vertexId, offset ))
+		if ( offsetId < kNumOffsets )
 		{
-			theVert.position += offset.position;
-			theVert.normal += offset.normal;
+			if ( isCompressed && (vectorCompressedOffset[offsetId].vertexId == (int)vertexId) )
+			{
+				compressedOffsets.decompress( vectorCompressedOffset[offsetId], offsetPosition, offsetNormal );
+				theVert.position += offsetPosition;
+				theVert.normal += offsetNormal;
+				++offsetId;
+			}
+			else if ( ! isCompressed && (vectorVertexIndex[offsetId] == (int)vertexId) )
+			{
+				theVert.position += vectorOffset[offsetId].position;
+				theVert.normal += vectorOffset[offsetId].normal;
+				++offsetId;
+			}
 		}
 		setBlendVertex( vertexId, theVert );
 	}
@@ -371,6 +901,25 @@ bool CalCoreSubMorphTargetDiffMap::appendBlendVertex(int vertexId,
 	return m_diffMap->appendBlendVertex( vertexId, vertex );
 }
 
+ /*****************************************************************************/
+/** Compresses the difference map.
+  *
+  * This function compresses the difference map shared by the copies of this
+  * sub morph target, see CalSharedDifferenceMap::compress. Call it once all
+  * blend vertices are appended and before the morph target is copied or used
+  * from several threads. The blend vertices cached by setCoreSubmesh are not
+  * touched, see CalCoreSubMorphTarget::compress for those.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if an error happened
+  *****************************************************************************/
+
+bool CalCoreSubMorphTargetDiffMap::compressDifferenceMap()
+{
+	return m_diffMap->compress();
+}
+
 //****************************************************************************//
 
  void
@@ -27,6 +27,59 @@ namespace cal3d{
 			   CalVector normal;
 			   std::vector<CalCoreSubmesh::TextureCoordinate> textureCoords;
 		   };
+		   /// A run of consecutive vertices moved by a morph target. Their deltas
+		   /// start at vertex offset in the span position and normal arrays.
+		   struct BlendVertexSpan
+		   {
+			   int firstVertexId;
+			   int vertexCount;
+			   int offset;
+		   };
+
+		   /// Blend vertices with their position and normal quantized to 16 bits
+		   /// against the bounding range of the set, and their texture
+		   /// coordinates kept in one array.
+		   class CAL3D_API CompressedBlendVertices
+		   {
+		   public:
+			   struct Entry
+			   {
+				   int   vertexId;
+				   short position[3];
+				   short normal[3];
+			   };
+
+			   CompressedBlendVertices();
+
+			   bool compress(const std::vector<int>& vectorVertexId, const std::vector<const BlendVertex *>& vectorBlendVertex);
+			   void clear();
+			   bool getBlendVertex(int vertexId, BlendVertex& outVertex) const;
+			   void scale(float factor);
+			   unsigned int size() const;
+
+			   /** returns the compressed blend vertices, in increasing vertex order **/
+			   inline const std::vector<Entry>& getVectorEntry() const { return m_vectorEntry; }
+
+			   /** returns the position and normal of a compressed blend vertex **/
+			   inline void decompress(const Entry& entry, CalVector& position, CalVector& normal) const
+			   {
+				   position.x = m_positionCenter.x + m_positionScale.x * entry.position[0];
+				   position.y = m_positionCenter.y + m_positionScale.y * entry.position[1];
+				   position.z = m_positionCenter.z + m_positionScale.z * entry.position[2];
+				   normal.x = m_normalCenter.x + m_normalScale.x * entry.normal[0];
+				   normal.y = m_normalCenter.y + m_normalScale.y * entry.normal[1];
+				   normal.z = m_normalCenter.z + m_normalScale.z * entry.normal[2];
+			   }
+
+		   private:
+			   std::vector<Entry>                             m_vectorEntry;
+			   std::vector<CalCoreSubmesh::TextureCoordinate> m_vectorTextureCoordinate;
+			   int                                            m_textureCoordinateCount;
+			   CalVector                                      m_positionCenter;
+			   CalVector                                      m_positionScale;
+			   CalVector                                      m_normalCenter;
+			   CalVector                                      m_normalScale;
+		   };
 	public:
 		typedef std::vector<BlendVertex*> VectorBlendVertex;
 		CalCoreSubMorphTarget();
@@ -37,17 +90,32 @@ namespace cal3d{
 		int getBlendVertexCount() const;
 		unsigned int size();
 
-		inline std::vector<BlendVertex>& getVectorBlendVertex()             { return m_vectorBlendVertex; }
+		/** returns the blend vertices for editing, dropping the spans until updateSparseBlendVertices is called after the edits **/
+		inline std::vector<BlendVertex>& getVectorBlendVertex()             { m_sparseBlendVertexValid = false; return m_vectorBlendVertex; }
 		inline const std::vector<BlendVertex>& getVectorBlendVertex() const { return m_vectorBlendVertex; }
 
-		inline BlendVertex const * getBlendVertex(int blendVertexId)        { return &m_vectorBlendVertex[blendVertexId]; }
-		inline const BlendVertex* getBlendVertex(int blendVertexId) const   { return &m_vectorBlendVertex[blendVertexId]; }
+		inline BlendVertex const * getBlendVertex(int blendVertexId)        { return m_compressed ? 0 : &m_vectorBlendVertex[blendVertexId]; }
+		inline const BlendVertex* getBlendVertex(int blendVertexId) const   { return m_compressed ? 0 : &m_vectorBlendVertex[blendVertexId]; }
 
 		virtual bool reserve(int blendVertexCount);
+		virtual void scale(float factor);
 
 		bool setBlendVertex(int vertexId, const BlendVertex& vertex);
 		void getBlendVertex(int vertexId, BlendVertex& outVertex) const;
 
+		void updateSparseBlendVertices();
+		const std::vector<BlendVertexSpan> *getVectorBlendVertexSpan() const;
+		/** returns the position deltas of the spans, three floats per vertex **/
+		inline const std::vector<float>& getVectorSpanPosition() const      { return m_vectorSpanPosition; }
+		/** returns the normal deltas of the spans, three floats per vertex **/
+		inline const std::vector<float>& getVectorSpanNormal() const        { return m_vectorSpanNormal; }
+
+		bool compress();
+		/** returns true if the blend vertices are only kept compressed **/
+		inline bool isCompressed() const                                    { return m_compressed; }
+		/** returns the compressed blend vertices, see compress **/
+		inline const CompressedBlendVertices& getCompressedBlendVertices() const { return m_compressedBlendVertices; }
+
 		///Type of this morph
 		inline CalMorphTargetType getMorphTargetType() const                { return m_morphTargetType; }
 		inline void setMorphTargetType(CalMorphTargetType c)                { m_morphTargetType = c; }
@@ -65,6 +133,13 @@ namespace cal3d{
 		CalCoreSubMorphTarget(const CalCoreSubMorphTarget& inOther);	// unimp
 
 		std::vector<BlendVertex>  m_vectorBlendVertex;
+		std::vector<BlendVertexSpan> m_vectorBlendVertexSpan;
+		std::vector<float>        m_vectorSpanPosition;
+		std::vector<float>        m_vectorSpanNormal;
+		bool                      m_sparseBlendVertexValid;
+		CompressedBlendVertices   m_compressedBlendVertices;
+		int                       m_compressedBlendVertexCount;
+		bool                      m_compressed;
 		CalCoreSubmesh           *m_coreSubmesh;
 		unsigned int              m_morphTargetID;
 		CalMorphTargetType        m_morphTargetType;
@@ -75,28 +150,39 @@ namespace cal3d{
 	class CalSharedDifferenceMap : public RefCounted
 	{
 	public:
-		CalSharedDifferenceMap() : m_NextIndex(0),
-			m_vectorVertexIndexSize(0),
-			m_vectorVertexIndexPtr(0),
-			m_vectorBlendVertexPtr(0) { }
+		CalSharedDifferenceMap() : m_compressed(false) { }
+		CalSharedDifferenceMap(const CalSharedDifferenceMap& inOther);
 
 		bool reserve(int blendVertexCount);
 		bool appendBlendVertex(int vertexId, const CalCoreSubMorphTarget::BlendVertex& vertex);
 
+		/** returns the number of blend vertices in the difference map **/
+		inline int getBlendVertexCount() const                                                  { return m_compressed ? (int)m_compressedBlendVertices.getVectorEntry().size() : (int)m_vectorVertexIndex.size(); }
+		/** returns the vertex ids of the blend vertices, in increasing order, empty once compressed **/
+		inline const std::vector<int>& getVectorVertexIndex() const                             { return m_vectorVertexIndex; }
+		/** returns the blend vertices, in the order of getVectorVertexIndex, empty once compressed **/
+		inline const std::vector<CalCoreSubMorphTarget::BlendVertex>& getVectorBlendVertex() const { return m_vectorBlendVertex; }
+
 		bool	getBlendVertex(int vertexId, CalCoreSubMorphTarget::BlendVertex& outVertex) const;
 
+		bool compress();
+		void scale(float factor);
+		unsigned int size() const;
+		/** returns true if the blend vertices are only kept compressed **/
+		inline bool isCompressed() const                                                        { return m_compressed; }
+		/** returns the compressed blend vertices, see compress **/
+		inline const CalCoreSubMorphTarget::CompressedBlendVertices& getCompressedBlendVertices() const { return m_compressedBlendVertices; }
+
 	protected:
 		~CalSharedDifferenceMap() { }
 
 	private:
+		// the difference map is shared between models, so it must not change
+		// once it is filled: readers walk the two arrays themselves
 		std::vector<CalCoreSubMorphTarget::BlendVertex>   m_vectorBlendVertex;
 		std::vector<int>                                  m_vectorVertexIndex;
-		mutable	int                                       m_NextIndex;
-
-		// performance optimization: direct access to vector size and arrays
-		mutable int                                       m_vectorVertexIndexSize;
-		mutable const int                                *m_vectorVertexIndexPtr;
-		mutable const CalCoreSubMorphTarget::BlendVertex *m_vectorBlendVertexPtr;
+		CalCoreSubMorphTarget::CompressedBlendVertices    m_compressedBlendVertices;
+		bool                                              m_compressed;
 	};
 	typedef RefPtr<CalSharedDifferenceMap> CalSharedDifferenceMapPtr;
 
@@ -109,10 +195,16 @@ namespace cal3d{
 		~CalCoreSubMorphTargetDiffMap() { }
 
 		virtual bool reserve(int blendVertexCount);
+		virtual void scale(float factor);
 		virtual void	setCoreSubmesh(CalCoreSubmesh* inCoreSubmesh);
 
 		bool appendBlendVertex(int vertexId, const CalCoreSubMorphTarget::BlendVertex& vertex);
 
+		/** returns the difference map shared by the copies of this morph target **/
+		inline const CalSharedDifferenceMap *getDifferenceMap() const { return m_diffMap.get(); }
+
+		bool compressDifferenceMap();
+
 	private:
 		CalSharedDifferenceMapPtr m_diffMap;
 	};
@@ -38,6 +38,8 @@ CalCoreTrack::CalCoreTrack()
   , m_translationRequired(true)
   , m_highRangeRequired(true)
   , m_translationIsDynamic(true)
+  , m_keyframeRate(0.0f)
+  , m_quantized(false)
 {
 }
 
@@ -46,10 +48,11 @@ unsigned int
 CalCoreTrack::size()
 {
   unsigned int r = sizeof( CalCoreTrack );
-  std::vector<CalCoreKeyframe *>::iterator iter1;
-  for( iter1 = m_keyframes.begin(); iter1 != m_keyframes.end(); ++iter1 ) {
-    r += (*iter1)->size();
-  }
+  r += m_keyframeTime.size() * sizeof( float );
+  r += m_keyframeTranslation.size() * sizeof( CalVector );
+  r += m_keyframeRotation.size() * sizeof( CalQuaternion );
+  r += m_quantizedKeyframe.size() * sizeof( unsigned short );
+  r += m_vectorCoreKeyframe.size() * sizeof( CalCoreKeyframe );
   return r;
 }
 
@@ -62,19 +65,74 @@ CalCoreTrack::size()
 
 CalCoreTrack::~CalCoreTrack()
 {
-    // destroy all core keyframes
-    for (unsigned int i = 0; i < m_keyframes.size(); ++i)
-    {
-            delete m_keyframes[i];
-    }
-    m_keyframes.clear();
+}
+
+ /*****************************************************************************/
+/** Copy-constructs the core track instance.
+  *
+  * This function copies the keyframes of another core track.
+  *
+  * @param other The core track to copy.
+  *****************************************************************************/
+
+CalCoreTrack::CalCoreTrack(const CalCoreTrack& other)
+  : m_coreBoneId(other.m_coreBoneId)
+  , m_translationRequired(other.m_translationRequired)
+  , m_highRangeRequired(other.m_highRangeRequired)
+  , m_translationIsDynamic(other.m_translationIsDynamic)
+  , m_keyframeTime(other.m_keyframeTime)
+  , m_keyframeTranslation(other.m_keyframeTranslation)
+  , m_keyframeRotation(other.m_keyframeRotation)
+  , m_keyframeRate(other.m_keyframeRate)
+  , m_quantized(other.m_quantized)
+  , m_quantizedKeyframe(other.m_quantizedKeyframe)
+  , m_quantizedTranslationMin(other.m_quantizedTranslationMin)
+  , m_quantizedTranslationScale(other.m_quantizedTranslationScale)
+{
+}
+
+ /*****************************************************************************/
+/** Assigns the keyframes of another core track.
+  *
+  * This function copies the keyframes of another core track. Pointers
+  * returned by getCoreKeyframe before the assignment become invalid.
+  *
+  * @param other The core track to copy.
+  *
+  * @return A reference to this core track.
+  *****************************************************************************/
+
+CalCoreTrack& CalCoreTrack::operator=(const CalCoreTrack& other)
+{
+  if(this != &other)
+  {
+    m_coreBoneId = other.m_coreBoneId;
+    m_translationRequired = other.m_translationRequired;
+    m_highRangeRequired = other.m_highRangeRequired;
+    m_translationIsDynamic = other.m_translationIsDynamic;
+    m_keyframeTime = other.m_keyframeTime;
+    m_keyframeTranslation = other.m_keyframeTranslation;
+    m_keyframeRotation = other.m_keyframeRotation;
+    m_keyframeRate = other.m_keyframeRate;
+    m_quantized = other.m_quantized;
+    m_quantizedKeyframe = other.m_quantizedKeyframe;
+    m_quantizedTranslationMin = other.m_quantizedTranslationMin;
+    m_quantizedTranslationScale = other.m_quantizedTranslationScale;
+
+    releaseCoreKeyframeObjects();
+  }
 
+  return *this;
 }
 
  /*****************************************************************************/
 /** Adds a core keyframe.
   *
-  * This function adds a core keyframe to the core track instance.
+  * This function adds a core keyframe to the core track instance. The track
+  * takes ownership of the keyframe instance, as it always did, but it stores
+  * keyframes by value: it copies the state of the keyframe and deletes the
+  * instance before returning, so the pointer must not be used afterwards.
+  * Use getCoreKeyframe to reach the stored keyframe.
   *
   * @param pCoreKeyframe A pointer to the core keyframe that should be added.
   *
@@ -85,15 +143,155 @@ CalCoreTrack::~CalCoreTrack()
 
 bool CalCoreTrack::addCoreKeyframe(CalCoreKeyframe *pCoreKeyframe)
 {
-  m_keyframes.push_back(pCoreKeyframe);
-  int idx = m_keyframes.size() - 1;
-  while (idx > 0 && m_keyframes[idx]->getTime() < m_keyframes[idx - 1]->getTime()) {
-    std::swap(m_keyframes[idx], m_keyframes[idx - 1]);
+  if(pCoreKeyframe == 0)
+  {
+    CalError::setLastError(CalError::INVALID_HANDLE, __FILE__, __LINE__);
+    return false;
+  }
+
+  bool added = addCoreKeyframe(pCoreKeyframe->getTime(), pCoreKeyframe->getTranslation(), pCoreKeyframe->getRotation());
+  delete pCoreKeyframe;
+
+  return added;
+}
+
+ /*****************************************************************************/
+/** Adds a core keyframe.
+  *
+  * This function adds a keyframe to the core track instance, after any
+  * keyframe with the same time.
+  *
+  * @param time The time of the keyframe in seconds.
+  * @param translation The translation of the keyframe.
+  * @param rotation The rotation of the keyframe.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if an error happened
+  *****************************************************************************/
+
+bool CalCoreTrack::addCoreKeyframe(float time, const CalVector& translation, const CalQuaternion& rotation)
+{
+  expand();
+
+  int idx = m_keyframeTime.size();
+  while (idx > 0 && time < m_keyframeTime[idx - 1]) {
     --idx;
   }
+
+  m_keyframeTime.insert(m_keyframeTime.begin() + idx, time);
+  m_keyframeTranslation.insert(m_keyframeTranslation.begin() + idx, translation);
+  m_keyframeRotation.insert(m_keyframeRotation.begin() + idx, rotation);
+
+  releaseCoreKeyframeObjects();
+  m_keyframeRate = 0.0f;
+
   return true;
 }
 
+ /*****************************************************************************/
+/** Removes a core keyframe.
+  *
+  * This function removes a keyframe from the core track instance.
+  *
+  * @param _i The index of the keyframe.
+  *****************************************************************************/
+
+void CalCoreTrack::removeCoreKeyFrame(int _i)
+{
+  expand();
+
+  m_keyframeTime.erase(m_keyframeTime.begin() + _i);
+  m_keyframeTranslation.erase(m_keyframeTranslation.begin() + _i);
+  m_keyframeRotation.erase(m_keyframeRotation.begin() + _i);
+
+  releaseCoreKeyframeObjects();
+  m_keyframeRate = 0.0f;
+}
+
+ /*****************************************************************************/
+/** Reserves memory for the keyframes.
+  *
+  * This function reserves memory for a number of keyframes, so that adding
+  * them one by one does not reallocate the arrays.
+  *
+  * @param keyframeCount The number of keyframes.
+  *****************************************************************************/
+
+void CalCoreTrack::reserve(int keyframeCount)
+{
+  expand();
+
+  m_keyframeTime.reserve(keyframeCount);
+  m_keyframeTranslation.reserve(keyframeCount);
+  m_keyframeRotation.reserve(keyframeCount);
+}
+
+ /*****************************************************************************/
+/** Sets the time of a keyframe.
+  *
+  * This function sets the time of a keyframe. It does not move the keyframe to
+  * keep the track sorted, and it does not check whether the keyframes are
+  * still evenly spaced; call updateKeyframeRate for that.
+  *
+  * @param idx The index of the keyframe.
+  * @param time The time in seconds.
+  *****************************************************************************/
+
+void CalCoreTrack::setKeyframeTime(int idx, float time)
+{
+  m_keyframeTime[idx] = time;
+  if(!m_vectorCoreKeyframe.empty()) m_vectorCoreKeyframe[idx].m_time = time;
+  m_keyframeRate = 0.0f;
+}
+
+ /*****************************************************************************/
+/** Sets the translation of a keyframe.
+  *
+  * This function sets the translation of a keyframe. A quantized track is
+  * expanded first.
+  *
+  * @param idx The index of the keyframe.
+  * @param translation The translation.
+  *****************************************************************************/
+
+void CalCoreTrack::setKeyframeTranslation(int idx, const CalVector& translation)
+{
+  expand();
+  m_keyframeTranslation[idx] = translation;
+  if(!m_vectorCoreKeyframe.empty()) m_vectorCoreKeyframe[idx].m_translation = translation;
+}
+
+ /*****************************************************************************/
+/** Sets the rotation of a keyframe.
+  *
+  * This function sets the rotation of a keyframe. A quantized track is
+  * expanded first.
+  *
+  * @param idx The index of the keyframe.
+  * @param rotation The rotation.
+  *****************************************************************************/
+
+void CalCoreTrack::setKeyframeRotation(int idx, const CalQuaternion& rotation)
+{
+  expand();
+  m_keyframeRotation[idx] = rotation;
+  if(!m_vectorCoreKeyframe.empty()) m_vectorCoreKeyframe[idx].m_rotation = rotation;
+}
+
+ /*****************************************************************************/
+/** Frees the keyframe objects handed out by getCoreKeyframe.
+  *
+  * This function is called whenever keyframes are inserted, removed or
+  * re-encoded. The keyframe objects are only built again by the next call to
+  * getCoreKeyframe, so tracks that are only sampled never hold them.
+  *****************************************************************************/
+
+void CalCoreTrack::releaseCoreKeyframeObjects()
+{
+  std::vector<CalCoreKeyframe>().swap(m_vectorCoreKeyframe);
+}
+
 
 inline float
 DistanceSquared( CalVector const & v1, CalVector const & v2 )
@@ -132,6 +330,18 @@ DistanceDegrees( CalQuaternion const & p1, CalQuaternion const & p2 )
   return fabsf( distdegrees );
 }
 
+// Same as DistanceDegrees, but without its loss of precision for small angles.
+static float
+AngleDegrees( CalQuaternion const & p1, CalQuaternion const & p2 )
+{
+  CalQuaternion odist = p1;
+  odist.invert();
+  odist *= p2;
+  float sinHalfAngle = sqrtf( odist.x * odist.x + odist.y * odist.y + odist.z * odist.z );
+  float angleRadians = 2.0f * atan2f( sinHalfAngle, fabsf( odist.w ) );
+  return angleRadians * 180.0f / 3.141592654f;
+}
+
 bool
 Near( CalVector const & p1, CalQuaternion const & q1, CalVector const & p2, CalQuaternion const & q2,
      double transTolerance,
@@ -145,52 +355,60 @@ Near( CalVector const & p1, CalQuaternion const & q1, CalVector const & p2, CalQ
 }
 
 
-// Returns true if rounding took place and they were not exactly equal.
-bool
-CalCoreTrack::roundTranslation( CalCoreKeyframe const * prevp, CalCoreKeyframe * p, double transTolerance  )
+// Returns true if the translation is within tolerance of the previous one but not
+// exactly equal, in which case it should be rounded to the previous one.
+static bool
+TranslationRoundable( CalVector const & prevTranslation, CalVector const & translation, double transTolerance )
 {
-  CalCoreKeyframe * prev = const_cast< CalCoreKeyframe * >( prevp );
-  CalVector translation;
-  assert( prev && p );
-
-  // blend between the two keyframes
-  translation = prev->getTranslation();
-  CalVector const ppos = p->getTranslation();
-  float dist = Distance( translation, ppos );
+  float dist = Distance( prevTranslation, translation );
 
   // Identical returns false.
   if( dist == 0 ) return false;
 
   // Compare with tolerance.
-  if( dist < transTolerance ) { // equal case handled above.
-    p->setTranslation( translation );
-    return true;
-  } else {
-    return false;
-  }
+  return dist < transTolerance;
+}
+
+// Returns true if rounding took place and they were not exactly equal.
+bool
+CalCoreTrack::roundTranslation( CalCoreKeyframe const * prev, CalCoreKeyframe * p, double transTolerance  )
+{
+  assert( prev && p );
+  if( !TranslationRoundable( prev->getTranslation(), p->getTranslation(), transTolerance ) ) return false;
+  p->setTranslation( prev->getTranslation() );
+  return true;
+}
+
+// Same as roundTranslation, on keyframes of this track.
+bool
+CalCoreTrack::roundKeyframeTranslation( int prevId, int keyframeId, double transTolerance )
+{
+  const CalVector prevTranslation = getKeyframeTranslation( prevId );
+  if( !TranslationRoundable( prevTranslation, getKeyframeTranslation( keyframeId ), transTolerance ) ) return false;
+  setKeyframeTranslation( keyframeId, prevTranslation );
+  return true;
 }
 
 bool
-CalCoreTrack::keyframeEliminatable( CalCoreKeyframe * prev, 
-                                   CalCoreKeyframe * p, 
-                                   CalCoreKeyframe * next,
+CalCoreTrack::keyframeEliminatable( int prev, 
+                                   int p, 
+                                   int next,
                                    double transTolerance,
-                                   double rotTolerance )
+                                   double rotTolerance ) const
 {
   CalVector translation;
   CalQuaternion rotation;
-  assert( prev && p && next );
-  float time = p->getTime();
+  float time = getKeyframeTime( p );
   float blendFactor;
-  blendFactor = ( time - prev->getTime() ) / ( next->getTime() - prev->getTime() );
+  blendFactor = ( time - getKeyframeTime( prev ) ) / ( getKeyframeTime( next ) - getKeyframeTime( prev ) );
 
   // blend between the two keyframes
-  translation = prev->getTranslation();
-  translation.blend( blendFactor, next->getTranslation() );
-  rotation = prev->getRotation();
-  rotation.blend( blendFactor, next->getRotation() );
-  CalVector const ppos = p->getTranslation();
-  CalQuaternion const pori = p->getRotation();
+  translation = getKeyframeTranslation( prev );
+  translation.blend( blendFactor, getKeyframeTranslation( next ) );
+  rotation = getKeyframeRotation( prev );
+  rotation.blend( blendFactor, getKeyframeRotation( next ) );
+  CalVector const ppos = getKeyframeTranslation( p );
+  CalQuaternion const pori = getKeyframeRotation( p );
   return Near( translation, rotation, ppos, pori, transTolerance, rotTolerance );
 }
 
@@ -198,21 +416,21 @@ CalCoreTrack::keyframeEliminatable( CalCoreKeyframe * prev,
 
 struct KeyLink {
   bool eliminated_;
-  CalCoreKeyframe * keyframe_;
+  int keyframeId_;
   KeyLink * next_;
 };
 
 
 unsigned int
-KeyFrameSequenceLength( KeyLink * p, double transTolerance, double rotTolerance )
+KeyFrameSequenceLength( const CalCoreTrack * track, KeyLink * p, double transTolerance, double rotTolerance )
 {
-  CalVector translation = p->keyframe_->getTranslation();
-  CalQuaternion rotation = p->keyframe_->getRotation();
+  CalVector translation = track->getKeyframeTranslation( p->keyframeId_ );
+  CalQuaternion rotation = track->getKeyframeRotation( p->keyframeId_ );
   p = p->next_;
   unsigned int len = 1;
   while( p ) {
-    CalVector const ppos = p->keyframe_->getTranslation();
-    CalQuaternion const pori = p->keyframe_->getRotation();
+    CalVector const ppos = track->getKeyframeTranslation( p->keyframeId_ );
+    CalQuaternion const pori = track->getKeyframeRotation( p->keyframeId_ );
     if( Near( translation, rotation, ppos, pori, transTolerance, rotTolerance ) ) {
       len++;
       p = p->next_;
@@ -227,24 +445,20 @@ KeyFrameSequenceLength( KeyLink * p, double transTolerance, double rotTolerance
 void
 CalCoreTrack::compress( double translationTolerance, double rotationToleranceDegrees, CalCoreSkeleton * skelOrNull )
 {
-  unsigned int numFrames = m_keyframes.size();
+  unsigned int numFrames = m_keyframeTime.size();
   if( !numFrames ) return;
   unsigned int numFramesEliminated = 0;
 
+  // Work on the float keyframes.
+  expand();
+
   // I want to iterate through the vector as a list, and remove elements easily.
-  static unsigned int arrayLen = 0;
-  static KeyLink * keyLinkArray = NULL;
-  if( arrayLen < numFrames ) {
-    if( keyLinkArray ) {
-      delete [] keyLinkArray;
-    }
-    keyLinkArray = new( KeyLink [ numFrames ] );
-    arrayLen = numFrames;
-  }
+  std::vector<KeyLink> vectorKeyLink( numFrames );
+  KeyLink * keyLinkArray = & vectorKeyLink[ 0 ];
   unsigned int i;
   for( i = 0; i < numFrames; i++ ) {
     KeyLink * kl = & keyLinkArray[ i ];
-    kl->keyframe_ = m_keyframes[ i ];
+    kl->keyframeId_ = i;
     kl->next_ = ( i == numFrames - 1 ) ? NULL : & keyLinkArray[ i + 1 ];
     kl->eliminated_ = false;
   }
@@ -262,9 +476,9 @@ CalCoreTrack::compress( double translationTolerance, double rotationToleranceDeg
       KeyLink * p = prev->next_;
       if( !p || !p->next_ ) break;
       KeyLink * next = p->next_;
-      if( keyframeEliminatable( prev->keyframe_, 
-		  p->keyframe_, 
-		  next->keyframe_,
+      if( keyframeEliminatable( prev->keyframeId_, 
+		  p->keyframeId_, 
+		  next->keyframeId_,
 		  translationTolerance, rotationToleranceDegrees) ) 
 	  {
         p->eliminated_ = true;
@@ -293,7 +507,7 @@ CalCoreTrack::compress( double translationTolerance, double rotationToleranceDeg
   KeyLink * prev = & keyLinkArray[ 0 ];
   KeyLink * p = prev->next_;
   while( p ) {
-    bool didRound = roundTranslation( prev->keyframe_, p->keyframe_, translationTolerance );
+    bool didRound = roundKeyframeTranslation( prev->keyframeId_, p->keyframeId_, translationTolerance );
     if( didRound ) {
       numRounded++;
     }
@@ -302,26 +516,13 @@ CalCoreTrack::compress( double translationTolerance, double rotationToleranceDeg
   }
   CalLoader::addAnimationCompressionStatistic( numFrames, numFramesEliminated, numRounded );
 
-  // Rebuild the vector, freeing any of the eliminated keyframes.
-  unsigned int numKept = 0;
+  // Rebuild the keyframe arrays from the frames that were kept.
+  std::vector<bool> vectorEliminated( numFrames );
   for( i = 0; i < numFrames; i++ ) {
-    KeyLink * kl = & keyLinkArray[ i ];
-    if( !kl->eliminated_ ) {
-      m_keyframes[ numKept ] = kl->keyframe_;
-      numKept++;
-    }
-  }
-  assert( numKept == numFrames - numFramesEliminated );
-
-  // Delete the eliminated keyframes.
-  for( i = 0; i < numFrames; i++ ) {
-    KeyLink * kl = & keyLinkArray[ i ];
-    if( kl->eliminated_ ) {
-//      kl->keyframe_->destroy();
-delete kl->keyframe_;
-    }
+    vectorEliminated[ i ] = keyLinkArray[ i ].eliminated_;
   }
-  m_keyframes.resize( numKept );
+  keepCoreKeyframes( vectorEliminated );
+  assert( m_keyframeTime.size() == numFrames - numFramesEliminated );
 
   // Update the flag saying whether the translation, which I have loaded, is actually required.
   // If translation is not required, I can't do any better than that so I leave it alone.
@@ -345,24 +546,20 @@ delete kl->keyframe_;
 void
 CalCoreTrack::collapseSequences( double translationTolerance, double rotationToleranceDegrees )
 {
-  unsigned int numFrames = m_keyframes.size();
+  unsigned int numFrames = m_keyframeTime.size();
   if( !numFrames ) return;
   unsigned int numFramesEliminated = 0;
 
+  // Work on the float keyframes.
+  expand();
+
   // I want to iterate through the vector as a list, and remove elements easily.
-  static unsigned int arrayLen = 0;
-  static KeyLink * keyLinkArray = NULL;
-  if( arrayLen < numFrames ) {
-    if( keyLinkArray ) {
-      delete [] keyLinkArray;
-    }
-    keyLinkArray = new( KeyLink [ numFrames ] );
-    arrayLen = numFrames;
-  }
+  std::vector<KeyLink> vectorKeyLink( numFrames );
+  KeyLink * keyLinkArray = & vectorKeyLink[ 0 ];
   unsigned int i;
   for( i = 0; i < numFrames; i++ ) {
     KeyLink * kl = & keyLinkArray[ i ];
-    kl->keyframe_ = m_keyframes[ i ];
+    kl->keyframeId_ = i;
     kl->next_ = ( i == numFrames - 1 ) ? NULL : & keyLinkArray[ i + 1 ];
     kl->eliminated_ = false;
   }
@@ -373,7 +570,7 @@ CalCoreTrack::collapseSequences( double translationTolerance, double rotationTol
   KeyLink * p = & keyLinkArray[ 0 ];
   KeyLink * pstart = p;
   while( p ) {
-    unsigned int lengthOfSequence = KeyFrameSequenceLength( p, translationTolerance, rotationToleranceDegrees );
+    unsigned int lengthOfSequence = KeyFrameSequenceLength( this, p, translationTolerance, rotationToleranceDegrees );
     assert( lengthOfSequence >= 1 );
     if( lengthOfSequence == 1 ) {
       p = p->next_;
@@ -407,38 +604,24 @@ CalCoreTrack::collapseSequences( double translationTolerance, double rotationTol
     }
   }
 
-  // Rebuild the vector, freeing any of the eliminated keyframes.
-  unsigned int numKept = 0;
+  // Rebuild the keyframe arrays from the frames that were kept.
+  std::vector<bool> vectorEliminated( numFrames );
   for( i = 0; i < numFrames; i++ ) {
-    KeyLink * kl = & keyLinkArray[ i ];
-    if( !kl->eliminated_ ) {
-      m_keyframes[ numKept ] = kl->keyframe_;
-      numKept++;
-    }
+    vectorEliminated[ i ] = keyLinkArray[ i ].eliminated_;
   }
-  assert( numKept == numFrames - numFramesEliminated );
-
-  // Delete the eliminated keyframes.
-  for( i = 0; i < numFrames; i++ ) {
-    KeyLink * kl = & keyLinkArray[ i ];
-    if( kl->eliminated_ ) {
-     // kl->keyframe_->destroy();
-delete       kl->keyframe_;
-    }
-  }
-  m_keyframes.resize( numKept );
+  keepCoreKeyframes( vectorEliminated );
+  assert( m_keyframeTime.size() == numFrames - numFramesEliminated );
 }
 
 
 void
 CalCoreTrack::fillInvalidTranslations( CalVector const & trans )
 {
-  unsigned int numFrames = m_keyframes.size();
+  unsigned int numFrames = m_keyframeTime.size();
   for( unsigned int i = 0; i < numFrames; i++ ) {
-    CalCoreKeyframe * keyframe = m_keyframes[ i ];
-    const CalVector & kftrans = keyframe->getTranslation();
+    const CalVector kftrans = getKeyframeTranslation( i );
     if( TranslationInvalid( kftrans ) ) {
-      keyframe->setTranslation( trans );
+      setKeyframeTranslation( i, trans );
     }
   }
 }
@@ -452,22 +635,21 @@ CalCoreTrack::translationCompressibility( bool * transRequiredResult, bool * tra
   * transRequiredResult = false;
   * transDynamicResult = false;
   * highRangeRequiredResult = false;
-  unsigned int numFrames = m_keyframes.size();
+  unsigned int numFrames = m_keyframeTime.size();
   CalCoreBone * cb = skel->getCoreBone( m_coreBoneId );
   const CalVector & cbtrans = cb->getTranslation();
   CalVector trans0;
   float t2 = threshold * threshold;
   unsigned int i;
   for( i = 0; i < numFrames; i++ ) {
-    CalCoreKeyframe * keyframe = m_keyframes[ i ];
-    const CalVector & kftrans = keyframe->getTranslation();
+    const CalVector kftrans = getKeyframeTranslation( i );
     if( fabsf( kftrans.x ) >= highRangeThreshold
       ||  fabsf( kftrans.y ) >= highRangeThreshold
       ||  fabsf( kftrans.z ) >= highRangeThreshold ) {
       * highRangeRequiredResult = true;
     }
     if( i == 0 ) {
-      trans0 = keyframe->getTranslation();
+      trans0 = kftrans;
     } else {
       float d2 = DistanceSquared( trans0, kftrans );
       if( d2 > t2 ) {
@@ -502,74 +684,150 @@ CalCoreTrack::translationCompressibility( bool * transRequiredResult, bool * tra
 
 bool CalCoreTrack::getState(float time, CalVector& translation, CalQuaternion& rotation) const
 {
-  std::vector<CalCoreKeyframe*>::const_iterator iteratorCoreKeyframeBefore;
-  std::vector<CalCoreKeyframe*>::const_iterator iteratorCoreKeyframeAfter;
+  int keyframeCursor = -1;
+  return getState(time, translation, rotation, keyframeCursor);
+}
 
-  // get the keyframe after the requested time
-  iteratorCoreKeyframeAfter = getUpperBound(time);
+ /*****************************************************************************/
+/** Returns a specified state, starting the keyframe search at a cursor.
+  *
+  * This function returns the same state as the version without cursor. The
+  * cursor remembers the keyframe interval found by the previous call, so when
+  * the time moves forward by less than a keyframe from one call to the next,
+  * the interval is found in constant time instead of by a binary search.
+  * Seeks and loop wraps fall back to the binary search. Each caller sampling
+  * the track must keep its own cursor, initialized to -1.
+  *
+  * @param time The time in seconds at which the state should be returned.
+  * @param translation A reference to the translation reference that will be
+  *                    filled with the specified state.
+  * @param rotation A reference to the rotation reference that will be filled
+  *                 with the specified state.
+  * @param keyframeCursor A reference to the cursor, updated by this function.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if an error happened
+  *****************************************************************************/
 
-  // check if the time is after the last keyframe
-  if(iteratorCoreKeyframeAfter == m_keyframes.end())
-  {
-    // return the last keyframe state
-    --iteratorCoreKeyframeAfter;
-    rotation = (*iteratorCoreKeyframeAfter)->getRotation();
-    translation = (*iteratorCoreKeyframeAfter)->getTranslation();
+bool CalCoreTrack::getState(float time, CalVector& translation, CalQuaternion& rotation, int& keyframeCursor) const
+{
+  if(m_keyframeTime.empty()) return false;
 
-    return true;
-  }
+  // get the keyframe after the requested time
+  int keyframeAfter = getUpperBound(time, keyframeCursor);
 
   // check if the time is before the first keyframe
-  if(iteratorCoreKeyframeAfter == m_keyframes.begin())
+  if(keyframeAfter == 0)
   {
     // return the first keyframe state
-    rotation = (*iteratorCoreKeyframeAfter)->getRotation();
-    translation = (*iteratorCoreKeyframeAfter)->getTranslation();
+    rotation = getKeyframeRotation(0);
+    translation = getKeyframeTranslation(0);
 
     return true;
   }
 
-  // get the keyframe before the requested one
-  iteratorCoreKeyframeBefore = iteratorCoreKeyframeAfter;
-  --iteratorCoreKeyframeBefore;
-
-  // get the two keyframe pointers
-  CalCoreKeyframe *pCoreKeyframeBefore;
-  pCoreKeyframeBefore = *iteratorCoreKeyframeBefore;
-  CalCoreKeyframe *pCoreKeyframeAfter;
-  pCoreKeyframeAfter = *iteratorCoreKeyframeAfter;
+  int keyframeBefore = keyframeAfter - 1;
 
   // calculate the blending factor between the two keyframe states
   float blendFactor;
-  blendFactor = (time - pCoreKeyframeBefore->getTime()) / (pCoreKeyframeAfter->getTime() - pCoreKeyframeBefore->getTime());
+  blendFactor = (time - m_keyframeTime[keyframeBefore]) / (m_keyframeTime[keyframeAfter] - m_keyframeTime[keyframeBefore]);
+
+  if(m_quantized)
+  {
+    // decode the two keyframes and blend between them
+    translation = decodeTranslation(keyframeBefore);
+    translation.blend(blendFactor, decodeTranslation(keyframeAfter));
+
+    rotation = decodeRotation(keyframeBefore);
+    rotation.blend(blendFactor, decodeRotation(keyframeAfter));
+
+    return true;
+  }
 
   // blend between the two keyframes
-  translation = pCoreKeyframeBefore->getTranslation();
-  translation.blend(blendFactor, pCoreKeyframeAfter->getTranslation());
+  translation = m_keyframeTranslation[keyframeBefore];
+  translation.blend(blendFactor, m_keyframeTranslation[keyframeAfter]);
 
-  rotation = pCoreKeyframeBefore->getRotation();
-  rotation.blend(blendFactor, pCoreKeyframeAfter->getRotation());
+  rotation = m_keyframeRotation[keyframeBefore];
+  rotation.blend(blendFactor, m_keyframeRotation[keyframeAfter]);
 
   return true;
 }
 
-std::vector<CalCoreKeyframe *>::const_iterator CalCoreTrack::getUpperBound(float time) const
+ /*****************************************************************************/
+/** Returns the keyframe closing the interval of a given time.
+  *
+  * This function returns the index of the first keyframe after the given time,
+  * clamped to [1, keyframe count - 1] so that there always is a keyframe before
+  * it, or 0 for a track with a single keyframe. If the keyframes are evenly
+  * spaced the index is computed from the time. Otherwise the cursor is tried
+  * first, then the keyframe following it; the binary search only runs when
+  * neither of them matches. The cursor is set to the returned index.
+  *
+  * @param time The time in seconds.
+  * @param keyframeCursor A reference to the cursor, -1 if unknown.
+  *
+  * @return The index of the keyframe.
+  *****************************************************************************/
+
+int CalCoreTrack::getUpperBound(float time, int& keyframeCursor) const
 {
+  const int keyframeCount = (int)m_keyframeTime.size();
+  if(keyframeCount < 2)
+  {
+    keyframeCursor = 0;
+    return 0;
+  }
 
-  int lowerBound = 0;
-  int upperBound = m_keyframes.size()-1;
-	//static int aa = 0;
+  const float *keyframeTime = &m_keyframeTime[0];
+
+  if(m_keyframeRate > 0.0f)
+  {
+    // the keyframe times are within a fraction of an interval of the grid, so
+    // the computed index is off by one at most
+    float position = (time - keyframeTime[0]) * m_keyframeRate;
+    int upperBound = keyframeCount - 1;
+    if(position < 0.0f) upperBound = 1;
+    else if(position < (float)(keyframeCount - 2)) upperBound = (int)position + 1;
+
+    if(upperBound > 1 && time < keyframeTime[upperBound - 1])
+    {
+      --upperBound;
+    }
+    else if(upperBound < keyframeCount - 1 && time >= keyframeTime[upperBound])
+    {
+      ++upperBound;
+    }
+
+    keyframeCursor = upperBound;
+    return upperBound;
+  }
 
-	//upperBound += aa;
-	//upperBound %= m_keyframes.size();
-	//aa++;
-	//time = m_keyframes[upperBound]->getTime();
+  int upperBound = keyframeCursor;
+  if(upperBound >= 1 && upperBound < keyframeCount
+    && (upperBound == 1 || time >= keyframeTime[upperBound - 1]))
+  {
+    // the cursor is not past the time; step forward at most once
+    if(upperBound < keyframeCount - 1 && time >= keyframeTime[upperBound])
+    {
+      ++upperBound;
+    }
+    if(upperBound == keyframeCount - 1 || time < keyframeTime[upperBound])
+    {
+      keyframeCursor = upperBound;
+      return upperBound;
+    }
+  }
+
+  int lowerBound = 0;
+  upperBound = keyframeCount - 1;
 
   while(lowerBound<upperBound-1)
   {
 	  int middle = (lowerBound+upperBound)/2;
 
-	  if(time >= m_keyframes[middle]->getTime())
+	  if(time >= keyframeTime[middle])
 	  {
 		  lowerBound=middle;
 	  }
@@ -577,11 +835,10 @@ std::vector<CalCoreKeyframe *>::const_iterator CalCoreTrack::getUpperBound(float
 	  {
 		  upperBound=middle;
 	  }
-		//break;
   }
 
-  return m_keyframes.begin() + upperBound;
-
+  keyframeCursor = upperBound;
+  return upperBound;
 }
 
  /*****************************************************************************/
@@ -614,19 +871,404 @@ bool CalCoreTrack::setCoreBoneId(int coreBoneId)
 
 int CalCoreTrack::getCoreKeyframeCount() const
 {
-  return m_keyframes.size();
+  return m_keyframeTime.size();
 }
 
+ /*****************************************************************************/
+/** Returns a core keyframe.
+  *
+  * This function returns a keyframe object holding the state of a keyframe of
+  * the track, whose setters write through to the track. The track stores its
+  * keyframes as arrays, so the keyframe objects of the track are only built by
+  * the first call to this function, and freed again when keyframes are added
+  * or removed, or the track is resampled, reduced or quantized, which
+  * invalidates the pointers. Use getKeyframeTime, getKeyframeTranslation and
+  * getKeyframeRotation to read keyframes without building the objects.
+  *
+  * @param idx The index of the keyframe.
+  *
+  * @return A pointer to the keyframe.
+  *****************************************************************************/
 
 CalCoreKeyframe *CalCoreTrack::getCoreKeyframe(int idx)
 {
-  return m_keyframes[idx];
+  if(m_vectorCoreKeyframe.size() != m_keyframeTime.size())
+  {
+    m_vectorCoreKeyframe.resize(m_keyframeTime.size());
+    for(size_t keyframeId = 0; keyframeId < m_keyframeTime.size(); ++keyframeId)
+    {
+      CalCoreKeyframe& keyframe = m_vectorCoreKeyframe[keyframeId];
+      keyframe.m_time = m_keyframeTime[keyframeId];
+      keyframe.m_translation = getKeyframeTranslation(keyframeId);
+      keyframe.m_rotation = getKeyframeRotation(keyframeId);
+      keyframe.m_pCoreTrack = this;
+      keyframe.m_keyframeId = (int)keyframeId;
+    }
+  }
+
+  return &m_vectorCoreKeyframe[idx];
+}
+
+ /*****************************************************************************/
+/** Returns a copy of a core keyframe.
+  *
+  * This function returns a keyframe object holding the state of a keyframe of
+  * the track, not linked to the track. It does not modify the track, so it can
+  * be called from several threads on a shared core track.
+  *
+  * @param idx The index of the keyframe.
+  *
+  * @return The keyframe.
+  *****************************************************************************/
+
+CalCoreKeyframe CalCoreTrack::getCoreKeyframe(int idx) const
+{
+  CalCoreKeyframe keyframe;
+  keyframe.m_time = m_keyframeTime[idx];
+  keyframe.m_translation = getKeyframeTranslation(idx);
+  keyframe.m_rotation = getKeyframeRotation(idx);
+  return keyframe;
+}
+
+ /*****************************************************************************/
+/** Removes the eliminated keyframes.
+  *
+  * This function is used by the keyframe reduction passes.
+  *
+  * @param vectorEliminated Whether each of the keyframes was eliminated.
+  *****************************************************************************/
+
+void CalCoreTrack::keepCoreKeyframes(const std::vector<bool>& vectorEliminated)
+{
+  expand();
+
+  size_t keptCount = 0;
+  for(size_t keyframeId = 0; keyframeId < m_keyframeTime.size(); ++keyframeId)
+  {
+    if(vectorEliminated[keyframeId]) continue;
+
+    m_keyframeTime[keptCount] = m_keyframeTime[keyframeId];
+    m_keyframeTranslation[keptCount] = m_keyframeTranslation[keyframeId];
+    m_keyframeRotation[keptCount] = m_keyframeRotation[keyframeId];
+    ++keptCount;
+  }
+  m_keyframeTime.resize(keptCount);
+  m_keyframeTranslation.resize(keptCount);
+  m_keyframeRotation.resize(keptCount);
+
+  releaseCoreKeyframeObjects();
+  m_keyframeRate = 0.0f;
+}
+
+ /*****************************************************************************/
+/** Checks whether the keyframes are evenly spaced.
+  *
+  * This function sets the keyframe rate of the track if its keyframes are
+  * evenly spaced in time, as is the case for animations exported at a fixed
+  * frame rate, so that getState can compute the keyframe interval from the
+  * time instead of searching for it. Otherwise the keyframe rate is set to 0.
+  * The loaders call this function on every track they load.
+  *****************************************************************************/
+
+void CalCoreTrack::updateKeyframeRate()
+{
+  m_keyframeRate = 0.0f;
+
+  const int keyframeCount = (int)m_keyframeTime.size();
+  if(keyframeCount < 2) return;
+
+  const float startTime = m_keyframeTime[0];
+  const float interval = (m_keyframeTime[keyframeCount - 1] - startTime) / (keyframeCount - 1);
+  if(!(interval > 0.0f)) return;
+
+  // allow for the rounding of the exported times
+  const float maxDeviation = interval * 0.01f;
+  for(int keyframeId = 1; keyframeId < keyframeCount - 1; ++keyframeId)
+  {
+    if(fabsf(m_keyframeTime[keyframeId] - (startTime + keyframeId * interval)) > maxDeviation) return;
+  }
+
+  m_keyframeRate = 1.0f / interval;
 }
 
+ /*****************************************************************************/
+/** Resamples the core track.
+  *
+  * This function replaces the keyframes of the core track by evenly spaced
+  * samples of the track, from time 0 to the given duration. The keyframe rate
+  * is raised as little as needed to put the last keyframe at the duration.
+  * Resampling is lossy; use getStateError to check the result against a copy
+  * of the original track.
+  *
+  * @param keyframeRate The number of keyframes per second.
+  * @param duration The duration of the animation in seconds.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if an error happened
+  *****************************************************************************/
 
-const CalCoreKeyframe *CalCoreTrack::getCoreKeyframe(int idx) const
+bool CalCoreTrack::resample(float keyframeRate, float duration)
 {
-  return m_keyframes[idx];
+  if(!(keyframeRate > 0.0f) || duration < 0.0f)
+  {
+    CalError::setLastError(CalError::INVALID_ATTRIBUTE_VALUE, __FILE__, __LINE__);
+    return false;
+  }
+
+  if(m_keyframeTime.empty()) return true;
+
+  expand();
+
+  int intervalCount = (int)ceilf(duration * keyframeRate - 0.001f);
+  if(intervalCount < 1) intervalCount = 1;
+
+  std::vector<float> vectorTime(intervalCount + 1);
+  std::vector<CalVector> vectorTranslation(intervalCount + 1);
+  std::vector<CalQuaternion> vectorRotation(intervalCount + 1);
+
+  int keyframeCursor = -1;
+  for(int keyframeId = 0; keyframeId <= intervalCount; ++keyframeId)
+  {
+    vectorTime[keyframeId] = duration * keyframeId / intervalCount;
+    getState(vectorTime[keyframeId], vectorTranslation[keyframeId], vectorRotation[keyframeId], keyframeCursor);
+  }
+
+  m_keyframeTime.swap(vectorTime);
+  m_keyframeTranslation.swap(vectorTranslation);
+  m_keyframeRotation.swap(vectorRotation);
+
+  releaseCoreKeyframeObjects();
+  updateKeyframeRate();
+
+  return true;
+}
+
+ /*****************************************************************************/
+/** Measures how far the core track is from another one.
+  *
+  * This function compares the states of two core tracks at all keyframe times
+  * of both tracks and halfway between them, from time 0 to the given duration,
+  * and returns the largest differences found.
+  *
+  * @param coreTrack The core track to compare with.
+  * @param duration The duration of the animation in seconds.
+  * @param maxTranslationError A reference to the largest translation distance.
+  * @param maxRotationErrorDegrees A reference to the largest rotation angle in
+  *                                degrees.
+  *****************************************************************************/
+
+void CalCoreTrack::getStateError(const CalCoreTrack& coreTrack, float duration, float& maxTranslationError, float& maxRotationErrorDegrees) const
+{
+  maxTranslationError = 0.0f;
+  maxRotationErrorDegrees = 0.0f;
+
+  std::vector<float> vectorTime;
+  vectorTime.push_back(0.0f);
+  vectorTime.push_back(duration);
+
+  const std::vector<float> *pVectorKeyframeTime[2] = { &m_keyframeTime, &coreTrack.m_keyframeTime };
+  for(int trackId = 0; trackId < 2; ++trackId)
+  {
+    const std::vector<float>& vectorKeyframeTime = *pVectorKeyframeTime[trackId];
+    for(size_t keyframeId = 0; keyframeId < vectorKeyframeTime.size(); ++keyframeId)
+    {
+      vectorTime.push_back(vectorKeyframeTime[keyframeId]);
+      if(keyframeId + 1 < vectorKeyframeTime.size())
+      {
+        vectorTime.push_back(0.5f * (vectorKeyframeTime[keyframeId] + vectorKeyframeTime[keyframeId + 1]));
+      }
+    }
+  }
+
+  for(size_t timeId = 0; timeId < vectorTime.size(); ++timeId)
+  {
+    float time = vectorTime[timeId];
+    if(time < 0.0f || time > duration) continue;
+
+    CalVector translation, otherTranslation;
+    CalQuaternion rotation, otherRotation;
+    if(!getState(time, translation, rotation) || !coreTrack.getState(time, otherTranslation, otherRotation)) continue;
+
+    float translationError = Distance(translation, otherTranslation);
+    if(translationError > maxTranslationError) maxTranslationError = translationError;
+
+    float rotationErrorDegrees = AngleDegrees(rotation, otherRotation);
+    if(rotationErrorDegrees > maxRotationErrorDegrees) maxRotationErrorDegrees = rotationErrorDegrees;
+  }
+}
+
+// The three smallest components of a unit quaternion lie in [-1/sqrt(2), 1/sqrt(2)].
+static const float QuantizedRotationRange = 0.70710678f;
+static const float QuantizedRotationSteps = 32767.0f;
+static const float QuantizedTranslationSteps = 65535.0f;
+
+// Store the three smallest components of the rotation in 15 bits each.  The remaining
+// three bits hold the index and the sign of the largest component, which is rebuilt
+// from the others, so the decoded quaternion has the same sign as the original.
+static void
+QuantizeRotation( const CalQuaternion & rotation, unsigned short * quantized )
+{
+  float component[ 4 ] = { rotation.x, rotation.y, rotation.z, rotation.w };
+  float length = sqrtf( component[ 0 ] * component[ 0 ] + component[ 1 ] * component[ 1 ]
+    + component[ 2 ] * component[ 2 ] + component[ 3 ] * component[ 3 ] );
+  if( length == 0.0f ) length = 1.0f;
+
+  int largest = 0;
+  int i;
+  for( i = 1; i < 4; i++ ) {
+    if( fabsf( component[ i ] ) > fabsf( component[ largest ] ) ) largest = i;
+  }
+
+  int slot = 0;
+  for( i = 0; i < 4; i++ ) {
+    if( i == largest ) continue;
+    float value = ( component[ i ] / length / QuantizedRotationRange ) * 0.5f + 0.5f;
+    if( value < 0.0f ) value = 0.0f;
+    if( value > 1.0f ) value = 1.0f;
+    quantized[ slot++ ] = ( unsigned short ) ( value * QuantizedRotationSteps + 0.5f );
+  }
+
+  quantized[ 0 ] |= ( largest & 1 ) << 15;
+  quantized[ 1 ] |= ( largest >> 1 ) << 15;
+  if( component[ largest ] < 0.0f ) quantized[ 2 ] |= 1 << 15;
+}
+
+static CalQuaternion
+DequantizeRotation( const unsigned short * quantized )
+{
+  int largest = ( quantized[ 0 ] >> 15 ) | ( ( quantized[ 1 ] >> 15 ) << 1 );
+
+  float component[ 4 ];
+  float sum = 0.0f;
+  int slot = 0;
+  for( int i = 0; i < 4; i++ ) {
+    if( i == largest ) continue;
+    float value = ( quantized[ slot++ ] & 0x7fff ) * ( 2.0f * QuantizedRotationRange / QuantizedRotationSteps ) - QuantizedRotationRange;
+    component[ i ] = value;
+    sum += value * value;
+  }
+
+  component[ largest ] = ( sum < 1.0f ) ? sqrtf( 1.0f - sum ) : 0.0f;
+  if( quantized[ 2 ] & 0x8000 ) component[ largest ] = - component[ largest ];
+
+  return CalQuaternion( component[ 0 ], component[ 1 ], component[ 2 ], component[ 3 ] );
+}
+
+ /*****************************************************************************/
+/** Quantizes the keyframes of the core track.
+  *
+  * This function replaces the float translations and rotations of the
+  * keyframes by 16-bit fixed point values: the translations relative to the
+  * bounding box of the track, the rotations as their three smallest
+  * components. This halves the memory of the keyframe arrays; getState decodes the
+  * two keyframes it blends. The keyframe times are kept as they are. Any
+  * change to the translations or rotations expands the track again.
+  *****************************************************************************/
+
+void CalCoreTrack::quantize()
+{
+  const int keyframeCount = (int)m_keyframeTime.size();
+  if(m_quantized || keyframeCount == 0) return;
+
+  // get the range of the translations
+  CalVector minTranslation = m_keyframeTranslation[0];
+  CalVector maxTranslation = m_keyframeTranslation[0];
+  int keyframeId;
+  for(keyframeId = 1; keyframeId < keyframeCount; ++keyframeId)
+  {
+    const CalVector& translation = m_keyframeTranslation[keyframeId];
+    for(int axis = 0; axis < 3; ++axis)
+    {
+      if(translation[axis] < minTranslation[axis]) minTranslation[axis] = translation[axis];
+      if(translation[axis] > maxTranslation[axis]) maxTranslation[axis] = translation[axis];
+    }
+  }
+
+  m_quantizedTranslationMin = minTranslation;
+  m_quantizedTranslationScale = maxTranslation - minTranslation;
+  m_quantizedTranslationScale /= QuantizedTranslationSteps;
+
+  m_quantizedKeyframe.resize(keyframeCount * 6);
+  for(keyframeId = 0; keyframeId < keyframeCount; ++keyframeId)
+  {
+    unsigned short *quantized = &m_quantizedKeyframe[keyframeId * 6];
+
+    const CalVector& translation = m_keyframeTranslation[keyframeId];
+    for(int axis = 0; axis < 3; ++axis)
+    {
+      float steps = 0.0f;
+      if(m_quantizedTranslationScale[axis] > 0.0f)
+      {
+        steps = (translation[axis] - minTranslation[axis]) / m_quantizedTranslationScale[axis] + 0.5f;
+        if(steps > QuantizedTranslationSteps) steps = QuantizedTranslationSteps;
+      }
+      quantized[axis] = (unsigned short)steps;
+    }
+
+    QuantizeRotation(m_keyframeRotation[keyframeId], quantized + 3);
+  }
+
+  std::vector<CalVector>().swap(m_keyframeTranslation);
+  std::vector<CalQuaternion>().swap(m_keyframeRotation);
+  m_quantized = true;
+
+  releaseCoreKeyframeObjects();
+}
+
+ /*****************************************************************************/
+/** Expands the keyframes of a quantized core track.
+  *
+  * This function replaces the quantized translations and rotations of the
+  * keyframes by their decoded float values. It does nothing if the track is
+  * not quantized.
+  *****************************************************************************/
+
+void CalCoreTrack::expand()
+{
+  if(!m_quantized) return;
+
+  const int keyframeCount = (int)m_keyframeTime.size();
+  m_keyframeTranslation.resize(keyframeCount);
+  m_keyframeRotation.resize(keyframeCount);
+  for(int keyframeId = 0; keyframeId < keyframeCount; ++keyframeId)
+  {
+    m_keyframeTranslation[keyframeId] = decodeTranslation(keyframeId);
+    m_keyframeRotation[keyframeId] = decodeRotation(keyframeId);
+  }
+
+  std::vector<unsigned short>().swap(m_quantizedKeyframe);
+  m_quantized = false;
+}
+
+ /*****************************************************************************/
+/** Decodes the translation of a quantized keyframe.
+  *
+  * @param idx The index of the keyframe.
+  *
+  * @return The translation.
+  *****************************************************************************/
+
+CalVector CalCoreTrack::decodeTranslation(int idx) const
+{
+  const unsigned short *quantized = &m_quantizedKeyframe[idx * 6];
+
+  return CalVector(m_quantizedTranslationMin.x + quantized[0] * m_quantizedTranslationScale.x,
+                   m_quantizedTranslationMin.y + quantized[1] * m_quantizedTranslationScale.y,
+                   m_quantizedTranslationMin.z + quantized[2] * m_quantizedTranslationScale.z);
+}
+
+ /*****************************************************************************/
+/** Decodes the rotation of a quantized keyframe.
+  *
+  * @param idx The index of the keyframe.
+  *
+  * @return The rotation.
+  *****************************************************************************/
+
+CalQuaternion CalCoreTrack::decodeRotation(int idx) const
+{
+  return DequantizeRotation(&m_quantizedKeyframe[idx * 6 + 3]);
 }
 
  /*****************************************************************************/
@@ -641,11 +1283,20 @@ const CalCoreKeyframe *CalCoreTrack::getCoreKeyframe(int idx) const
 
 void CalCoreTrack::scale(float factor)
 {
-  for(size_t keyframeId = 0; keyframeId < m_keyframes.size(); keyframeId++)
+  if(m_quantized)
+  {
+    // the quantized translations are relative to the range of the track
+    m_quantizedTranslationMin *= factor;
+    m_quantizedTranslationScale *= factor;
+    releaseCoreKeyframeObjects();
+    return;
+  }
+
+  for(size_t keyframeId = 0; keyframeId < m_keyframeTime.size(); keyframeId++)
   {
-    CalVector translation = m_keyframes[keyframeId]->getTranslation();
+    CalVector translation = m_keyframeTranslation[keyframeId];
     translation*=factor;
-    m_keyframes[keyframeId]->setTranslation(translation);
+    setKeyframeTranslation(keyframeId, translation);
   }
 
 }
@@ -16,10 +16,10 @@
 #include "cal3d/matrix.h"
 #include "cal3d/vector.h"
 #include "cal3d/quaternion.h"
+#include "cal3d/corekeyframe.h"
 
 namespace cal3d{
 	class CalCoreBone;
-	class CalCoreKeyframe;
 	class CalCoreSkeleton;
 
 
@@ -37,17 +37,37 @@ namespace cal3d{
 		static int m_translationRequiredCount;
 		static int m_translationNotRequiredCount;
 
-		/// List of keyframes, always sorted by time.
-		std::vector<CalCoreKeyframe*> m_keyframes;
+		/// Keyframes, always sorted by time, stored as one array per component.
+		std::vector<float> m_keyframeTime;
+		std::vector<CalVector> m_keyframeTranslation;
+		std::vector<CalQuaternion> m_keyframeRotation;
+
+		/// Keyframe objects handed out by getCoreKeyframe, built on its first
+		/// call and kept in sync with the arrays above until they are freed.
+		std::vector<CalCoreKeyframe> m_vectorCoreKeyframe;
+
+		/// Keyframes per second if the keyframes are evenly spaced, 0 otherwise.
+		float m_keyframeRate;
+
+		/// Quantized translations and rotations, 6 shorts per keyframe, used
+		/// instead of the float arrays once the track is quantized.
+		bool m_quantized;
+		std::vector<unsigned short> m_quantizedKeyframe;
+		CalVector m_quantizedTranslationMin;
+		CalVector m_quantizedTranslationScale;
 
 		// constructors/destructor
 	public:
 		CalCoreTrack();
+		CalCoreTrack(const CalCoreTrack& other);
 		~CalCoreTrack();
 
+		CalCoreTrack& operator=(const CalCoreTrack& other);
+
 		unsigned int size();
 
 		bool getState(float time, CalVector& translation, CalQuaternion& rotation) const;
+		bool getState(float time, CalVector& translation, CalQuaternion& rotation, int& keyframeCursor) const;
 
 		/*****************************************************************************/
 		/** Returns the ID of the core bone.
@@ -65,10 +85,32 @@ namespace cal3d{
 
 		int getCoreKeyframeCount() const;
 		CalCoreKeyframe *getCoreKeyframe(int idx);
-		const CalCoreKeyframe *getCoreKeyframe(int idx) const;
+		CalCoreKeyframe getCoreKeyframe(int idx) const;
 
 		bool addCoreKeyframe(CalCoreKeyframe *pCoreKeyframe);
-		void removeCoreKeyFrame(int _i)           { m_keyframes.erase(m_keyframes.begin() + _i); }
+		bool addCoreKeyframe(float time, const CalVector& translation, const CalQuaternion& rotation);
+		void removeCoreKeyFrame(int _i);
+		void reserve(int keyframeCount);
+
+		///keyframe data, indexed like getCoreKeyframe
+		inline float getKeyframeTime(int idx) const                          { return m_keyframeTime[idx]; }
+		inline CalVector getKeyframeTranslation(int idx) const               { return m_quantized ? decodeTranslation(idx) : m_keyframeTranslation[idx]; }
+		inline CalQuaternion getKeyframeRotation(int idx) const              { return m_quantized ? decodeRotation(idx) : m_keyframeRotation[idx]; }
+		inline const std::vector<float>& getVectorKeyframeTime() const       { return m_keyframeTime; }
+		void setKeyframeTime(int idx, float time);
+		void setKeyframeTranslation(int idx, const CalVector& translation);
+		void setKeyframeRotation(int idx, const CalQuaternion& rotation);
+
+		///keyframes per second if the keyframes are evenly spaced, 0 otherwise
+		inline float getKeyframeRate() const                                 { return m_keyframeRate; }
+		void updateKeyframeRate();
+		bool resample(float keyframeRate, float duration);
+		void getStateError(const CalCoreTrack& coreTrack, float duration, float& maxTranslationError, float& maxRotationErrorDegrees) const;
+
+		///quantized keyframes are decoded when the track is sampled
+		inline bool isQuantized() const                                      { return m_quantized; }
+		void quantize();
+		void expand();
 
 		bool getTranslationRequired() { return m_translationRequired; }
 		void setTranslationRequired(bool p)     { m_translationRequired = p; }
@@ -90,9 +132,14 @@ namespace cal3d{
 		void collapseSequences(double translationTolerance, double rotationToleranceDegrees);
 
 	private:
-		std::vector<CalCoreKeyframe *>::const_iterator getUpperBound(float time) const;
-		bool keyframeEliminatable(CalCoreKeyframe * prev, CalCoreKeyframe * p, CalCoreKeyframe * next,
-			double translationTolerance, double rotationToleranceDegrees);
+		int getUpperBound(float time, int& keyframeCursor) const;
+		bool keyframeEliminatable(int prev, int p, int next,
+			double translationTolerance, double rotationToleranceDegrees) const;
+		bool roundKeyframeTranslation(int prevId, int keyframeId, double translationTolerance);
+		void keepCoreKeyframes(const std::vector<bool>& vectorEliminated);
+		void releaseCoreKeyframeObjects();
+		CalVector decodeTranslation(int idx) const;
+		CalQuaternion decodeRotation(int idx) const;
 	};
 }
 #endif
@@ -388,6 +388,35 @@ const CalVector & CalHardwareModel::getTranslationBoneSpace(int boneId, CalSkele
   return vectorBone[m_vectorHardwareMesh[m_selectedHardwareMesh].m_vectorBonesIndices[boneId]]->getTranslationBoneSpace();
 }
 
+ /*****************************************************************************/
+/** Writes the skinning palette of the selected hardware mesh.
+  *
+  * This function writes the skinning matrices of all bones of the selected
+  * hardware mesh to a contiguous array of 12 floats per bone, entry i being
+  * the matrix of the bone with the number i in the matrix index buffer. See
+  * CalSkeleton::getSkinningPalette for the layouts.
+  *
+  * @param pPalette A pointer to the array receiving the matrices, 12 floats
+  *                 per bone of the hardware mesh.
+  * @param pSkeleton A pointer to the skeleton holding the bone states.
+  * @param layout The memory layout of the matrices.
+  *
+  * @return One of the following values:
+  *         \li the number of matrices written
+  *         \li \b -1 if an error happened
+  *****************************************************************************/
+
+int CalHardwareModel::getSkinningPalette(float *pPalette, const CalSkeleton *pSkeleton, CalSkinningPaletteLayout layout) const
+{
+  if((m_selectedHardwareMesh < 0) || (m_selectedHardwareMesh >= (int)m_vectorHardwareMesh.size()))
+  {
+    CalError::setLastError(CalError::INVALID_HANDLE, __FILE__, __LINE__);
+    return -1;
+  }
+
+  return pSkeleton->getSkinningPalette(pPalette, m_vectorHardwareMesh[m_selectedHardwareMesh].m_vectorBonesIndices, layout);
+}
+
  /*****************************************************************************/
 /** Returns the number of hardware meshes.
   *
@@ -679,7 +708,6 @@ bool CalHardwareModel::load(int baseVertexIndex, int startIndex,int maxBonesPerM
     {     
       CalCoreSubmesh *pCoreSubmesh = pCoreMesh->getCoreSubmesh(submeshId);
       
-      std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
       std::vector<CalCoreSubmesh::Face>& vectorFace = pCoreSubmesh->getVectorFace();
                         // unused.
       //std::vector< std::vector<CalCoreSubmesh::TextureCoordinate> >& vectorTex = pCoreSubmesh->getVectorVectorTextureCoordinate();
@@ -701,7 +729,7 @@ bool CalHardwareModel::load(int baseVertexIndex, int startIndex,int maxBonesPerM
       int faceId;     
       for( faceId =0 ;faceId<pCoreSubmesh->getFaceCount();faceId++)
       {
-        if(canAddFace(hardwareMesh,vectorFace[faceId],vectorVertex,maxBonesPerMesh))
+        if(canAddFace(hardwareMesh,vectorFace[faceId],pCoreSubmesh,maxBonesPerMesh))
         {
           m_pIndexBuffer[startIndex+hardwareMesh.faceCount*3]=   addVertex(hardwareMesh,vectorFace[faceId].vertexId[0],pCoreSubmesh,maxBonesPerMesh);
           m_pIndexBuffer[startIndex+hardwareMesh.faceCount*3+1]= addVertex(hardwareMesh,vectorFace[faceId].vertexId[1],pCoreSubmesh,maxBonesPerMesh);
@@ -759,17 +787,19 @@ bool CalHardwareModel::load(int baseVertexIndex, int startIndex,int maxBonesPerM
 
 
 
-bool CalHardwareModel::canAddFace(CalHardwareMesh &hardwareMesh, CalCoreSubmesh::Face & face,std::vector<CalCoreSubmesh::Vertex>& vectorVertex, int maxBonesPerMesh) const
+bool CalHardwareModel::canAddFace(CalHardwareMesh &hardwareMesh, CalCoreSubmesh::Face & face,const CalCoreSubmesh *pCoreSubmesh, int maxBonesPerMesh) const
 {
   size_t boneCount=hardwareMesh.m_vectorBonesIndices.size();
   
   for(unsigned faceIndex=0;faceIndex<3;faceIndex++)
   {
-    for(size_t influenceIndex=0;influenceIndex< vectorVertex[face.vertexId[faceIndex]].vectorInfluence.size();influenceIndex++)
+    const CalCoreSubmesh::Influence *pInfluence = pCoreSubmesh->getInfluences(face.vertexId[faceIndex]);
+    int influenceCount = pCoreSubmesh->getInfluenceCount(face.vertexId[faceIndex]);
+    for(int influenceIndex=0;influenceIndex< influenceCount;influenceIndex++)
     {
       unsigned boneIndex=0;
       while(boneIndex< hardwareMesh.m_vectorBonesIndices.size() 
-        && hardwareMesh.m_vectorBonesIndices[boneIndex]!=vectorVertex[face.vertexId[faceIndex]].vectorInfluence[influenceIndex].boneId)
+        && hardwareMesh.m_vectorBonesIndices[boneIndex]!=pInfluence[influenceIndex].boneId)
         boneIndex++;
       
       if(boneIndex==hardwareMesh.m_vectorBonesIndices.size())
@@ -797,7 +827,7 @@ int CalHardwareModel::addVertex(CalHardwareMesh &hardwareMesh, int indice, CalCo
     return i;
 
   
-  std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
+  const std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
   std::vector< std::vector<CalCoreSubmesh::TextureCoordinate> >& vectorvectorTextureCoordinate = pCoreSubmesh->getVectorVectorTextureCoordinate();
   std::vector< std::vector<CalCoreSubmesh::TangentSpace> >& vectorvectorTangentSpace = pCoreSubmesh->getVectorVectorTangentSpace();
 
@@ -829,15 +859,17 @@ int CalHardwareModel::addVertex(CalHardwareMesh &hardwareMesh, int indice, CalCo
     }
   }
   
-  for(size_t l=0 ; l<4 ; l++)
+  const CalCoreSubmesh::Influence *pInfluence = pCoreSubmesh->getInfluences(indice);
+  int influenceCount = pCoreSubmesh->getInfluenceCount(indice);
+  for(int l=0 ; l<4 ; l++)
   {
-    if(l < vectorVertex[indice].vectorInfluence.size())
+    if(l < influenceCount)
     { 
-      int BoneId = vectorVertex[indice].vectorInfluence[l].boneId;
+      int BoneId = pInfluence[l].boneId;
 
       float newBoneId = (float)addBoneIndice(hardwareMesh,BoneId,maxBonesPerMesh);
     
-      memcpy(&m_pWeightBuffer[(hardwareMesh.baseVertexIndex+i)*m_weightStride+l * sizeof(float) ], &vectorVertex[indice].vectorInfluence[l].weight ,sizeof(float));     
+      memcpy(&m_pWeightBuffer[(hardwareMesh.baseVertexIndex+i)*m_weightStride+l * sizeof(float) ], &pInfluence[l].weight ,sizeof(float));     
       memcpy(&m_pMatrixIndexBuffer[(hardwareMesh.baseVertexIndex+i)*m_matrixIndexStride+l * sizeof(float) ], &newBoneId ,sizeof(float));      
     }
     else
@@ -14,6 +14,7 @@
 
 #include "cal3d/global.h"
 #include "cal3d/coresubmesh.h"
+#include "cal3d/skeleton.h"
 
 namespace cal3d{
 	class CalCoreModel;
@@ -60,6 +61,7 @@ namespace cal3d{
 		void getSpecularColor(unsigned char *pColorBuffer) const;
 		const CalQuaternion & getRotationBoneSpace(int boneId, CalSkeleton *pSkeleton) const;
 		const CalVector & getTranslationBoneSpace(int boneId, CalSkeleton *pSkeleton) const;
+		int getSkinningPalette(float *pPalette, const CalSkeleton *pSkeleton, CalSkinningPaletteLayout layout = CAL_SKINNING_PALETTE_ROW_MAJOR_3X4) const;
 
 		float getShininess() const;
 
@@ -80,7 +82,7 @@ namespace cal3d{
 		bool selectHardwareMesh(size_t meshId);
 
 	private:
-		bool canAddFace(CalHardwareMesh &hardwareMesh, CalCoreSubmesh::Face & face, std::vector<CalCoreSubmesh::Vertex>& vectorVertex, int maxBonesPerMesh) const;
+		bool canAddFace(CalHardwareMesh &hardwareMesh, CalCoreSubmesh::Face & face, const CalCoreSubmesh *pCoreSubmesh, int maxBonesPerMesh) const;
 		int  addVertex(CalHardwareMesh &hardwareMesh, int indice, CalCoreSubmesh *pCoreSubmesh, int maxBonesPerMesh);
 		int  addBoneIndice(CalHardwareMesh &hardwareMesh, int Indice, int maxBonesPerMesh);
 
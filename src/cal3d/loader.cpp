@@ -46,10 +46,17 @@ double CalLoader::translationTolerance = 0.25;
 double CalLoader::rotationToleranceDegrees = 0.1;
 bool CalLoader::loadingCompressionOn = false;
 bool CalLoader::collapseSequencesOn = false;
+float CalLoader::resampleRate = 0.0f;
+bool CalLoader::quantizationOn = false;
 int CalLoader::numEliminatedKeyframes = 0;
 int CalLoader::numKeptKeyframes = 0;
 int CalLoader::numCompressedAnimations = 0;
 int CalLoader::numRoundedKeyframes = 0;
+int CalLoader::numResampledTracks = 0;
+int CalLoader::numResampleRejectedTracks = 0;
+int CalLoader::numQuantizedTracks = 0;
+int CalLoader::numQuantizeRejectedTracks = 0;
+int CalLoader::numQuantizedBytesSaved = 0;
 
 
 // Quat format:
@@ -105,6 +112,8 @@ TranslationWritten( CalCoreKeyframe * lastCoreKeyframe, bool translationRequired
   *             which has the effect of swapping Y/Z coordinates.
   *         \li LOADER_INVERT_V_COORD will substitute (1-v) for any v texture coordinate
   *             to eliminate the need for texture inversion after export.
+  *         \li LOADER_RELEASE_VERTEX_INFLUENCES will free the per-vertex influence
+  *             vectors once the flattened influence stream of a submesh is built.
   *
   *****************************************************************************/
 void CalLoader::setLoadingMode(int flags)
@@ -654,6 +663,15 @@ CalCoreAnimationPtr CalLoader::loadCoreAnimation(CalDataSource& dataSrc, CalCore
     pCoreAnimation->addCoreTrack(pCoreTrack);
   }
 
+  if(resampleRate > 0.0f)
+  {
+    resampleCoreAnimation(pCoreAnimation.get());
+  }
+  if(quantizationOn)
+  {
+    quantizeCoreAnimation(pCoreAnimation.get());
+  }
+
   return pCoreAnimation;
 }
 
@@ -670,6 +688,63 @@ CalLoader::compressCoreAnimation( CalCoreAnimation * anim, CalCoreSkeleton *skel
 }
 
 
+// Resample each track to evenly spaced keyframes at resampleRate, so that sampling it
+// does not search for the keyframes.  A track is only resampled if the result stays within
+// the animation tolerances of the original; otherwise it is left as it is.
+void
+CalLoader::resampleCoreAnimation( CalCoreAnimation * anim )
+{
+	const float duration = anim->getDuration();
+	const std::list<CalCoreTrack *>& listCoreTrack = anim->getListCoreTrack();
+	std::list<CalCoreTrack *>::const_iterator iteratorCoreTrack;
+    for(iteratorCoreTrack = listCoreTrack.begin(); iteratorCoreTrack != listCoreTrack.end(); ++iteratorCoreTrack)
+    {
+      CalCoreTrack *pCoreTrack=*iteratorCoreTrack;
+      CalCoreTrack originalCoreTrack( *pCoreTrack );
+      if( !pCoreTrack->resample( resampleRate, duration ) ) continue;
+
+      float maxTranslationError, maxRotationErrorDegrees;
+      pCoreTrack->getStateError( originalCoreTrack, duration, maxTranslationError, maxRotationErrorDegrees );
+      if( maxTranslationError <= translationTolerance && maxRotationErrorDegrees <= rotationToleranceDegrees ) {
+        numResampledTracks++;
+      } else {
+        * pCoreTrack = originalCoreTrack;
+        numResampleRejectedTracks++;
+      }
+    }
+}
+
+
+// Quantize the keyframes of each track, so that they take half the memory and are decoded
+// when sampled.  As for resampling, a track is only quantized if the result stays within the
+// animation tolerances of the original.
+void
+CalLoader::quantizeCoreAnimation( CalCoreAnimation * anim )
+{
+	const float duration = anim->getDuration();
+	const std::list<CalCoreTrack *>& listCoreTrack = anim->getListCoreTrack();
+	std::list<CalCoreTrack *>::const_iterator iteratorCoreTrack;
+    for(iteratorCoreTrack = listCoreTrack.begin(); iteratorCoreTrack != listCoreTrack.end(); ++iteratorCoreTrack)
+    {
+      CalCoreTrack *pCoreTrack=*iteratorCoreTrack;
+      CalCoreTrack originalCoreTrack( *pCoreTrack );
+      unsigned int originalSize = pCoreTrack->size();
+      pCoreTrack->quantize();
+      if( !pCoreTrack->isQuantized() ) continue;
+
+      float maxTranslationError, maxRotationErrorDegrees;
+      pCoreTrack->getStateError( originalCoreTrack, duration, maxTranslationError, maxRotationErrorDegrees );
+      if( maxTranslationError <= translationTolerance && maxRotationErrorDegrees <= rotationToleranceDegrees ) {
+        numQuantizedTracks++;
+        numQuantizedBytesSaved += originalSize - pCoreTrack->size();
+      } else {
+        * pCoreTrack = originalCoreTrack;
+        numQuantizeRejectedTracks++;
+      }
+    }
+}
+
+
 /*****************************************************************************/
 /** Loads a core animatedMorph instance.
 *
@@ -1756,10 +1831,9 @@ CalCoreSubmesh *CalLoader::loadCoreSubmesh(CalDataSource& dataSrc, int version)
 	// load all vertices and their influences
    pCoreSubmesh->setHasNonWhiteVertexColors( false );
 	int vertexId;
-	std::vector<CalCoreSubmesh::Vertex>&	vertexVector( pCoreSubmesh->getVectorVertex() );
 	for(vertexId = 0; vertexId < vertexCount; ++vertexId)
 	{
-		CalCoreSubmesh::Vertex& vertex( vertexVector[ vertexId ] );
+		CalCoreSubmesh::Vertex vertex;
 
 		// load data of the vertex
 		dataSrc.readFloat(vertex.position.x);
@@ -1993,10 +2067,10 @@ CalCoreSubmesh *CalLoader::loadCoreSubmesh(CalDataSource& dataSrc, int version)
 		if (justOnce==0)
 		{
 			// get vertexes of first face
-			std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
-			CalCoreSubmesh::Vertex& v1 = vectorVertex[tmp[0]];
-			CalCoreSubmesh::Vertex& v2 = vectorVertex[tmp[1]];
-			CalCoreSubmesh::Vertex& v3 = vectorVertex[tmp[2]];
+			const std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
+			const CalCoreSubmesh::Vertex& v1 = vectorVertex[tmp[0]];
+			const CalCoreSubmesh::Vertex& v2 = vectorVertex[tmp[1]];
+			const CalCoreSubmesh::Vertex& v3 = vectorVertex[tmp[2]];
 
 			CalVector point1 = CalVector(v1.position.x, v1.position.y, v1.position.z);
 			CalVector point2 = CalVector(v2.position.x, v2.position.y, v2.position.z);
@@ -2044,6 +2118,14 @@ CalCoreSubmesh *CalLoader::loadCoreSubmesh(CalDataSource& dataSrc, int version)
 		pCoreSubmesh->setFace(faceId, face);
 	}
 
+	// flatten the influences and pack the vertex data for the vectorized skinning path
+	pCoreSubmesh->updateInfluenceStream();
+	pCoreSubmesh->updateSkinningLayout();
+	if (loadingMode & LOADER_RELEASE_VERTEX_INFLUENCES)
+	{
+		pCoreSubmesh->releaseVertexInfluences();
+	}
+
 	return pCoreSubmesh.release();
 }
 
@@ -2129,15 +2211,15 @@ CalCoreTrack *CalLoader::loadCoreTrack(
 
 
    // load all core keyframes
+   pCoreTrack->reserve(keyframeCount);
    int keyframeId;
-   CalCoreKeyframe * lastCoreKeyframe = NULL;
+   CalCoreKeyframe lastCoreKeyframe;
    for(keyframeId = 0; keyframeId < keyframeCount; ++keyframeId)
    {
       // load the core keyframe
       CalCoreKeyframe *pCoreKeyframe = loadCoreKeyframe(
-         dataSrc, cb, version, lastCoreKeyframe, translationRequired, highRangeRequired, translationIsDynamic,
+         dataSrc, cb, version, keyframeId > 0 ? &lastCoreKeyframe : NULL, translationRequired, highRangeRequired, translationIsDynamic,
          useAnimationCompression);
-      lastCoreKeyframe = pCoreKeyframe;
       if(pCoreKeyframe == 0)
       {
          delete pCoreTrack;
@@ -2160,6 +2242,10 @@ CalCoreTrack *CalLoader::loadCoreTrack(
          }
       }
 
+      // keep a copy for decoding the next keyframe, since the track destroys
+      // the keyframe instance once it has copied it
+      lastCoreKeyframe = *pCoreKeyframe;
+
       // add the core keyframe to the core track instance
       pCoreTrack->addCoreKeyframe(pCoreKeyframe);
    }
@@ -2179,6 +2265,7 @@ CalCoreTrack *CalLoader::loadCoreTrack(
       // translationRequired flag; instead it will leave it, as above.
       pCoreTrack->compress( translationTolerance, rotationToleranceDegrees, skel );
    }
+   pCoreTrack->updateKeyframeRate();
 
    return pCoreTrack;
 }
@@ -2333,5 +2420,15 @@ CalLoader::setAnimationRotationToleranceDegrees( double p )
 {
    rotationToleranceDegrees = p;
 }
+void
+CalLoader::setAnimationResampleRate( float p )
+{
+   resampleRate = p;
+}
+void
+CalLoader::setAnimationQuantizationOn( bool p )
+{
+   quantizationOn = p;
+}
 
 //****************************************************************************//
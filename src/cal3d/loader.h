@@ -50,7 +50,8 @@ namespace cal3d
 	{
 		LOADER_ROTATE_X_AXIS = 1,
 		LOADER_INVERT_V_COORD = 2,
-		LOADER_FLIP_WINDING = 4
+		LOADER_FLIP_WINDING = 4,
+		LOADER_RELEASE_VERTEX_INFLUENCES = 8
 	};
 
 
@@ -108,6 +109,8 @@ namespace cal3d
 		static void setAnimationLoadingCompressionOn(bool p);
 		static void setAnimationTranslationTolerance(double p);
 		static void setAnimationRotationToleranceDegrees(double p);
+		static void setAnimationResampleRate(float p);
+		static void setAnimationQuantizationOn(bool p);
 
 		static bool getAnimationLoadingCompressionOn() { return loadingCompressionOn; }
 		static CalCoreKeyframe *loadCoreKeyframe(CalDataSource& dataSrc);
@@ -118,6 +121,13 @@ namespace cal3d
 		static int getAnimationNumKeptKeyframes() { return numKeptKeyframes; }
 		static int getAnimationNumRoundedKeyframes() { return numRoundedKeyframes; }
 		static int getAnimationNumCompressedAnimations() { return numCompressedAnimations; }
+		static float getAnimationResampleRate() { return resampleRate; }
+		static int getAnimationNumResampledTracks() { return numResampledTracks; }
+		static int getAnimationNumResampleRejectedTracks() { return numResampleRejectedTracks; }
+		static bool getAnimationQuantizationOn() { return quantizationOn; }
+		static int getAnimationNumQuantizedTracks() { return numQuantizedTracks; }
+		static int getAnimationNumQuantizeRejectedTracks() { return numQuantizeRejectedTracks; }
+		static int getAnimationNumQuantizedBytesSaved() { return numQuantizedBytesSaved; }
 		static void addAnimationCompressionStatistic(int totalKeyframes, int eliminatedKeyframes, int numRounded) {
 			numEliminatedKeyframes += eliminatedKeyframes;
 			numKeptKeyframes += totalKeyframes - eliminatedKeyframes;
@@ -140,6 +150,8 @@ namespace cal3d
 			int version,
 			bool needTranslation, bool highRangeRequired);
 		static void compressCoreAnimation(CalCoreAnimation * anim, CalCoreSkeleton *skel);
+		static void resampleCoreAnimation(CalCoreAnimation * anim);
+		static void quantizeCoreAnimation(CalCoreAnimation * anim);
 
 		// xmlformat.cpp
 		static CalCoreAnimationPtr loadXmlCoreAnimation(const std::string& strFilename, CalCoreSkeleton *skel = NULL);
@@ -176,11 +188,18 @@ namespace cal3d
 		static double rotationToleranceDegrees;
 		static bool loadingCompressionOn;
 		static bool collapseSequencesOn;
+		static float resampleRate;
+		static bool quantizationOn;
 
 		static int numEliminatedKeyframes;
 		static int numKeptKeyframes;
 		static int numCompressedAnimations;
 		static int numRoundedKeyframes;
+		static int numResampledTracks;
+		static int numResampleRejectedTracks;
+		static int numQuantizedTracks;
+		static int numQuantizeRejectedTracks;
+		static int numQuantizedBytesSaved;
 	};
 
 
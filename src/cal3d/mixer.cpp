@@ -33,6 +33,9 @@
 #include "cal3d/animation.h"
 #include "cal3d/animation_action.h"
 #include "cal3d/animation_cycle.h"
+#include "cal3d/posecache.h"
+
+#include <algorithm>
 
 using namespace cal3d;
 /*****************************************************************************/
@@ -58,8 +61,16 @@ CalMixer::CalMixer(CalModel* pModel)
 	m_animationTime = 0.0f;
 	m_animationDuration = 0.0f;
 	m_timeFactor = 1.0f;
-	m_numBoneAdjustments = 0;
 
+	m_boneAdjustmentVersion = 0;
+	m_lastBoneAdjustmentVersion = 0;
+	m_skeletonStateVersion = 0;
+	m_skeletonValid = false;
+	m_numSkeletonUpdates = 0;
+	m_numSkippedSkeletonUpdates = 0;
+
+	m_pPoseCache = 0;
+	m_updatingAnimations = false;
 }
 
 /*****************************************************************************/
@@ -70,24 +81,33 @@ CalMixer::CalMixer(CalModel* pModel)
 
 CalMixer::~CalMixer()
 {
-	// destroy all active animation actions
-	while (!m_listAnimationAction.empty())
+	// destroy all active and free animation actions
+	size_t actionId;
+	for (actionId = 0; actionId < m_vectorAnimationAction.size(); ++actionId)
 	{
-		CalAnimationAction *pAnimationAction = m_listAnimationAction.front();
-		m_listAnimationAction.pop_front();
+		delete m_vectorAnimationAction[actionId];
+	}
+	m_vectorAnimationAction.clear();
 
-		delete pAnimationAction;
+	for (actionId = 0; actionId < m_vectorFreeAnimationAction.size(); ++actionId)
+	{
+		delete m_vectorFreeAnimationAction[actionId];
 	}
+	m_vectorFreeAnimationAction.clear();
 
-	// destroy all active animation cycles
-	while (!m_listAnimationCycle.empty())
+	// destroy all active and free animation cycles
+	size_t cycleId;
+	for (cycleId = 0; cycleId < m_vectorAnimationCycle.size(); ++cycleId)
 	{
-		CalAnimationCycle *pAnimationCycle;
-		pAnimationCycle = m_listAnimationCycle.front();
-		m_listAnimationCycle.pop_front();
+		delete m_vectorAnimationCycle[cycleId];
+	}
+	m_vectorAnimationCycle.clear();
 
-		delete pAnimationCycle;
+	for (cycleId = 0; cycleId < m_vectorFreeAnimationCycle.size(); ++cycleId)
+	{
+		delete m_vectorFreeAnimationCycle[cycleId];
 	}
+	m_vectorFreeAnimationCycle.clear();
 
 	// clear the animation table
 	m_vectorAnimation.clear();
@@ -501,20 +521,15 @@ bool CalMixer::stopAction(int coreAnimationId)
 		return false;
 	}
 
-	// update all active animation actions of this model
-	std::list<CalAnimationAction *>::iterator iteratorAnimationAction;
-
-	for (iteratorAnimationAction = m_listAnimationAction.begin();
-		iteratorAnimationAction != m_listAnimationAction.end() && (*iteratorAnimationAction)->getCoreAnimation() != pCoreAnimation;
-		iteratorAnimationAction++);
-
-	// find the specified action and remove it
-	if (iteratorAnimationAction != m_listAnimationAction.end())
+	// find the most recent action of the core animation and remove it
+	for (size_t actionId = m_vectorAnimationAction.size(); actionId-- > 0; )
 	{
-		// found, so remove
-		(*iteratorAnimationAction)->completeCallbacks(m_pModel);
-		m_listAnimationAction.erase(iteratorAnimationAction);
-		return true;
+		CalAnimationAction *pAnimationAction = m_vectorAnimationAction[actionId];
+		if (pAnimationAction != 0 && pAnimationAction->getCoreAnimation() == pCoreAnimation)
+		{
+			removeAnimationAction(actionId);
+			return true;
+		}
 	}
 	return false;
 }
@@ -539,22 +554,166 @@ bool CalMixer::stopCycle(int coreAnimationId)
 		return false;
 	}
 
-	// update all active animation actions of this model
-	std::list<CalAnimationCycle *>::iterator iteratorAnimation;
+	// find the most recent cycle of the core animation and remove it
+	for (size_t cycleId = m_vectorAnimationCycle.size(); cycleId-- > 0; )
+	{
+		CalAnimationCycle *pAnimationCycle = m_vectorAnimationCycle[cycleId];
+		if (pAnimationCycle != 0 && pAnimationCycle->getCoreAnimation() == pCoreAnimation)
+		{
+			// the cycle is gone, so blendCycle has to start a new one
+			if (m_vectorAnimation[coreAnimationId] == pAnimationCycle)
+			{
+				m_vectorAnimation[coreAnimationId] = 0;
+			}
+
+			removeAnimationCycle(cycleId);
+			return true;
+		}
+	}
+	return false;
+}
 
-	for (iteratorAnimation = m_listAnimationCycle.begin();
-		iteratorAnimation != m_listAnimationCycle.end() && (*iteratorAnimation)->getCoreAnimation() != pCoreAnimation;
-		iteratorAnimation++);
+ /*****************************************************************************/
+/** Allocates an animation action.
+  *
+  * This function returns an animation action of the given core animation,
+  * reusing a finished one if there is any, and appends it to the active
+  * animation actions.
+  *
+  * @param pCoreAnimation A pointer to the core animation.
+  *
+  * @return One of the following values:
+  *         \li a pointer to the animation action
+  *         \li \b 0 if an error happened
+  *****************************************************************************/
 
-	// find the specified action and remove it
-	if (iteratorAnimation != m_listAnimationCycle.end())
+CalAnimationAction *CalMixer::allocateAnimationAction(CalCoreAnimation *pCoreAnimation)
+{
+	CalAnimationAction *pAnimationAction;
+	if (!m_vectorFreeAnimationAction.empty())
 	{
-		// found, so remove
-		(*iteratorAnimation)->completeCallbacks(m_pModel);
-		m_listAnimationCycle.erase(iteratorAnimation);
-		return true;
+		pAnimationAction = m_vectorFreeAnimationAction.back();
+		m_vectorFreeAnimationAction.pop_back();
+		pAnimationAction->reset(pCoreAnimation);
 	}
-	return false;
+	else
+	{
+		pAnimationAction = new(std::nothrow) CalAnimationAction(pCoreAnimation);
+		if (pAnimationAction == 0)
+		{
+			CalError::setLastError(CalError::MEMORY_ALLOCATION_FAILED, __FILE__, __LINE__);
+			return 0;
+		}
+	}
+
+	m_vectorAnimationAction.push_back(pAnimationAction);
+	return pAnimationAction;
+}
+
+ /*****************************************************************************/
+/** Allocates an animation cycle.
+  *
+  * This function returns an animation cycle of the given core animation,
+  * reusing a finished one if there is any, and appends it to the active
+  * animation cycles.
+  *
+  * @param pCoreAnimation A pointer to the core animation.
+  *
+  * @return One of the following values:
+  *         \li a pointer to the animation cycle
+  *         \li \b 0 if an error happened
+  *****************************************************************************/
+
+CalAnimationCycle *CalMixer::allocateAnimationCycle(CalCoreAnimation *pCoreAnimation)
+{
+	CalAnimationCycle *pAnimationCycle;
+	if (!m_vectorFreeAnimationCycle.empty())
+	{
+		pAnimationCycle = m_vectorFreeAnimationCycle.back();
+		m_vectorFreeAnimationCycle.pop_back();
+		pAnimationCycle->reset(pCoreAnimation);
+	}
+	else
+	{
+		pAnimationCycle = new(std::nothrow) CalAnimationCycle(pCoreAnimation);
+		if (pAnimationCycle == 0)
+		{
+			CalError::setLastError(CalError::MEMORY_ALLOCATION_FAILED, __FILE__, __LINE__);
+			return 0;
+		}
+	}
+
+	m_vectorAnimationCycle.push_back(pAnimationCycle);
+	return pAnimationCycle;
+}
+
+ /*****************************************************************************/
+/** Removes an active animation action.
+  *
+  * This function removes an animation action from the active animation
+  * actions, calls its completion callbacks and keeps it for reuse. While
+  * updateAnimation runs, the entry is only cleared and compacted afterwards.
+  *
+  * @param actionId The index of the animation action in the active actions.
+  *****************************************************************************/
+
+void CalMixer::removeAnimationAction(size_t actionId)
+{
+	CalAnimationAction *pAnimationAction = m_vectorAnimationAction[actionId];
+
+	if (m_updatingAnimations)
+	{
+		m_vectorAnimationAction[actionId] = 0;
+	}
+	else
+	{
+		m_vectorAnimationAction.erase(m_vectorAnimationAction.begin() + actionId);
+	}
+
+	pAnimationAction->completeCallbacks(m_pModel);
+	m_vectorFreeAnimationAction.push_back(pAnimationAction);
+}
+
+ /*****************************************************************************/
+/** Removes an active animation cycle.
+  *
+  * This function removes an animation cycle from the active animation cycles,
+  * calls its completion callbacks and keeps it for reuse. While
+  * updateAnimation runs, the entry is only cleared and compacted afterwards.
+  *
+  * @param cycleId The index of the animation cycle in the active cycles.
+  *****************************************************************************/
+
+void CalMixer::removeAnimationCycle(size_t cycleId)
+{
+	CalAnimationCycle *pAnimationCycle = m_vectorAnimationCycle[cycleId];
+
+	if (m_updatingAnimations)
+	{
+		m_vectorAnimationCycle[cycleId] = 0;
+	}
+	else
+	{
+		m_vectorAnimationCycle.erase(m_vectorAnimationCycle.begin() + cycleId);
+	}
+
+	pAnimationCycle->completeCallbacks(m_pModel);
+	m_vectorFreeAnimationCycle.push_back(pAnimationCycle);
+}
+
+ /*****************************************************************************/
+/** Compacts the active animations.
+  *
+  * This function drops the entries cleared while updateAnimation ran from the
+  * active animation vectors.
+  *****************************************************************************/
+
+void CalMixer::compactAnimations()
+{
+	m_vectorAnimationAction.erase(std::remove(m_vectorAnimationAction.begin(), m_vectorAnimationAction.end(), (CalAnimationAction *)0),
+		m_vectorAnimationAction.end());
+	m_vectorAnimationCycle.erase(std::remove(m_vectorAnimationCycle.begin(), m_vectorAnimationCycle.end(), (CalAnimationCycle *)0),
+		m_vectorAnimationCycle.end());
 }
 
 
@@ -574,25 +733,21 @@ static void addExtraKeyframeForLoopedAnim(CalCoreAnimation *pCoreAnimation)
 	if (coreTrack == 0)
 		return;
 
-	CalCoreKeyframe *lastKeyframe = coreTrack->getCoreKeyframe(coreTrack->getCoreKeyframeCount() - 1);
-	if (lastKeyframe == 0)
+	if (coreTrack->getCoreKeyframeCount() == 0)
 		return;
 
-	if (lastKeyframe->getTime() < pCoreAnimation->getDuration())
+	if (coreTrack->getKeyframeTime(coreTrack->getCoreKeyframeCount() - 1) < pCoreAnimation->getDuration())
 	{
 		std::list<CalCoreTrack *>::const_iterator itr;
 		for (itr = listCoreTrack.begin(); itr != listCoreTrack.end(); ++itr)
 		{
 			coreTrack = *itr;
 
-			CalCoreKeyframe *firstKeyframe = coreTrack->getCoreKeyframe(0);
-			CalCoreKeyframe *newKeyframe = new CalCoreKeyframe();
-
-			newKeyframe->setTranslation(firstKeyframe->getTranslation());
-			newKeyframe->setRotation(firstKeyframe->getRotation());
-			newKeyframe->setTime(pCoreAnimation->getDuration());
+			// copy the first keyframe, the references are invalidated by the insertion
+			CalVector translation = coreTrack->getKeyframeTranslation(0);
+			CalQuaternion rotation = coreTrack->getKeyframeRotation(0);
 
-			coreTrack->addCoreKeyframe(newKeyframe);
+			coreTrack->addCoreKeyframe(pCoreAnimation->getDuration(), translation, rotation);
 		}
 	}
 }
@@ -638,17 +793,12 @@ bool CalMixer::blendCycle(int id, float weight, float delay)
 		// looping.
 		::addExtraKeyframeForLoopedAnim(pCoreAnimation);
 
-		// allocate a new animation cycle instance
-		CalAnimationCycle *pAnimationCycle = new(std::nothrow) CalAnimationCycle(pCoreAnimation);
-		if (pAnimationCycle == 0)
-		{
-			CalError::setLastError(CalError::MEMORY_ALLOCATION_FAILED, __FILE__, __LINE__);
-			return false;
-		}
+		// allocate a new animation cycle instance and make it active
+		CalAnimationCycle *pAnimationCycle = allocateAnimationCycle(pCoreAnimation);
+		if (pAnimationCycle == 0) return false;
 
-		// insert new animation into the tables
+		// insert new animation into the table
 		m_vectorAnimation[id] = pAnimationCycle;
-		m_listAnimationCycle.push_front(pAnimationCycle);
 
 		// blend the animation
 		return pAnimationCycle->blend(weight, delay);
@@ -758,16 +908,9 @@ bool CalMixer::executeAction(int id, float delayIn, float delayOut, float weight
 		return false;
 	}
 
-	// allocate a new animation action instance
-	CalAnimationAction *pAnimationAction = new(std::nothrow) CalAnimationAction(pCoreAnimation);
-	if (pAnimationAction == 0)
-	{
-		CalError::setLastError(CalError::MEMORY_ALLOCATION_FAILED, __FILE__, __LINE__);
-		return false;
-	}
-
-	// insert new animation into the table
-	m_listAnimationAction.push_front(pAnimationAction);
+	// allocate a new animation action instance and make it active
+	CalAnimationAction *pAnimationAction = allocateAnimationAction(pCoreAnimation);
+	if (pAnimationAction == 0) return false;
 
 	// execute the animation
 	if (!pAnimationAction->execute(delayIn, delayOut, weightTarget, autoLock))
@@ -877,61 +1020,63 @@ void CalMixer::updateAnimation(float deltaTime)
 
 	}
 
-	// update all active animation actions of this model
-	std::list<CalAnimationAction *>::iterator iteratorAnimationAction;
-	iteratorAnimationAction = m_listAnimationAction.begin();
+	// the callbacks may start and stop animations, so ended animations are
+	// only cleared from the vectors until the loops are done, and animations
+	// started meanwhile are appended behind the loops
+	m_updatingAnimations = true;
 
-	while (iteratorAnimationAction != m_listAnimationAction.end())
+	// update all active animation actions of this model, the newest first
+	for (size_t actionId = m_vectorAnimationAction.size(); actionId-- > 0; )
 	{
+		CalAnimationAction *pAnimationAction = m_vectorAnimationAction[actionId];
+		if (pAnimationAction == 0) continue;
+
 		// update and check if animation action is still active
-		if ((*iteratorAnimationAction)->update(deltaTime))
+		if (pAnimationAction->update(deltaTime))
 		{
-			(*iteratorAnimationAction)->checkCallbacks((*iteratorAnimationAction)->getTime(), m_pModel);
-			++iteratorAnimationAction;
+			pAnimationAction->checkCallbacks(pAnimationAction->getTime(), m_pModel);
 		}
 		else
 		{
-			// animation action has ended, destroy and remove it from the animation list
-			(*iteratorAnimationAction)->completeCallbacks(m_pModel);
-			delete (*iteratorAnimationAction);
-			iteratorAnimationAction = m_listAnimationAction.erase(iteratorAnimationAction);
+			// animation action has ended, remove it from the active actions
+			removeAnimationAction(actionId);
 		}
 	}
 
 	// todo: update all active animation poses of this model
 
 	// update the weight of all active animation cycles of this model
-	std::list<CalAnimationCycle *>::iterator iteratorAnimationCycle;
-	iteratorAnimationCycle = m_listAnimationCycle.begin();
-
 	float accumulatedWeight, accumulatedDuration;
 	accumulatedWeight = 0.0f;
 	accumulatedDuration = 0.0f;
 
-	while (iteratorAnimationCycle != m_listAnimationCycle.end())
+	for (size_t cycleId = m_vectorAnimationCycle.size(); cycleId-- > 0; )
 	{
+		CalAnimationCycle *pAnimationCycle = m_vectorAnimationCycle[cycleId];
+		if (pAnimationCycle == 0) continue;
+
 		// update and check if animation cycle is still active
-		if ((*iteratorAnimationCycle)->update(deltaTime))
+		if (pAnimationCycle->update(deltaTime))
 		{
 			// check if it is in sync. if yes, update accumulated weight and duration
-			if ((*iteratorAnimationCycle)->getState() == CalAnimation::STATE_SYNC)
+			if (pAnimationCycle->getState() == CalAnimation::STATE_SYNC)
 			{
-				accumulatedWeight += (*iteratorAnimationCycle)->getWeight();
-				accumulatedDuration += (*iteratorAnimationCycle)->getWeight() * (*iteratorAnimationCycle)->getCoreAnimation()->getDuration();
+				accumulatedWeight += pAnimationCycle->getWeight();
+				accumulatedDuration += pAnimationCycle->getWeight() * pAnimationCycle->getCoreAnimation()->getDuration();
 			}
 
-			(*iteratorAnimationCycle)->checkCallbacks(m_animationTime, m_pModel);
-			++iteratorAnimationCycle;
+			pAnimationCycle->checkCallbacks(m_animationTime, m_pModel);
 		}
 		else
 		{
-			// animation cycle has ended, destroy and remove it from the animation list
-			(*iteratorAnimationCycle)->completeCallbacks(m_pModel);
-			delete (*iteratorAnimationCycle);
-			iteratorAnimationCycle = m_listAnimationCycle.erase(iteratorAnimationCycle);
+			// animation cycle has ended, remove it from the active cycles
+			removeAnimationCycle(cycleId);
 		}
 	}
 
+	m_updatingAnimations = false;
+	compactAnimations();
+
 	// adjust the global animation cycle duration
 	if (accumulatedWeight > 0.0f)
 	{
@@ -943,15 +1088,34 @@ void CalMixer::updateAnimation(float deltaTime)
 	}
 }
 
+ /*****************************************************************************/
+/** Blends the bone adjustments.
+  *
+  * This function blends the bone adjustments into the layer pose, as the
+  * highest priority replace animations, and sets the mesh scales. It is called
+  * by updateSkeleton before the animations are blended.
+  *
+  * An override must blend its states through blendBoneState. The pose the
+  * mixer blends is handed to the skeleton with CalSkeleton::setPose, which
+  * overwrites the relative translation and rotation of every bone, so states
+  * blended into or set on the bones directly are lost.
+  *
+  * updateSkeleton only tracks the bone adjustments of the table, see
+  * addBoneAdjustment, to decide whether the skeleton has to be updated at all.
+  * An override that reads anything else must call invalidateSkeleton whenever
+  * that changes, or the skeleton keeps the previous result.
+  *****************************************************************************/
 
 void
 CalMixer::applyBoneAdjustments()
 {
 	CalSkeleton * pSkeleton = m_pModel->getSkeleton();
 	const std::vector<CalBone *>& vectorBone = pSkeleton->getVectorBone();
-	unsigned int i;
-	for (i = 0; i < m_numBoneAdjustments; i++) {
-		BoneAdjustmentAndBoneId * ba = &m_boneAdjustmentAndBoneIdArray[i];
+	const unsigned char * pBoneActive = pSkeleton->getBoneLodMask();
+	const int adjustmentCount = getBoneAdjustmentCount();
+	for (int i = 0; i < adjustmentCount; i++) {
+		const BoneAdjustmentAndBoneId * ba = &getBoneAdjustmentAndBoneId(i);
+		if (pBoneActive != 0 && !pBoneActive[ba->boneId_]) continue;
 		CalBone * bo = vectorBone[ba->boneId_];
 		CalCoreBone * cbo = bo->getCoreBone();
 		if (ba->boneAdjustment_.flags_ & BoneAdjustment::FlagMeshScale) {
@@ -965,7 +1129,7 @@ CalMixer::applyBoneAdjustments()
 			float rampValue = ba->boneAdjustment_.rampValue_;
 			static bool const replace = true;
 			static float const unrampedWeight = 1.0f;
-			bo->blendState(unrampedWeight,
+			blendBoneState(ba->boneId_, unrampedWeight,
 				adjustedLocalPos,
 				adjustedLocalOri,
 				scale, replace, rampValue, true);
@@ -973,40 +1137,136 @@ CalMixer::applyBoneAdjustments()
 	}
 }
 
+ /*****************************************************************************/
+/** Stores a bone adjustment.
+  *
+  * This function adds the adjustment of a bone to the table, or replaces the
+  * adjustment the bone already has. The bone id must be valid.
+  *
+  * @param boneId The ID of the bone.
+  * @param ba The bone adjustment.
+  *****************************************************************************/
+
+void
+CalMixer::storeBoneAdjustment(int boneId, BoneAdjustment const & ba)
+{
+	int& index = m_vectorBoneAdjustmentIndex[boneId];
+	if (index < 0) {
+		index = (int)m_vectorBoneAdjustment.size();
+		m_vectorBoneAdjustment.push_back(BoneAdjustmentAndBoneId());
+		m_vectorBoneAdjustment.back().boneId_ = boneId;
+	}
+	m_vectorBoneAdjustment[index].boneAdjustment_ = ba;
+}
+
+ /*****************************************************************************/
+/** Adds a bone adjustment.
+  *
+  * This function adds an adjustment to a bone, see BoneAdjustment. A bone has
+  * at most one adjustment, so the adjustment replaces the one the bone
+  * already has instead of being blended with it, as a second adjustment of
+  * the same bone used to be. The number of adjustments is not limited.
+  *
+  * @param boneId The ID of the bone.
+  * @param ba The bone adjustment.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if the bone ID is invalid
+  *****************************************************************************/
+
 bool
 CalMixer::addBoneAdjustment(int boneId, BoneAdjustment const & ba)
 {
-	if (m_numBoneAdjustments == CalMixerBoneAdjustmentsMax) return false;
-	m_boneAdjustmentAndBoneIdArray[m_numBoneAdjustments].boneAdjustment_ = ba;
-	m_boneAdjustmentAndBoneIdArray[m_numBoneAdjustments].boneId_ = boneId;
-	m_numBoneAdjustments++;
+	return setBoneAdjustments(&boneId, &ba, 1);
+}
+
+ /*****************************************************************************/
+/** Sets the adjustments of several bones.
+  *
+  * This function adds or replaces the adjustments of several bones in one
+  * call, see addBoneAdjustment. If a bone ID is invalid, no adjustment is
+  * changed.
+  *
+  * @param pBoneId A pointer to the IDs of the bones.
+  * @param pBoneAdjustment A pointer to the bone adjustments, one per bone ID.
+  * @param count The number of bones.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if a bone ID is invalid
+  *****************************************************************************/
+
+bool
+CalMixer::setBoneAdjustments(const int *pBoneId, const BoneAdjustment *pBoneAdjustment, int count)
+{
+	CalSkeleton * pSkeleton = m_pModel->getSkeleton();
+	const int boneCount = pSkeleton != 0 ? (int)pSkeleton->getVectorBone().size() : 0;
+
+	int i;
+	for (i = 0; i < count; i++) {
+		if (pBoneId[i] < 0 || pBoneId[i] >= boneCount) {
+			CalError::setLastError(CalError::INVALID_HANDLE, __FILE__, __LINE__);
+			return false;
+		}
+	}
+
+	if ((int)m_vectorBoneAdjustmentIndex.size() != boneCount) {
+		m_vectorBoneAdjustmentIndex.resize(boneCount, -1);
+	}
+
+	for (i = 0; i < count; i++) {
+		storeBoneAdjustment(pBoneId[i], pBoneAdjustment[i]);
+	}
+	m_boneAdjustmentVersion++;
 	return true;
 }
 
 void
 CalMixer::removeAllBoneAdjustments()
 {
-	m_numBoneAdjustments = 0;
+	m_vectorBoneAdjustment.clear();
+	m_vectorBoneAdjustmentIndex.assign(m_vectorBoneAdjustmentIndex.size(), -1);
+	m_boneAdjustmentVersion++;
 }
 
 bool
 CalMixer::removeBoneAdjustment(int boneId)
 {
-	unsigned int i;
-	for (i = 0; i < m_numBoneAdjustments; i++) {
-		BoneAdjustmentAndBoneId * ba = &m_boneAdjustmentAndBoneIdArray[i];
-		if (ba->boneId_ == boneId) break;
-	}
-	if (i == m_numBoneAdjustments) return false; // Couldn't find it.
-	i++;
-	while (i < m_numBoneAdjustments) {
-		m_boneAdjustmentAndBoneIdArray[i - 1] = m_boneAdjustmentAndBoneIdArray[i];
-		i++;
-	}
-	m_numBoneAdjustments--;
+	if (boneId < 0 || boneId >= (int)m_vectorBoneAdjustmentIndex.size()) return false;
+	int index = m_vectorBoneAdjustmentIndex[boneId];
+	if (index < 0) return false; // Couldn't find it.
+
+	// move the last adjustment into the hole
+	const BoneAdjustmentAndBoneId& last = m_vectorBoneAdjustment.back();
+	m_vectorBoneAdjustmentIndex[last.boneId_] = index;
+	m_vectorBoneAdjustment[index] = last;
+	m_vectorBoneAdjustment.pop_back();
+	m_vectorBoneAdjustmentIndex[boneId] = -1;
+	m_boneAdjustmentVersion++;
 	return true;
 }
- 
+
+ /*****************************************************************************/
+/** Returns the adjustment of a bone.
+  *
+  * This function returns the adjustment of a bone, see addBoneAdjustment.
+  *
+  * @param boneId The ID of the bone.
+  *
+  * @return One of the following values:
+  *         \li a pointer to the bone adjustment
+  *         \li \b 0 if the bone has no adjustment
+  *****************************************************************************/
+
+const BoneAdjustment *
+CalMixer::getBoneAdjustment(int boneId) const
+{
+	if (boneId < 0 || boneId >= (int)m_vectorBoneAdjustmentIndex.size()) return 0;
+	int index = m_vectorBoneAdjustmentIndex[boneId];
+	if (index < 0) return 0;
+	return &m_vectorBoneAdjustment[index].boneAdjustment_;
+} 
 
 /*
 unsigned int
@@ -1033,25 +1293,186 @@ CalMixer::numActiveOneShotAnimations()
 }
 
 */
+ /*****************************************************************************/
+/** Collects the animations to blend.
+  *
+  * This function lists the active animation actions, then the animation
+  * cycles, each list ending with a null entry, with the time, weight and
+  * blending parameters updateSkeleton uses for them.
+  *****************************************************************************/
+
+void CalMixer::collectPoseInputs()
+{
+	m_vectorPoseInput.clear();
+
+	PoseInput poseInput;
+
+	// loop through all animation actions, the newest first
+	for (size_t actionId = m_vectorAnimationAction.size(); actionId-- > 0; )
+	{
+		CalAnimationAction* pAction = m_vectorAnimationAction[actionId];
+		if (pAction != 0 && pAction->isOn())
+		{
+			// Replace and CrossFade both blend with the replace function.
+			CalAnimation::CompositionFunction compFunc = pAction->getCompositionFunction();
+
+			poseInput.pCoreAnimation = pAction->getCoreAnimation();
+			poseInput.pBoneMask = findBoneMask(poseInput.pCoreAnimation);
+			poseInput.pKeyframeCursor = pAction->getKeyframeCursors();
+			poseInput.time = pAction->getTime();
+			poseInput.weight = pAction->getWeight();
+			poseInput.scale = pAction->getScale();
+			poseInput.rampValue = pAction->getRampValue();
+			poseInput.replace = compFunc != CalAnimation::CompositionFunctionAverage && compFunc != CalAnimation::CompositionFunctionNull;
+			m_vectorPoseInput.push_back(poseInput);
+		}
+	}
+
+	// end of the layer of the actions
+	poseInput.pCoreAnimation = 0;
+	poseInput.pBoneMask = 0;
+	poseInput.pKeyframeCursor = 0;
+	poseInput.time = 0.0f;
+	poseInput.weight = 0.0f;
+	poseInput.scale = 1.0f;
+	poseInput.rampValue = 1.0f;
+	poseInput.replace = false;
+	m_vectorPoseInput.push_back(poseInput);
+
+	// loop through all animation cycles, the newest first
+	for (size_t cycleId = m_vectorAnimationCycle.size(); cycleId-- > 0; )
+	{
+		CalAnimationCycle* pAnimCycle = m_vectorAnimationCycle[cycleId];
+		if (pAnimCycle == 0) continue;
+
+		// get the core animation instance
+		CalCoreAnimation* pCoreAnimation = pAnimCycle->getCoreAnimation();
+
+		// calculate adjusted time
+		float animationTime;
+		if (pAnimCycle->getState() == CalAnimation::STATE_SYNC)
+		{
+			if (m_animationDuration == 0.0f)
+			{
+				animationTime = 0.0f;
+			}
+			else
+			{
+				animationTime = m_animationTime * pCoreAnimation->getDuration() / m_animationDuration;
+			}
+		}
+		else
+		{
+			animationTime = pAnimCycle->getTime();
+		}
+
+		poseInput.pCoreAnimation = pCoreAnimation;
+		poseInput.pBoneMask = findBoneMask(pCoreAnimation);
+		poseInput.pKeyframeCursor = pAnimCycle->getKeyframeCursors();
+		poseInput.time = animationTime;
+		poseInput.weight = pAnimCycle->getWeight();
+		poseInput.scale = 1.0f;
+		poseInput.rampValue = 1.0f;
+		poseInput.replace = false;
+		m_vectorPoseInput.push_back(poseInput);
+	}
+
+	// end of the layer of the cycles
+	poseInput.pCoreAnimation = 0;
+	poseInput.pBoneMask = 0;
+	poseInput.pKeyframeCursor = 0;
+	poseInput.time = 0.0f;
+	poseInput.weight = 0.0f;
+	poseInput.scale = 1.0f;
+	poseInput.rampValue = 1.0f;
+	poseInput.replace = false;
+	m_vectorPoseInput.push_back(poseInput);
+}
+
+ /*****************************************************************************/
+/** Updates the skeleton.
+  *
+  * This function blends the bone adjustments, the active animation actions and
+  * the animation cycles into the skeleton and calculates its state.
+  *
+  * If the animations, their times, weights and blending parameters and the
+  * bone adjustments are the same as in the previous update, and the skeleton
+  * was not changed by anybody else since then, the skeleton already holds the
+  * result and is left alone. Changes the mixer cannot see, like edits of the
+  * core bones or of the core animations, or of anything an override of
+  * applyBoneAdjustments reads, need a call to invalidateSkeleton.
+  *****************************************************************************/
+
 void CalMixer::updateSkeleton()
 {
 	// get the skeleton we need to update
 	CalSkeleton* pSkeleton = m_pModel->getSkeleton();
 	if (pSkeleton == 0) return;
 
+	++m_numSkeletonUpdates;
+
+	// list what has to be blended and check whether it changed since the last update
+	collectPoseInputs();
+
+	bool changed = !m_skeletonValid
+		|| pSkeleton->getStateVersion() != m_skeletonStateVersion
+		|| m_boneAdjustmentVersion != m_lastBoneAdjustmentVersion
+		|| m_vectorPoseInput.size() != m_vectorLastPoseInput.size();
+	for (size_t inputId = 0; !changed && inputId < m_vectorPoseInput.size(); ++inputId)
+	{
+		const PoseInput& poseInput = m_vectorPoseInput[inputId];
+		const PoseInput& lastPoseInput = m_vectorLastPoseInput[inputId];
+		changed = poseInput.pCoreAnimation != lastPoseInput.pCoreAnimation
+			|| poseInput.pBoneMask != lastPoseInput.pBoneMask
+			|| poseInput.time != lastPoseInput.time
+			|| poseInput.weight != lastPoseInput.weight
+			|| poseInput.scale != lastPoseInput.scale
+			|| poseInput.rampValue != lastPoseInput.rampValue
+			|| poseInput.replace != lastPoseInput.replace;
+	}
+
+	if (!changed)
+	{
+		++m_numSkippedSkeletonUpdates;
+		return;
+	}
+
+	m_vectorLastPoseInput.swap(m_vectorPoseInput);
+	m_lastBoneAdjustmentVersion = m_boneAdjustmentVersion;
+	m_skeletonValid = false;
+
 	// clear the skeleton state
 	pSkeleton->clearState();
 
 	// get the bone vector of the skeleton
 	typedef std::vector<CalBone *> BoneList;
 	const BoneList& vectorBone = pSkeleton->getVectorBone();
-
-	// For each bone, reset the transform-related variables to the core (bind pose) bone position and orientation.
-	BoneList::const_iterator curIter = vectorBone.begin();
-	BoneList::const_iterator endIter = vectorBone.end();
-	for (; curIter != endIter; ++curIter)
+	const size_t boneCount = vectorBone.size();
+	if (boneCount == 0) return;
+
+	// make room for the pose buffers
+	m_vectorPoseTranslation.resize(boneCount);
+	m_vectorPoseRotation.resize(boneCount);
+	m_vectorLayerTranslation.resize(boneCount);
+	m_vectorLayerRotation.resize(boneCount);
+	m_vectorLayerWeight.resize(boneCount);
+	m_vectorReplacementAttenuation.resize(boneCount);
+	m_vectorFirstBlendScale.resize(boneCount);
+	m_vectorMixTranslation.resize(boneCount);
+	m_vectorMixRotation.resize(boneCount);
+	m_vectorMixWeight.resize(boneCount);
+
+	// For each bone, reset the mix to the core (bind pose) bone position and orientation,
+	// and clear the weights.
+	for (size_t boneId = 0; boneId < boneCount; ++boneId)
 	{
-		(*curIter)->setCoreTransformStateVariables();
+		const CalCoreBone *pCoreBone = vectorBone[boneId]->getCoreBone();
+		m_vectorMixTranslation[boneId] = pCoreBone->getTranslation();
+		m_vectorMixRotation[boneId] = pCoreBone->getRotation();
+		m_vectorMixWeight[boneId] = 0.0f;
+		m_vectorLayerWeight[boneId] = 0.0f;
+		m_vectorReplacementAttenuation[boneId] = 1.0f;
+		m_vectorFirstBlendScale[boneId] = 1.0f;
 	}
 
 	// The bone adjustments are "replace" so they have to go first, giving them
@@ -1059,104 +1480,331 @@ void CalMixer::updateSkeleton()
 	// including subsequent replace animations, will have their incluence attenuated appropriately.
 	applyBoneAdjustments();
 
-	// loop through all animation actions
-	CalAnimationAction* pAction = NULL;
-	std::list<CalAnimationAction *>::iterator iteratorAnimationAction;
-	for (iteratorAnimationAction = m_listAnimationAction.begin(); iteratorAnimationAction != m_listAnimationAction.end(); ++iteratorAnimationAction)
+	// blend the actions, then the cycles, locking each layer at its end; the
+	// tracks of the bones left out by the bone LOD or by the bone mask of the
+	// animation are neither sampled nor blended
+	const unsigned char* pBoneActive = pSkeleton->getBoneLodMask();
+	std::vector<PoseInput>::const_iterator iteratorPoseInput;
+	for (iteratorPoseInput = m_vectorLastPoseInput.begin(); iteratorPoseInput != m_vectorLastPoseInput.end(); ++iteratorPoseInput)
 	{
-		pAction = *iteratorAnimationAction;
-		if (pAction->isOn())
+		const PoseInput& poseInput = *iteratorPoseInput;
+		if (poseInput.pCoreAnimation == 0)
 		{
-			// get the core animation instance
-			CalCoreAnimation* pCoreAnimation = pAction->getCoreAnimation();
-
-			// get the list of core tracks of above core animation
-			const std::list<CalCoreTrack *>& listCoreTrack = pCoreAnimation->getListCoreTrack();
+			lockPose();
+			continue;
+		}
 
-			// loop through all core tracks of the core animation
-			CalCoreTrack* pTrack = NULL;
-			std::list<CalCoreTrack *>::const_iterator iteratorCoreTrack;
-			for (iteratorCoreTrack = listCoreTrack.begin(); iteratorCoreTrack != listCoreTrack.end(); ++iteratorCoreTrack)
+		const unsigned char* pSampleActive = pBoneActive;
+		const float* pBoneWeight = 0;
+		if (poseInput.pBoneMask != 0)
+		{
+			pSampleActive = &poseInput.pBoneMask->vectorBoneActive[0];
+			pBoneWeight = &poseInput.pBoneMask->vectorBoneWeight[0];
+			if (pBoneActive != 0)
 			{
-				pTrack = *iteratorCoreTrack;
+				m_vectorSampleActive.resize(boneCount);
+				for (size_t boneId = 0; boneId < boneCount; ++boneId)
+				{
+					m_vectorSampleActive[boneId] = pBoneActive[boneId] & pSampleActive[boneId];
+				}
+				pSampleActive = &m_vectorSampleActive[0];
+			}
+		}
 
-				// get the appropriate bone of the track
-				CalBone* pBone = vectorBone[pTrack->getCoreBoneId()];
+		// sample the pose of the animation, using the keyframe cursors of the animation
+		if (m_pPoseCache != 0)
+		{
+			m_pPoseCache->samplePose(poseInput.pCoreAnimation, poseInput.time, &m_vectorPoseTranslation[0], &m_vectorPoseRotation[0], poseInput.pKeyframeCursor, pSampleActive);
+		}
+		else
+		{
+			poseInput.pCoreAnimation->samplePose(poseInput.time, &m_vectorPoseTranslation[0], &m_vectorPoseRotation[0], poseInput.pKeyframeCursor, pSampleActive);
+		}
 
-				// get the current translation and rotation
-				CalVector translation;
-				CalQuaternion rotation;
-				pTrack->getState(pAction->getTime(), translation, rotation);
+		// blend the pose into the layer
+		blendPose(poseInput.pCoreAnimation, poseInput.weight, poseInput.scale, poseInput.replace, poseInput.rampValue, pBoneWeight);
+	}
 
-				// Replace and CrossFade both blend with the replace function.
-				CalAnimation::CompositionFunction compFunc = pAction->getCompositionFunction();
-				bool replace = compFunc != CalAnimation::CompositionFunctionAverage && compFunc != CalAnimation::CompositionFunctionNull;
-				float scale = pAction->getScale();
+	// hand the pose to the skeleton and let it calculate its final state
+	pSkeleton->setPose(&m_vectorMixTranslation[0], &m_vectorMixRotation[0]);
+	pSkeleton->calculateState();
 
-				bool absoluteTrans = pTrack->getTranslationRequired();
-				pBone->blendState(pAction->getWeight(), translation, rotation, scale, replace, pAction->getRampValue(), absoluteTrans);
-			}
-		}
+	m_skeletonStateVersion = pSkeleton->getStateVersion();
+	m_skeletonValid = true;
+}
+
+ /*****************************************************************************/
+/** Sets the bone mask of a core animation.
+  *
+  * This function restricts the animation actions and cycles of a core
+  * animation to some bones, so that animations of different parts of the body,
+  * like an upper body and a lower body animation, can be layered. Each bone
+  * has a weight from 0 to 1 that scales the ramp value of the animation for
+  * the bone, see CalAnimationAction::setRampValue: the tracks of bones with
+  * weight 0 are not sampled at all, and a replace action with a bone weight
+  * below 1 only partially replaces the lower priority animations of the bone.
+  * See CalCoreSkeleton::calculateBoneMaskBySubtree to build the weights.
+  *
+  * @param coreAnimationId The ID of the core animation.
+  * @param vectorBoneWeight The bone weights, one per core bone.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if an error happened
+  *****************************************************************************/
+
+bool CalMixer::setBoneMask(int coreAnimationId, const std::vector<float>& vectorBoneWeight)
+{
+	CalCoreAnimation *pCoreAnimation = m_pModel->getCoreModel()->getCoreAnimation(coreAnimationId);
+	CalSkeleton *pSkeleton = m_pModel->getSkeleton();
+	if (pCoreAnimation == 0 || pSkeleton == 0 || vectorBoneWeight.size() != pSkeleton->getVectorBone().size())
+	{
+		CalError::setLastError(CalError::INVALID_HANDLE, __FILE__, __LINE__);
+		return false;
 	}
 
-	// lock the skeleton state
-	pSkeleton->lockState();
+	BoneMask& boneMask = m_mapBoneMask[pCoreAnimation];
+	const size_t boneCount = vectorBoneWeight.size();
+	boneMask.vectorBoneWeight.resize(boneCount);
+	boneMask.vectorBoneActive.resize(boneCount);
+	for (size_t boneId = 0; boneId < boneCount; ++boneId)
+	{
+		float weight = vectorBoneWeight[boneId];
+		if (weight < 0.0f) weight = 0.0f;
+		if (weight > 1.0f) weight = 1.0f;
+		boneMask.vectorBoneWeight[boneId] = weight;
+		boneMask.vectorBoneActive[boneId] = weight > 0.0f ? 1 : 0;
+	}
+
+	m_skeletonValid = false;
+	return true;
+}
+
+ /*****************************************************************************/
+/** Clears the bone mask of a core animation.
+  *
+  * This function lets the animation actions and cycles of a core animation
+  * influence all the bones they have tracks for again.
+  *
+  * @param coreAnimationId The ID of the core animation.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if an error happened
+  *****************************************************************************/
 
-	// loop through all animation cycles
-	CalAnimationCycle* pAnimCycle = NULL;
-	std::list<CalAnimationCycle *>::iterator iteratorAnimationCycle;
-	for (iteratorAnimationCycle = m_listAnimationCycle.begin(); iteratorAnimationCycle != m_listAnimationCycle.end(); ++iteratorAnimationCycle)
+bool CalMixer::clearBoneMask(int coreAnimationId)
+{
+	CalCoreAnimation *pCoreAnimation = m_pModel->getCoreModel()->getCoreAnimation(coreAnimationId);
+	if (pCoreAnimation == 0)
 	{
-		pAnimCycle = *iteratorAnimationCycle;
+		CalError::setLastError(CalError::INVALID_HANDLE, __FILE__, __LINE__);
+		return false;
+	}
 
-		// get the core animation instance
-		const CalCoreAnimation* pCoreAnimation = pAnimCycle->getCoreAnimation();
+	if (m_mapBoneMask.erase(pCoreAnimation) != 0)
+	{
+		m_skeletonValid = false;
+	}
+	return true;
+}
 
-		// calculate adjusted time
-		float animationTime;
-		if (pAnimCycle->getState() == CalAnimation::STATE_SYNC)
+ /*****************************************************************************/
+/** Returns the bone mask of a core animation.
+  *
+  * This function returns the bone weights of a core animation, see
+  * setBoneMask.
+  *
+  * @param coreAnimationId The ID of the core animation.
+  *
+  * @return One of the following values:
+  *         \li a pointer to the weights, one per core bone
+  *         \li \b 0 if the core animation has no bone mask
+  *****************************************************************************/
+
+const float *CalMixer::getBoneMask(int coreAnimationId) const
+{
+	const BoneMask *pBoneMask = findBoneMask(m_pModel->getCoreModel()->getCoreAnimation(coreAnimationId));
+	if (pBoneMask == 0) return 0;
+	return &pBoneMask->vectorBoneWeight[0];
+}
+
+ /*****************************************************************************/
+/** Finds the bone mask of a core animation.
+  *
+  * This function returns the bone mask of a core animation, see setBoneMask.
+  *
+  * @param pCoreAnimation A pointer to the core animation.
+  *
+  * @return One of the following values:
+  *         \li a pointer to the bone mask
+  *         \li \b 0 if the core animation has no bone mask
+  *****************************************************************************/
+
+const CalMixer::BoneMask *CalMixer::findBoneMask(const CalCoreAnimation *pCoreAnimation) const
+{
+	if (m_mapBoneMask.empty()) return 0;
+
+	std::map<const CalCoreAnimation *, BoneMask>::const_iterator iteratorBoneMask = m_mapBoneMask.find(pCoreAnimation);
+	if (iteratorBoneMask == m_mapBoneMask.end()) return 0;
+	return &iteratorBoneMask->second;
+}
+
+ /*****************************************************************************/
+/** Sets the pose cache.
+  *
+  * This function makes updateSkeleton take the sampled poses of the animations
+  * from a pose cache, which can be shared by all the models playing the same
+  * core animations, see CalPoseCache. The animation times are then rounded to
+  * the time quantization of the cache. The bone LOD and the bone masks still
+  * apply to the cached poses. The mixer does not own the cache, which
+  * must outlive it or be unset first.
+  *
+  * @param pPoseCache A pointer to the pose cache, or 0 to sample the animations
+  *                   directly.
+  *****************************************************************************/
+
+void CalMixer::setPoseCache(CalPoseCache *pPoseCache)
+{
+	m_pPoseCache = pPoseCache;
+	m_skeletonValid = false;
+}
+
+ /*****************************************************************************/
+/** Blends a state into the pose of a bone.
+  *
+  * This function blends a state into the layer pose of a bone, with the same
+  * weighting as CalBone::blendState.
+  *
+  * @param boneId The ID of the bone.
+  * @param unrampedWeight The blending weight, not incorporating ramp value
+  * @param translation The relative translation to be interpolated to.
+  * @param rotation The relative rotation to be interpolated to.
+  * @param scale Optional scale from 0-1 applies to transformation directly without affecting weights.
+  * @param replace If true, subsequent animations will have their weight attenuated by 1 - rampValue.
+  * @param rampValue Amount to attenuate weight when ramping in/out the animation.
+  * @param absoluteTranslation If true, use the translation as absolute, otherwise add it to the current bone translation as relative.
+  *****************************************************************************/
+
+void CalMixer::blendBoneState(int boneId, float unrampedWeight, const CalVector& translation, const CalQuaternion& rotation,
+                              float scale, bool replace, float rampValue, bool absoluteTranslation)
+{
+	float rampedWeight = unrampedWeight * rampValue;
+	float attenuatedWeight = rampedWeight * m_vectorReplacementAttenuation[boneId];
+
+	if (scale < 0.0f) scale = 0.0f;
+	if (scale > 1.0f) scale = 1.0f;
+
+	float& layerWeight = m_vectorLayerWeight[boneId];
+	if (layerWeight == 0.0f)
+	{
+		// the first state is copied, its scale is compensated on the second blend
+		layerWeight = attenuatedWeight;
+		m_vectorLayerTranslation[boneId] = absoluteTranslation ? translation : m_vectorMixTranslation[boneId] + translation;
+		m_vectorLayerRotation[boneId] = rotation;
+		m_vectorFirstBlendScale[boneId] = scale;
+	}
+	else
+	{
+		float factor = scale * attenuatedWeight / (layerWeight + attenuatedWeight);
+		assert(factor <= 1.0f);
+		factor = 1.0f - m_vectorFirstBlendScale[boneId] * (1.0f - factor);
+		CalVector newTrans(absoluteTranslation ? translation : m_vectorMixTranslation[boneId] + translation);
+		m_vectorLayerTranslation[boneId].blend(factor, newTrans);
+		m_vectorLayerRotation[boneId].blend(factor, rotation);
+		layerWeight += attenuatedWeight;
+		m_vectorFirstBlendScale[boneId] = 1.0;
+	}
+	if (replace)
+	{
+		m_vectorReplacementAttenuation[boneId] *= (1.0f - rampValue);
+	}
+}
+
+ /*****************************************************************************/
+/** Blends the sampled pose of an animation into the layer pose.
+  *
+  * This function blends the states sampled into the pose buffers for every
+  * track of a core animation into the layer pose.
+  *
+  * @param pCoreAnimation The core animation whose pose was sampled.
+  * @param unrampedWeight The blending weight, not incorporating ramp value
+  * @param scale Optional scale from 0-1 applies to transformation directly without affecting weights.
+  * @param replace If true, subsequent animations will have their weight attenuated by 1 - rampValue.
+  * @param rampValue Amount to attenuate weight when ramping in/out the animation.
+  * @param pBoneWeight Optional weight per core bone of the bone mask of the
+  *                    animation, scaling the ramp value of the bone.
+  *****************************************************************************/
+
+void CalMixer::blendPose(CalCoreAnimation *pCoreAnimation, float unrampedWeight, float scale, bool replace, float rampValue,
+                         const float *pBoneWeight)
+{
+	const std::vector<CalCoreTrack *>& vectorCoreTrack = pCoreAnimation->getVectorCoreTrack();
+	const unsigned char *pBoneActive = m_pModel->getSkeleton()->getBoneLodMask();
+
+	std::vector<CalCoreTrack *>::const_iterator iteratorCoreTrack;
+	for (iteratorCoreTrack = vectorCoreTrack.begin(); iteratorCoreTrack != vectorCoreTrack.end(); ++iteratorCoreTrack)
+	{
+		CalCoreTrack *pTrack = *iteratorCoreTrack;
+		int coreBoneId = pTrack->getCoreBoneId();
+		if (pBoneActive != 0 && !pBoneActive[coreBoneId]) continue;
+
+		// a bone weight below one ramps the animation partially out of the bone
+		float boneRampValue = rampValue;
+		if (pBoneWeight != 0)
 		{
-			if (m_animationDuration == 0.0f)
-			{
-				animationTime = 0.0f;
-			}
-			else
-			{
-				animationTime = m_animationTime * pCoreAnimation->getDuration() / m_animationDuration;
-			}
+			if (pBoneWeight[coreBoneId] <= 0.0f) continue;
+			boneRampValue *= pBoneWeight[coreBoneId];
 		}
-		else
+
+		blendBoneState(coreBoneId, unrampedWeight, m_vectorPoseTranslation[coreBoneId], m_vectorPoseRotation[coreBoneId],
+			scale, replace, boneRampValue, pTrack->getTranslationRequired());
+	}
+}
+
+ /*****************************************************************************/
+/** Locks the layer pose.
+  *
+  * This function blends the layer pose into the mix pose, with the same
+  * weighting as CalBone::lockState, and clears the layer weights.
+  *****************************************************************************/
+
+void CalMixer::lockPose()
+{
+	const size_t boneCount = m_vectorMixWeight.size();
+	for (size_t boneId = 0; boneId < boneCount; ++boneId)
+	{
+		float& layerWeight = m_vectorLayerWeight[boneId];
+		float& mixWeight = m_vectorMixWeight[boneId];
+
+		// clamp accumulated weight
+		if (layerWeight > 1.0f - mixWeight)
 		{
-			animationTime = pAnimCycle->getTime();
+			layerWeight = 1.0f - mixWeight;
 		}
 
-		// get the list of core tracks of above core animation
-		const std::list<CalCoreTrack *>& listCoreTrack = pCoreAnimation->getListCoreTrack();
-
-		// loop through all core tracks of the core animation
-		CalCoreTrack* pTrack = NULL;
-		std::list<CalCoreTrack *>::const_iterator iteratorCoreTrack;
-		for (iteratorCoreTrack = listCoreTrack.begin(); iteratorCoreTrack != listCoreTrack.end(); ++iteratorCoreTrack)
+		if (layerWeight > 0.0f)
 		{
-			pTrack = *iteratorCoreTrack;
+			if (mixWeight == 0.0f)
+			{
+				// it is the first state, so we can just copy it into the mix
+				m_vectorMixTranslation[boneId] = m_vectorLayerTranslation[boneId];
+				m_vectorMixRotation[boneId] = m_vectorLayerRotation[boneId];
 
-			// get the appropriate bone of the track
-			CalBone *pBone = vectorBone[pTrack->getCoreBoneId()];
+				mixWeight = layerWeight;
+			}
+			else
+			{
+				// it is not the first state, so blend all attributes
+				float factor = layerWeight / (mixWeight + layerWeight);
 
-			// get the current translation and rotation
-			CalVector translation;
-			CalQuaternion rotation;
-			pTrack->getState(animationTime, translation, rotation);
+				m_vectorMixTranslation[boneId].blend(factor, m_vectorLayerTranslation[boneId]);
+				m_vectorMixRotation[boneId].blend(factor, m_vectorLayerRotation[boneId]);
 
-			// blend the bone state with the new state
-			bool absoluteTrans = pTrack->getTranslationRequired();
-			pBone->blendState(pAnimCycle->getWeight(), translation, rotation, 1.0f, false, 1.0f, absoluteTrans);
+				mixWeight += layerWeight;
+			}
+
+			layerWeight = 0.0f;
 		}
 	}
-
-	// lock the skeleton state
-	pSkeleton->lockState();
-
-	// let the skeleton calculate its final state
-	pSkeleton->calculateState();
 }
@@ -26,6 +26,7 @@ namespace cal3d{
 	class CalModel;
 	class CalAnimationAction;
 	class CalAnimationCycle;
+	class CalPoseCache;
 
 
 	/*****************************************************************************/
@@ -187,8 +188,8 @@ namespace cal3d{
 
 
 
-		// Total number of bone adjustments per mixer.
-#define CalMixerBoneAdjustmentsMax ( 20 ) // Arbitrary.
+		// Former limit of bone adjustments per mixer, which is no longer limited.
+#define CalMixerBoneAdjustmentsMax ( 20 ) // Kept for source compatibility.
 
 		CalMixer(CalModel* pModel);
 		virtual ~CalMixer();
@@ -252,29 +253,140 @@ namespace cal3d{
 		void removeAnimationAction(CalAnimation *);
 		*/
 		/** return array of current actions mixed **/
-		inline const std::list<CalAnimationAction *> getCurrentOneShotActions(){ return m_listAnimationAction; }
+		inline const std::list<CalAnimationAction *> getCurrentOneShotActions(){ return std::list<CalAnimationAction *>(m_vectorAnimationAction.rbegin(), m_vectorAnimationAction.rend()); }
 		/** return array of current cycle animations mixed **/
-		inline const std::list<CalAnimationCycle *> getCurrentCycleActions(){ return m_listAnimationCycle; }
+		inline const std::list<CalAnimationCycle *> getCurrentCycleActions(){ return std::list<CalAnimationCycle *>(m_vectorAnimationCycle.rbegin(), m_vectorAnimationCycle.rend()); }
 
 
-		/** add a bone constraint to the mixer **/
+		/** add a bone constraint to the mixer, replacing the constraint of the bone if there is one **/
 		bool addBoneAdjustment(int boneId, BoneAdjustment const & ba);
+		/** add or replace the bone constraints of several bones at once **/
+		bool setBoneAdjustments(const int *pBoneId, const BoneAdjustment *pBoneAdjustment, int count);
 		/** purge all bone constraints of the mixer **/
 		void removeAllBoneAdjustments();
 		/** remove a bone constraint from the mix **/
 		bool removeBoneAdjustment(int boneId);
+		/** get the bone constraint of a bone, or 0 if it has none **/
+		const BoneAdjustment *getBoneAdjustment(int boneId) const;
+		/** get the number of bone constraints of the mixer **/
+		inline int getBoneAdjustmentCount() const		{ return (int)m_vectorBoneAdjustment.size(); }
+
+		/** make the next updateSkeleton recalculate the skeleton even if the mix did not change **/
+		inline void invalidateSkeleton()		{ m_skeletonValid = false; }
+		/** get the number of calls to updateSkeleton **/
+		inline int getNumSkeletonUpdates() const		{ return m_numSkeletonUpdates; }
+		/** get the number of calls to updateSkeleton that found the skeleton up to date **/
+		inline int getNumSkippedSkeletonUpdates() const		{ return m_numSkippedSkeletonUpdates; }
+		/** reset the skeleton update counters **/
+		inline void resetUpdateStatistics()		{ m_numSkeletonUpdates = 0; m_numSkippedSkeletonUpdates = 0; }
+
+		/** restrict the animations of a core animation to some bones, with a weight per bone **/
+		bool setBoneMask(int coreAnimationId, const std::vector<float>& vectorBoneWeight);
+		/** let the animations of a core animation influence all their bones again **/
+		bool clearBoneMask(int coreAnimationId);
+		/** get the bone weights of a core animation, or 0 if it has no bone mask **/
+		const float *getBoneMask(int coreAnimationId) const;
+
+		/** share the sampled animation poses with other mixers through a pose cache, or stop sharing with 0 **/
+		void setPoseCache(CalPoseCache *pPoseCache);
+		/** get the pose cache of the mixer, or 0 **/
+		inline CalPoseCache *getPoseCache() const		{ return m_pPoseCache; }
 
 	protected:
-		unsigned int m_numBoneAdjustments;
-		BoneAdjustmentAndBoneId m_boneAdjustmentAndBoneIdArray[CalMixerBoneAdjustmentsMax];
+		// The bone mask of a core animation, see setBoneMask.  The active flags
+		// tell which tracks need to be sampled at all.
+		struct BoneMask
+		{
+			std::vector<float> vectorBoneWeight;
+			std::vector<unsigned char> vectorBoneActive;
+		};
+
+		// An animation blended into the skeleton by updateSkeleton, a null core
+		// animation ending a layer.
+		struct PoseInput
+		{
+			CalCoreAnimation *pCoreAnimation;
+			const BoneMask *pBoneMask;
+			int *pKeyframeCursor;
+			float time;
+			float weight;
+			float scale;
+			float rampValue;
+			bool replace;
+		};
+		void collectPoseInputs();
+		const BoneMask *findBoneMask(const CalCoreAnimation *pCoreAnimation) const;
+
+		// The bone adjustments in no particular order, and for every bone the
+		// index of its adjustment or -1.
+		std::vector<BoneAdjustmentAndBoneId> m_vectorBoneAdjustment;
+		std::vector<int> m_vectorBoneAdjustmentIndex;
+		// The bone adjustment at an index from 0 to getBoneAdjustmentCount() - 1,
+		// for overrides of applyBoneAdjustments walking all the adjustments.
+		inline const BoneAdjustmentAndBoneId& getBoneAdjustmentAndBoneId(int index) const	{ return m_vectorBoneAdjustment[index]; }
+		void storeBoneAdjustment(int boneId, BoneAdjustment const & ba);
+		// Overrides must blend through blendBoneState: the bones are overwritten
+		// with the blended pose at the end of updateSkeleton.  Only the table of
+		// bone adjustments is tracked for change detection; an override reading
+		// other state must call invalidateSkeleton when that state changes.
 		virtual void applyBoneAdjustments();
+		void blendBoneState(int boneId, float unrampedWeight, const CalVector& translation, const CalQuaternion& rotation,
+			float scale, bool replace, float rampValue, bool absoluteTranslation);
+		void blendPose(CalCoreAnimation *pCoreAnimation, float unrampedWeight, float scale, bool replace, float rampValue,
+			const float *pBoneWeight = 0);
+		void lockPose();
+		CalAnimationAction *allocateAnimationAction(CalCoreAnimation *pCoreAnimation);
+		CalAnimationCycle *allocateAnimationCycle(CalCoreAnimation *pCoreAnimation);
+		void removeAnimationAction(size_t actionId);
+		void removeAnimationCycle(size_t cycleId);
+		void compactAnimations();
 		CalModel *m_pModel;
 		std::vector<CalAnimation *> m_vectorAnimation;
-		std::list<CalAnimationAction *> m_listAnimationAction;
-		std::list<CalAnimationCycle *> m_listAnimationCycle;
+
+		// The active animations, oldest first, so that animations started from
+		// callbacks during updateAnimation are appended behind the loops.  They
+		// are blended newest first.  Finished animations go to the free vectors
+		// and are reused by the next animations started.
+		std::vector<CalAnimationAction *> m_vectorAnimationAction;
+		std::vector<CalAnimationCycle *> m_vectorAnimationCycle;
+		std::vector<CalAnimationAction *> m_vectorFreeAnimationAction;
+		std::vector<CalAnimationCycle *> m_vectorFreeAnimationCycle;
+		bool m_updatingAnimations;
 		float m_animationTime;
 		float m_animationDuration;
 		float m_timeFactor;
+
+		// Pose buffers, indexed by core bone id.  The pose of the animation being
+		// blended is sampled into the pose arrays, blended into the layer arrays,
+		// and the layers are locked one after the other into the mix arrays, which
+		// are handed to the skeleton.  See CalBone::blendState for the weights.
+		std::vector<CalVector> m_vectorPoseTranslation;
+		std::vector<CalQuaternion> m_vectorPoseRotation;
+		std::vector<CalVector> m_vectorLayerTranslation;
+		std::vector<CalQuaternion> m_vectorLayerRotation;
+		std::vector<float> m_vectorLayerWeight;
+		std::vector<float> m_vectorReplacementAttenuation;
+		std::vector<float> m_vectorFirstBlendScale;
+		std::vector<CalVector> m_vectorMixTranslation;
+		std::vector<CalQuaternion> m_vectorMixRotation;
+		std::vector<float> m_vectorMixWeight;
+
+		// Change detection.  updateSkeleton leaves the skeleton alone if the
+		// animations, their times and weights and the bone adjustments are the
+		// same as in the previous update, and nobody else touched the skeleton.
+		std::vector<PoseInput> m_vectorPoseInput;
+		std::vector<PoseInput> m_vectorLastPoseInput;
+		unsigned int m_boneAdjustmentVersion;
+		unsigned int m_lastBoneAdjustmentVersion;
+		unsigned int m_skeletonStateVersion;
+		bool m_skeletonValid;
+		int m_numSkeletonUpdates;
+		int m_numSkippedSkeletonUpdates;
+
+		CalPoseCache *m_pPoseCache;
+
+		std::map<const CalCoreAnimation *, BoneMask> m_mapBoneMask;
+		std::vector<unsigned char> m_vectorSampleActive;
 	};
 }
 #endif
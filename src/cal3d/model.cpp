@@ -47,6 +47,15 @@ CalModel::CalModel(CalCoreModel *pCoreModel)
   , m_pSpringSystem(0)
   , m_pRenderer(0)
   , m_userData(0)
+  , m_updateInterval(1)
+  , m_updatePeriod(0.0f)
+  , m_framesSinceEvaluation(0)
+  , m_timeSinceEvaluation(0.0f)
+  , m_evaluationPeriod(0.0f)
+  , m_hasEvaluatedPose(false)
+  , m_isPoseMoving(false)
+  , m_poseFactor(1.0f)
+  , m_skeletonStateVersion(0)
 {
   assert(pCoreModel);
 
@@ -709,7 +718,14 @@ void CalModel::setUserData(Cal::UserData userData)
 void CalModel::update(float deltaTime)
 {
   m_pMixer->updateAnimation(deltaTime);
-  m_pMixer->updateSkeleton();
+  if(m_updateInterval > 1 || m_updatePeriod > 0.0f)
+  {
+    updateSkeletonAtReducedRate(deltaTime);
+  }
+  else
+  {
+    m_pMixer->updateSkeleton();
+  }
   // m_pMorpher->update(...);
   m_pMorphTargetMixer->update(deltaTime);
   m_pPhysique->update();
@@ -732,4 +748,195 @@ void CalModel::disableInternalData()
   }
 }
 
+ /*****************************************************************************/
+/** Sets the update interval in frames.
+  *
+  * This function makes update evaluate the mixer and the skeleton only every
+  * given number of updates, for models where the full evaluation is not worth
+  * its cost, like distant crowds. The relative bone states are interpolated
+  * from the second-to-last to the last evaluated pose over the time the
+  * animations advance until the next evaluation, so the model moves smoothly
+  * but lags one interval behind its animations. Updates that do not advance
+  * the time, like update(0.0f), neither move the pose nor count towards the
+  * interval. The animations themselves, and their callbacks, are still
+  * updated every frame. Bone adjustments and other changes to the mix only
+  * show one interval after the next evaluation.
+  *
+  * Setting an interval replaces an update frequency set before.
+  *
+  * @param frameCount The number of updates between two evaluations, 1 or less
+  *                   to evaluate every update.
+  *****************************************************************************/
+
+void CalModel::setUpdateInterval(int frameCount)
+{
+  m_updateInterval = frameCount > 1 ? frameCount : 1;
+  m_updatePeriod = 0.0f;
+  m_framesSinceEvaluation = 0;
+  m_timeSinceEvaluation = 0.0f;
+  m_evaluationPeriod = 0.0f;
+  m_hasEvaluatedPose = false;
+}
+
+ /*****************************************************************************/
+/** Returns the update interval in frames.
+  *
+  * This function returns the number of updates between two evaluations of the
+  * mixer and the skeleton, see setUpdateInterval.
+  *
+  * @return The number of updates, 1 if every update evaluates the skeleton or
+  *         an update frequency is used.
+  *****************************************************************************/
+
+int CalModel::getUpdateInterval() const
+{
+  return m_updateInterval;
+}
+
+ /*****************************************************************************/
+/** Sets the update frequency.
+  *
+  * This function makes update evaluate the mixer and the skeleton at most the
+  * given number of times per second of animation time, interpolating the pose
+  * in between, see setUpdateInterval.
+  *
+  * Setting a frequency replaces an update interval set before.
+  *
+  * @param frequency The number of evaluations per second, 0 or less to
+  *                  evaluate every update.
+  *****************************************************************************/
+
+void CalModel::setUpdateFrequency(float frequency)
+{
+  m_updateInterval = 1;
+  m_updatePeriod = frequency > 0.0f ? 1.0f / frequency : 0.0f;
+  m_framesSinceEvaluation = 0;
+  m_timeSinceEvaluation = 0.0f;
+  m_evaluationPeriod = 0.0f;
+  m_hasEvaluatedPose = false;
+}
+
+ /*****************************************************************************/
+/** Returns the update frequency.
+  *
+  * This function returns the number of evaluations of the mixer and the
+  * skeleton per second, see setUpdateFrequency.
+  *
+  * @return The number of evaluations per second, 0 if no frequency is set.
+  *****************************************************************************/
+
+float CalModel::getUpdateFrequency() const
+{
+  return m_updatePeriod > 0.0f ? 1.0f / m_updatePeriod : 0.0f;
+}
+
+ /*****************************************************************************/
+/** Updates the skeleton at a reduced rate.
+  *
+  * This function evaluates the mixer and the skeleton when the update interval
+  * or period is over, and sets the skeleton to the pose between the last two
+  * evaluated poses given by the time since the last evaluation over the time
+  * between the last two. The skeleton is only touched when its pose changes,
+  * so that a model whose pose holds still keeps its state version.
+  *
+  * @param deltaTime The elapsed time in seconds since the last update.
+  *****************************************************************************/
+
+void CalModel::updateSkeletonAtReducedRate(float deltaTime)
+{
+  // updates that do not advance the animations leave the pose where it is
+  if(deltaTime > 0.0f)
+  {
+    ++m_framesSinceEvaluation;
+    m_timeSinceEvaluation += deltaTime;
+  }
+
+  bool evaluate;
+  if(!m_hasEvaluatedPose)
+  {
+    evaluate = true;
+  }
+  else if(m_updatePeriod > 0.0f)
+  {
+    evaluate = m_timeSinceEvaluation >= m_updatePeriod;
+  }
+  else
+  {
+    evaluate = m_framesSinceEvaluation >= m_updateInterval;
+  }
+
+  if(evaluate)
+  {
+    m_pMixer->updateSkeleton();
+
+    // keep the last two evaluated poses
+    const CalBoneStateArrays& boneState = m_pSkeleton->getBoneState();
+    const int boneCount = boneState.getBoneCount();
+
+    m_vectorPreviousTranslation.swap(m_vectorEvaluatedTranslation);
+    m_vectorPreviousRotation.swap(m_vectorEvaluatedRotation);
+    m_vectorEvaluatedTranslation.assign(boneState.pTranslation, boneState.pTranslation + boneCount);
+    m_vectorEvaluatedRotation.assign(boneState.pRotation, boneState.pRotation + boneCount);
+
+    if(!m_hasEvaluatedPose || (int)m_vectorPreviousTranslation.size() != boneCount)
+    {
+      // nothing to continue the motion from yet
+      m_vectorPreviousTranslation = m_vectorEvaluatedTranslation;
+      m_vectorPreviousRotation = m_vectorEvaluatedRotation;
+    }
+
+    m_isPoseMoving = m_vectorPreviousTranslation != m_vectorEvaluatedTranslation
+      || m_vectorPreviousRotation != m_vectorEvaluatedRotation;
+
+    // the skeleton holds the evaluated pose
+    m_poseFactor = 1.0f;
+    m_skeletonStateVersion = m_pSkeleton->getStateVersion();
+
+    m_hasEvaluatedPose = true;
+    m_evaluationPeriod = m_timeSinceEvaluation;
+    m_framesSinceEvaluation = 0;
+    m_timeSinceEvaluation = 0.0f;
+  }
+
+  const int boneCount = (int)m_vectorEvaluatedTranslation.size();
+  if(boneCount == 0) return;
+
+  // how far the model is from the second-to-last evaluated pose to the last
+  // one, in the time between them, so it reaches the last one when the next
+  // is evaluated
+  float factor = 1.0f;
+  if(m_isPoseMoving && m_evaluationPeriod > 0.0f)
+  {
+    factor = m_timeSinceEvaluation / m_evaluationPeriod;
+    if(factor > 1.0f) factor = 1.0f;
+  }
+
+  // leave the skeleton alone if it already holds the pose
+  if(factor == m_poseFactor && m_pSkeleton->getStateVersion() == m_skeletonStateVersion) return;
+
+  if(factor == 1.0f)
+  {
+    m_pSkeleton->setPose(&m_vectorEvaluatedTranslation[0], &m_vectorEvaluatedRotation[0]);
+  }
+  else if(factor == 0.0f)
+  {
+    m_pSkeleton->setPose(&m_vectorPreviousTranslation[0], &m_vectorPreviousRotation[0]);
+  }
+  else
+  {
+    m_vectorPoseTranslation = m_vectorPreviousTranslation;
+    m_vectorPoseRotation = m_vectorPreviousRotation;
+    for(int boneId = 0; boneId < boneCount; ++boneId)
+    {
+      m_vectorPoseTranslation[boneId].blend(factor, m_vectorEvaluatedTranslation[boneId]);
+      m_vectorPoseRotation[boneId].blend(factor, m_vectorEvaluatedRotation[boneId]);
+    }
+    m_pSkeleton->setPose(&m_vectorPoseTranslation[0], &m_vectorPoseRotation[0]);
+  }
+  m_pSkeleton->calculateState();
+
+  m_poseFactor = factor;
+  m_skeletonStateVersion = m_pSkeleton->getStateVersion();
+}
+
 //****************************************************************************//
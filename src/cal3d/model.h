@@ -14,6 +14,7 @@
 
 #include "cal3d/global.h"
 #include "cal3d/vector.h"
+#include "cal3d/quaternion.h"
 
 namespace cal3d{
 	class CalCoreModel;
@@ -62,8 +63,14 @@ namespace cal3d{
 		void setUserData(Cal::UserData userData);
 		void update(float deltaTime);
 		void disableInternalData();
+		void setUpdateInterval(int frameCount);
+		int getUpdateInterval() const;
+		void setUpdateFrequency(float frequency);
+		float getUpdateFrequency() const;
 
 	private:
+		void updateSkeletonAtReducedRate(float deltaTime);
+
 		CalCoreModel          *m_pCoreModel;
 		CalSkeleton           *m_pSkeleton;
 		CalAbstractMixer      *m_pMixer;
@@ -74,6 +81,23 @@ namespace cal3d{
 		Cal::UserData          m_userData;
 		std::vector<CalMesh *> m_vectorMesh;
 		CalBoundingBox         m_boundingBox;
+
+		// update-rate LOD, see setUpdateInterval
+		int                        m_updateInterval;
+		float                      m_updatePeriod;
+		int                        m_framesSinceEvaluation;
+		float                      m_timeSinceEvaluation;
+		float                      m_evaluationPeriod;
+		bool                       m_hasEvaluatedPose;
+		bool                       m_isPoseMoving;
+		float                      m_poseFactor;
+		unsigned int               m_skeletonStateVersion;
+		std::vector<CalVector>     m_vectorPreviousTranslation;
+		std::vector<CalQuaternion> m_vectorPreviousRotation;
+		std::vector<CalVector>     m_vectorEvaluatedTranslation;
+		std::vector<CalQuaternion> m_vectorEvaluatedRotation;
+		std::vector<CalVector>     m_vectorPoseTranslation;
+		std::vector<CalQuaternion> m_vectorPoseRotation;
 	};
 }
 #endif
@@ -0,0 +1,335 @@
+//****************************************************************************//
+// modelbatch.cpp                                                             //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+//****************************************************************************//
+// Includes                                                                   //
+//****************************************************************************//
+
+#include "cal3d/modelbatch.h"
+#include "cal3d/model.h"
+
+#ifdef CAL3D_THREADS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+using namespace cal3d;
+
+#ifdef CAL3D_THREADS
+
+// Each participating thread owns a range of chunks of the model list. It takes
+// chunks from the front of its own range and, once it runs dry, steals from
+// the back of the ranges of the other threads.
+struct CalModelBatch::WorkerPool
+{
+  struct WorkQueue
+  {
+    std::mutex mutex;
+    int        chunkBegin;
+    int        chunkEnd;
+  };
+
+  explicit WorkerPool(int threadCount)
+    : vectorWorkQueue(threadCount)
+    , generation(0)
+    , busyCount(0)
+    , quit(false)
+    , ppModel(0)
+    , modelCount(0)
+    , deltaTime(0.0f)
+    , chunkSize(1)
+  {
+    // the calling thread takes part in the work as participant 0
+    for(int workerId = 1; workerId < threadCount; ++workerId)
+    {
+      vectorThread.push_back(std::thread(&WorkerPool::workerMain, this, workerId));
+    }
+  }
+
+  ~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      quit = true;
+    }
+    wakeCondition.notify_all();
+
+    for(size_t threadId = 0; threadId < vectorThread.size(); ++threadId)
+    {
+      vectorThread[threadId].join();
+    }
+  }
+
+  void update(CalModel **ppModelIn, int modelCountIn, float deltaTimeIn)
+  {
+    const int queueCount = (int)vectorWorkQueue.size();
+
+    ppModel = ppModelIn;
+    modelCount = modelCountIn;
+    deltaTime = deltaTimeIn;
+
+    // cut the model list into a few chunks per thread so that stealing can
+    // even out models that are more expensive than others
+    chunkSize = modelCount / (queueCount * 8);
+    if(chunkSize < 1) chunkSize = 1;
+    int chunkCount = (modelCount + chunkSize - 1) / chunkSize;
+
+    for(int queueId = 0; queueId < queueCount; ++queueId)
+    {
+      WorkQueue& workQueue = vectorWorkQueue[queueId];
+      std::lock_guard<std::mutex> lock(workQueue.mutex);
+      workQueue.chunkBegin = (int)((long long)chunkCount * queueId / queueCount);
+      workQueue.chunkEnd = (int)((long long)chunkCount * (queueId + 1) / queueCount);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      busyCount = (int)vectorThread.size();
+      ++generation;
+    }
+    wakeCondition.notify_all();
+
+    run(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while(busyCount > 0)
+    {
+      doneCondition.wait(lock);
+    }
+  }
+
+  void workerMain(int workerId)
+  {
+    unsigned int seenGeneration = 0;
+
+    for(;;)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        while(!quit && generation == seenGeneration)
+        {
+          wakeCondition.wait(lock);
+        }
+        if(quit) return;
+        seenGeneration = generation;
+      }
+
+      run(workerId);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(--busyCount == 0) doneCondition.notify_one();
+      }
+    }
+  }
+
+  void run(int workerId)
+  {
+    int chunkId;
+    while(takeChunk(workerId, chunkId))
+    {
+      int modelBegin = chunkId * chunkSize;
+      int modelEnd = modelBegin + chunkSize;
+      if(modelEnd > modelCount) modelEnd = modelCount;
+
+      for(int modelId = modelBegin; modelId < modelEnd; ++modelId)
+      {
+        ppModel[modelId]->update(deltaTime);
+      }
+    }
+  }
+
+  bool takeChunk(int workerId, int& chunkId)
+  {
+    const int queueCount = (int)vectorWorkQueue.size();
+
+    {
+      WorkQueue& workQueue = vectorWorkQueue[workerId];
+      std::lock_guard<std::mutex> lock(workQueue.mutex);
+      if(workQueue.chunkBegin < workQueue.chunkEnd)
+      {
+        chunkId = workQueue.chunkBegin++;
+        return true;
+      }
+    }
+
+    for(int victimOffset = 1; victimOffset < queueCount; ++victimOffset)
+    {
+      WorkQueue& workQueue = vectorWorkQueue[(workerId + victimOffset) % queueCount];
+      std::lock_guard<std::mutex> lock(workQueue.mutex);
+      if(workQueue.chunkBegin < workQueue.chunkEnd)
+      {
+        chunkId = --workQueue.chunkEnd;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  std::vector<std::thread> vectorThread;
+  std::vector<WorkQueue>   vectorWorkQueue;
+  std::mutex               mutex;
+  std::condition_variable  wakeCondition;
+  std::condition_variable  doneCondition;
+  unsigned int             generation;
+  int                      busyCount;
+  bool                     quit;
+
+  // the batch being updated
+  CalModel               **ppModel;
+  int                      modelCount;
+  float                    deltaTime;
+  int                      chunkSize;
+};
+
+#else
+
+struct CalModelBatch::WorkerPool
+{
+};
+
+#endif
+
+ /*****************************************************************************/
+/** Constructs the model batch.
+  *
+  * This function is the default constructor of the model batch. The worker
+  * threads are only started by the first update that needs them.
+  *
+  * @param threadCount The number of threads updating the models, including the
+  *                    calling thread. 0 uses one thread per hardware thread.
+  *****************************************************************************/
+
+CalModelBatch::CalModelBatch(int threadCount)
+  : m_threadCount(1)
+  , m_pWorkerPool(0)
+{
+  setThreadCount(threadCount);
+}
+
+ /*****************************************************************************/
+/** Destructs the model batch.
+  *
+  * This function is the destructor of the model batch. It stops the worker
+  * threads.
+  *****************************************************************************/
+
+CalModelBatch::~CalModelBatch()
+{
+  delete m_pWorkerPool;
+}
+
+ /*****************************************************************************/
+/** Sets the number of threads.
+  *
+  * This function sets the number of threads that update the models, including
+  * the calling thread. If the library was built without thread support the
+  * batch always runs on the calling thread.
+  *
+  * @param threadCount The number of threads, or 0 to use one thread per
+  *                    hardware thread.
+  *****************************************************************************/
+
+void CalModelBatch::setThreadCount(int threadCount)
+{
+#ifdef CAL3D_THREADS
+  if(threadCount <= 0)
+  {
+    threadCount = (int)std::thread::hardware_concurrency();
+  }
+  if(threadCount < 1) threadCount = 1;
+#else
+  threadCount = 1;
+#endif
+
+  if(threadCount == m_threadCount) return;
+
+  delete m_pWorkerPool;
+  m_pWorkerPool = 0;
+  m_threadCount = threadCount;
+}
+
+ /*****************************************************************************/
+/** Returns the number of threads.
+  *
+  * This function returns the number of threads that update the models,
+  * including the calling thread.
+  *
+  * @return The number of threads.
+  *****************************************************************************/
+
+int CalModelBatch::getThreadCount() const
+{
+  return m_threadCount;
+}
+
+ /*****************************************************************************/
+/** Updates a list of model instances.
+  *
+  * This function calls CalModel::update on every model of the list, spreading
+  * the models over the threads of the batch, and returns once all of them are
+  * updated. Every model is updated exactly once by exactly one thread, so the
+  * results are the same as updating the models one after the other.
+  *
+  * The models may share core models, but each model must appear only once in
+  * the list. Animation callbacks are called from the thread that updates the
+  * model, so they must be thread-safe when more than one thread is used.
+  *
+  * @param ppModel A pointer to the first model pointer of the list.
+  * @param modelCount The number of models in the list.
+  * @param deltaTime The elapsed time in seconds since the last update.
+  *****************************************************************************/
+
+void CalModelBatch::update(CalModel **ppModel, int modelCount, float deltaTime)
+{
+  if(modelCount <= 0) return;
+
+#ifdef CAL3D_THREADS
+  if(m_threadCount > 1 && modelCount > 1)
+  {
+    if(m_pWorkerPool == 0)
+    {
+      m_pWorkerPool = new WorkerPool(m_threadCount);
+    }
+
+    m_pWorkerPool->update(ppModel, modelCount, deltaTime);
+    return;
+  }
+#endif
+
+  for(int modelId = 0; modelId < modelCount; ++modelId)
+  {
+    ppModel[modelId]->update(deltaTime);
+  }
+}
+
+ /*****************************************************************************/
+/** Updates a list of model instances.
+  *
+  * This function updates all models of a vector, see the pointer version.
+  *
+  * @param vectorModel The models to update.
+  * @param deltaTime The elapsed time in seconds since the last update.
+  *****************************************************************************/
+
+void CalModelBatch::update(const std::vector<CalModel *>& vectorModel, float deltaTime)
+{
+  if(vectorModel.empty()) return;
+
+  update(const_cast<CalModel **>(&vectorModel[0]), (int)vectorModel.size(), deltaTime);
+}
+
+//****************************************************************************//
@@ -0,0 +1,41 @@
+//****************************************************************************//
+// modelbatch.h                                                               //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+#ifndef CAL_MODELBATCH_H
+#define CAL_MODELBATCH_H
+
+
+#include "cal3d/global.h"
+
+namespace cal3d{
+	class CalModel;
+
+
+	class CAL3D_API CalModelBatch : NonCopyable
+	{
+	public:
+		explicit CalModelBatch(int threadCount = 0);
+		~CalModelBatch();
+
+		void setThreadCount(int threadCount);
+		int getThreadCount() const;
+		void update(CalModel **ppModel, int modelCount, float deltaTime);
+		void update(const std::vector<CalModel *>& vectorModel, float deltaTime);
+
+	private:
+		struct WorkerPool;
+
+		int         m_threadCount;
+		WorkerPool *m_pWorkerPool;
+	};
+}
+#endif
+
+//****************************************************************************//
@@ -28,8 +28,456 @@
 #include "cal3d/coresubmorphtarget.h"
 
 #include <cfloat>
+#include <cstring>
+#include <algorithm>
+
+#if defined(CAL3D_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+#if defined(CAL3D_SIMD_AVX2)
+#include <immintrin.h>
+#endif
 
 using namespace cal3d;
+
+namespace
+{
+  // Input and output of one run of the packed skinning kernel, see
+  // CalCoreSubmesh::SkinningLayout. The palette holds one 3x4 row-major bone
+  // transform (rotation and bone space translation) per entry.
+  struct SkinVerticesJob
+  {
+    const float *positionX;
+    const float *positionY;
+    const float *positionZ;
+    const int   *vertexId;
+    const int   *blockInfluenceCount;
+    const int   *blockInfluenceOffset;
+    const int   *paletteIndex;
+    const float *weight;
+    const float *palette;
+    int          blockCount;
+    int          vertexCount;
+    float        axisFactor[3];
+    float       *pVertexBuffer;
+    int          stride;
+  };
+
+  const int VertexBlock = CalCoreSubmesh::SkinningLayout::VertexBlock;
+
+  // Writes one skinned vertex, skipping block padding and vertices removed by
+  // the level of detail.
+  inline void storeVertex(const SkinVerticesJob& job, int vertexId, float x, float y, float z)
+  {
+    if((unsigned int)vertexId >= (unsigned int)job.vertexCount) return;
+
+    float *pVertex = (float *)(((char *)job.pVertexBuffer) + vertexId * job.stride);
+    pVertex[0] = x * job.axisFactor[0];
+    pVertex[1] = y * job.axisFactor[1];
+    pVertex[2] = z * job.axisFactor[2];
+  }
+
+  // Every kernel evaluates x = sum(weight * (M * position + t)) in the same
+  // order as the per-vertex code path so that the results match it.
+
+  void skinVerticesScalar(const SkinVerticesJob& job)
+  {
+    for(int blockId = 0; blockId < job.blockCount; ++blockId)
+    {
+      int influenceCount = job.blockInfluenceCount[blockId];
+      int influenceOffset = job.blockInfluenceOffset[blockId];
+
+      for(int lane = 0; lane < VertexBlock; ++lane)
+      {
+        int packedId = blockId * VertexBlock + lane;
+        float px = job.positionX[packedId];
+        float py = job.positionY[packedId];
+        float pz = job.positionZ[packedId];
+
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+
+        for(int slot = 0; slot < influenceCount; ++slot)
+        {
+          int i = influenceOffset + slot * VertexBlock + lane;
+          float weight = job.weight[i];
+          if(weight == 0.0f) continue;
+
+          const float *m = job.palette + 12 * job.paletteIndex[i];
+
+          float vx = m[0] * px + m[1] * py + m[2] * pz;
+          float vy = m[4] * px + m[5] * py + m[6] * pz;
+          float vz = m[8] * px + m[9] * py + m[10] * pz;
+          vx += m[3];
+          vy += m[7];
+          vz += m[11];
+
+          x += weight * vx;
+          y += weight * vy;
+          z += weight * vz;
+        }
+
+        storeVertex(job, job.vertexId[packedId], x, y, z);
+      }
+    }
+  }
+
+#if defined(CAL3D_SIMD_SSE2)
+
+  // Transposes one row of four palette entries and applies it to four positions.
+  inline __m128 transformRowSSE2(const float *m0, const float *m1, const float *m2, const float *m3,
+                                 int row, __m128 px, __m128 py, __m128 pz)
+  {
+    __m128 c0 = _mm_loadu_ps(m0 + row);
+    __m128 c1 = _mm_loadu_ps(m1 + row);
+    __m128 c2 = _mm_loadu_ps(m2 + row);
+    __m128 c3 = _mm_loadu_ps(m3 + row);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+    __m128 v = _mm_add_ps(_mm_mul_ps(c0, px), _mm_mul_ps(c1, py));
+    v = _mm_add_ps(v, _mm_mul_ps(c2, pz));
+    return _mm_add_ps(v, c3);
+  }
+
+  void skinVerticesSSE2(const SkinVerticesJob& job)
+  {
+    const __m128 zero = _mm_setzero_ps();
+
+    for(int blockId = 0; blockId < job.blockCount; ++blockId)
+    {
+      int influenceCount = job.blockInfluenceCount[blockId];
+      int influenceOffset = job.blockInfluenceOffset[blockId];
+
+      // a block is skinned as two groups of four vertices
+      for(int half = 0; half < VertexBlock; half += 4)
+      {
+        int packedId = blockId * VertexBlock + half;
+        __m128 px = _mm_loadu_ps(job.positionX + packedId);
+        __m128 py = _mm_loadu_ps(job.positionY + packedId);
+        __m128 pz = _mm_loadu_ps(job.positionZ + packedId);
+
+        __m128 x = zero;
+        __m128 y = zero;
+        __m128 z = zero;
+
+        for(int slot = 0; slot < influenceCount; ++slot)
+        {
+          int i = influenceOffset + slot * VertexBlock + half;
+          __m128 weight = _mm_loadu_ps(job.weight + i);
+          if(_mm_movemask_ps(_mm_cmpneq_ps(weight, zero)) == 0) continue;
+
+          const float *m0 = job.palette + 12 * job.paletteIndex[i];
+          const float *m1 = job.palette + 12 * job.paletteIndex[i + 1];
+          const float *m2 = job.palette + 12 * job.paletteIndex[i + 2];
+          const float *m3 = job.palette + 12 * job.paletteIndex[i + 3];
+
+          x = _mm_add_ps(x, _mm_mul_ps(weight, transformRowSSE2(m0, m1, m2, m3, 0, px, py, pz)));
+          y = _mm_add_ps(y, _mm_mul_ps(weight, transformRowSSE2(m0, m1, m2, m3, 4, px, py, pz)));
+          z = _mm_add_ps(z, _mm_mul_ps(weight, transformRowSSE2(m0, m1, m2, m3, 8, px, py, pz)));
+        }
+
+        float lanes[3][4];
+        _mm_storeu_ps(lanes[0], x);
+        _mm_storeu_ps(lanes[1], y);
+        _mm_storeu_ps(lanes[2], z);
+        for(int lane = 0; lane < 4; ++lane)
+        {
+          storeVertex(job, job.vertexId[packedId + lane], lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+        }
+      }
+    }
+  }
+
+#endif
+
+#if defined(CAL3D_SIMD_AVX2)
+
+  // Transposes one row of eight palette entries and applies it to eight
+  // positions. Lanes k and k + 4 share a register so that the in-lane
+  // shuffles transpose both 4x4 halves at once.
+  CAL3D_TARGET_AVX2
+  inline __m256 transformRowAVX2(const float * const *m, int row, __m256 px, __m256 py, __m256 pz)
+  {
+    __m256 r0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(m[0] + row)), _mm_loadu_ps(m[4] + row), 1);
+    __m256 r1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(m[1] + row)), _mm_loadu_ps(m[5] + row), 1);
+    __m256 r2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(m[2] + row)), _mm_loadu_ps(m[6] + row), 1);
+    __m256 r3 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(m[3] + row)), _mm_loadu_ps(m[7] + row), 1);
+
+    __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+    __m256 t1 = _mm256_unpacklo_ps(r2, r3);
+    __m256 t2 = _mm256_unpackhi_ps(r0, r1);
+    __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+    __m256 c0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 c1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 c2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 c3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+    __m256 v = _mm256_add_ps(_mm256_mul_ps(c0, px), _mm256_mul_ps(c1, py));
+    v = _mm256_add_ps(v, _mm256_mul_ps(c2, pz));
+    return _mm256_add_ps(v, c3);
+  }
+
+  CAL3D_TARGET_AVX2
+  void skinVerticesAVX2(const SkinVerticesJob& job)
+  {
+    const __m256 zero = _mm256_setzero_ps();
+
+    for(int blockId = 0; blockId < job.blockCount; ++blockId)
+    {
+      int influenceCount = job.blockInfluenceCount[blockId];
+      int influenceOffset = job.blockInfluenceOffset[blockId];
+
+      int packedId = blockId * VertexBlock;
+      __m256 px = _mm256_loadu_ps(job.positionX + packedId);
+      __m256 py = _mm256_loadu_ps(job.positionY + packedId);
+      __m256 pz = _mm256_loadu_ps(job.positionZ + packedId);
+
+      __m256 x = zero;
+      __m256 y = zero;
+      __m256 z = zero;
+
+      for(int slot = 0; slot < influenceCount; ++slot)
+      {
+        int i = influenceOffset + slot * VertexBlock;
+        __m256 weight = _mm256_loadu_ps(job.weight + i);
+        if(_mm256_movemask_ps(_mm256_cmp_ps(weight, zero, _CMP_NEQ_UQ)) == 0) continue;
+
+        const float *m[8];
+        for(int lane = 0; lane < 8; ++lane)
+        {
+          m[lane] = job.palette + 12 * job.paletteIndex[i + lane];
+        }
+
+        x = _mm256_add_ps(x, _mm256_mul_ps(weight, transformRowAVX2(m, 0, px, py, pz)));
+        y = _mm256_add_ps(y, _mm256_mul_ps(weight, transformRowAVX2(m, 4, px, py, pz)));
+        z = _mm256_add_ps(z, _mm256_mul_ps(weight, transformRowAVX2(m, 8, px, py, pz)));
+      }
+
+      float lanes[3][8];
+      _mm256_storeu_ps(lanes[0], x);
+      _mm256_storeu_ps(lanes[1], y);
+      _mm256_storeu_ps(lanes[2], z);
+      for(int lane = 0; lane < 8; ++lane)
+      {
+        storeVertex(job, job.vertexId[packedId + lane], lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+      }
+    }
+  }
+
+#endif
+
+  void skinVertices(const SkinVerticesJob& job)
+  {
+    switch(CalPlatform::getSimdLevel())
+    {
+#if defined(CAL3D_SIMD_AVX2)
+    case CAL_SIMD_AVX2:
+      skinVerticesAVX2(job);
+      return;
+#endif
+#if defined(CAL3D_SIMD_SSE2)
+    case CAL_SIMD_SSE2:
+      skinVerticesSSE2(job);
+      return;
+#endif
+    default:
+      skinVerticesScalar(job);
+      return;
+    }
+  }
+
+  // Input and output of one run of the morph blending kernel. It adds the
+  // weighted deltas of up to MorphBatch morph targets to a run of floats, one
+  // morph target after the other so that every kernel gives the same results.
+  const int MorphBatch = 4;
+
+  struct BlendMorphJob
+  {
+    float       *pDestination;
+    const float *pDelta[MorphBatch];
+    float        weight[MorphBatch];
+    int          deltaCount;
+    int          count;
+  };
+
+  inline void blendMorphRange(const BlendMorphJob& job, int begin)
+  {
+    for(int i = begin; i < job.count; ++i)
+    {
+      float value = job.pDestination[i];
+      for(int deltaId = 0; deltaId < job.deltaCount; ++deltaId)
+      {
+        value += job.weight[deltaId] * job.pDelta[deltaId][i];
+      }
+      job.pDestination[i] = value;
+    }
+  }
+
+  void blendMorphScalar(const BlendMorphJob& job)
+  {
+    blendMorphRange(job, 0);
+  }
+
+#if defined(CAL3D_SIMD_SSE2)
+
+  void blendMorphSSE2(const BlendMorphJob& job)
+  {
+    __m128 weight[MorphBatch];
+    for(int deltaId = 0; deltaId < job.deltaCount; ++deltaId)
+    {
+      weight[deltaId] = _mm_set1_ps(job.weight[deltaId]);
+    }
+
+    int i = 0;
+    for(; i + 4 <= job.count; i += 4)
+    {
+      __m128 value = _mm_loadu_ps(job.pDestination + i);
+      for(int deltaId = 0; deltaId < job.deltaCount; ++deltaId)
+      {
+        value = _mm_add_ps(value, _mm_mul_ps(weight[deltaId], _mm_loadu_ps(job.pDelta[deltaId] + i)));
+      }
+      _mm_storeu_ps(job.pDestination + i, value);
+    }
+
+    blendMorphRange(job, i);
+  }
+
+#endif
+
+#if defined(CAL3D_SIMD_AVX2)
+
+  CAL3D_TARGET_AVX2
+  void blendMorphAVX2(const BlendMorphJob& job)
+  {
+    __m256 weight[MorphBatch];
+    for(int deltaId = 0; deltaId < job.deltaCount; ++deltaId)
+    {
+      weight[deltaId] = _mm256_set1_ps(job.weight[deltaId]);
+    }
+
+    int i = 0;
+    for(; i + 8 <= job.count; i += 8)
+    {
+      __m256 value = _mm256_loadu_ps(job.pDestination + i);
+      for(int deltaId = 0; deltaId < job.deltaCount; ++deltaId)
+      {
+        value = _mm256_add_ps(value, _mm256_mul_ps(weight[deltaId], _mm256_loadu_ps(job.pDelta[deltaId] + i)));
+      }
+      _mm256_storeu_ps(job.pDestination + i, value);
+    }
+
+    blendMorphRange(job, i);
+  }
+
+#endif
+
+  void blendMorph(const BlendMorphJob& job)
+  {
+    switch(CalPlatform::getSimdLevel())
+    {
+#if defined(CAL3D_SIMD_AVX2)
+    case CAL_SIMD_AVX2:
+      blendMorphAVX2(job);
+      return;
+#endif
+#if defined(CAL3D_SIMD_SSE2)
+    case CAL_SIMD_SSE2:
+      blendMorphSSE2(job);
+      return;
+#endif
+    default:
+      blendMorphScalar(job);
+      return;
+    }
+  }
+
+  // Adds the span deltas of the morph target at position listId of a list of
+  // morph targets to vertex positions and/or normals, three floats per vertex.
+  // The following morph targets of the list that move the same single span are
+  // added in the same pass. Returns the number of morph targets added, 0 if
+  // the spans of the morph target are not up to date.
+  int blendMorphTargetSpans(const CalSubmesh *pSubmesh, const std::vector<int>& vectorMorphTargetId, int listId,
+                            int vertexCount, float *pPosition, float *pNormal)
+  {
+    const std::vector<CalCoreSubMorphTarget*>& vectorSubMorphTarget =
+      pSubmesh->getCoreSubmesh()->getVectorCoreSubMorphTarget();
+    const int listCount = (int)vectorMorphTargetId.size();
+
+    const int morphTargetId = vectorMorphTargetId[listId];
+    const CalCoreSubMorphTarget *pMorphTarget = vectorSubMorphTarget[morphTargetId];
+
+    const std::vector<CalCoreSubMorphTarget::BlendVertexSpan> *pVectorSpan = pMorphTarget->getVectorBlendVertexSpan();
+    if(pVectorSpan == 0) return 0;
+
+    const int spanCount = (int)pVectorSpan->size();
+
+    // gather the following morph targets that move the same single span
+    const CalCoreSubMorphTarget *batchMorphTarget[MorphBatch];
+    const CalCoreSubMorphTarget::BlendVertexSpan *batchSpan[MorphBatch];
+    float batchScale[MorphBatch];
+    int batchCount = 1;
+    batchMorphTarget[0] = pMorphTarget;
+    batchScale[0] = pSubmesh->getMorphTargetWeight(morphTargetId);
+    if(spanCount == 1)
+    {
+      batchSpan[0] = &(*pVectorSpan)[0];
+      while(batchCount < MorphBatch && listId + batchCount < listCount)
+      {
+        const int nextMorphTargetId = vectorMorphTargetId[listId + batchCount];
+        const CalCoreSubMorphTarget *pNextMorphTarget = vectorSubMorphTarget[nextMorphTargetId];
+        const std::vector<CalCoreSubMorphTarget::BlendVertexSpan> *pVectorNextSpan = pNextMorphTarget->getVectorBlendVertexSpan();
+        if(pVectorNextSpan == 0 || pVectorNextSpan->size() != 1) break;
+
+        const CalCoreSubMorphTarget::BlendVertexSpan& nextSpan = (*pVectorNextSpan)[0];
+        if(nextSpan.firstVertexId != batchSpan[0]->firstVertexId || nextSpan.vertexCount != batchSpan[0]->vertexCount) break;
+
+        batchMorphTarget[batchCount] = pNextMorphTarget;
+        batchSpan[batchCount] = &nextSpan;
+        batchScale[batchCount] = pSubmesh->getMorphTargetWeight(nextMorphTargetId);
+        ++batchCount;
+      }
+    }
+
+    for(int spanId = 0; spanId < spanCount; ++spanId)
+    {
+      const CalCoreSubMorphTarget::BlendVertexSpan& span = (*pVectorSpan)[spanId];
+      if(span.firstVertexId >= vertexCount) break;
+      const int spanVertexCount = std::min(span.vertexCount, vertexCount - span.firstVertexId);
+
+      BlendMorphJob job;
+      job.deltaCount = batchCount;
+      job.count = 3 * spanVertexCount;
+      for(int batchId = 0; batchId < batchCount; ++batchId)
+      {
+        job.weight[batchId] = batchScale[batchId];
+      }
+
+      if(pPosition)
+      {
+        job.pDestination = pPosition + 3 * span.firstVertexId;
+        job.pDelta[0] = &pMorphTarget->getVectorSpanPosition()[3 * span.offset];
+        for(int batchId = 1; batchId < batchCount; ++batchId)
+        {
+          job.pDelta[batchId] = &batchMorphTarget[batchId]->getVectorSpanPosition()[3 * batchSpan[batchId]->offset];
+        }
+        blendMorph(job);
+      }
+      if(pNormal)
+      {
+        job.pDestination = pNormal + 3 * span.firstVertexId;
+        job.pDelta[0] = &pMorphTarget->getVectorSpanNormal()[3 * span.offset];
+        for(int batchId = 1; batchId < batchCount; ++batchId)
+        {
+          job.pDelta[batchId] = &batchMorphTarget[batchId]->getVectorSpanNormal()[3 * batchSpan[batchId]->offset];
+        }
+        blendMorph(job);
+      }
+    }
+
+    return batchCount;
+  }
+}
  /*****************************************************************************/
 /** Constructs the physique instance.
   *
@@ -45,13 +493,229 @@ CalPhysique::CalPhysique(CalModel* pModel)
   m_axisFactorX = 1.0f;
   m_axisFactorY = 1.0f;
   m_axisFactorZ = 1.0f;
+  m_settingsVersion = 0;
+}
+
+ /*****************************************************************************/
+/** Checks whether the vertex data of a submesh changed.
+  *
+  * This function compares what the vertex data computed by this physique for
+  * a submesh depends on (the state of the skeleton, the morph target weights
+  * and the LOD level of the submesh and the settings of the physique) with a
+  * key saved with earlier results, and updates the key. Changes to the core
+  * model data are not seen.
+  *
+  * @param pSubmesh A pointer to the submesh.
+  * @param key The key saved with the earlier results.
+  *
+  * @return One of the following values:
+  *         \li \b true if the vertex data has to be computed again
+  *         \li \b false if the earlier results are still valid
+  *****************************************************************************/
+
+bool CalPhysique::updateSkinningKey(const CalSubmesh *pSubmesh, CalSubmesh::SkinningKey& key) const
+{
+  unsigned int skeletonVersion = m_pModel->getSkeleton()->getStateVersion();
+  const std::vector<float>& vectorMorphTargetWeight = pSubmesh->getVectorMorphTargetWeight();
+
+  if(key.pPhysique == this
+    && key.physiqueVersion == m_settingsVersion
+    && key.skeletonVersion == skeletonVersion
+    && key.vertexCount == pSubmesh->getVertexCount()
+    && key.vectorMorphTargetWeight == vectorMorphTargetWeight)
+  {
+    return false;
+  }
+
+  key.pPhysique = this;
+  key.physiqueVersion = m_settingsVersion;
+  key.skeletonVersion = skeletonVersion;
+  key.vertexCount = pSubmesh->getVertexCount();
+  key.vectorMorphTargetWeight = vectorMorphTargetWeight;
+  return true;
+}
+
+ /*****************************************************************************/
+/** Blends the active morph targets of a submesh.
+  *
+  * This function blends the morph targets with a non-zero weight into scratch
+  * buffers of the physique, see the other blendMorphTargets.
+  *
+  * @param pSubmesh A pointer to the submesh.
+  * @param vertexCount The number of vertices to blend.
+  * @param blendPositions Whether to blend the positions.
+  * @param blendNormals Whether to blend the normals.
+  *
+  * @return One of the following values:
+  *         \li \b true if a morph target is active and the scratch buffers
+  *                hold the blended vertices
+  *         \li \b false if no morph target is active
+  *****************************************************************************/
+
+bool CalPhysique::blendMorphTargets(CalSubmesh *pSubmesh, int vertexCount, bool blendPositions, bool blendNormals) const
+{
+  const int morphTargetCount = pSubmesh->getMorphTargetWeightCount();
+
+  m_vectorActiveMorphTargetId.clear();
+  for(int morphTargetId = 0; morphTargetId < morphTargetCount; ++morphTargetId)
+  {
+    if(pSubmesh->getMorphTargetWeight(morphTargetId) != 0.0f)
+    {
+      m_vectorActiveMorphTargetId.push_back(morphTargetId);
+    }
+  }
+
+  return blendMorphTargets(pSubmesh, m_vectorActiveMorphTargetId, 1.0f, vertexCount, blendPositions, blendNormals);
+}
+
+ /*****************************************************************************/
+/** Blends a list of morph targets of a submesh.
+  *
+  * This function copies the vertex positions and/or normals of a submesh,
+  * scaled by a base weight, into scratch buffers of the physique and adds the
+  * weighted deltas of the given morph targets in list order. Only the spans
+  * of vertices a morph target moves are touched, see
+  * CalCoreSubMorphTarget::updateSparseBlendVertices, and every span is
+  * blended with the vectorized kernel that CalPlatform::getSimdLevel selects.
+  * Morph targets that move the same single span, such as morph targets that
+  * move the whole submesh, are blended several at a time in one pass.
+  *
+  * @param pSubmesh A pointer to the submesh.
+  * @param vectorMorphTargetId The ids of the morph targets to blend.
+  * @param baseWeight The weight of the submesh vertices.
+  * @param vertexCount The number of vertices to blend.
+  * @param blendPositions Whether to blend the positions.
+  * @param blendNormals Whether to blend the normals.
+  *
+  * @return One of the following values:
+  *         \li \b true if the scratch buffers hold the blended vertices
+  *         \li \b false if there is no morph target to blend
+  *****************************************************************************/
+
+bool CalPhysique::blendMorphTargets(CalSubmesh *pSubmesh, const std::vector<int>& vectorMorphTargetId, float baseWeight,
+                                    int vertexCount, bool blendPositions, bool blendNormals) const
+{
+  if(vectorMorphTargetId.empty() || vertexCount <= 0) return false;
+
+  const std::vector<CalCoreSubMorphTarget*>& vectorSubMorphTarget =
+    pSubmesh->getCoreSubmesh()->getVectorCoreSubMorphTarget();
+
+  // start from the vertices of the core submesh
+  const std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pSubmesh->getCoreSubmesh()->getVectorVertex();
+  float *pPosition = 0;
+  float *pNormal = 0;
+  if(blendPositions)
+  {
+    m_vectorMorphedVertexPosition.resize(3 * vertexCount);
+    pPosition = &m_vectorMorphedVertexPosition[0];
+  }
+  if(blendNormals)
+  {
+    m_vectorMorphedVertexNormal.resize(3 * vertexCount);
+    pNormal = &m_vectorMorphedVertexNormal[0];
+  }
+
+  int vertexId;
+  for(vertexId = 0; vertexId < vertexCount; ++vertexId)
+  {
+    const CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
+    if(pPosition)
+    {
+      pPosition[3 * vertexId + 0] = baseWeight * vertex.position.x;
+      pPosition[3 * vertexId + 1] = baseWeight * vertex.position.y;
+      pPosition[3 * vertexId + 2] = baseWeight * vertex.position.z;
+    }
+    if(pNormal)
+    {
+      pNormal[3 * vertexId + 0] = baseWeight * vertex.normal.x;
+      pNormal[3 * vertexId + 1] = baseWeight * vertex.normal.y;
+      pNormal[3 * vertexId + 2] = baseWeight * vertex.normal.z;
+    }
+  }
+
+  // add the deltas of the morph targets, in list order
+  const int listCount = (int)vectorMorphTargetId.size();
+  int listId = 0;
+  while(listId < listCount)
+  {
+    const int morphTargetId = vectorMorphTargetId[listId];
+    const float morphScale = pSubmesh->getMorphTargetWeight(morphTargetId);
+    const CalCoreSubMorphTarget *pMorphTarget = vectorSubMorphTarget[morphTargetId];
+
+    // blend the morph target, and the following ones moving the same span, span by span
+    int blendCount = blendMorphTargetSpans(pSubmesh, vectorMorphTargetId, listId, vertexCount, pPosition, pNormal);
+    if(blendCount > 0)
+    {
+      listId += blendCount;
+      continue;
+    }
+
+    if(pMorphTarget->isCompressed())
+    {
+      const CalCoreSubMorphTarget::CompressedBlendVertices& compressedBlendVertices = pMorphTarget->getCompressedBlendVertices();
+      const std::vector<CalCoreSubMorphTarget::CompressedBlendVertices::Entry>& vectorEntry = compressedBlendVertices.getVectorEntry();
+      const int entryCount = (int)vectorEntry.size();
+      CalVector position, normal;
+      for(int entryId = 0; entryId < entryCount; ++entryId)
+      {
+        vertexId = vectorEntry[entryId].vertexId;
+        if(vertexId >= vertexCount) break;
+
+        compressedBlendVertices.decompress(vectorEntry[entryId], position, normal);
+        if(pPosition)
+        {
+          pPosition[3 * vertexId + 0] += morphScale * position.x;
+          pPosition[3 * vertexId + 1] += morphScale * position.y;
+          pPosition[3 * vertexId + 2] += morphScale * position.z;
+        }
+        if(pNormal)
+        {
+          pNormal[3 * vertexId + 0] += morphScale * normal.x;
+          pNormal[3 * vertexId + 1] += morphScale * normal.y;
+          pNormal[3 * vertexId + 2] += morphScale * normal.z;
+        }
+      }
+    }
+    else
+    {
+      // the spans are not up to date, go through all vertices
+      for(vertexId = 0; vertexId < vertexCount; ++vertexId)
+      {
+        const CalCoreSubMorphTarget::BlendVertex *blendVertex = pMorphTarget->getBlendVertex(vertexId);
+        if(pPosition)
+        {
+          pPosition[3 * vertexId + 0] += morphScale * blendVertex->position.x;
+          pPosition[3 * vertexId + 1] += morphScale * blendVertex->position.y;
+          pPosition[3 * vertexId + 2] += morphScale * blendVertex->position.z;
+        }
+        if(pNormal)
+        {
+          pNormal[3 * vertexId + 0] += morphScale * blendVertex->normal.x;
+          pNormal[3 * vertexId + 1] += morphScale * blendVertex->normal.y;
+          pNormal[3 * vertexId + 2] += morphScale * blendVertex->normal.z;
+        }
+      }
+    }
+
+    ++listId;
+  }
+
+  return true;
 }
 
  /*****************************************************************************/
 /** Calculates the transformed vertex data.
   *
   * This function calculates and returns the transformed vertex data of a
-  * specific submesh.
+  * specific submesh. It only writes to scratch storage owned by this physique
+  * and to the submesh, so the physiques of different models can be run from
+  * different threads at the same time, as long as their skeletons are not
+  * being updated.
+  *
+  * When the state of the skeleton did not change since the last call for a
+  * submesh with morph targets, the vertices are taken from a cached skinned
+  * base pose and only the vertices moved by the active morph targets are
+  * skinned, see calculateVerticesFromBasePose.
   *
   * @param pSubmesh A pointer to the submesh from which the vertex data should
   *                 be calculated and returned.
@@ -68,11 +732,214 @@ int CalPhysique::calculateVertices(CalSubmesh *pSubmesh, float *pVertexBuffer, i
 	  stride = 3*sizeof(float);
   }
 
+  if(calculateVerticesFromBasePose(pSubmesh, pVertexBuffer, stride))
+  {
+    return pSubmesh->getVertexCount();
+  }
+
+  return calculateSkinnedVertices(pSubmesh, pVertexBuffer, stride, true);
+}
+
+ /*****************************************************************************/
+/** Calculates the transformed vertex data from a cached base pose.
+  *
+  * This function skins the vertices of a submesh on top of its cached base
+  * pose, the vertices skinned without morph targets. As skinning is linear,
+  * the skinned vertex of a morphed position is the skinned base vertex plus
+  * the morph delta transformed by the blended bone rotations, so only the
+  * vertices moved by the active morph targets go through the bones.
+  *
+  * The base pose is kept in the submesh and skinned once the skeleton stays
+  * the same for two calls in a row, so submeshes whose bones move every frame
+  * never pay for it. Submeshes without morph targets, with springs, or with
+  * active morph targets whose spans are not up to date are left to the full
+  * skinning path.
+  *
+  * @param pSubmesh A pointer to the submesh.
+  * @param pVertexBuffer A pointer to the user-provided buffer where the vertex
+  *                      data is written to.
+  * @param stride The byte offset between two vertices in the buffer.
+  *
+  * @return One of the following values:
+  *         \li \b true if the vertex data was written to the buffer
+  *         \li \b false if the vertex data has to be skinned in full
+  *****************************************************************************/
+
+bool CalPhysique::calculateVerticesFromBasePose(CalSubmesh *pSubmesh, float *pVertexBuffer, int stride) const
+{
+  const int morphTargetCount = pSubmesh->getMorphTargetWeightCount();
+  if(morphTargetCount == 0) return false;
+
+  if((pSubmesh->getCoreSubmesh()->getSpringCount() > 0) && pSubmesh->hasInternalData()) return false;
+
+  // check whether the bones moved since the last call
+  CalSubmesh::BasePoseCache& basePoseCache = pSubmesh->getBasePoseCache();
+  CalSubmesh::SkinningKey& key = basePoseCache.key;
+  const unsigned int skeletonVersion = m_pModel->getSkeleton()->getStateVersion();
+  const int vertexCount = pSubmesh->getVertexCount();
+  if(key.pPhysique != this
+    || key.physiqueVersion != m_settingsVersion
+    || key.skeletonVersion != skeletonVersion
+    || key.vertexCount != vertexCount)
+  {
+    key.pPhysique = this;
+    key.physiqueVersion = m_settingsVersion;
+    key.skeletonVersion = skeletonVersion;
+    key.vertexCount = vertexCount;
+    basePoseCache.vectorPosition.clear();
+    return false;
+  }
+
+  // collect the active morph targets, all of them with up-to-date spans
+  const std::vector<CalCoreSubMorphTarget*>& vectorSubMorphTarget =
+    pSubmesh->getCoreSubmesh()->getVectorCoreSubMorphTarget();
+  m_vectorActiveMorphTargetId.clear();
+  m_vectorMorphRange.clear();
+  for(int morphTargetId = 0; morphTargetId < morphTargetCount; ++morphTargetId)
+  {
+    if(pSubmesh->getMorphTargetWeight(morphTargetId) == 0.0f) continue;
+
+    const std::vector<CalCoreSubMorphTarget::BlendVertexSpan> *pVectorSpan =
+      vectorSubMorphTarget[morphTargetId]->getVectorBlendVertexSpan();
+    if(pVectorSpan == 0) return false;
+
+    m_vectorActiveMorphTargetId.push_back(morphTargetId);
+    for(size_t spanId = 0; spanId < pVectorSpan->size(); ++spanId)
+    {
+      const CalCoreSubMorphTarget::BlendVertexSpan& span = (*pVectorSpan)[spanId];
+      if(span.firstVertexId >= vertexCount) break;
+      m_vectorMorphRange.push_back(std::make_pair(span.firstVertexId, std::min(span.firstVertexId + span.vertexCount, vertexCount)));
+    }
+  }
+
+  // merge the spans of the active morph targets into disjoint ranges
+  std::sort(m_vectorMorphRange.begin(), m_vectorMorphRange.end());
+  size_t rangeCount = 0;
+  for(size_t spanId = 0; spanId < m_vectorMorphRange.size(); ++spanId)
+  {
+    if(rangeCount > 0 && m_vectorMorphRange[spanId].first <= m_vectorMorphRange[rangeCount - 1].second)
+    {
+      m_vectorMorphRange[rangeCount - 1].second = std::max(m_vectorMorphRange[rangeCount - 1].second, m_vectorMorphRange[spanId].second);
+    }
+    else
+    {
+      m_vectorMorphRange[rangeCount++] = m_vectorMorphRange[spanId];
+    }
+  }
+  m_vectorMorphRange.resize(rangeCount);
+
+  // skinning most of the vertices is faster with the vectorized kernel of the
+  // full skinning path
+  int movedVertexCount = 0;
+  size_t rangeId;
+  for(rangeId = 0; rangeId < rangeCount; ++rangeId)
+  {
+    movedVertexCount += m_vectorMorphRange[rangeId].second - m_vectorMorphRange[rangeId].first;
+  }
+  if(2 * movedVertexCount > vertexCount) return false;
+
+  // skin the base pose the first time the bones stay still
+  if(basePoseCache.vectorPosition.empty())
+  {
+    basePoseCache.vectorPosition.resize(3 * vertexCount + 3);
+    calculateSkinnedVertices(pSubmesh, &basePoseCache.vectorPosition[0], 3 * sizeof(float), false);
+  }
+
+  // start from the base pose
+  const float *pBasePosition = &basePoseCache.vectorPosition[0];
+  if(stride == 3 * sizeof(float))
+  {
+    memcpy(pVertexBuffer, pBasePosition, vertexCount * 3 * sizeof(float));
+  }
+  else
+  {
+    char *pDestination = (char *)pVertexBuffer;
+    for(int vertexId = 0; vertexId < vertexCount; ++vertexId)
+    {
+      memcpy(pDestination, pBasePosition + 3 * vertexId, 3 * sizeof(float));
+      pDestination += stride;
+    }
+  }
+
+  // blend the morph deltas over the ranges only
+  m_vectorMorphedVertexPosition.resize(3 * vertexCount);
+  float *pDelta = &m_vectorMorphedVertexPosition[0];
+  for(rangeId = 0; rangeId < rangeCount; ++rangeId)
+  {
+    std::fill(pDelta + 3 * m_vectorMorphRange[rangeId].first, pDelta + 3 * m_vectorMorphRange[rangeId].second, 0.0f);
+  }
+
+  const int listCount = (int)m_vectorActiveMorphTargetId.size();
+  int listId = 0;
+  while(listId < listCount)
+  {
+    listId += blendMorphTargetSpans(pSubmesh, m_vectorActiveMorphTargetId, listId, vertexCount, pDelta, 0);
+  }
+
+  // skin the deltas and add them to the base pose
+  const std::vector<CalBone *>& vectorBone = m_pModel->getSkeleton()->getVectorBone();
+  const CalCoreSubmesh *pCoreSubmesh = pSubmesh->getCoreSubmesh();
+  for(rangeId = 0; rangeId < rangeCount; ++rangeId)
+  {
+    for(int vertexId = m_vectorMorphRange[rangeId].first; vertexId < m_vectorMorphRange[rangeId].second; ++vertexId)
+    {
+      CalVector delta(pDelta[3 * vertexId], pDelta[3 * vertexId + 1], pDelta[3 * vertexId + 2]);
+
+      const CalCoreSubmesh::Influence *pInfluence = pCoreSubmesh->getInfluences(vertexId);
+      size_t influenceCount = pCoreSubmesh->getInfluenceCount(vertexId);
+      if(influenceCount > 0)
+      {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        for(size_t influenceId = 0; influenceId < influenceCount; ++influenceId)
+        {
+          const CalCoreSubmesh::Influence& influence = pInfluence[influenceId];
+
+          // rotate the delta with the current state of the bone
+          CalVector v(delta);
+          v *= vectorBone[influence.boneId]->getTransformMatrix();
+
+          x += influence.weight * v.x;
+          y += influence.weight * v.y;
+          z += influence.weight * v.z;
+        }
+        delta.set(x, y, z);
+      }
+
+      float *pVertex = (float *)(((char *)pVertexBuffer) + vertexId * stride);
+      pVertex[0] += delta.x * m_axisFactorX;
+      pVertex[1] += delta.y * m_axisFactorY;
+      pVertex[2] += delta.z * m_axisFactorZ;
+    }
+  }
+
+  return true;
+}
+
+ /*****************************************************************************/
+/** Skins the vertex data.
+  *
+  * This function skins the vertices of a submesh in full, see
+  * calculateVertices.
+  *
+  * @param pSubmesh A pointer to the submesh.
+  * @param pVertexBuffer A pointer to the user-provided buffer where the vertex
+  *                      data is written to.
+  * @param stride The byte offset between two vertices in the buffer.
+  * @param applyMorphTargets Whether to blend the active morph targets first.
+  *
+  * @return The number of vertices written to the buffer.
+  *****************************************************************************/
+
+int CalPhysique::calculateSkinnedVertices(CalSubmesh *pSubmesh, float *pVertexBuffer, int stride, bool applyMorphTargets) const
+{
   // get bone vector of the skeleton
   const std::vector<CalBone *>& vectorBone = m_pModel->getSkeleton()->getVectorBone();
 
   // get vertex vector of the core submesh
-  std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pSubmesh->getCoreSubmesh()->getVectorVertex();
+  CalCoreSubmesh *pCoreSubmesh = pSubmesh->getCoreSubmesh();
+  const std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
 
   // get physical property vector of the core submesh
   std::vector<CalCoreSubmesh::PhysicalProperty>& vectorPhysicalProperty = pSubmesh->getCoreSubmesh()->getVectorPhysicalProperty();
@@ -81,57 +948,99 @@ int CalPhysique::calculateVertices(CalSubmesh *pSubmesh, float *pVertexBuffer, i
   int vertexCount;
   vertexCount = pSubmesh->getVertexCount();
 
-  // get the sub morph target vector from the core sub mesh
-  std::vector<CalCoreSubMorphTarget*>& vectorSubMorphTarget =
-  pSubmesh->getCoreSubmesh()->getVectorCoreSubMorphTarget();
-
-
-  // Get the number of morph targets and cache the weights in an array
-  // that can be indexed quickly inside the vertex inner loop.
-  int morphTargetCount = pSubmesh->getMorphTargetWeightCount();
-  static int const morphTargetCountMax = 100; // Arbitrary.
-  if( morphTargetCount > morphTargetCountMax ) {
-     morphTargetCount = morphTargetCountMax;
-  }
-  static float morphTargetScaleArray[ morphTargetCountMax ];
-  for(int i = 0; i < morphTargetCount; i++ )
-  {
-     morphTargetScaleArray[ i ] = pSubmesh->getMorphTargetWeight( i );
-  }
-
   // Check for spring case
   bool	hasSpringsAndInternalData =
 	(pSubmesh->getCoreSubmesh()->getSpringCount() > 0) &&
 	pSubmesh->hasInternalData();
 
+  // use the vectorized kernel if the core submesh has packed skinning data;
+  // spring vertices keep going through the per-vertex loop below
+  const CalCoreSubmesh::SkinningLayout *pLayout = pSubmesh->getCoreSubmesh()->getSkinningLayout();
+  if(pLayout && !hasSpringsAndInternalData)
+  {
+    // gather the transforms of the bones used by the submesh, entry 0 being the identity
+    int paletteSize = (int)pLayout->boneId.size() + 1;
+    m_vectorSkinningPalette.resize(12 * paletteSize);
+    float *pPalette = &m_vectorSkinningPalette[0];
+    pPalette[0] = 1.0f; pPalette[1] = 0.0f; pPalette[2]  = 0.0f; pPalette[3]  = 0.0f;
+    pPalette[4] = 0.0f; pPalette[5] = 1.0f; pPalette[6]  = 0.0f; pPalette[7]  = 0.0f;
+    pPalette[8] = 0.0f; pPalette[9] = 0.0f; pPalette[10] = 1.0f; pPalette[11] = 0.0f;
+    m_pModel->getSkeleton()->getSkinningPalette(pPalette + 12, pLayout->boneId, CAL_SKINNING_PALETTE_ROW_MAJOR_3X4);
+
+    SkinVerticesJob job;
+    job.positionX = &pLayout->positionX[0];
+    job.positionY = &pLayout->positionY[0];
+    job.positionZ = &pLayout->positionZ[0];
+    job.vertexId = &pLayout->vertexId[0];
+    job.blockInfluenceCount = &pLayout->blockInfluenceCount[0];
+    job.blockInfluenceOffset = &pLayout->blockInfluenceOffset[0];
+    job.paletteIndex = &pLayout->paletteIndex[0];
+    job.weight = &pLayout->weight[0];
+    job.palette = pPalette;
+    job.blockCount = (int)pLayout->blockInfluenceCount.size();
+    job.vertexCount = vertexCount;
+    job.axisFactor[0] = m_axisFactorX;
+    job.axisFactor[1] = m_axisFactorY;
+    job.axisFactor[2] = m_axisFactorZ;
+    job.pVertexBuffer = pVertexBuffer;
+    job.stride = stride;
+
+    // blend the active morph targets and pack the morphed positions
+    if(applyMorphTargets && blendMorphTargets(pSubmesh, vertexCount, true, false))
+    {
+      const float *pMorphedPosition = &m_vectorMorphedVertexPosition[0];
+      int packedCount = (int)pLayout->vertexId.size();
+      m_vectorMorphedPosition.resize(3 * packedCount);
+      float *pX = &m_vectorMorphedPosition[0];
+      float *pY = pX + packedCount;
+      float *pZ = pY + packedCount;
+
+      for(int packedId = 0; packedId < packedCount; ++packedId)
+      {
+        int vertexId = pLayout->vertexId[packedId];
+        if((unsigned int)vertexId >= (unsigned int)vertexCount)
+        {
+          // block padding and vertices removed by the level of detail
+          pX[packedId] = pLayout->positionX[packedId];
+          pY[packedId] = pLayout->positionY[packedId];
+          pZ[packedId] = pLayout->positionZ[packedId];
+          continue;
+        }
 
+        pX[packedId] = pMorphedPosition[3 * vertexId + 0];
+        pY[packedId] = pMorphedPosition[3 * vertexId + 1];
+        pZ[packedId] = pMorphedPosition[3 * vertexId + 2];
+      }
+
+      job.positionX = pX;
+      job.positionY = pY;
+      job.positionZ = pZ;
+    }
+
+    skinVertices(job);
+
+    return vertexCount;
+  }
+
+  // blend the active morph targets
+  const float *pMorphedPosition = 0;
+  if(applyMorphTargets && blendMorphTargets(pSubmesh, vertexCount, true, false))
+  {
+    pMorphedPosition = &m_vectorMorphedVertexPosition[0];
+  }
 
   // calculate all submesh vertices
   int vertexId;
   for(vertexId = 0; vertexId < vertexCount; ++vertexId)
   {
     // get the vertex
-    CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
+    const CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
 
-    // blend the morph targets
+    // take the morphed position if there is one
     CalVector position=vertex.position;
-
+    if(pMorphedPosition)
     {
-
-      int morphTargetId;
-      for(morphTargetId=0; morphTargetId < morphTargetCount;++morphTargetId)
-      {
-         CalCoreSubMorphTarget::BlendVertex const * blendVertex =
-            vectorSubMorphTarget[morphTargetId]->getBlendVertex(vertexId);
-         float morphScale = morphTargetScaleArray[ morphTargetId ];
-         if( blendVertex )
-         {
-            position.x += morphScale * blendVertex->position.x;
-            position.y += morphScale * blendVertex->position.y;
-            position.z += morphScale * blendVertex->position.z;
-         }
-
-      }
+      position.set(pMorphedPosition[3 * vertexId], pMorphedPosition[3 * vertexId + 1], pMorphedPosition[3 * vertexId + 2]);
     }
 
     // initialize vertex
@@ -141,7 +1050,8 @@ int CalPhysique::calculateVertices(CalSubmesh *pSubmesh, float *pVertexBuffer, i
     z = 0.0f;
 
     // blend together all vertex influences
-    size_t influenceCount=vertex.vectorInfluence.size();
+    const CalCoreSubmesh::Influence *pInfluence = pCoreSubmesh->getInfluences(vertexId);
+    size_t influenceCount=pCoreSubmesh->getInfluenceCount(vertexId);
     if(influenceCount == 0)
 	{
       x = position.x;
@@ -153,7 +1063,7 @@ int CalPhysique::calculateVertices(CalSubmesh *pSubmesh, float *pVertexBuffer, i
 		for(size_t influenceId = 0; influenceId < influenceCount; ++influenceId)
 		{
 			// get the influence
-			CalCoreSubmesh::Influence& influence = vertex.vectorInfluence[influenceId];
+			const CalCoreSubmesh::Influence& influence = pInfluence[influenceId];
 
 			// get the bone of the influence vertex
 			CalBone *pBone;
@@ -217,7 +1127,8 @@ CalVector CalPhysique::calculateVertex(CalSubmesh *pSubmesh, int vertexId)
   const std::vector<CalBone *>& vectorBone = m_pModel->getSkeleton()->getVectorBone();
 
   // get vertex of the core submesh
-  std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pSubmesh->getCoreSubmesh()->getVectorVertex();
+  CalCoreSubmesh *pCoreSubmesh = pSubmesh->getCoreSubmesh();
+  const std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
 
   // get physical property vector of the core submesh
   //std::vector<CalCoreSubmesh::PhysicalProperty>& vectorPhysicalProperty = pSubmesh->getCoreSubmesh()->getVectorPhysicalProperty();
@@ -232,7 +1143,7 @@ CalVector CalPhysique::calculateVertex(CalSubmesh *pSubmesh, int vertexId)
   int morphTargetCount = pSubmesh->getMorphTargetWeightCount();
 
   // get the vertex
-  CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
+  const CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
 
   // blend the morph targets
   CalVector position=vertex.position;
@@ -260,7 +1171,8 @@ CalVector CalPhysique::calculateVertex(CalSubmesh *pSubmesh, int vertexId)
 
   // blend together all vertex influences
   int influenceId;
-  int influenceCount=(int)vertex.vectorInfluence.size();
+  const CalCoreSubmesh::Influence *pInfluence = pCoreSubmesh->getInfluences(vertexId);
+  int influenceCount=pCoreSubmesh->getInfluenceCount(vertexId);
   if(influenceCount == 0)
   {
     x = position.x;
@@ -272,7 +1184,7 @@ CalVector CalPhysique::calculateVertex(CalSubmesh *pSubmesh, int vertexId)
 	  for(influenceId = 0; influenceId < influenceCount; ++influenceId)
 	  {
 		  // get the influence
-		  CalCoreSubmesh::Influence& influence = vertex.vectorInfluence[influenceId];
+		  const CalCoreSubmesh::Influence& influence = pInfluence[influenceId];
 
 		  // get the bone of the influence vertex
 		  CalBone *pBone;
@@ -340,8 +1252,8 @@ int CalPhysique::calculateTangentSpaces(CalSubmesh *pSubmesh, int mapId, float *
   // get bone vector of the skeleton
   const std::vector<CalBone *>& vectorBone = m_pModel->getSkeleton()->getVectorBone();
 
-  // get vertex vector of the submesh
-  std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pSubmesh->getCoreSubmesh()->getVectorVertex();
+  // get the core submesh
+  CalCoreSubmesh *pCoreSubmesh = pSubmesh->getCoreSubmesh();
 
   // get tangent space vector of the submesh
   std::vector<CalCoreSubmesh::TangentSpace>& vectorTangentSpace = pSubmesh->getCoreSubmesh()->getVectorVectorTangentSpace()[mapId];
@@ -356,9 +1268,6 @@ int CalPhysique::calculateTangentSpaces(CalSubmesh *pSubmesh, int mapId, float *
   {
     CalCoreSubmesh::TangentSpace& tangentSpace = vectorTangentSpace[vertexId];
 
-    // get the vertex
-    CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
-
     // initialize tangent
     float tx, ty, tz;
     tx = 0.0f;
@@ -367,12 +1276,13 @@ int CalPhysique::calculateTangentSpaces(CalSubmesh *pSubmesh, int mapId, float *
 
     // blend together all vertex influences
     int influenceId;
-    int influenceCount=(int)vertex.vectorInfluence.size();
+    const CalCoreSubmesh::Influence *pInfluence = pCoreSubmesh->getInfluences(vertexId);
+    int influenceCount=pCoreSubmesh->getInfluenceCount(vertexId);
 
     for(influenceId = 0; influenceId < influenceCount; influenceId++)
     {
       // get the influence
-      CalCoreSubmesh::Influence& influence = vertex.vectorInfluence[influenceId];
+      const CalCoreSubmesh::Influence& influence = pInfluence[influenceId];
 
       // get the bone of the influence vertex
       CalBone *pBone;
@@ -442,44 +1352,28 @@ int CalPhysique::calculateNormals(CalSubmesh *pSubmesh, float *pNormalBuffer, in
   const std::vector<CalBone *>& vectorBone = m_pModel->getSkeleton()->getVectorBone();
 
   // get vertex vector of the submesh
-  std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pSubmesh->getCoreSubmesh()->getVectorVertex();
+  CalCoreSubmesh *pCoreSubmesh = pSubmesh->getCoreSubmesh();
+  const std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
 
   // get the number of vertices
   int vertexCount;
   vertexCount = pSubmesh->getVertexCount();
 
-  // get the sub morph target vector from the core sub mesh
-  std::vector<CalCoreSubMorphTarget*>& vectorSubMorphTarget =
-  pSubmesh->getCoreSubmesh()->getVectorCoreSubMorphTarget();
-
-
-
-  // get the number of morph targets
-  int morphTargetCount = pSubmesh->getMorphTargetWeightCount();
+  // blend the active morph targets
+  const float *pMorphedNormal = blendMorphTargets(pSubmesh, vertexCount, false, true) ? &m_vectorMorphedVertexNormal[0] : 0;
 
   // calculate normal for all submesh vertices
   int vertexId;
   for(vertexId = 0; vertexId < vertexCount; ++vertexId)
   {
     // get the vertex
-    CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
+    const CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
 
-    // blend the morph targets
+    // take the morphed normal if there is one
     CalVector normal=vertex.normal;
-
+    if(pMorphedNormal)
     {
-      int morphTargetId;
-      for(morphTargetId=0; morphTargetId < morphTargetCount;++morphTargetId)
-      {
-         CalCoreSubMorphTarget::BlendVertex const * blendVertex =
-            vectorSubMorphTarget[morphTargetId]->getBlendVertex(vertexId);
-         float currentWeight = pSubmesh->getMorphTargetWeight(morphTargetId);
-         if( blendVertex ) {
-            normal.x += currentWeight*blendVertex->normal.x;
-            normal.y += currentWeight*blendVertex->normal.y;
-            normal.z += currentWeight*blendVertex->normal.z;
-         }
-      }
+      normal.set(pMorphedNormal[3 * vertexId], pMorphedNormal[3 * vertexId + 1], pMorphedNormal[3 * vertexId + 2]);
     }
 
     // initialize normal
@@ -490,7 +1384,8 @@ int CalPhysique::calculateNormals(CalSubmesh *pSubmesh, float *pNormalBuffer, in
 
     // blend together all vertex influences
     int influenceId;
-	int influenceCount=(int)vertex.vectorInfluence.size();
+	const CalCoreSubmesh::Influence *pInfluence = pCoreSubmesh->getInfluences(vertexId);
+	int influenceCount=pCoreSubmesh->getInfluenceCount(vertexId);
     if(influenceCount == 0)
 	{
       nx = normal.x;
@@ -502,7 +1397,7 @@ int CalPhysique::calculateNormals(CalSubmesh *pSubmesh, float *pNormalBuffer, in
 		for(influenceId = 0; influenceId < influenceCount; ++influenceId)
 		{
 			// get the influence
-			CalCoreSubmesh::Influence& influence = vertex.vectorInfluence[influenceId];
+			const CalCoreSubmesh::Influence& influence = pInfluence[influenceId];
 
 			// get the bone of the influence vertex
 			CalBone *pBone;
@@ -574,7 +1469,8 @@ int CalPhysique::calculateVerticesAndNormals(CalSubmesh *pSubmesh, float *pVerte
  // CalBone ** vectorBonePtr = &vectorBone[0];
 
   // get vertex vector of the core submesh
-  CalCoreSubmesh::Vertex* vectorVertex = &pSubmesh->getCoreSubmesh()->getVectorVertex()[0];
+  CalCoreSubmesh *pCoreSubmesh = pSubmesh->getCoreSubmesh();
+  const CalCoreSubmesh::Vertex* vectorVertex = &pCoreSubmesh->getVectorVertex()[0];
 
   // get physical property vector of the core submesh
   std::vector<CalCoreSubmesh::PhysicalProperty>& vectorPhysicalProperty = pSubmesh->getCoreSubmesh()->getVectorPhysicalProperty();
@@ -594,7 +1490,7 @@ int CalPhysique::calculateVerticesAndNormals(CalSubmesh *pSubmesh, float *pVerte
   for(vertexId = 0; vertexId < vertexCount; ++vertexId)
   {
     // get the vertex
-    CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
+    const CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
 
     // Off unless normalizing set to on and either there are morph targets or multiple influences.
     bool mustNormalize = false;
@@ -618,7 +1514,8 @@ int CalPhysique::calculateVerticesAndNormals(CalSubmesh *pSubmesh, float *pVerte
 
     // blend together all vertex influences
     int influenceId;
-	int influenceCount=(int)vertex.vectorInfluence.size();
+	const CalCoreSubmesh::Influence *pInfluence = pCoreSubmesh->getInfluences(vertexId);
+	int influenceCount=pCoreSubmesh->getInfluenceCount(vertexId);
     if(influenceCount > 1)
 	{
       mustNormalize = true; // If multiple influences, normalize the normals!
@@ -627,7 +1524,7 @@ int CalPhysique::calculateVerticesAndNormals(CalSubmesh *pSubmesh, float *pVerte
     for(influenceId = 0; influenceId < influenceCount; ++influenceId)
     {
        // get the influence
-       CalCoreSubmesh::Influence& influence = vertex.vectorInfluence[influenceId];
+       const CalCoreSubmesh::Influence& influence = pInfluence[influenceId];
 
        // get the bone of the influence vertex
        CalBone *pBone;
@@ -726,7 +1623,8 @@ int CalPhysique::calculateVerticesNormalsAndTexCoords(CalSubmesh *pSubmesh, floa
   const std::vector<CalBone *>& vectorBone = m_pModel->getSkeleton()->getVectorBone();
 
   // get vertex vector of the core submesh
-  std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pSubmesh->getCoreSubmesh()->getVectorVertex();
+  CalCoreSubmesh *pCoreSubmesh = pSubmesh->getCoreSubmesh();
+  const std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
 
   // get the texture coordinate vector vector
   std::vector<std::vector<CalCoreSubmesh::TextureCoordinate> >& vectorvectorTextureCoordinate = pSubmesh->getCoreSubmesh()->getVectorVectorTextureCoordinate();
@@ -750,50 +1648,30 @@ int CalPhysique::calculateVerticesNormalsAndTexCoords(CalSubmesh *pSubmesh, floa
   int vertexCount;
   vertexCount = pSubmesh->getVertexCount();
 
-  // get the sub morph target vector from the core sub mesh
-  std::vector<CalCoreSubMorphTarget*>& vectorSubMorphTarget =
-  pSubmesh->getCoreSubmesh()->getVectorCoreSubMorphTarget();
-
-
-
-  // get the number of morph targets
-  int morphTargetCount = pSubmesh->getMorphTargetWeightCount();
-
   // Check for spring case
   bool	hasSpringsAndInternalData =
 	(pSubmesh->getCoreSubmesh()->getSpringCount() > 0) &&
 	pSubmesh->hasInternalData();
 
+  // blend the active morph targets
+  bool morphed = blendMorphTargets(pSubmesh, vertexCount, true, true);
+  const float *pMorphedPosition = morphed ? &m_vectorMorphedVertexPosition[0] : 0;
+  const float *pMorphedNormal = morphed ? &m_vectorMorphedVertexNormal[0] : 0;
+
   // calculate all submesh vertices
   int vertexId;
   for(vertexId = 0; vertexId < vertexCount; ++vertexId)
   {
     // get the vertex
-    CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
+    const CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
 
-    // blend the morph targets
+    // take the morphed position and normal if there are some
     CalVector position=vertex.position;
     CalVector normal=vertex.normal;
-
+    if(morphed)
     {
-
-      int morphTargetId;
-      for(morphTargetId=0; morphTargetId < morphTargetCount;++morphTargetId)
-      {
-         CalCoreSubMorphTarget::BlendVertex const * blendVertex =
-            vectorSubMorphTarget[morphTargetId]->getBlendVertex(vertexId);
-         float currentWeight = pSubmesh->getMorphTargetWeight(morphTargetId);
-         if( currentWeight != 0 ) {
-            if( blendVertex ) {
-               position.x += currentWeight*blendVertex->position.x;
-               position.y += currentWeight*blendVertex->position.y;
-               position.z += currentWeight*blendVertex->position.z;
-               normal.x += currentWeight*blendVertex->normal.x;
-               normal.y += currentWeight*blendVertex->normal.y;
-               normal.z += currentWeight*blendVertex->normal.z;
-            }
-         }
-      }
+      position.set(pMorphedPosition[3 * vertexId], pMorphedPosition[3 * vertexId + 1], pMorphedPosition[3 * vertexId + 2]);
+      normal.set(pMorphedNormal[3 * vertexId], pMorphedNormal[3 * vertexId + 1], pMorphedNormal[3 * vertexId + 2]);
     }
 
     // initialize vertex
@@ -810,7 +1688,8 @@ int CalPhysique::calculateVerticesNormalsAndTexCoords(CalSubmesh *pSubmesh, floa
 
     // blend together all vertex influences
     int influenceId;
-	int influenceCount=(int)vertex.vectorInfluence.size();
+	const CalCoreSubmesh::Influence *pInfluence = pCoreSubmesh->getInfluences(vertexId);
+	int influenceCount=pCoreSubmesh->getInfluenceCount(vertexId);
 	if(influenceCount == 0)
 	{
       x = position.x;
@@ -825,7 +1704,7 @@ int CalPhysique::calculateVerticesNormalsAndTexCoords(CalSubmesh *pSubmesh, floa
 		for(influenceId = 0; influenceId < influenceCount; ++influenceId)
 		{
 			// get the influence
-			CalCoreSubmesh::Influence& influence = vertex.vectorInfluence[influenceId];
+			const CalCoreSubmesh::Influence& influence = pInfluence[influenceId];
 
 			// get the bone of the influence vertex
 			CalBone *pBone;
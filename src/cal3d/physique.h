@@ -12,6 +12,7 @@
 #define CAL_PHYSIQUE_H
 
 #include "cal3d/global.h"
+#include "cal3d/submesh.h"
 
 namespace cal3d{
 	class CalModel;
@@ -32,6 +33,9 @@ namespace cal3d{
 		virtual int calculateVerticesAndNormals(CalSubmesh *pSubmesh, float *pVertexBuffer, int stride = 0) const;
 		virtual int calculateVerticesNormalsAndTexCoords(CalSubmesh *pSubmesh, float *pVertexBuffer, int NumTexCoords = 1) const;
 		void update();
+		bool updateSkinningKey(const CalSubmesh *pSubmesh, CalSubmesh::SkinningKey& key) const;
+		/** returns a counter that changes whenever a setting of the physique changes**/
+		unsigned int getSettingsVersion() const { return m_settingsVersion; }
 
 		/*****************************************************************************/
 		/** Sets the normalization flag to true or false.
@@ -41,10 +45,10 @@ namespace cal3d{
 		  * up to the user.
 		  *****************************************************************************/
 
-		void setNormalization(bool normalize) { m_Normalize = normalize; }
-		void setAxisFactorX(float factor) { m_axisFactorX = factor;         m_Normalize = true; }
-		void setAxisFactorY(float factor) { m_axisFactorY = factor;         m_Normalize = true; }
-		void setAxisFactorZ(float factor) { m_axisFactorZ = factor;         m_Normalize = true; }
+		void setNormalization(bool normalize) { m_Normalize = normalize;    ++m_settingsVersion; }
+		void setAxisFactorX(float factor) { m_axisFactorX = factor;         m_Normalize = true; ++m_settingsVersion; }
+		void setAxisFactorY(float factor) { m_axisFactorY = factor;         m_Normalize = true; ++m_settingsVersion; }
+		void setAxisFactorZ(float factor) { m_axisFactorZ = factor;         m_Normalize = true; ++m_settingsVersion; }
 
 	protected:
 		CalModel *m_pModel;
@@ -52,6 +56,30 @@ namespace cal3d{
 		float     m_axisFactorX;
 		float     m_axisFactorY;
 		float     m_axisFactorZ;
+		unsigned int m_settingsVersion;
+
+	protected:
+		bool blendMorphTargets(CalSubmesh *pSubmesh, int vertexCount, bool blendPositions, bool blendNormals) const;
+		bool blendMorphTargets(CalSubmesh *pSubmesh, const std::vector<int>& vectorMorphTargetId, float baseWeight,
+		                       int vertexCount, bool blendPositions, bool blendNormals) const;
+		bool calculateVerticesFromBasePose(CalSubmesh *pSubmesh, float *pVertexBuffer, int stride) const;
+		int calculateSkinnedVertices(CalSubmesh *pSubmesh, float *pVertexBuffer, int stride, bool applyMorphTargets) const;
+
+		// morphed vertex positions and normals, three floats per vertex, see
+		// blendMorphTargets
+		mutable std::vector<float> m_vectorMorphedVertexPosition;
+		mutable std::vector<float> m_vectorMorphedVertexNormal;
+
+	private:
+		// scratch buffers of the vectorized skinning path
+		mutable std::vector<float> m_vectorSkinningPalette;
+		mutable std::vector<float> m_vectorMorphedPosition;
+
+		// ids of the active morph targets of the submesh being skinned
+		mutable std::vector<int> m_vectorActiveMorphTargetId;
+
+		// vertex ranges moved by the active morph targets, see calculateVerticesFromBasePose
+		mutable std::vector<std::pair<int, int> > m_vectorMorphRange;
 	};
 }
 #endif
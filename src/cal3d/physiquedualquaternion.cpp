@@ -37,104 +37,6 @@
 
 
 using namespace cal3d;
-static void CalcMorphBlendedPosition( CalSubmesh *pSubmesh, int vertexID,
-                                      float baseWeight, std::vector<int>& morphIDs,
-                                      CalVector& outPosition )
-{
-  CalCoreSubmesh::Vertex& vertex =
-    pSubmesh->getCoreSubmesh()->getVectorVertex()[vertexID];
-
-  if (morphIDs.empty())
-  {
-    outPosition = vertex.position;
-  }
-  else
-  {
-    // get the sub morph target vector from the core sub mesh
-    std::vector<CalCoreSubMorphTarget*>& vectorSubMorphTarget =
-      pSubmesh->getCoreSubmesh()->getVectorCoreSubMorphTarget();
-
-    outPosition = baseWeight * vertex.position;
-
-    int morphTargetId;
-    for (int i = 0; i < morphIDs.size(); ++i)
-    {
-      morphTargetId = morphIDs[i];
-      float currentWeight = pSubmesh->getMorphTargetWeight(morphTargetId);
-      CalCoreSubMorphTarget::BlendVertex	blendVertex;
-      vectorSubMorphTarget[morphTargetId]->getBlendVertex(vertexID, blendVertex);
-      outPosition += currentWeight * blendVertex.position;
-    }
-  }
-}
-
-
-static void CalcMorphBlendedNormal( CalSubmesh *pSubmesh, int vertexID,
-                                    float baseWeight, std::vector<int>& morphIDs,
-                                    CalVector& outNormal )
-{
-  CalCoreSubmesh::Vertex& vertex =
-    pSubmesh->getCoreSubmesh()->getVectorVertex()[vertexID];
-
-  if (morphIDs.empty())
-  {
-    outNormal = vertex.normal;
-  }
-  else
-  {
-    // get the sub morph target vector from the core sub mesh
-    std::vector<CalCoreSubMorphTarget*>& vectorSubMorphTarget =
-      pSubmesh->getCoreSubmesh()->getVectorCoreSubMorphTarget();
-
-    outNormal = baseWeight * vertex.normal;
-
-    int morphTargetId;
-    for (int i = 0; i < morphIDs.size(); ++i)
-    {
-      morphTargetId = morphIDs[i];
-      float currentWeight = pSubmesh->getMorphTargetWeight(morphTargetId);
-      CalCoreSubMorphTarget::BlendVertex	blendVertex;
-      vectorSubMorphTarget[morphTargetId]->getBlendVertex(vertexID, blendVertex);
-      outNormal += currentWeight * blendVertex.normal;
-    }
-  }
-}
-
-static void CalcMorphBlendedPositionAndNormal( CalSubmesh *pSubmesh, int vertexID,
-                                               float baseWeight, std::vector<int>& morphIDs,
-                                               CalVector& outPosition,
-                                               CalVector& outNormal )
-{
-  CalCoreSubmesh::Vertex& vertex =
-    pSubmesh->getCoreSubmesh()->getVectorVertex()[vertexID];
-
-  if (morphIDs.empty())
-  {
-    outPosition = vertex.position;
-    outNormal = vertex.normal;
-  }
-  else
-  {
-    // get the sub morph target vector from the core sub mesh
-    std::vector<CalCoreSubMorphTarget*>& vectorSubMorphTarget =
-      pSubmesh->getCoreSubmesh()->getVectorCoreSubMorphTarget();
-
-    outPosition = baseWeight * vertex.position;
-    outNormal = baseWeight * vertex.normal;
-
-    int morphTargetId;
-    for (int i = 0; i < morphIDs.size(); ++i)
-    {
-      morphTargetId = morphIDs[i];
-      float currentWeight = pSubmesh->getMorphTargetWeight(morphTargetId);
-      CalCoreSubMorphTarget::BlendVertex	blendVertex;
-      vectorSubMorphTarget[morphTargetId]->getBlendVertex(vertexID, blendVertex);
-      outPosition += currentWeight * blendVertex.position;
-      outNormal += currentWeight * blendVertex.normal;
-    }
-  }
-}
-
 static void GetUsedMorphTargetIDs( CalSubmesh *pSubmesh, std::vector<int>& outMorphIDs )
 {
   int morphTargetCount = pSubmesh->getMorphTargetWeightCount();
@@ -168,13 +70,18 @@ inline static void StoreVectorInBuffer( const CalVector& inVec, float* outBuffer
   outBuffer[2] = inVec.z;
 }
 
+inline static void LoadVectorFromBuffer( const float* inBuffer, CalVector& outVec )
+{
+  outVec.set( inBuffer[0], inBuffer[1], inBuffer[2] );
+}
+
 static void CalcInfluencedPosition( const CalVector& morphedPosition,
-                                    const std::vector<CalCoreSubmesh::Influence>& vectorInfluence,
+                                    const CalCoreSubmesh::Influence* vectorInfluence,
+                                    int influenceCount,
                                     CalBone *const *vectorBone,
                                     CalVector& outPosition )
 {
   // blend together all vertex influences
-  size_t influenceCount = vectorInfluence.size();
   if (influenceCount == 0)
   {
     outPosition = morphedPosition;
@@ -193,7 +100,7 @@ static void CalcInfluencedPosition( const CalVector& morphedPosition,
     blended.dual = CalQuaternion( 0.0f, 0.0f, 0.0f, 0.0f );
     CalQuaternion	pivot;
 
-    for (size_t influenceId = 0; influenceId < influenceCount; ++influenceId)
+    for (int influenceId = 0; influenceId < influenceCount; ++influenceId)
     {
       // get the influence
       const CalCoreSubmesh::Influence& influence = vectorInfluence[influenceId];
@@ -231,12 +138,12 @@ static void CalcInfluencedPosition( const CalVector& morphedPosition,
 }
 
 static void CalcInfluencedNormal( const CalVector& morphedNormal,
-                                  const std::vector<CalCoreSubmesh::Influence>& vectorInfluence,
+                                  const CalCoreSubmesh::Influence* vectorInfluence,
+                                  int influenceCount,
                                   CalBone *const *vectorBone,
                                   CalVector& outNormal )
 {
   // blend together all vertex influences
-  size_t influenceCount = vectorInfluence.size();
   if (influenceCount == 0)
   {
     outNormal = morphedNormal;
@@ -254,7 +161,7 @@ static void CalcInfluencedNormal( const CalVector& morphedNormal,
     blended.dual = CalQuaternion( 0.0f, 0.0f, 0.0f, 0.0f );
     CalQuaternion	pivot;
 
-    for (size_t influenceId = 0; influenceId < influenceCount; ++influenceId)
+    for (int influenceId = 0; influenceId < influenceCount; ++influenceId)
     {
       // get the influence
       const CalCoreSubmesh::Influence& influence = vectorInfluence[influenceId];
@@ -308,7 +215,8 @@ int CalPhysiqueDualQuat::calculateVertices(CalSubmesh *pSubmesh, float *pVertexB
   CalBone *const *vectorBone = &m_pModel->getSkeleton()->getVectorBone()[0];
 
   // get vertex vector of the core submesh
-  const CalCoreSubmesh::Vertex* vectorVertex = &pSubmesh->getCoreSubmesh()->getVectorVertex()[0];
+  const CalCoreSubmesh *pCoreSubmesh = pSubmesh->getCoreSubmesh();
+  const CalCoreSubmesh::Vertex* vectorVertex = &pCoreSubmesh->getVectorVertex()[0];
 
   // get physical property vector of the core submesh
   std::vector<CalCoreSubmesh::PhysicalProperty>& vectorPhysicalProperty =
@@ -324,6 +232,13 @@ int CalPhysiqueDualQuat::calculateVertices(CalSubmesh *pSubmesh, float *pVertexB
   // calculate the base weight
   float baseWeight = CalcMorphBaseWeight( pSubmesh, morphIDs );
 
+  // blend the morph targets over the whole submesh
+  const float *pMorphedPosition = 0;
+  if (blendMorphTargets( pSubmesh, morphIDs, baseWeight, vertexCount, true, false ))
+  {
+    pMorphedPosition = &m_vectorMorphedVertexPosition[0];
+  }
+
   // Check for spring case
   bool hasSpringsAndInternalData =
     (pSubmesh->getCoreSubmesh()->getSpringCount() > 0) &&
@@ -336,14 +251,14 @@ int CalPhysiqueDualQuat::calculateVertices(CalSubmesh *pSubmesh, float *pVertexB
     // get the vertex
     const CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
 
-    // blend the morph targets
-    CalVector morphedPosition;
-    CalcMorphBlendedPosition( pSubmesh, vertexId, baseWeight, morphIDs,
-      morphedPosition );
+    // take the morphed position if there is one
+    CalVector morphedPosition = vertex.position;
+    if (pMorphedPosition) LoadVectorFromBuffer( pMorphedPosition + 3 * vertexId, morphedPosition );
 
     // blend influences by bones
     CalVector	influencedPosition;
-    CalcInfluencedPosition( morphedPosition, vertex.vectorInfluence,
+    CalcInfluencedPosition( morphedPosition, pCoreSubmesh->getInfluences(vertexId),
+      pCoreSubmesh->getInfluenceCount(vertexId),
       vectorBone, influencedPosition );
     influencedPosition.x *= m_axisFactorX;
     influencedPosition.y *= m_axisFactorY;
@@ -399,7 +314,8 @@ int CalPhysiqueDualQuat::calculateNormals(CalSubmesh *pSubmesh, float *pNormalBu
   CalBone *const *vectorBone = &m_pModel->getSkeleton()->getVectorBone()[0];
 
   // get vertex vector of the submesh
-  const CalCoreSubmesh::Vertex *vectorVertex = &pSubmesh->getCoreSubmesh()->getVectorVertex()[0];
+  const CalCoreSubmesh *pCoreSubmesh = pSubmesh->getCoreSubmesh();
+  const CalCoreSubmesh::Vertex *vectorVertex = &pCoreSubmesh->getVectorVertex()[0];
 
   // get the number of vertices
   const int vertexCount = pSubmesh->getVertexCount();
@@ -411,6 +327,13 @@ int CalPhysiqueDualQuat::calculateNormals(CalSubmesh *pSubmesh, float *pNormalBu
   // calculate the base weight
   float baseWeight = CalcMorphBaseWeight( pSubmesh, morphIDs );
 
+  // blend the morph targets over the whole submesh
+  const float *pMorphedNormal = 0;
+  if (blendMorphTargets( pSubmesh, morphIDs, baseWeight, vertexCount, false, true ))
+  {
+    pMorphedNormal = &m_vectorMorphedVertexNormal[0];
+  }
+
   // calculate normal for all submesh vertices
   int vertexId;
   for (vertexId = 0; vertexId < vertexCount; ++vertexId)
@@ -418,14 +341,14 @@ int CalPhysiqueDualQuat::calculateNormals(CalSubmesh *pSubmesh, float *pNormalBu
     // get the vertex
     const CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
 
-    // blend the morph targets
-    CalVector morphedNormal;
-    CalcMorphBlendedNormal( pSubmesh, vertexId, baseWeight, morphIDs,
-      morphedNormal );
+    // take the morphed normal if there is one
+    CalVector morphedNormal = vertex.normal;
+    if (pMorphedNormal) LoadVectorFromBuffer( pMorphedNormal + 3 * vertexId, morphedNormal );
 
     // blend together all vertex influences
     CalVector	influencedNormal;
-    CalcInfluencedNormal( morphedNormal, vertex.vectorInfluence,
+    CalcInfluencedNormal( morphedNormal, pCoreSubmesh->getInfluences(vertexId),
+      pCoreSubmesh->getInfluenceCount(vertexId),
       vectorBone, influencedNormal );
 
     // re-normalize normal if necessary
@@ -471,7 +394,8 @@ int CalPhysiqueDualQuat::calculateVerticesAndNormals(CalSubmesh *pSubmesh, float
   CalBone *const *vectorBone = &m_pModel->getSkeleton()->getVectorBone()[0];
 
   // get vertex vector of the core submesh
-  const CalCoreSubmesh::Vertex *vectorVertex = &pSubmesh->getCoreSubmesh()->getVectorVertex()[0];
+  const CalCoreSubmesh *pCoreSubmesh = pSubmesh->getCoreSubmesh();
+  const CalCoreSubmesh::Vertex *vectorVertex = &pCoreSubmesh->getVectorVertex()[0];
 
   // get physical property vector of the core submesh
   std::vector<CalCoreSubmesh::PhysicalProperty>& vectorPhysicalProperty = pSubmesh->getCoreSubmesh()->getVectorPhysicalProperty();
@@ -486,6 +410,15 @@ int CalPhysiqueDualQuat::calculateVerticesAndNormals(CalSubmesh *pSubmesh, float
   // calculate the base weight
   float baseWeight = CalcMorphBaseWeight( pSubmesh, morphIDs );
 
+  // blend the morph targets over the whole submesh
+  const float *pMorphedPosition = 0;
+  const float *pMorphedNormal = 0;
+  if (blendMorphTargets( pSubmesh, morphIDs, baseWeight, vertexCount, true, true ))
+  {
+    pMorphedPosition = &m_vectorMorphedVertexPosition[0];
+    pMorphedNormal = &m_vectorMorphedVertexNormal[0];
+  }
+
   // Check for spring case
   bool hasSpringsAndInternalData =
     (pSubmesh->getCoreSubmesh()->getSpringCount() > 0) &&
@@ -493,28 +426,32 @@ int CalPhysiqueDualQuat::calculateVerticesAndNormals(CalSubmesh *pSubmesh, float
 
   // calculate all submesh vertices
   int vertexId;
-  CalCoreSubMorphTarget::BlendVertex	blendVertex;
   for(vertexId = 0; vertexId < vertexCount; ++vertexId)
   {
     // get the vertex
     const CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
 
-    // blend the morph targets
-    CalVector morphedPosition;
-    CalVector morphedNormal;
-    CalcMorphBlendedPositionAndNormal( pSubmesh, vertexId, baseWeight, morphIDs,
-      morphedPosition, morphedNormal );
+    // take the morphed position and normal if there are some
+    CalVector morphedPosition = vertex.position;
+    CalVector morphedNormal = vertex.normal;
+    if (pMorphedPosition)
+    {
+      LoadVectorFromBuffer( pMorphedPosition + 3 * vertexId, morphedPosition );
+      LoadVectorFromBuffer( pMorphedNormal + 3 * vertexId, morphedNormal );
+    }
 
     // blend influences by bones
     CalVector	influencedPosition;
-    CalcInfluencedPosition( morphedPosition, vertex.vectorInfluence,
+    CalcInfluencedPosition( morphedPosition, pCoreSubmesh->getInfluences(vertexId),
+      pCoreSubmesh->getInfluenceCount(vertexId),
       vectorBone, influencedPosition );
     influencedPosition.x *= m_axisFactorX;
     influencedPosition.y *= m_axisFactorY;
     influencedPosition.z *= m_axisFactorZ;
 
     CalVector	influencedNormal;
-    CalcInfluencedNormal( morphedNormal, vertex.vectorInfluence,
+    CalcInfluencedNormal( morphedNormal, pCoreSubmesh->getInfluences(vertexId),
+      pCoreSubmesh->getInfluenceCount(vertexId),
       vectorBone, influencedNormal );
 
     // re-normalize normal if necessary
@@ -582,7 +519,8 @@ int CalPhysiqueDualQuat::calculateVerticesNormalsAndTexCoords(CalSubmesh *pSubme
   CalBone *const *vectorBone = &m_pModel->getSkeleton()->getVectorBone()[0];
 
   // get vertex vector of the core submesh
-  const CalCoreSubmesh::Vertex *vectorVertex = &pSubmesh->getCoreSubmesh()->getVectorVertex()[0];
+  const CalCoreSubmesh *pCoreSubmesh = pSubmesh->getCoreSubmesh();
+  const CalCoreSubmesh::Vertex *vectorVertex = &pCoreSubmesh->getVectorVertex()[0];
 
   // get the texture coordinate vector vector
   std::vector<std::vector<CalCoreSubmesh::TextureCoordinate> >& vectorvectorTextureCoordinate = pSubmesh->getCoreSubmesh()->getVectorVectorTextureCoordinate();
@@ -612,6 +550,15 @@ int CalPhysiqueDualQuat::calculateVerticesNormalsAndTexCoords(CalSubmesh *pSubme
   // calculate the base weight
   float baseWeight = CalcMorphBaseWeight( pSubmesh, morphIDs );
 
+  // blend the morph targets over the whole submesh
+  const float *pMorphedPosition = 0;
+  const float *pMorphedNormal = 0;
+  if (blendMorphTargets( pSubmesh, morphIDs, baseWeight, vertexCount, true, true ))
+  {
+    pMorphedPosition = &m_vectorMorphedVertexPosition[0];
+    pMorphedNormal = &m_vectorMorphedVertexNormal[0];
+  }
+
   // Check for spring case
   bool hasSpringsAndInternalData =
     (pSubmesh->getCoreSubmesh()->getSpringCount() > 0) &&
@@ -619,28 +566,32 @@ int CalPhysiqueDualQuat::calculateVerticesNormalsAndTexCoords(CalSubmesh *pSubme
 
   // calculate all submesh vertices
   int vertexId;
-  CalCoreSubMorphTarget::BlendVertex blendVertex;
   for(vertexId = 0; vertexId < vertexCount; ++vertexId)
   {
     // get the vertex
     const CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
 
-    // blend the morph targets
-    CalVector morphedPosition;
-    CalVector morphedNormal;
-    CalcMorphBlendedPositionAndNormal( pSubmesh, vertexId, baseWeight, morphIDs,
-      morphedPosition, morphedNormal );
+    // take the morphed position and normal if there are some
+    CalVector morphedPosition = vertex.position;
+    CalVector morphedNormal = vertex.normal;
+    if (pMorphedPosition)
+    {
+      LoadVectorFromBuffer( pMorphedPosition + 3 * vertexId, morphedPosition );
+      LoadVectorFromBuffer( pMorphedNormal + 3 * vertexId, morphedNormal );
+    }
 
     // blend influences by bones
     CalVector	influencedPosition;
-    CalcInfluencedPosition( morphedPosition, vertex.vectorInfluence,
+    CalcInfluencedPosition( morphedPosition, pCoreSubmesh->getInfluences(vertexId),
+      pCoreSubmesh->getInfluenceCount(vertexId),
       vectorBone, influencedPosition );
     influencedPosition.x *= m_axisFactorX;
     influencedPosition.y *= m_axisFactorY;
     influencedPosition.z *= m_axisFactorZ;
 
     CalVector	influencedNormal;
-    CalcInfluencedNormal( morphedNormal, vertex.vectorInfluence,
+    CalcInfluencedNormal( morphedNormal, pCoreSubmesh->getInfluences(vertexId),
+      pCoreSubmesh->getInfluenceCount(vertexId),
       vectorBone, influencedNormal );
 
     // re-normalize normal if necessary
@@ -20,6 +20,10 @@
 
 #include <string.h>
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
 
 using namespace cal3d;
  /*****************************************************************************/
@@ -478,4 +482,84 @@ bool CalPlatform::writeString(std::ostream& output, const std::string& strValue)
   return !output ? false : true;
 }
 
+ /*****************************************************************************/
+/** Detects the best instruction set supported by the processor.
+  *
+  * This function checks the processor (and, for AVX2, the operating system
+  * support for the wider registers) against the kernels compiled in.
+  *
+  * @return The best usable SIMD level.
+  *****************************************************************************/
+
+static CalSimdLevel detectSimdLevel()
+{
+  CalSimdLevel level = CAL_SIMD_SCALAR;
+
+#if defined(CAL3D_SIMD_SSE2)
+  level = CAL_SIMD_SSE2;
+
+#if defined(CAL3D_SIMD_AVX2)
+#if defined(__GNUC__)
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2"))
+  {
+    level = CAL_SIMD_AVX2;
+  }
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if(info[0] >= 7)
+  {
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+    if(osxsave && avx && avx2 && (_xgetbv(0) & 6) == 6)
+    {
+      level = CAL_SIMD_AVX2;
+    }
+  }
+#endif
+#endif
+
+#endif
+
+  return level;
+}
+
+static CalSimdLevel s_supportedSimdLevel = detectSimdLevel();
+static CalSimdLevel s_simdLevel = s_supportedSimdLevel;
+
+ /*****************************************************************************/
+/** Returns the SIMD level used by the vectorized kernels.
+  *
+  * This function returns the instruction set that the skinning and blending
+  * kernels dispatch to. It defaults to the best level supported by both the
+  * build and the processor.
+  *
+  * @return The current SIMD level.
+  *****************************************************************************/
+
+CalSimdLevel CalPlatform::getSimdLevel()
+{
+  return s_simdLevel;
+}
+
+ /*****************************************************************************/
+/** Overrides the SIMD level used by the vectorized kernels.
+  *
+  * This function restricts the vectorized kernels to a given instruction set,
+  * for example to compare them against the scalar code. Levels above what the
+  * build and the processor support are clamped. It is meant to be called at
+  * startup, before any model is updated.
+  *
+  * @param level The requested SIMD level.
+  *****************************************************************************/
+
+void CalPlatform::setSimdLevel(CalSimdLevel level)
+{
+  s_simdLevel = (level < s_supportedSimdLevel) ? level : s_supportedSimdLevel;
+}
+
 //****************************************************************************//
@@ -71,6 +71,50 @@ typedef int intptr_t;
 
 #endif
 
+//****************************************************************************//
+// SIMD setup                                                                 //
+//****************************************************************************//
+
+// CAL3D_SIMD_SSE2 and CAL3D_SIMD_AVX2 tell which vectorized kernels are
+// compiled in. Whether they are used is decided at runtime, see
+// CalPlatform::getSimdLevel. Define CAL3D_NO_SIMD to build the scalar
+// code paths only.
+
+#if !defined(CAL3D_NO_SIMD)
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CAL3D_SIMD_SSE2
+#endif
+
+#if defined(CAL3D_SIMD_SSE2) && \
+    ((defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))) || \
+     (defined(_MSC_VER) && _MSC_VER >= 1800))
+#define CAL3D_SIMD_AVX2
+#endif
+
+#endif
+
+// Functions holding AVX2 code must be marked with CAL3D_TARGET_AVX2 so that
+// gcc and clang emit them even when the rest of the library targets SSE2.
+#if defined(CAL3D_SIMD_AVX2) && defined(__GNUC__)
+#define CAL3D_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CAL3D_TARGET_AVX2
+#endif
+
+//****************************************************************************//
+// Threading setup                                                            //
+//****************************************************************************//
+
+// CAL3D_THREADS tells whether the library is built with std::thread support,
+// which CalModelBatch uses to update models in parallel. Without it the batch
+// updates run on the calling thread. Define CAL3D_NO_THREADS to turn it off.
+
+#if !defined(CAL3D_NO_THREADS) && \
+    (__cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1700))
+#define CAL3D_THREADS
+#endif
+
 //****************************************************************************//
 // Includes                                                                   //
 //****************************************************************************//
@@ -92,6 +136,14 @@ typedef int intptr_t;
 #include <map>
 
 namespace cal3d{
+	/// Instruction sets the vectorized kernels can be dispatched to.
+	enum CalSimdLevel
+	{
+		CAL_SIMD_SCALAR = 0,
+		CAL_SIMD_SSE2,
+		CAL_SIMD_AVX2
+	};
+
 	/*****************************************************************************/
 	/** The platform class.
 	  *****************************************************************************/
@@ -122,6 +174,9 @@ namespace cal3d{
 		static bool writeShort(std::ostream& output, short value);
 		static bool writeInteger(std::ostream& output, int value);
 		static bool writeString(std::ostream& output, const std::string& strValue);
+
+		static CalSimdLevel getSimdLevel();
+		static void setSimdLevel(CalSimdLevel level);
 	};
 }
 #endif
@@ -0,0 +1,332 @@
+//****************************************************************************//
+// posecache.cpp                                                              //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+//****************************************************************************//
+// Includes                                                                   //
+//****************************************************************************//
+
+#include "cal3d/posecache.h"
+#include "cal3d/coreanimation.h"
+#include "cal3d/coretrack.h"
+
+#include <string.h>
+
+#ifdef CAL3D_THREADS
+#include <mutex>
+#endif
+
+using namespace cal3d;
+
+#ifdef CAL3D_THREADS
+
+struct CalPoseCache::Lock
+{
+  std::mutex mutex;
+};
+
+#define CAL3D_POSECACHE_LOCK() std::lock_guard<std::mutex> lock(m_pLock->mutex)
+
+#else
+
+struct CalPoseCache::Lock
+{
+};
+
+#define CAL3D_POSECACHE_LOCK()
+
+#endif
+
+ /*****************************************************************************/
+/** Constructs the pose cache.
+  *
+  * This function is the default constructor of the pose cache.
+  *
+  * @param timeQuantum The time step in seconds the sample times are rounded
+  *                    to, see setTimeQuantum.
+  * @param maxPoseCount The maximum number of poses kept, see setMaxPoseCount.
+  *****************************************************************************/
+
+CalPoseCache::CalPoseCache(float timeQuantum, int maxPoseCount)
+  : m_timeQuantum(timeQuantum > 0.0f ? timeQuantum : 0.0f)
+  , m_maxPoseCount(maxPoseCount > 1 ? maxPoseCount : 1)
+  , m_numHits(0)
+  , m_numMisses(0)
+  , m_pLock(new Lock())
+{
+}
+
+ /*****************************************************************************/
+/** Destructs the pose cache.
+  *
+  * This function is the destructor of the pose cache.
+  *****************************************************************************/
+
+CalPoseCache::~CalPoseCache()
+{
+  delete m_pLock;
+}
+
+ /*****************************************************************************/
+/** Sets the time quantization.
+  *
+  * This function sets the time step the sample times are rounded to before
+  * they are looked up. Models playing the same animation at times closer than
+  * half a step share one sampled pose. A larger step gives more hits but
+  * coarser motion. The cache is cleared.
+  *
+  * @param timeQuantum The time step in seconds, or 0 to share only poses
+  *                    sampled at exactly the same time.
+  *****************************************************************************/
+
+void CalPoseCache::setTimeQuantum(float timeQuantum)
+{
+  CAL3D_POSECACHE_LOCK();
+
+  m_timeQuantum = timeQuantum > 0.0f ? timeQuantum : 0.0f;
+  m_listPose.clear();
+  m_mapPose.clear();
+}
+
+ /*****************************************************************************/
+/** Returns the time quantization.
+  *
+  * This function returns the time step the sample times are rounded to.
+  *
+  * @return The time step in seconds, 0 if the times are not rounded.
+  *****************************************************************************/
+
+float CalPoseCache::getTimeQuantum() const
+{
+  CAL3D_POSECACHE_LOCK();
+
+  return m_timeQuantum;
+}
+
+ /*****************************************************************************/
+/** Sets the maximum number of poses.
+  *
+  * This function sets how many poses the cache keeps. When it is full, the
+  * least recently used pose is dropped.
+  *
+  * @param maxPoseCount The maximum number of poses.
+  *****************************************************************************/
+
+void CalPoseCache::setMaxPoseCount(int maxPoseCount)
+{
+  CAL3D_POSECACHE_LOCK();
+
+  m_maxPoseCount = maxPoseCount > 1 ? maxPoseCount : 1;
+  trim();
+}
+
+ /*****************************************************************************/
+/** Returns the maximum number of poses.
+  *
+  * This function returns how many poses the cache keeps.
+  *
+  * @return The maximum number of poses.
+  *****************************************************************************/
+
+int CalPoseCache::getMaxPoseCount() const
+{
+  return m_maxPoseCount;
+}
+
+ /*****************************************************************************/
+/** Returns the number of poses.
+  *
+  * This function returns how many poses the cache currently holds.
+  *
+  * @return The number of poses.
+  *****************************************************************************/
+
+int CalPoseCache::getPoseCount() const
+{
+  CAL3D_POSECACHE_LOCK();
+
+  return (int)m_mapPose.size();
+}
+
+ /*****************************************************************************/
+/** Clears the pose cache.
+  *
+  * This function drops all poses. It must be called when a core animation
+  * used with the cache is changed or destroyed.
+  *****************************************************************************/
+
+void CalPoseCache::clear()
+{
+  CAL3D_POSECACHE_LOCK();
+
+  m_listPose.clear();
+  m_mapPose.clear();
+}
+
+ /*****************************************************************************/
+/** Samples the pose of a core animation through the cache.
+  *
+  * This function does the same as CalCoreAnimation::samplePose, but at the
+  * sample time rounded to the time quantization, and takes the pose from the
+  * cache if another model sampled it already. The cache may be shared by the
+  * models of several threads. The cache keeps whole poses, so a pose missing
+  * from the cache is sampled for all the bones, while a cached pose is only
+  * copied for the active bones.
+  *
+  * @param pCoreAnimation The core animation to sample.
+  * @param time The time in seconds at which the pose should be sampled.
+  * @param pTranslation A pointer to the translation array to fill.
+  * @param pRotation A pointer to the rotation array to fill.
+  * @param pKeyframeCursor A pointer to one keyframe cursor per track, in track
+  *                        order, used when the pose has to be sampled, or 0.
+  * @param pBoneActive A pointer to one flag per core bone telling which bones
+  *                    are needed, or 0 for all of them.
+  *****************************************************************************/
+
+void CalPoseCache::samplePose(CalCoreAnimation *pCoreAnimation, float time, CalVector *pTranslation, CalQuaternion *pRotation, int *pKeyframeCursor, const unsigned char *pBoneActive)
+{
+  const std::vector<CalCoreTrack *>& vectorCoreTrack = pCoreAnimation->getVectorCoreTrack();
+  const int trackCount = (int)vectorCoreTrack.size();
+
+  PoseKey key;
+  key.pCoreAnimation = pCoreAnimation;
+
+  float timeQuantum;
+  float sampleTime;
+  {
+    CAL3D_POSECACHE_LOCK();
+
+    timeQuantum = m_timeQuantum;
+    if(timeQuantum > 0.0f)
+    {
+      key.timeKey = (long long)floor(time / timeQuantum + 0.5f);
+      sampleTime = (float)key.timeKey * timeQuantum;
+    }
+    else
+    {
+      unsigned int timeBits;
+      memcpy(&timeBits, &time, sizeof(timeBits));
+      key.timeKey = timeBits;
+      sampleTime = time;
+    }
+
+    PoseMap::iterator iteratorPose = m_mapPose.find(key);
+    if(iteratorPose != m_mapPose.end())
+    {
+      ++m_numHits;
+
+      PoseList::iterator iteratorListPose = iteratorPose->second;
+      m_listPose.splice(m_listPose.begin(), m_listPose, iteratorListPose);
+
+      const Pose& pose = *iteratorListPose;
+      for(int trackId = 0; trackId < trackCount; ++trackId)
+      {
+        const int coreBoneId = vectorCoreTrack[trackId]->getCoreBoneId();
+        if(pBoneActive != 0 && !pBoneActive[coreBoneId]) continue;
+        pTranslation[coreBoneId] = pose.vectorTranslation[trackId];
+        pRotation[coreBoneId] = pose.vectorRotation[trackId];
+      }
+      return;
+    }
+
+    ++m_numMisses;
+  }
+
+  // sample the pose outside of the lock, then keep a copy of it
+  pCoreAnimation->samplePose(sampleTime, pTranslation, pRotation, pKeyframeCursor);
+
+  Pose pose;
+  pose.key = key;
+  pose.vectorTranslation.resize(trackCount);
+  pose.vectorRotation.resize(trackCount);
+  for(int trackId = 0; trackId < trackCount; ++trackId)
+  {
+    const int coreBoneId = vectorCoreTrack[trackId]->getCoreBoneId();
+    pose.vectorTranslation[trackId] = pTranslation[coreBoneId];
+    pose.vectorRotation[trackId] = pRotation[coreBoneId];
+  }
+
+  CAL3D_POSECACHE_LOCK();
+
+  // another thread may have sampled the same pose meanwhile, or changed the
+  // time quantization the key was made with
+  if(m_timeQuantum != timeQuantum || m_mapPose.find(key) != m_mapPose.end()) return;
+
+  m_listPose.push_front(pose);
+  m_mapPose[key] = m_listPose.begin();
+  trim();
+}
+
+ /*****************************************************************************/
+/** Returns the number of cache hits.
+  *
+  * This function returns how many poses were taken from the cache since the
+  * statistics were last reset.
+  *
+  * @return The number of hits.
+  *****************************************************************************/
+
+int CalPoseCache::getNumHits() const
+{
+  CAL3D_POSECACHE_LOCK();
+
+  return m_numHits;
+}
+
+ /*****************************************************************************/
+/** Returns the number of cache misses.
+  *
+  * This function returns how many poses had to be sampled since the statistics
+  * were last reset.
+  *
+  * @return The number of misses.
+  *****************************************************************************/
+
+int CalPoseCache::getNumMisses() const
+{
+  CAL3D_POSECACHE_LOCK();
+
+  return m_numMisses;
+}
+
+ /*****************************************************************************/
+/** Resets the statistics.
+  *
+  * This function resets the hit and miss counters.
+  *****************************************************************************/
+
+void CalPoseCache::resetStatistics()
+{
+  CAL3D_POSECACHE_LOCK();
+
+  m_numHits = 0;
+  m_numMisses = 0;
+}
+
+ /*****************************************************************************/
+/** Drops the least recently used poses.
+  *
+  * This function drops poses until the cache holds no more than the maximum
+  * number of poses. The lock must be held.
+  *****************************************************************************/
+
+void CalPoseCache::trim()
+{
+  while((int)m_mapPose.size() > m_maxPoseCount)
+  {
+    m_mapPose.erase(m_listPose.back().key);
+    m_listPose.pop_back();
+  }
+}
+
+//****************************************************************************//
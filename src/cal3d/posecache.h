@@ -0,0 +1,80 @@
+//****************************************************************************//
+// posecache.h                                                                //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+#ifndef CAL_POSECACHE_H
+#define CAL_POSECACHE_H
+
+
+#include "cal3d/global.h"
+#include "cal3d/vector.h"
+#include "cal3d/quaternion.h"
+
+namespace cal3d{
+	class CalCoreAnimation;
+
+
+	class CAL3D_API CalPoseCache : NonCopyable
+	{
+	public:
+		CalPoseCache(float timeQuantum = 1.0f / 60.0f, int maxPoseCount = 256);
+		~CalPoseCache();
+
+		void setTimeQuantum(float timeQuantum);
+		float getTimeQuantum() const;
+		void setMaxPoseCount(int maxPoseCount);
+		int getMaxPoseCount() const;
+		int getPoseCount() const;
+		void clear();
+
+		void samplePose(CalCoreAnimation *pCoreAnimation, float time, CalVector *pTranslation, CalQuaternion *pRotation, int *pKeyframeCursor = 0, const unsigned char *pBoneActive = 0);
+
+		int getNumHits() const;
+		int getNumMisses() const;
+		void resetStatistics();
+
+	private:
+		struct PoseKey
+		{
+			const CalCoreAnimation *pCoreAnimation;
+			long long timeKey;
+			bool operator<(const PoseKey& other) const
+			{
+				return pCoreAnimation < other.pCoreAnimation
+					|| (pCoreAnimation == other.pCoreAnimation && timeKey < other.timeKey);
+			}
+		};
+
+		// a sampled pose, one state per track of the core animation
+		struct Pose
+		{
+			PoseKey                    key;
+			std::vector<CalVector>     vectorTranslation;
+			std::vector<CalQuaternion> vectorRotation;
+		};
+
+		typedef std::list<Pose> PoseList;
+		typedef std::map<PoseKey, PoseList::iterator> PoseMap;
+
+		struct Lock;
+
+		void trim();
+
+		float    m_timeQuantum;
+		int      m_maxPoseCount;
+		PoseList m_listPose;     // most recently used first
+		PoseMap  m_mapPose;
+		int      m_numHits;
+		int      m_numMisses;
+		Lock    *m_pLock;
+	};
+}
+#endif
+
+//****************************************************************************//
@@ -40,6 +40,9 @@ using namespace cal3d;
 
 CalRenderer::CalRenderer(CalModel *pModel)
   : m_pSelectedSubmesh(0)
+  , m_vertexCacheOn(false)
+  , m_numVertexFetches(0)
+  , m_numCachedVertexFetches(0)
 {
   assert(pModel);
 
@@ -57,6 +60,9 @@ CalRenderer::CalRenderer(CalRenderer *pRenderer)
 {
   m_pModel = pRenderer->m_pModel ;
   m_pSelectedSubmesh = pRenderer->m_pSelectedSubmesh ;
+  m_vertexCacheOn = pRenderer->m_vertexCacheOn ;
+  m_numVertexFetches = 0 ;
+  m_numCachedVertexFetches = 0 ;
 }
 
  /*****************************************************************************/
@@ -405,7 +411,14 @@ int CalRenderer::getNormals(float *pNormalBuffer, int stride) const
     return normalCount;
   }
 
+  // reuse the normals computed by an earlier fetch if nothing changed since
+  if(m_vertexCacheOn)
+  {
+    return getCachedVertexData(CalSubmesh::VERTEX_CACHE_NORMALS, pNormalBuffer, stride);
+  }
+
   // submesh does not handle the vertex data internally, so let the physique calculate it now
+  ++m_numVertexFetches;
   return m_pModel->getPhysique()->calculateNormals(m_pSelectedSubmesh, pNormalBuffer, stride);
 }
 
@@ -628,7 +641,14 @@ int CalRenderer::getVertices(float *pVertexBuffer, int stride) const
     return vertexCount;
   }
 
+  // reuse the vertices computed by an earlier fetch if nothing changed since
+  if(m_vertexCacheOn)
+  {
+    return getCachedVertexData(CalSubmesh::VERTEX_CACHE_VERTICES, pVertexBuffer, stride);
+  }
+
   // submesh does not handle the vertex data internally, so let the physique calculate it now
+  ++m_numVertexFetches;
   return m_pModel->getPhysique()->calculateVertices(m_pSelectedSubmesh, pVertexBuffer, stride);
 }
 
@@ -651,13 +671,13 @@ int CalRenderer::getVertColors(float *pVertexBuffer)
   vertexCount = m_pSelectedSubmesh->getVertexCount();
 
   // get vertex vector of the core submesh
-  std::vector<CalCoreSubmesh::Vertex>& vectorVertex = m_pSelectedSubmesh->getCoreSubmesh()->getVectorVertex();
+  const std::vector<CalCoreSubmesh::Vertex>& vectorVertex = m_pSelectedSubmesh->getCoreSubmesh()->getVectorVertex();
 
   int vertexId;
   for(vertexId = 0; vertexId < vertexCount; ++vertexId)
   {
     // get the vertex
-    CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
+    const CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
     pVertexBuffer[0] = vertex.vertexColor.x;
     pVertexBuffer[1] = vertex.vertexColor.y;
     pVertexBuffer[2] = vertex.vertexColor.z;
@@ -679,13 +699,13 @@ int CalRenderer::getVertColorsAsStandardPixels( unsigned int *pVertexBuffer)
   vertexCount = m_pSelectedSubmesh->getVertexCount();
 
   // get vertex vector of the core submesh
-  std::vector<CalCoreSubmesh::Vertex>& vectorVertex = m_pSelectedSubmesh->getCoreSubmesh()->getVectorVertex();
+  const std::vector<CalCoreSubmesh::Vertex>& vectorVertex = m_pSelectedSubmesh->getCoreSubmesh()->getVectorVertex();
 
   int vertexId;
   for(vertexId = 0; vertexId < vertexCount; ++vertexId)
   {
     // get the vertex
-    CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
+    const CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
 #ifdef    CAL3D_LITTLE_ENDIAN
 
     // Win32 StandardPixels are ARGB8 with low byte first, which means BGRA byte order.
@@ -757,7 +777,14 @@ int CalRenderer::getVerticesAndNormals(float *pVertexBuffer, int stride) const
     return vertexCount;
   }
 
+  // reuse the vertices and normals computed by an earlier fetch if nothing changed since
+  if(m_vertexCacheOn)
+  {
+    return getCachedVertexData(CalSubmesh::VERTEX_CACHE_VERTICES_AND_NORMALS, pVertexBuffer, stride);
+  }
+
   // submesh does not handle the vertex data internally, so let the physique calculate it now
+  ++m_numVertexFetches;
   return m_pModel->getPhysique()->calculateVerticesAndNormals(m_pSelectedSubmesh, pVertexBuffer, stride);
 }
 
@@ -895,6 +922,111 @@ void CalRenderer::setNormalization(bool normalize)
 }
 
 
+ /*****************************************************************************/
+/** Turns the vertex cache on or off.
+  *
+  * This function turns on or off the caching of the vertices and normals the
+  * physique computes for getVertices, getNormals and getVerticesAndNormals.
+  * With the cache on, every submesh keeps a copy of the data it was last asked
+  * for, and a fetch only copies it to the buffer as long as the skeleton, the
+  * morph target weights, the LOD level and the physique settings did not
+  * change. Changes to the core model data are not detected; turn the cache off
+  * and on again to drop the cached data. Turning the cache off frees it.
+  *
+  * @param on True to turn the cache on, false to turn it off.
+  *****************************************************************************/
+
+void CalRenderer::setVertexCacheOn(bool on)
+{
+  m_vertexCacheOn = on;
+  if(on) return;
+
+  std::vector<CalMesh *>& vectorMesh = m_pModel->getVectorMesh();
+  for(size_t meshId = 0; meshId < vectorMesh.size(); ++meshId)
+  {
+    std::vector<CalSubmesh *>& vectorSubmesh = vectorMesh[meshId]->getVectorSubmesh();
+    for(size_t submeshId = 0; submeshId < vectorSubmesh.size(); ++submeshId)
+    {
+      vectorSubmesh[submeshId]->clearVertexCache();
+    }
+  }
+}
+
+ /*****************************************************************************/
+/** Fetches vertex data through the vertex cache.
+  *
+  * This function copies the vertex data of the given type of the selected
+  * submesh from its vertex cache to the buffer, letting the physique compute
+  * the data again first if it changed since it was cached.
+  *
+  * @param type The CalSubmesh::VertexCacheType of the data.
+  * @param pBuffer A pointer to the user-provided buffer the data is written to.
+  * @param stride The byte offset between two vertices in the buffer, 0 for
+  *               packed data.
+  *
+  * @return The number of vertices written to the buffer.
+  *****************************************************************************/
+
+int CalRenderer::getCachedVertexData(int type, float *pBuffer, int stride) const
+{
+  CalPhysique *pPhysique = m_pModel->getPhysique();
+  CalSubmesh::VertexCache& vertexCache = m_pSelectedSubmesh->getVertexCache((CalSubmesh::VertexCacheType)type);
+
+  int floatCount = (type == CalSubmesh::VERTEX_CACHE_VERTICES_AND_NORMALS) ? 6 : 3;
+  int vertexSize = floatCount * sizeof(float);
+
+  ++m_numVertexFetches;
+
+  if(pPhysique->updateSkinningKey(m_pSelectedSubmesh, vertexCache.key))
+  {
+    vertexCache.vectorData.resize(m_pSelectedSubmesh->getVertexCount() * floatCount + floatCount);
+    float *pData = &vertexCache.vectorData[0];
+
+    int vertexCount;
+    if(type == CalSubmesh::VERTEX_CACHE_VERTICES)
+    {
+      vertexCount = pPhysique->calculateVertices(m_pSelectedSubmesh, pData, vertexSize);
+    }
+    else if(type == CalSubmesh::VERTEX_CACHE_NORMALS)
+    {
+      vertexCount = pPhysique->calculateNormals(m_pSelectedSubmesh, pData, vertexSize);
+    }
+    else
+    {
+      vertexCount = pPhysique->calculateVerticesAndNormals(m_pSelectedSubmesh, pData, vertexSize);
+    }
+
+    if(vertexCount < 0)
+    {
+      vertexCache.key = CalSubmesh::SkinningKey();
+      return vertexCount;
+    }
+  }
+  else
+  {
+    ++m_numCachedVertexFetches;
+  }
+
+  int vertexCount = vertexCache.key.vertexCount;
+  const float *pData = &vertexCache.vectorData[0];
+
+  if(stride <= 0 || stride == vertexSize)
+  {
+    memcpy(pBuffer, pData, vertexCount * vertexSize);
+  }
+  else
+  {
+    char *pDestination = (char *)pBuffer;
+    for(int vertexId = 0; vertexId < vertexCount; ++vertexId)
+    {
+      memcpy(pDestination, pData + vertexId * floatCount, vertexSize);
+      pDestination += stride;
+    }
+  }
+
+  return vertexCount;
+}
+
 //****************************************************************************//
 
 
@@ -53,10 +53,24 @@ namespace cal3d{
 		void setNormalization(bool normalize);
 		bool textureCoordinatesForMapValid(int mapId);
 		bool hasNonWhiteVertexColors();
+		void setVertexCacheOn(bool on);
+		/** returns whether the vertex data computed by the physique is cached **/
+		bool getVertexCacheOn() const { return m_vertexCacheOn; }
+		/** returns the number of vertex data fetches computed by the physique or taken from the cache **/
+		int getNumVertexFetches() const { return m_numVertexFetches; }
+		/** returns the number of vertex data fetches taken from the cache **/
+		int getNumCachedVertexFetches() const { return m_numCachedVertexFetches; }
+		/** resets the vertex fetch counters **/
+		void resetVertexCacheStatistics() { m_numVertexFetches = 0; m_numCachedVertexFetches = 0; }
 
 	private:
+		int getCachedVertexData(int type, float *pBuffer, int stride) const;
+
 		CalModel   *m_pModel;
 		CalSubmesh *m_pSelectedSubmesh;
+		bool        m_vertexCacheOn;
+		mutable int m_numVertexFetches;
+		mutable int m_numCachedVertexFetches;
 	};
 }
 #endif
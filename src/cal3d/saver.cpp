@@ -777,7 +777,7 @@ bool CalSaver::saveCoreSubmesh(std::ofstream& file, const std::string& strFilena
 	}
 
 	// get the vertex, face, physical property and spring vector
-	std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
+	const std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
 	std::vector<CalCoreSubmesh::Face>& vectorFace = pCoreSubmesh->getVectorFace();
 	std::vector<CalCoreSubmesh::PhysicalProperty>& vectorPhysicalProperty = pCoreSubmesh->getVectorPhysicalProperty();
 	std::vector<CalCoreSubmesh::Spring>& vectorSpring = pCoreSubmesh->getVectorSpring();
@@ -809,7 +809,7 @@ bool CalSaver::saveCoreSubmesh(std::ofstream& file, const std::string& strFilena
 	int vertexId;
 	for (vertexId = 0; vertexId < (int)vectorVertex.size(); ++vertexId)
 	{
-		CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
+		const CalCoreSubmesh::Vertex& vertex = vectorVertex[vertexId];
 
 		// write the vertex data
 		CalPlatform::writeFloat(file, vertex.position.x);
@@ -841,7 +841,9 @@ bool CalSaver::saveCoreSubmesh(std::ofstream& file, const std::string& strFilena
 		}
 
 		// write the number of influences
-		if (!CalPlatform::writeInteger(file, vertex.vectorInfluence.size()))
+		const CalCoreSubmesh::Influence *pInfluence = pCoreSubmesh->getInfluences(vertexId);
+		int influenceCount = pCoreSubmesh->getInfluenceCount(vertexId);
+		if (!CalPlatform::writeInteger(file, influenceCount))
 		{
 			CalError::setLastError(CalError::FILE_WRITING_FAILED, __FILE__, __LINE__, strFilename);
 			return false;
@@ -849,9 +851,9 @@ bool CalSaver::saveCoreSubmesh(std::ofstream& file, const std::string& strFilena
 
 		// write all influences of this vertex
 		int influenceId;
-		for (influenceId = 0; influenceId < (int)vertex.vectorInfluence.size(); ++influenceId)
+		for (influenceId = 0; influenceId < influenceCount; ++influenceId)
 		{
-			CalCoreSubmesh::Influence& influence = vertex.vectorInfluence[influenceId];
+			const CalCoreSubmesh::Influence& influence = pInfluence[influenceId];
 
 			// write the influence data
 			CalPlatform::writeInteger(file, influence.boneId);
@@ -915,11 +917,11 @@ bool CalSaver::saveCoreSubmesh(std::ofstream& file, const std::string& strFilena
 
 		for (int blendId = 0; blendId < morphTarget->getBlendVertexCount(); ++blendId)
 		{
-			CalCoreSubMorphTarget::BlendVertex const * bv = morphTarget->getBlendVertex(blendId);
-			if (!bv) {
-				continue;
-			}
-			CalCoreSubmesh::Vertex& Vertex = vectorVertex[blendId];
+			// go through the copying accessor, which also reads compressed morph targets
+			CalCoreSubMorphTarget::BlendVertex blendVertex;
+			morphTarget->getBlendVertex(blendId, blendVertex);
+			CalCoreSubMorphTarget::BlendVertex const * bv = &blendVertex;
+			const CalCoreSubmesh::Vertex& Vertex = vectorVertex[blendId];
 			static double differenceTolerance = 0.01;
 			CalVector positionDiff = bv->position - Vertex.position;
 			CalVector normalDiff = bv->normal - Vertex.normal;
@@ -1070,7 +1072,12 @@ bool CalSaver::saveCoreTrack(std::ofstream& file, const std::string& strFilename
 			translationWritten = false;
 		}
 
-		if (!saveCoreKeyframe(file, strFilename, pCoreTrack->getCoreKeyframe(i), version,
+		CalCoreKeyframe coreKeyframe;
+		coreKeyframe.setTime(pCoreTrack->getKeyframeTime(i));
+		coreKeyframe.setTranslation(pCoreTrack->getKeyframeTranslation(i));
+		coreKeyframe.setRotation(pCoreTrack->getKeyframeRotation(i));
+
+		if (!saveCoreKeyframe(file, strFilename, &coreKeyframe, version,
 			translationWritten, highRangeRequired, useAnimationCompression))
 		{
 			return false;
@@ -1348,12 +1355,10 @@ bool CalSaver::saveXmlCoreAnimation(const std::string& strFilename, CalCoreAnima
 		// save all core keyframes
 		for (int i = 0; i < pCoreTrack->getCoreKeyframeCount(); ++i)
 		{
-			CalCoreKeyframe *pCoreKeyframe = pCoreTrack->getCoreKeyframe(i);
-
 			TiXmlElement keyframe("KEYFRAME");
 
 			str.str("");
-			str << pCoreKeyframe->getTime();
+			str << pCoreTrack->getKeyframeTime(i);
 			keyframe.SetAttribute("TIME", str.str());
 
 			if (pCoreTrack->getTranslationRequired())
@@ -1362,7 +1367,7 @@ bool CalSaver::saveXmlCoreAnimation(const std::string& strFilename, CalCoreAnima
 				if (translationIsDynamic || i == 0)
 				{
 					TiXmlElement translation("TRANSLATION");
-					const CalVector& translationVector = pCoreKeyframe->getTranslation();
+					const CalVector& translationVector = pCoreTrack->getKeyframeTranslation(i);
 
 					str.str("");
 					str << translationVector.x << " "
@@ -1377,7 +1382,7 @@ bool CalSaver::saveXmlCoreAnimation(const std::string& strFilename, CalCoreAnima
 			}
 
 			TiXmlElement rotation("ROTATION");
-			const CalQuaternion& rotationQuad = pCoreKeyframe->getRotation();
+			const CalQuaternion& rotationQuad = pCoreTrack->getKeyframeRotation(i);
 
 			str.str("");
 			str << rotationQuad.x << " "
@@ -1562,7 +1567,7 @@ bool CalSaver::saveXmlCoreMesh(const std::string& strFilename, CalCoreMesh *pCor
 
 
 		// get the vertex, face, physical property and spring vector
-		std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
+		const std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
 		std::vector<CalCoreSubmesh::Face>& vectorFace = pCoreSubmesh->getVectorFace();
 		std::vector<CalCoreSubmesh::PhysicalProperty>& vectorPhysicalProperty = pCoreSubmesh->getVectorPhysicalProperty();
 		std::vector<CalCoreSubmesh::Spring>& vectorSpring = pCoreSubmesh->getVectorSpring();
@@ -1575,11 +1580,13 @@ bool CalSaver::saveXmlCoreMesh(const std::string& strFilename, CalCoreMesh *pCor
 		int vertexId;
 		for (vertexId = 0; vertexId < (int)vectorVertex.size(); ++vertexId)
 		{
-			CalCoreSubmesh::Vertex& Vertex = vectorVertex[vertexId];
+			const CalCoreSubmesh::Vertex& Vertex = vectorVertex[vertexId];
 
 			TiXmlElement vertex("VERTEX");
 			vertex.SetAttribute("ID", vertexId);
-			vertex.SetAttribute("NUMINFLUENCES", Vertex.vectorInfluence.size());
+			const CalCoreSubmesh::Influence *pInfluence = pCoreSubmesh->getInfluences(vertexId);
+			int influenceCount = pCoreSubmesh->getInfluenceCount(vertexId);
+			vertex.SetAttribute("NUMINFLUENCES", influenceCount);
 
 			// write the vertex data
 
@@ -1657,9 +1664,9 @@ bool CalSaver::saveXmlCoreMesh(const std::string& strFilename, CalCoreMesh *pCor
 
 			// write all influences of this vertex
 			int influenceId;
-			for (influenceId = 0; influenceId < (int)Vertex.vectorInfluence.size(); ++influenceId)
+			for (influenceId = 0; influenceId < influenceCount; ++influenceId)
 			{
-				CalCoreSubmesh::Influence& Influence = Vertex.vectorInfluence[influenceId];
+				const CalCoreSubmesh::Influence& Influence = pInfluence[influenceId];
 
 				TiXmlElement influence("INFLUENCE");
 
@@ -1733,12 +1740,11 @@ bool CalSaver::saveXmlCoreMesh(const std::string& strFilename, CalCoreMesh *pCor
 			int morphVertCount = 0;
 			for (int blendId = 0; blendId < morphTarget->getBlendVertexCount(); ++blendId)
 			{
-				CalCoreSubMorphTarget::BlendVertex const * bv = morphTarget->getBlendVertex(blendId);
-				if (!bv)
-				{
-					continue;
-				}
-				CalCoreSubmesh::Vertex& Vertex = vectorVertex[blendId];
+				// go through the copying accessor, which also reads compressed morph targets
+				CalCoreSubMorphTarget::BlendVertex blendVertex;
+				morphTarget->getBlendVertex(blendId, blendVertex);
+				CalCoreSubMorphTarget::BlendVertex const * bv = &blendVertex;
+				const CalCoreSubmesh::Vertex& Vertex = vectorVertex[blendId];
 				static double differenceTolerance = 1.0;
 				CalVector positionDiff = bv->position - Vertex.position;
 				CalVector normalDiff = bv->normal - Vertex.normal;
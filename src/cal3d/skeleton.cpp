@@ -43,13 +43,16 @@ CalSkeleton::CalSkeleton(CalCoreSkeleton *pCoreSkeleton)
   // get the number of bones
   int boneCount = vectorCoreBone.size();
 
+  // allocate the state of all bones, the bone instances refer to it
+  m_boneState.resize(boneCount);
+
   // reserve space in the bone vector
   m_vectorBone.reserve(boneCount);
 
   // clone every core bone
   for(int boneId = 0; boneId < boneCount; ++boneId)
   {
-    CalBone *pBone = new CalBone(vectorCoreBone[boneId]);
+    CalBone *pBone = new CalBone(vectorCoreBone[boneId], &m_boneState, boneId);
 
     // set skeleton in the bone instance
     pBone->setSkeleton(this);
@@ -78,19 +81,52 @@ CalSkeleton::~CalSkeleton()
  /*****************************************************************************/
 /** Calculates the state of the skeleton instance.
   *
-  * This function calculates the state of the skeleton instance by recursively
-  * calculating the states of its bones.
+  * This function calculates the state of the skeleton instance by calculating
+  * the states of its bones in the bone order of the core skeleton, every parent
+  * before its children. While the bone order is out of date, see
+  * CalCoreSkeleton::invalidateBoneOrder, the bones are calculated recursively.
   *****************************************************************************/
 
 void CalSkeleton::calculateState()
 {
-  // calculate all bone states of the skeleton
-  const std::vector<int>& listRootCoreBoneId = m_pCoreSkeleton->getVectorRootCoreBoneId();
+  const std::vector<int>& vectorBoneOrder = m_pCoreSkeleton->getVectorBoneOrder();
+  const std::vector<int>& vectorParentId = m_pCoreSkeleton->getVectorParentId();
 
-  std::vector<int>::const_iterator iteratorRootBoneId;
-  for(iteratorRootBoneId = listRootCoreBoneId.begin(); iteratorRootBoneId != listRootCoreBoneId.end(); ++iteratorRootBoneId)
+  if(vectorParentId.size() == m_vectorBone.size())
+  {
+    // calculate the bones in a single pass, every parent before its children
+    const unsigned char *pBoneActive = getBoneLodMask();
+    const int orderCount = (int)vectorBoneOrder.size();
+    for(int orderId = 0; orderId < orderCount; ++orderId)
+    {
+      int boneId = vectorBoneOrder[orderId];
+      int parentId = vectorParentId[boneId];
+      if(parentId == -1)
+      {
+        m_vectorBone[boneId]->calculateBoneState(0);
+      }
+      else if(pBoneActive != 0 && !pBoneActive[boneId])
+      {
+        // bones left out by the bone LOD follow their parent
+        m_vectorBone[boneId]->calculateMaskedBoneState(m_vectorBone[parentId]);
+      }
+      else
+      {
+        m_vectorBone[boneId]->calculateBoneState(m_vectorBone[parentId]);
+      }
+    }
+  }
+  else
   {
-    m_vectorBone[*iteratorRootBoneId]->calculateState();
+    // the bone order of the core skeleton is out of date, calculate all bone
+    // states of the skeleton recursively
+    const std::vector<int>& listRootCoreBoneId = m_pCoreSkeleton->getVectorRootCoreBoneId();
+
+    std::vector<int>::const_iterator iteratorRootBoneId;
+    for(iteratorRootBoneId = listRootCoreBoneId.begin(); iteratorRootBoneId != listRootCoreBoneId.end(); ++iteratorRootBoneId)
+    {
+      m_vectorBone[*iteratorRootBoneId]->calculateState();
+    }
   }
   m_isBoundingBoxesComputed=false;
 }
@@ -130,6 +166,199 @@ void CalSkeleton::lockState()
   }
 }
 
+ /*****************************************************************************/
+/** Sets the pose of the skeleton instance.
+  *
+  * This function sets the relative translation and rotation of every bone,
+  * as CalBone::setTranslation and CalBone::setRotation do. Call
+  * calculateState afterwards to update the absolute states.
+  *
+  * @param pTranslation A pointer to one translation per bone.
+  * @param pRotation A pointer to one rotation per bone.
+  *****************************************************************************/
+
+void CalSkeleton::setPose(const CalVector *pTranslation, const CalQuaternion *pRotation)
+{
+  for(size_t boneId = 0; boneId < m_vectorBone.size(); ++boneId)
+  {
+    m_vectorBone[boneId]->setTranslation(pTranslation[boneId]);
+    m_vectorBone[boneId]->setRotation(pRotation[boneId]);
+  }
+}
+
+// writes the skinning matrix of one bone, see CalSkeleton::getSkinningPalette
+static inline void WriteSkinningMatrix(float *pEntry, const CalMatrix& m, const CalVector& t, CalSkinningPaletteLayout layout)
+{
+  if(layout == CAL_SKINNING_PALETTE_COLUMN_MAJOR_3X4)
+  {
+    pEntry[0] = m.dxdx; pEntry[1]  = m.dydx; pEntry[2]  = m.dzdx;
+    pEntry[3] = m.dxdy; pEntry[4]  = m.dydy; pEntry[5]  = m.dzdy;
+    pEntry[6] = m.dxdz; pEntry[7]  = m.dydz; pEntry[8]  = m.dzdz;
+    pEntry[9] = t.x;    pEntry[10] = t.y;    pEntry[11] = t.z;
+  }
+  else
+  {
+    pEntry[0] = m.dxdx; pEntry[1] = m.dxdy; pEntry[2]  = m.dxdz; pEntry[3]  = t.x;
+    pEntry[4] = m.dydx; pEntry[5] = m.dydy; pEntry[6]  = m.dydz; pEntry[7]  = t.y;
+    pEntry[8] = m.dzdx; pEntry[9] = m.dzdy; pEntry[10] = m.dzdz; pEntry[11] = t.z;
+  }
+}
+
+ /*****************************************************************************/
+/** Writes the skinning palette of all bones.
+  *
+  * This function writes the skinning matrix of every bone, in bone id order,
+  * to a contiguous array of 12 floats per bone, see the bone list version.
+  *
+  * @param pPalette A pointer to the array receiving the matrices, 12 floats
+  *                 per bone of the skeleton.
+  * @param layout The memory layout of the matrices.
+  *
+  * @return The number of matrices written.
+  *****************************************************************************/
+
+int CalSkeleton::getSkinningPalette(float *pPalette, CalSkinningPaletteLayout layout) const
+{
+  const int boneCount = m_boneState.getBoneCount();
+  const CalMatrix *pTransformMatrix = m_boneState.pTransformMatrix;
+  const CalVector *pTranslationBoneSpace = m_boneState.pTranslationBoneSpace;
+
+  for(int boneId = 0; boneId < boneCount; ++boneId)
+  {
+    WriteSkinningMatrix(pPalette + 12 * boneId, pTransformMatrix[boneId], pTranslationBoneSpace[boneId], layout);
+  }
+
+  return boneCount;
+}
+
+ /*****************************************************************************/
+/** Writes the skinning palette of a list of bones.
+  *
+  * This function writes the skinning matrix of every bone of the list to a
+  * contiguous array of 12 floats per bone, entry i holding the matrix of bone
+  * pBoneId[i]. A skinning matrix brings a vertex from model space in the core
+  * pose to model space in the current pose: its 3x3 part is the transform
+  * matrix of the bone and its last column the bone space translation, as used
+  * by CalPhysique. With CAL_SKINNING_PALETTE_ROW_MAJOR_3X4 the entry holds the
+  * three rows one after the other, with CAL_SKINNING_PALETTE_COLUMN_MAJOR_3X4
+  * the four columns one after the other.
+  *
+  * Passing the m_vectorBonesIndices of a CalHardwareModel::CalHardwareMesh
+  * gives the palette of that hardware mesh, see
+  * CalHardwareModel::getSkinningPalette.
+  *
+  * @param pPalette A pointer to the array receiving the matrices, 12 floats
+  *                 per bone of the list.
+  * @param pBoneId A pointer to the first bone id of the list.
+  * @param boneCount The number of bones in the list.
+  * @param layout The memory layout of the matrices.
+  *
+  * @return One of the following values:
+  *         \li the number of matrices written
+  *         \li \b -1 if a bone id is invalid
+  *****************************************************************************/
+
+int CalSkeleton::getSkinningPalette(float *pPalette, const int *pBoneId, int boneCount, CalSkinningPaletteLayout layout) const
+{
+  const int skeletonBoneCount = m_boneState.getBoneCount();
+  const CalMatrix *pTransformMatrix = m_boneState.pTransformMatrix;
+  const CalVector *pTranslationBoneSpace = m_boneState.pTranslationBoneSpace;
+
+  for(int entryId = 0; entryId < boneCount; ++entryId)
+  {
+    int boneId = pBoneId[entryId];
+    if((boneId < 0) || (boneId >= skeletonBoneCount))
+    {
+      CalError::setLastError(CalError::INVALID_HANDLE, __FILE__, __LINE__);
+      return -1;
+    }
+
+    WriteSkinningMatrix(pPalette + 12 * entryId, pTransformMatrix[boneId], pTranslationBoneSpace[boneId], layout);
+  }
+
+  return boneCount;
+}
+
+ /*****************************************************************************/
+/** Writes the skinning palette of a list of bones.
+  *
+  * This function writes the skinning matrices of the bones of a vector, see
+  * the pointer version.
+  *
+  * @param pPalette A pointer to the array receiving the matrices, 12 floats
+  *                 per bone of the list.
+  * @param vectorBoneId The ids of the bones.
+  * @param layout The memory layout of the matrices.
+  *
+  * @return One of the following values:
+  *         \li the number of matrices written
+  *         \li \b -1 if a bone id is invalid
+  *****************************************************************************/
+
+int CalSkeleton::getSkinningPalette(float *pPalette, const std::vector<int>& vectorBoneId, CalSkinningPaletteLayout layout) const
+{
+  if(vectorBoneId.empty()) return 0;
+
+  return getSkinningPalette(pPalette, &vectorBoneId[0], (int)vectorBoneId.size(), layout);
+}
+
+ /*****************************************************************************/
+/** Sets the bone LOD mask.
+  *
+  * This function sets which bones are evaluated, for example to leave out the
+  * fingers, the face and the twist bones of distant models. See the
+  * calculateBoneLodMask functions of CalCoreSkeleton for ways to build a mask.
+  *
+  * The bones left out keep their core state relative to their parent: the
+  * mixer does not sample or blend their tracks, bone adjustments on them are
+  * ignored, and calculateState gives them the bone space transformation of
+  * their parent, so the vertices they influence move with the parent. Root
+  * bones are always evaluated, whatever their entry in the mask.
+  *
+  * @param vectorBoneActive One entry per bone, false for the bones to leave
+  *                         out.
+  *
+  * @return One of the following values:
+  *         \li \b true if successful
+  *         \li \b false if the mask does not have one entry per bone
+  *****************************************************************************/
+
+bool CalSkeleton::setBoneLodMask(const std::vector<bool>& vectorBoneActive)
+{
+  if(vectorBoneActive.size() != m_vectorBone.size())
+  {
+    CalError::setLastError(CalError::INVALID_HANDLE, __FILE__, __LINE__);
+    return false;
+  }
+
+  // root bones have no parent to follow, so they are always evaluated
+  m_vectorBoneActive.resize(vectorBoneActive.size());
+  for(size_t boneId = 0; boneId < vectorBoneActive.size(); ++boneId)
+  {
+    bool isRoot = m_vectorBone[boneId]->getCoreBone()->getParentId() == -1;
+    m_vectorBoneActive[boneId] = (vectorBoneActive[boneId] || isRoot) ? 1 : 0;
+  }
+
+  // the state of the skeleton has to be calculated again
+  m_boneState.touch();
+  return true;
+}
+
+ /*****************************************************************************/
+/** Removes the bone LOD mask.
+  *
+  * This function removes the bone LOD mask, so that all bones are evaluated
+  * again.
+  *****************************************************************************/
+
+void CalSkeleton::clearBoneLodMask()
+{
+  if(m_vectorBoneActive.empty()) return;
+
+  m_vectorBoneActive.clear();
+  m_boneState.touch();
+}
+
 /*****************************************************************************/
 /** Calculates axis aligned bounding box of skeleton bones
   *
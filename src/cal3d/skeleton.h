@@ -13,11 +13,20 @@
 #define CAL_SKELETON_H
 
 #include "cal3d/global.h"
+#include "cal3d/bone.h"
 namespace cal3d{
 	class CalCoreSkeleton;
 	class CalCoreModel;
-	class CalBone;
 
+	/// Memory layouts of the 3x4 matrices written by CalSkeleton::getSkinningPalette.
+	enum CalSkinningPaletteLayout
+	{
+		CAL_SKINNING_PALETTE_ROW_MAJOR_3X4 = 0,
+		CAL_SKINNING_PALETTE_COLUMN_MAJOR_3X4
+	};
+
+	/** The skeleton of a model instance. It owns the per-frame state of all its
+	  * bones in one CalBoneStateArrays, which is why skeletons are not copyable. **/
 	class CAL3D_API CalSkeleton
 	{
 	public:
@@ -35,6 +44,11 @@ namespace cal3d{
 		/** Provides access to the bone vector.returns the bone vector of the skeleton instance.  **/
 		inline std::vector<CalBone *>& getVectorBone()			{ return m_vectorBone; }
 
+		/** Provides access to the state of all bones, stored in parallel arrays indexed by bone id.  **/
+		inline const CalBoneStateArrays& getBoneState() const		{ return m_boneState; }
+		/** Returns a counter that changes whenever the state of a bone changes.  **/
+		inline unsigned int getStateVersion() const			{ return m_boneState.getVersion(); }
+
 		/** Provides access to thecore skeleton.returns core skeleton (model) of the skeleton instance.  **/
 		inline const CalCoreSkeleton *getCoreSkeleton() const		{ return m_pCoreSkeleton; }
 		/** Provides access to thecore skeleton.returns core skeleton (model) of the skeleton instance.  **/
@@ -54,10 +68,26 @@ namespace cal3d{
 		void calculateState();
 		/** Clears the state of the skeleton instance by recursively clears the states of its bones	**/
 		void clearState();
+		/** Sets the relative state of all bones from arrays indexed by bone id **/
+		void setPose(const CalVector *pTranslation, const CalQuaternion *pRotation);
+		/** Sets the bone LOD mask, one entry per bone, false for the bones left out **/
+		bool setBoneLodMask(const std::vector<bool>& vectorBoneActive);
+		/** Removes the bone LOD mask, so that all bones are evaluated again **/
+		void clearBoneLodMask();
+		/** Returns one flag per bone, zero for the bones left out by the bone LOD, or 0 if there is no mask **/
+		inline const unsigned char *getBoneLodMask() const		{ return m_vectorBoneActive.empty() ? 0 : &m_vectorBoneActive[0]; }
+		/** Writes the skinning matrices of all bones to a contiguous array **/
+		int getSkinningPalette(float *pPalette, CalSkinningPaletteLayout layout = CAL_SKINNING_PALETTE_ROW_MAJOR_3X4) const;
+		/** Writes the skinning matrices of a list of bones to a contiguous array **/
+		int getSkinningPalette(float *pPalette, const int *pBoneId, int boneCount, CalSkinningPaletteLayout layout = CAL_SKINNING_PALETTE_ROW_MAJOR_3X4) const;
+		/** Writes the skinning matrices of a list of bones to a contiguous array **/
+		int getSkinningPalette(float *pPalette, const std::vector<int>& vectorBoneId, CalSkinningPaletteLayout layout = CAL_SKINNING_PALETTE_ROW_MAJOR_3X4) const;
 
 	private:
 		CalCoreSkeleton       *m_pCoreSkeleton;
+		CalBoneStateArrays     m_boneState;
 		std::vector<CalBone *> m_vectorBone;
+		std::vector<unsigned char> m_vectorBoneActive;
 		bool                   m_isBoundingBoxesComputed;
 	};
 }
@@ -79,7 +79,7 @@ CalSubmesh::CalSubmesh(CalCoreSubmesh *coreSubmesh)
         m_vectorPhysicalProperty.resize(m_pCoreSubmesh->getVertexCount());
 
         // get the vertex vector of the core submesh
-        std::vector<CalCoreSubmesh::Vertex>& vectorVertex = m_pCoreSubmesh->getVectorVertex();
+        const std::vector<CalCoreSubmesh::Vertex>& vectorVertex = m_pCoreSubmesh->getVectorVertex();
 
         // copy the data from the core submesh as default values
         int vertexId;
@@ -123,6 +123,26 @@ int CalSubmesh::getFaces(CalIndex *pFaceBuffer) const
     return m_faceCount;
 }
 
+/*****************************************************************************/
+/** Frees the cached vertex data.
+  *
+  * This function frees the vertex data cached by CalRenderer and the base
+  * pose cached by CalPhysique for the submesh instance, so that the next fetch
+  * computes them again.
+  *****************************************************************************/
+
+void CalSubmesh::clearVertexCache()
+{
+  for(int type = 0; type < VERTEX_CACHE_TYPE_COUNT; ++type)
+  {
+    m_vertexCache[type].key = SkinningKey();
+    std::vector<float>().swap(m_vertexCache[type].vectorData);
+  }
+
+  m_basePoseCache.key = SkinningKey();
+  std::vector<float>().swap(m_basePoseCache.vectorPosition);
+}
+
 /*****************************************************************************/
 /** Disable internal data (and thus springs system)
   *
@@ -214,7 +234,7 @@ void CalSubmesh::setLodLevel(float lodLevel)
     lodCount = (int)((1.0f - lodLevel) * lodCount);
 
     // get vertex vector of the core submesh
-    std::vector<CalCoreSubmesh::Vertex>& vectorVertex = m_pCoreSubmesh->getVectorVertex();
+    const std::vector<CalCoreSubmesh::Vertex>& vectorVertex = m_pCoreSubmesh->getVectorVertex();
     int coreVertexCount = vectorVertex.size();
     const CalCoreSubmesh::Vertex*	coreVertexPtr = &vectorVertex[0];
 
@@ -19,6 +19,7 @@
 
 namespace cal3d{
 	class CalCoreSubmesh;
+	class CalPhysique;
 
 
 	// Structure used to return an array of the morphs that have non-zero weights.
@@ -48,6 +49,41 @@ namespace cal3d{
 			CalIndex vertexId[3];
 		};
 
+		/// What the vertex data computed by a physique for the submesh depends on, see CalPhysique::updateSkinningKey.
+		struct SkinningKey
+		{
+			SkinningKey() : pPhysique(0), physiqueVersion(0), skeletonVersion(0), vertexCount(-1) { }
+
+			const CalPhysique  *pPhysique;
+			unsigned int        physiqueVersion;
+			unsigned int        skeletonVersion;
+			int                 vertexCount;
+			std::vector<float>  vectorMorphTargetWeight;
+		};
+
+		/// Kinds of vertex data cached by CalRenderer.
+		enum VertexCacheType
+		{
+			VERTEX_CACHE_VERTICES = 0,
+			VERTEX_CACHE_NORMALS,
+			VERTEX_CACHE_VERTICES_AND_NORMALS,
+			VERTEX_CACHE_TYPE_COUNT
+		};
+
+		/// Vertex data computed by the physique, with the key it was computed for.
+		struct VertexCache
+		{
+			SkinningKey         key;
+			std::vector<float>  vectorData;
+		};
+
+		/// Vertex positions skinned by CalPhysique without morph targets, with the key they were skinned for.
+		struct BasePoseCache
+		{
+			SkinningKey         key;
+			std::vector<float>  vectorPosition;
+		};
+
 	public:
 		CalSubmesh(CalCoreSubmesh *coreSubmesh);
 		~CalSubmesh() { }
@@ -120,6 +156,13 @@ namespace cal3d{
 		/** Disable internal data (and thus springs system)**/
 		void disableInternalData();
 
+		/**returns the vertex data of the given type cached by CalRenderer**/
+		inline VertexCache& getVertexCache(VertexCacheType type)	{ return m_vertexCache[type]; }
+		/**Frees the vertex data cached by CalRenderer and CalPhysique.**/
+		void clearVertexCache();
+		/**returns the skinned base pose cached by CalPhysique**/
+		inline BasePoseCache& getBasePoseCache()					{ return m_basePoseCache; }
+
 	private:
 		CalCoreSubmesh                         *m_pCoreSubmesh;
 		std::vector<float>                      m_vectorMorphTargetWeight;
@@ -136,6 +179,8 @@ namespace cal3d{
 		int                                     m_faceCount;
 		int                                     m_coreMaterialId;
 		bool                                    m_bInternalData;
+		VertexCache                             m_vertexCache[VERTEX_CACHE_TYPE_COUNT];
+		BasePoseCache                           m_basePoseCache;
 	};
 }
 #endif
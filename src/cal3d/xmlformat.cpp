@@ -744,7 +744,7 @@ CalCoreAnimationPtr CalLoader::loadXmlCoreAnimation(cal3d::TiXmlDocument &doc, C
     cal3d::TiXmlElement* keyframe= track->FirstChildElement();
 
     // load all core keyframes
-    CalCoreKeyframe * prevCoreKeyframe = NULL;
+    CalCoreKeyframe prevCoreKeyframe;
     int keyframeId;
     for(keyframeId = 0; keyframeId < keyframeCount; ++keyframeId)
     {
@@ -779,8 +779,8 @@ CalCoreAnimationPtr CalLoader::loadXmlCoreAnimation(cal3d::TiXmlDocument &doc, C
       // If translation is required but not dynamic, then I may elide the translation
       // values for all but the first frame, and for each frame's translation I will
       // copy the translation from the previous frame.
-      if( prevCoreKeyframe && !translationIsDynamic && translationRequired ) {
-        CalVector const & vec = prevCoreKeyframe->getTranslation();
+      if( keyframeId > 0 && !translationIsDynamic && translationRequired ) {
+        CalVector const & vec = prevCoreKeyframe.getTranslation();
         tx = vec.x;
         ty = vec.y;
         tz = vec.z;
@@ -870,7 +870,6 @@ CalCoreAnimationPtr CalLoader::loadXmlCoreAnimation(cal3d::TiXmlDocument &doc, C
       pCoreKeyframe->setTime(time);
       pCoreKeyframe->setTranslation(CalVector(tx, ty, tz));
       pCoreKeyframe->setRotation(CalQuaternion(rx, ry, rz, rw));
-      prevCoreKeyframe = pCoreKeyframe;
 
       if (loadingMode & LOADER_ROTATE_X_AXIS)
       {
@@ -889,6 +888,9 @@ CalCoreAnimationPtr CalLoader::loadXmlCoreAnimation(cal3d::TiXmlDocument &doc, C
         }
       }
 
+      // keep a copy, the track destroys the keyframe instance once it has copied it
+      prevCoreKeyframe = *pCoreKeyframe;
+
       // add the core keyframe to the core track instance
          pCoreTrack->addCoreKeyframe(pCoreKeyframe);
 
@@ -905,10 +907,20 @@ CalCoreAnimationPtr CalLoader::loadXmlCoreAnimation(cal3d::TiXmlDocument &doc, C
       // translationRequired flag; instead it will leave it, as above.
       pCoreTrack->compress( translationTolerance, rotationToleranceDegrees, skel );
     }
+    pCoreTrack->updateKeyframeRate();
     pCoreAnimation->addCoreTrack(pCoreTrack);
     track=track->NextSiblingElement();
   }
 
+  if(resampleRate > 0.0f)
+  {
+    resampleCoreAnimation(pCoreAnimation);
+  }
+  if(quantizationOn)
+  {
+    quantizeCoreAnimation(pCoreAnimation);
+  }
+
   // explicitly close the file
   doc.Clear();
 
@@ -1239,7 +1251,7 @@ CalCoreMeshPtr CalLoader::loadXmlCoreMesh(cal3d::TiXmlDocument & doc)
     cal3d::TiXmlElement *vertex = submesh->FirstChildElement();
 
     // load all vertices and their influences
-          std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
+          const std::vector<CalCoreSubmesh::Vertex>& vectorVertex = pCoreSubmesh->getVectorVertex();
 
     int vertexId;
     for(vertexId = 0; vertexId < vertexCount; ++vertexId)
@@ -1247,7 +1259,7 @@ CalCoreMeshPtr CalLoader::loadXmlCoreMesh(cal3d::TiXmlDocument & doc)
             if( !ValidateTag(vertex, "VERTEX", pCoreMesh, pCoreSubmesh) ) {
               return 0;
             }
-            CalCoreSubmesh::Vertex & Vertex = vectorVertex[vertexId];
+            CalCoreSubmesh::Vertex Vertex;
 
             cal3d::TiXmlElement *pos= vertex->FirstChildElement();
             if( !ValidateTag(pos, "POS", pCoreMesh, pCoreSubmesh) ) {
@@ -1454,7 +1466,7 @@ CalCoreMeshPtr CalLoader::loadXmlCoreMesh(cal3d::TiXmlDocument & doc)
       }
 
       // set vertex in the core submesh instance
-      // === pCoreSubmesh->setVertex(vertexId, Vertex);
+      pCoreSubmesh->setVertex(vertexId, Vertex);
 
       cal3d::TiXmlElement *physique = influence;
 
@@ -1578,7 +1590,7 @@ CalCoreMeshPtr CalLoader::loadXmlCoreMesh(cal3d::TiXmlDocument & doc)
                morphTarget->setBlendVertex(blendVertI, Vertex);
              } else {
 
-               CalCoreSubmesh::Vertex & origVertex = vectorVertex[blendVertI];
+               const CalCoreSubmesh::Vertex & origVertex = vectorVertex[blendVertI];
                // use the origVertex
                Vertex.position = origVertex.position;
                Vertex.normal = origVertex.normal;
@@ -1641,6 +1653,14 @@ CalCoreMeshPtr CalLoader::loadXmlCoreMesh(cal3d::TiXmlDocument & doc)
     }
     submesh=submesh->NextSiblingElement();
 
+    // flatten the influences and pack the vertex data for the vectorized skinning path
+    pCoreSubmesh->updateInfluenceStream();
+    pCoreSubmesh->updateSkinningLayout();
+    if (loadingMode & LOADER_RELEASE_VERTEX_INFLUENCES)
+    {
+      pCoreSubmesh->releaseVertexInfluences();
+    }
+
     // add the core submesh to the core mesh instance
       pCoreMesh->addCoreSubmesh(pCoreSubmesh);
 
@@ -37,6 +37,64 @@ int GetFileType(std::string strFilename)
 	return -1;
 }
 
+// Compresses the morph targets of a mesh and reports the memory they take
+// before and after, together with the largest error the compression makes.
+int ReportMorphCompression(const std::string& strFilename)
+{
+	CalLoader Loader;
+	CalCoreMeshPtr Mesh = Loader.loadCoreMesh(strFilename);
+	if(!Mesh)
+	{
+		cout << "Error during loading of "<< strFilename<< endl;
+		return 1;
+	}
+
+	unsigned int totalSizeBefore = 0, totalSizeAfter = 0;
+	float totalPositionError = 0.0f, totalNormalError = 0.0f;
+
+	cout << "submesh\tmorph\tblend vertices\tbytes before\tbytes after\tmax position error\tmax normal error\n";
+	for(int submeshId = 0; submeshId < (int)Mesh->getCoreSubmeshCount(); ++submeshId)
+	{
+		std::vector<CalCoreSubMorphTarget *>& vectorMorph = Mesh->getCoreSubmesh(submeshId)->getVectorCoreSubMorphTarget();
+		for(size_t morphId = 0; morphId < vectorMorph.size(); ++morphId)
+		{
+			CalCoreSubMorphTarget *pMorph = vectorMorph[morphId];
+			std::vector<CalCoreSubMorphTarget::BlendVertex> vectorOriginal = pMorph->getVectorBlendVertex();
+
+			unsigned int sizeBefore = pMorph->size();
+			if(!pMorph->compress())
+			{
+				cout << "Error compressing morph target "<< pMorph->getName()<< endl;
+				return 1;
+			}
+			unsigned int sizeAfter = pMorph->size();
+
+			float positionError = 0.0f, normalError = 0.0f;
+			for(size_t vertexId = 0; vertexId < vectorOriginal.size(); ++vertexId)
+			{
+				CalCoreSubMorphTarget::BlendVertex blendVertex;
+				pMorph->getBlendVertex((int)vertexId, blendVertex);
+				for(int axis = 0; axis < 3; ++axis)
+				{
+					positionError = std::max(positionError, (float)fabs(blendVertex.position[axis] - vectorOriginal[vertexId].position[axis]));
+					normalError = std::max(normalError, (float)fabs(blendVertex.normal[axis] - vectorOriginal[vertexId].normal[axis]));
+				}
+			}
+
+			cout << submeshId << "\t" << pMorph->getName() << "\t" << vectorOriginal.size() << "\t"
+				<< sizeBefore << "\t" << sizeAfter << "\t" << positionError << "\t" << normalError << "\n";
+
+			totalSizeBefore += sizeBefore;
+			totalSizeAfter += sizeAfter;
+			totalPositionError = std::max(totalPositionError, positionError);
+			totalNormalError = std::max(totalNormalError, normalError);
+		}
+	}
+	cout << "total\t\t\t" << totalSizeBefore << "\t" << totalSizeAfter << "\t" << totalPositionError << "\t" << totalNormalError << endl;
+
+	return 0;
+}
+
 
 int main(int argc, char* argv[])
 {
@@ -72,6 +130,10 @@ int main(int argc, char* argv[])
 			return 1;
 		}
 	}
+	else if(argc==3 && strcmp(argv[1], "--morph-report")==0)
+	{
+		return ReportMorphCompression(argv[2]);
+	}
 	else if(argc==3)
 	{
 		strFilename1 = argv[1];
@@ -88,6 +150,7 @@ int main(int argc, char* argv[])
 	{
 		cout << "Usage :\n";
 		cout << "Cal3DFormatConv [Source Dest]\n";
+		cout << "Cal3DFormatConv --morph-report Mesh\n";
 	}
 
 
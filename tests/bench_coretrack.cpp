@@ -0,0 +1,130 @@
+//****************************************************************************//
+// bench_coretrack.cpp                                                        //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Measures the keyframe lookup of CalCoreTrack::getState: a binary search per
+// sample, the keyframe cursor on forward playback and on random seeks, and
+// the direct index of evenly spaced tracks. Each track is sampled with float
+// keyframes and again once quantized, where the keyframes are decoded on
+// every sample, and the size of both is printed.
+//
+// usage: bench_coretrack [keyframe count] [samples per keyframe]
+
+#include "test.h"
+#include "cal3d/coretrack.h"
+
+#include <cstdlib>
+
+using namespace cal3d;
+
+namespace
+{
+	const float KeyframeInterval = 1.0f / 30.0f;
+
+	void buildTrack(CalCoreTrack& coreTrack, int keyframeCount, bool jittered)
+	{
+		std::srand(1);
+
+		coreTrack.reserve(keyframeCount);
+
+		int keyframeId;
+		for(keyframeId = 0; keyframeId < keyframeCount; ++keyframeId)
+		{
+			// jittered times are not on a grid, so the direct index is not used
+			float jitter = jittered ? (0.4f * std::rand() / RAND_MAX - 0.2f) * KeyframeInterval : 0.0f;
+			float time = (keyframeId + ((keyframeId > 0) ? jitter : 0.0f)) * KeyframeInterval;
+
+			CalQuaternion rotation(0.0f, 0.0f, std::sin(0.01f * keyframeId), std::cos(0.01f * keyframeId));
+			coreTrack.addCoreKeyframe(time, CalVector(0.1f * keyframeId, 0.0f, 1.0f), rotation);
+		}
+
+		coreTrack.updateKeyframeRate();
+	}
+
+	// returns nanoseconds per sample
+	double sampleTrack(const CalCoreTrack& coreTrack, const std::vector<float>& vectorTime, bool useCursor, float& checksum)
+	{
+		CalVector translation;
+		CalQuaternion rotation;
+		int keyframeCursor = -1;
+
+		double startTime = CalTest::seconds();
+		for(size_t sampleId = 0; sampleId < vectorTime.size(); ++sampleId)
+		{
+			if(!useCursor) keyframeCursor = -1;
+			coreTrack.getState(vectorTime[sampleId], translation, rotation, keyframeCursor);
+			checksum += translation.x + rotation.w;
+		}
+		return (CalTest::seconds() - startTime) * 1.0e9 / vectorTime.size();
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int keyframeCount = (argc > 1) ? std::atoi(argv[1]) : 4000;
+	int samplesPerKeyframe = (argc > 2) ? std::atoi(argv[2]) : 4;
+	if(keyframeCount < 2) keyframeCount = 2;
+	if(samplesPerKeyframe < 1) samplesPerKeyframe = 1;
+
+	const float duration = (keyframeCount - 1) * KeyframeInterval;
+	const int sampleCount = (keyframeCount - 1) * samplesPerKeyframe;
+
+	// forward playback, and the same times shuffled for random seeks
+	std::vector<float> vectorForward(sampleCount);
+	int sampleId;
+	for(sampleId = 0; sampleId < sampleCount; ++sampleId)
+	{
+		vectorForward[sampleId] = duration * sampleId / sampleCount;
+	}
+	std::vector<float> vectorRandom(vectorForward);
+	std::srand(2);
+	for(sampleId = sampleCount - 1; sampleId > 0; --sampleId)
+	{
+		std::swap(vectorRandom[sampleId], vectorRandom[std::rand() % (sampleId + 1)]);
+	}
+
+	std::printf("%d keyframes, %d samples per keyframe\n", keyframeCount, samplesPerKeyframe);
+	std::printf("track     lookup          ns/sample float  ns/sample quantized\n");
+
+	float checksum = 0.0f;
+	int jittered;
+	for(jittered = 1; jittered >= 0; --jittered)
+	{
+		CalCoreTrack coreTrack;
+		buildTrack(coreTrack, keyframeCount, jittered != 0);
+		CalCoreTrack quantizedTrack(coreTrack);
+		quantizedTrack.quantize();
+		const char *strTrack = jittered ? "jittered" : "even    ";
+
+		// warm up
+		sampleTrack(coreTrack, vectorForward, true, checksum);
+		sampleTrack(quantizedTrack, vectorForward, true, checksum);
+
+		double floatTime = sampleTrack(coreTrack, vectorForward, false, checksum);
+		double quantizedTime = sampleTrack(quantizedTrack, vectorForward, false, checksum);
+		std::printf("%s  binary search   %15.1f  %19.1f\n", strTrack, floatTime, quantizedTime);
+		floatTime = sampleTrack(coreTrack, vectorForward, true, checksum);
+		quantizedTime = sampleTrack(quantizedTrack, vectorForward, true, checksum);
+		std::printf("%s  cursor forward  %15.1f  %19.1f\n", strTrack, floatTime, quantizedTime);
+		floatTime = sampleTrack(coreTrack, vectorRandom, true, checksum);
+		quantizedTime = sampleTrack(quantizedTrack, vectorRandom, true, checksum);
+		std::printf("%s  cursor random   %15.1f  %19.1f\n", strTrack, floatTime, quantizedTime);
+
+		if(!jittered)
+		{
+			std::printf("size: %u bytes float, %u bytes quantized\n", coreTrack.size(), quantizedTrack.size());
+		}
+	}
+
+	std::printf("checksum %g\n", checksum);
+
+	return 0;
+}
+
+//****************************************************************************//
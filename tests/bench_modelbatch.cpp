@@ -0,0 +1,86 @@
+//****************************************************************************//
+// bench_modelbatch.cpp                                                       //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Measures how CalModelBatch::update scales with the number of threads.
+//
+// usage: bench_modelbatch [model count] [frame count] [max thread count]
+
+#include "test.h"
+
+#include <cstdlib>
+
+using namespace cal3d;
+
+int main(int argc, char *argv[])
+{
+	int modelCount = (argc > 1) ? std::atoi(argv[1]) : 256;
+	int frameCount = (argc > 2) ? std::atoi(argv[2]) : 200;
+	if(modelCount < 1) modelCount = 1;
+	if(frameCount < 1) frameCount = 1;
+
+	CalCoreModel coreModel("cally");
+	if(!CalTest::loadCally(coreModel)) return 1;
+
+	std::vector<CalModel *> vectorModel;
+	int modelId;
+	for(modelId = 0; modelId < modelCount; ++modelId)
+	{
+		CalModel *pModel = new CalModel(&coreModel);
+		CalTest::attachAllMeshes(*pModel);
+		pModel->getMixer()->blendCycle(CalTest::CALLY_WALK + modelId % 2, 1.0f, 0.0f);
+		pModel->getMixer()->blendCycle(CalTest::CALLY_IDLE, 0.5f, 0.0f);
+		vectorModel.push_back(pModel);
+	}
+
+	// defaults to one thread per hardware thread
+	CalModelBatch hardwareBatch((argc > 3) ? std::atoi(argv[3]) : 0);
+	int maxThreadCount = hardwareBatch.getThreadCount();
+
+	std::printf("%d models, %d frames, up to %d threads\n", modelCount, frameCount, maxThreadCount);
+	std::printf("threads  ms/frame  speedup\n");
+
+	// 1, 2, 4, ... threads, and the hardware thread count
+	std::vector<int> vectorThreadCount;
+	int threadCount;
+	for(threadCount = 1; threadCount < maxThreadCount; threadCount *= 2)
+	{
+		vectorThreadCount.push_back(threadCount);
+	}
+	vectorThreadCount.push_back(maxThreadCount);
+
+	double serialTime = 0.0;
+	for(size_t id = 0; id < vectorThreadCount.size(); ++id)
+	{
+		CalModelBatch batch(vectorThreadCount[id]);
+
+		// warm up, this also starts the worker threads
+		batch.update(vectorModel, 0.01f);
+
+		double startTime = CalTest::seconds();
+		int frameId;
+		for(frameId = 0; frameId < frameCount; ++frameId)
+		{
+			batch.update(vectorModel, 0.016f);
+		}
+		double frameTime = (CalTest::seconds() - startTime) / frameCount;
+
+		if(id == 0) serialTime = frameTime;
+		std::printf("%7d  %8.3f  %7.2f\n", batch.getThreadCount(), frameTime * 1000.0, serialTime / frameTime);
+	}
+
+	for(modelId = 0; modelId < modelCount; ++modelId)
+	{
+		delete vectorModel[modelId];
+	}
+
+	return 0;
+}
+
+//****************************************************************************//
@@ -0,0 +1,86 @@
+//****************************************************************************//
+// bench_morph.cpp                                                            //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Measures CalPhysique::calculateVertices and calculateNormals on a face mesh
+// with many morph targets, with the morph targets off and on, at every SIMD
+// level the build and the processor support.
+//
+// usage: bench_morph [vertex count] [morph target count] [iteration count]
+
+#include "test.h"
+
+#include <cstdlib>
+
+using namespace cal3d;
+
+int main(int argc, char *argv[])
+{
+	int vertexCount = (argc > 1) ? std::atoi(argv[1]) : 8000;
+	int morphTargetCount = (argc > 2) ? std::atoi(argv[2]) : 50;
+	int iterationCount = (argc > 3) ? std::atoi(argv[3]) : 400;
+	if(vertexCount < 2) vertexCount = 2;
+	if(morphTargetCount < 0) morphTargetCount = 0;
+	if(iterationCount < 1) iterationCount = 1;
+
+	CalCoreModel coreModel("face");
+	const int meshId = CalTest::addFaceMesh(coreModel, vertexCount, morphTargetCount);
+
+	CalModel model(&coreModel);
+	model.attachMesh(meshId);
+	model.update(0.0f);
+	CalSubmesh *pSubmesh = model.getMesh(meshId)->getSubmesh(0);
+	std::vector<float> vectorBuffer(vertexCount * 6);
+
+	std::printf("%d vertices, %d morph targets, %d iterations\n", vertexCount, morphTargetCount, iterationCount);
+	std::printf("simd    morphs  vertices us  normals us\n");
+
+	static const char *levelName[] = { "scalar", "sse2", "avx2" };
+	static const CalSimdLevel level[] = { CAL_SIMD_SCALAR, CAL_SIMD_SSE2, CAL_SIMD_AVX2 };
+	const CalSimdLevel supportedLevel = CalPlatform::getSimdLevel();
+	for(int levelId = 0; levelId < 3 && level[levelId] <= supportedLevel; ++levelId)
+	{
+		CalPlatform::setSimdLevel(level[levelId]);
+
+		for(int active = 0; active < 2; ++active)
+		{
+			CalTest::setMorphTargetWeights(pSubmesh, active != 0);
+
+			// the best of a few runs
+			double vertexTime = HUGE_VAL;
+			double normalTime = HUGE_VAL;
+			for(int run = 0; run < 5; ++run)
+			{
+				double startTime = CalTest::seconds();
+				int iterationId;
+				for(iterationId = 0; iterationId < iterationCount; ++iterationId)
+				{
+					model.getPhysique()->calculateVertices(pSubmesh, &vectorBuffer[0]);
+				}
+				double time = (CalTest::seconds() - startTime) / iterationCount;
+				if(time < vertexTime) vertexTime = time;
+
+				startTime = CalTest::seconds();
+				for(iterationId = 0; iterationId < iterationCount; ++iterationId)
+				{
+					model.getPhysique()->calculateNormals(pSubmesh, &vectorBuffer[0]);
+				}
+				time = (CalTest::seconds() - startTime) / iterationCount;
+				if(time < normalTime) normalTime = time;
+			}
+
+			std::printf("%-6s  %-6s  %11.1f  %10.1f\n", levelName[levelId], active ? "on" : "off", vertexTime * 1e6, normalTime * 1e6);
+		}
+	}
+	CalPlatform::setSimdLevel(supportedLevel);
+
+	return 0;
+}
+
+//****************************************************************************//
@@ -0,0 +1,311 @@
+//****************************************************************************//
+// test.h                                                                     //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+#ifndef CAL_TEST_H
+#define CAL_TEST_H
+
+//****************************************************************************//
+// Includes                                                                   //
+//****************************************************************************//
+
+#include "cal3d/cal3d.h"
+
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#ifdef CAL3D_THREADS
+#include <chrono>
+#endif
+
+#ifndef CAL3D_TEST_DATA_DIR
+#define CAL3D_TEST_DATA_DIR "../data"
+#endif
+
+// exit code that tells the automake test driver a test was skipped
+#define CAL_TEST_SKIP 77
+
+// records a failure without stopping the test
+#define CAL_TEST_CHECK(condition) \
+	CalTest::check((condition), #condition, __FILE__, __LINE__)
+
+//****************************************************************************//
+// Helpers shared by the unit tests and the benchmarks                        //
+//****************************************************************************//
+
+namespace CalTest
+{
+	inline int& failureCount()
+	{
+		static int count = 0;
+		return count;
+	}
+
+	inline bool check(bool condition, const char *strCondition, const char *strFile, int line)
+	{
+		if(!condition)
+		{
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", strFile, line, strCondition);
+			++failureCount();
+		}
+		return condition;
+	}
+
+	// returns the exit code of the test program
+	inline int result()
+	{
+		if(failureCount() > 0)
+		{
+			std::fprintf(stderr, "%d check(s) failed\n", failureCount());
+			return 1;
+		}
+		return 0;
+	}
+
+	inline std::string dataPath(const std::string& strFilename)
+	{
+		return std::string(CAL3D_TEST_DATA_DIR) + "/" + strFilename;
+	}
+
+	// animations of the cally model, in the order loadCally assigns their ids
+	enum CallyAnimation
+	{
+		CALLY_IDLE = 0,
+		CALLY_WALK,
+		CALLY_JOG,
+		CALLY_WAVE,
+		CALLY_STRUT,
+		CALLY_SHOOT_ARROW,
+		CALLY_TORNADO_KICK,
+		CALLY_ANIMATION_COUNT
+	};
+
+	// loads the skeleton, the animations and the meshes of the cally model
+	inline bool loadCally(cal3d::CalCoreModel& coreModel)
+	{
+		static const char *animationFilename[CALLY_ANIMATION_COUNT] =
+		{
+			"cally_idle.caf", "cally_walk.caf", "cally_jog.caf", "cally_wave.caf",
+			"cally_strut.caf", "cally_shoot_arrow.caf", "cally_tornado_kick.caf"
+		};
+		static const char *meshFilename[] =
+		{
+			"cally_calf_left.cmf", "cally_calf_right.cmf", "cally_chest.cmf",
+			"cally_foot_left.cmf", "cally_foot_right.cmf", "cally_hand_left.cmf",
+			"cally_hand_right.cmf", "cally_head.cmf", "cally_lowerarm_left.cmf",
+			"cally_lowerarm_right.cmf", "cally_neck.cmf", "cally_pelvis.cmf",
+			"cally_ponytail.cmf", "cally_thigh_left.cmf", "cally_thigh_right.cmf",
+			"cally_upperarm_left.cmf", "cally_upperarm_right.cmf"
+		};
+
+		if(!coreModel.loadCoreSkeleton(dataPath("cally/cally.csf")))
+		{
+			cal3d::CalError::printLastError();
+			return false;
+		}
+
+		int animationId;
+		for(animationId = 0; animationId < CALLY_ANIMATION_COUNT; ++animationId)
+		{
+			if(coreModel.loadCoreAnimation(dataPath(std::string("cally/") + animationFilename[animationId])) != animationId)
+			{
+				cal3d::CalError::printLastError();
+				return false;
+			}
+		}
+
+		for(size_t meshId = 0; meshId < sizeof(meshFilename) / sizeof(meshFilename[0]); ++meshId)
+		{
+			if(coreModel.loadCoreMesh(dataPath(std::string("cally/") + meshFilename[meshId])) == -1)
+			{
+				cal3d::CalError::printLastError();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// attaches every core mesh of the core model to the model
+	inline void attachAllMeshes(cal3d::CalModel& model)
+	{
+		int meshId;
+		for(meshId = 0; meshId < model.getCoreModel()->getCoreMeshCount(); ++meshId)
+		{
+			model.attachMesh(meshId);
+		}
+	}
+
+	// adds morph targets that move every stride-th vertex of a submesh, so
+	// that the sparse morph paths have something to skip
+	inline void addMorphTargets(cal3d::CalCoreSubmesh *pCoreSubmesh, int morphTargetCount, int stride)
+	{
+		int vertexCount = pCoreSubmesh->getVertexCount();
+
+		int morphTargetId;
+		for(morphTargetId = 0; morphTargetId < morphTargetCount; ++morphTargetId)
+		{
+			cal3d::CalCoreSubMorphTarget *pMorphTarget = new cal3d::CalCoreSubMorphTarget();
+			pMorphTarget->reserve(vertexCount);
+
+			int vertexId;
+			for(vertexId = 0; vertexId < vertexCount; ++vertexId)
+			{
+				cal3d::CalCoreSubMorphTarget::BlendVertex blendVertex;
+				const cal3d::CalCoreSubmesh::Vertex& vertex = pCoreSubmesh->getVectorVertex()[vertexId];
+				blendVertex.position = vertex.position;
+				blendVertex.normal = vertex.normal;
+				if((vertexId + morphTargetId) % stride == 0)
+				{
+					blendVertex.position += cal3d::CalVector(0.5f + morphTargetId, 0.01f * (vertexId % 17), -0.25f);
+				}
+				pMorphTarget->setBlendVertex(vertexId, blendVertex);
+			}
+
+			pCoreSubmesh->addCoreSubMorphTarget(pMorphTarget);
+		}
+	}
+
+	// adds a single-submesh face mesh bound to the root bone, with morph
+	// targets like those of a face rig: the first ones move the whole face,
+	// the others a patch of it; creates a one-bone skeleton if there is none
+	// and returns the core mesh id
+	inline int addFaceMesh(cal3d::CalCoreModel& coreModel, int vertexCount, int morphTargetCount)
+	{
+		if(coreModel.getCoreSkeleton() == 0)
+		{
+			cal3d::CalCoreSkeleton *pCoreSkeleton = new cal3d::CalCoreSkeleton();
+			cal3d::CalCoreBone *pCoreBone = new cal3d::CalCoreBone("root");
+			pCoreBone->setCoreSkeleton(pCoreSkeleton);
+			pCoreBone->setTranslation(cal3d::CalVector(0.0f, 0.0f, 0.0f));
+			pCoreBone->setRotation(cal3d::CalQuaternion());
+			pCoreBone->setTranslationBoneSpace(cal3d::CalVector(0.0f, 0.0f, 0.0f));
+			pCoreBone->setRotationBoneSpace(cal3d::CalQuaternion());
+			pCoreSkeleton->addCoreBone(pCoreBone);
+			pCoreSkeleton->calculateState();
+			coreModel.setCoreSkeleton(pCoreSkeleton);
+		}
+
+		cal3d::CalCoreSubmesh *pCoreSubmesh = new cal3d::CalCoreSubmesh();
+		pCoreSubmesh->reserve(vertexCount, 0, 0, 0);
+
+		int vertexId;
+		for(vertexId = 0; vertexId < vertexCount; ++vertexId)
+		{
+			cal3d::CalCoreSubmesh::Vertex vertex;
+			vertex.position.set(0.01f * vertexId, 0.1f * (vertexId % 97), 0.2f * (vertexId % 13));
+			vertex.normal.set(0.0f, 0.0f, 1.0f);
+			vertex.collapseId = -1;
+			vertex.faceCollapseCount = 0;
+			cal3d::CalCoreSubmesh::Influence influence;
+			influence.boneId = 0;
+			influence.weight = 1.0f;
+			vertex.vectorInfluence.push_back(influence);
+			pCoreSubmesh->setVertex(vertexId, vertex);
+		}
+
+		const int wholeFaceCount = 8;
+		const int patchVertexCount = vertexCount / 12 + 1;
+		int morphTargetId;
+		for(morphTargetId = 0; morphTargetId < morphTargetCount; ++morphTargetId)
+		{
+			int firstVertexId = 0;
+			int movedVertexCount = vertexCount;
+			if(morphTargetId >= wholeFaceCount)
+			{
+				firstVertexId = (morphTargetId * 151) % (vertexCount - patchVertexCount);
+				movedVertexCount = patchVertexCount;
+			}
+
+			cal3d::CalCoreSubMorphTarget *pMorphTarget = new cal3d::CalCoreSubMorphTarget();
+			pMorphTarget->reserve(vertexCount);
+			for(vertexId = 0; vertexId < vertexCount; ++vertexId)
+			{
+				cal3d::CalCoreSubMorphTarget::BlendVertex blendVertex;
+				blendVertex.position.set(0.0f, 0.0f, 0.0f);
+				blendVertex.normal.set(0.0f, 0.0f, 0.0f);
+				if(vertexId >= firstVertexId && vertexId < firstVertexId + movedVertexCount)
+				{
+					blendVertex.position.set(0.01f * morphTargetId, 0.002f * vertexId, -0.1f);
+					blendVertex.normal.set(0.01f, 0.0f, -0.01f);
+				}
+				pMorphTarget->setBlendVertex(vertexId, blendVertex);
+			}
+			pCoreSubmesh->addCoreSubMorphTarget(pMorphTarget);
+		}
+
+		cal3d::CalCoreMesh *pCoreMesh = new cal3d::CalCoreMesh();
+		pCoreMesh->addCoreSubmesh(pCoreSubmesh);
+		return coreModel.addCoreMesh(pCoreMesh);
+	}
+
+	// sets the weights of the morph targets of a submesh, 0 for all of them
+	// if not active
+	inline void setMorphTargetWeights(cal3d::CalSubmesh *pSubmesh, bool active)
+	{
+		int morphTargetId;
+		for(morphTargetId = 0; morphTargetId < pSubmesh->getMorphTargetWeightCount(); ++morphTargetId)
+		{
+			pSubmesh->setMorphTargetWeight(morphTargetId, active ? 0.02f * (morphTargetId % 5 + 1) : 0.0f);
+		}
+	}
+
+	// skins every submesh of the model into one position array
+	inline void calculateModelVertices(cal3d::CalModel& model, std::vector<float>& vectorPosition)
+	{
+		vectorPosition.clear();
+
+		int meshId;
+		for(meshId = 0; meshId < model.getCoreModel()->getCoreMeshCount(); ++meshId)
+		{
+			cal3d::CalMesh *pMesh = model.getMesh(meshId);
+			if(pMesh == 0) continue;
+
+			int submeshId;
+			for(submeshId = 0; submeshId < pMesh->getSubmeshCount(); ++submeshId)
+			{
+				cal3d::CalSubmesh *pSubmesh = pMesh->getSubmesh(submeshId);
+				std::vector<float> vectorBuffer(pSubmesh->getVertexCount() * 3 + 3);
+				model.getPhysique()->calculateVertices(pSubmesh, &vectorBuffer[0]);
+				vectorPosition.insert(vectorPosition.end(), vectorBuffer.begin(), vectorBuffer.end() - 3);
+			}
+		}
+	}
+
+	// wall clock time in seconds, used by the benchmarks
+	inline double seconds()
+	{
+#ifdef CAL3D_THREADS
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+		return (double)std::clock() / CLOCKS_PER_SEC;
+#endif
+	}
+
+	// largest difference between two arrays, relative to the magnitude of b
+	inline double maxRelativeError(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		if(a.size() != b.size()) return HUGE_VAL;
+
+		double maxError = 0.0;
+		for(size_t id = 0; id < a.size(); ++id)
+		{
+			double error = std::fabs((double)a[id] - (double)b[id]) / (1.0 + std::fabs((double)b[id]));
+			if(error > maxError) maxError = error;
+		}
+		return maxError;
+	}
+}
+
+#endif
+
+//****************************************************************************//
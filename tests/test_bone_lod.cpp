@@ -0,0 +1,140 @@
+//****************************************************************************//
+// test_bone_lod.cpp                                                          //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Checks that the bone LOD mask builders and CalSkeleton::setBoneLodMask
+// always keep the root bones, and that the skeleton honors the mask the same
+// way whether it walks the bone order of the core skeleton or, while that
+// order is out of date, recurses through the child lists, and whether it takes
+// the animation poses from a pose cache or not.
+
+#include "test.h"
+
+using namespace cal3d;
+
+namespace
+{
+	bool rootBonesKept(const CalCoreSkeleton *pCoreSkeleton, const std::vector<bool>& vectorBoneActive)
+	{
+		const std::vector<int>& vectorRootCoreBoneId = pCoreSkeleton->getVectorRootCoreBoneId();
+		for(size_t rootId = 0; rootId < vectorRootCoreBoneId.size(); ++rootId)
+		{
+			if(!vectorBoneActive[vectorRootCoreBoneId[rootId]]) return false;
+		}
+		return !vectorRootCoreBoneId.empty();
+	}
+
+	void copySkeletonState(const CalSkeleton *pSkeleton, std::vector<CalVector>& vectorTranslation, std::vector<CalQuaternion>& vectorRotation)
+	{
+		const std::vector<CalBone *>& vectorBone = pSkeleton->getVectorBone();
+		vectorTranslation.clear();
+		vectorRotation.clear();
+		for(size_t boneId = 0; boneId < vectorBone.size(); ++boneId)
+		{
+			vectorTranslation.push_back(vectorBone[boneId]->getTranslationBoneSpace());
+			vectorRotation.push_back(vectorBone[boneId]->getRotationBoneSpace());
+		}
+	}
+}
+
+int main()
+{
+	CalCoreModel coreModel("cally");
+	if(!CalTest::loadCally(coreModel)) return 1;
+	CalCoreSkeleton *pCoreSkeleton = coreModel.getCoreSkeleton();
+	const int boneCount = (int)pCoreSkeleton->getVectorCoreBone().size();
+
+	// every builder keeps the root bones
+	std::vector<bool> vectorBoneActive;
+	pCoreSkeleton->calculateBoneLodMaskByDepth(-1, vectorBoneActive);
+	CAL_TEST_CHECK(rootBonesKept(pCoreSkeleton, vectorBoneActive));
+
+	std::vector<std::string> vectorBoneName(1, pCoreSkeleton->getCoreBone(pCoreSkeleton->getVectorRootCoreBoneId()[0])->getName());
+	pCoreSkeleton->calculateBoneLodMaskByName(vectorBoneName, vectorBoneActive);
+	CAL_TEST_CHECK(rootBonesKept(pCoreSkeleton, vectorBoneActive));
+
+	pCoreSkeleton->calculateBoneLodMaskByInfluence(std::vector<CalCoreMesh *>(), 0.5f, vectorBoneActive);
+	CAL_TEST_CHECK(rootBonesKept(pCoreSkeleton, vectorBoneActive));
+
+	// a subtree bone mask of a root bone covers the whole skeleton
+	std::vector<float> vectorBoneWeight;
+	pCoreSkeleton->calculateBoneMaskBySubtree(vectorBoneName, 0.5f, vectorBoneWeight);
+	CAL_TEST_CHECK(vectorBoneWeight == std::vector<float>(boneCount, 0.5f));
+
+	// the skeleton keeps the root bones of any mask
+	CalModel model(&coreModel);
+	CAL_TEST_CHECK(model.getSkeleton()->setBoneLodMask(std::vector<bool>(boneCount, false)));
+	CAL_TEST_CHECK(model.getSkeleton()->getBoneLodMask()[pCoreSkeleton->getVectorRootCoreBoneId()[0]] != 0);
+
+	// the same masked state with and without the bone order
+	vectorBoneName.clear();
+	vectorBoneName.push_back("Cally L Hand");
+	vectorBoneName.push_back("Cally Ponytail1");
+	pCoreSkeleton->calculateBoneLodMaskByName(vectorBoneName, vectorBoneActive);
+	CAL_TEST_CHECK(model.getSkeleton()->setBoneLodMask(vectorBoneActive));
+
+	model.getMixer()->blendCycle(CalTest::CALLY_WAVE, 1.0f, 0.0f);
+	model.update(0.3f);
+
+	std::vector<CalVector> vectorTranslation;
+	std::vector<CalQuaternion> vectorRotation;
+	copySkeletonState(model.getSkeleton(), vectorTranslation, vectorRotation);
+
+	pCoreSkeleton->invalidateBoneOrder();
+	model.getMixer()->invalidateSkeleton();
+	model.update(0.0f);
+
+	std::vector<CalVector> vectorRecursiveTranslation;
+	std::vector<CalQuaternion> vectorRecursiveRotation;
+	copySkeletonState(model.getSkeleton(), vectorRecursiveTranslation, vectorRecursiveRotation);
+	CAL_TEST_CHECK(vectorRecursiveTranslation == vectorTranslation);
+	CAL_TEST_CHECK(vectorRecursiveRotation == vectorRotation);
+
+	// bones left out follow their parent in both paths
+	const int handBoneId = pCoreSkeleton->getCoreBoneId("Cally L Hand");
+	const int forearmBoneId = pCoreSkeleton->getCoreBoneId("Cally L Forearm");
+	if(CAL_TEST_CHECK(handBoneId != -1 && forearmBoneId != -1))
+	{
+		CAL_TEST_CHECK(vectorRecursiveTranslation[handBoneId] == vectorRecursiveTranslation[forearmBoneId]);
+		CAL_TEST_CHECK(vectorRecursiveRotation[handBoneId] == vectorRecursiveRotation[forearmBoneId]);
+	}
+
+	// the pose cache honors the bone LOD and the bone masks, whether the pose
+	// is sampled or taken from the cache
+	std::vector<float> vectorSpineWeight;
+	pCoreSkeleton->calculateBoneMaskBySubtree(std::vector<std::string>(1, "Cally Spine"), 1.0f, vectorSpineWeight);
+	CAL_TEST_CHECK(model.getMixer()->setBoneMask(CalTest::CALLY_WAVE, vectorSpineWeight));
+	model.getMixer()->blendCycle(CalTest::CALLY_WALK, 1.0f, 0.0f);
+	model.update(0.2f);
+	copySkeletonState(model.getSkeleton(), vectorTranslation, vectorRotation);
+
+	CalPoseCache poseCache(0.0f);
+	for(int cacheModelId = 0; cacheModelId < 2; ++cacheModelId)
+	{
+		CalModel cacheModel(&coreModel);
+		CAL_TEST_CHECK(cacheModel.getSkeleton()->setBoneLodMask(vectorBoneActive));
+		cacheModel.getMixer()->setPoseCache(&poseCache);
+		CAL_TEST_CHECK(cacheModel.getMixer()->setBoneMask(CalTest::CALLY_WAVE, vectorSpineWeight));
+		cacheModel.getMixer()->blendCycle(CalTest::CALLY_WAVE, 1.0f, 0.0f);
+		cacheModel.update(0.3f);
+		cacheModel.getMixer()->blendCycle(CalTest::CALLY_WALK, 1.0f, 0.0f);
+		cacheModel.update(0.2f);
+
+		std::vector<CalVector> vectorCacheTranslation;
+		std::vector<CalQuaternion> vectorCacheRotation;
+		copySkeletonState(cacheModel.getSkeleton(), vectorCacheTranslation, vectorCacheRotation);
+		CAL_TEST_CHECK(vectorCacheTranslation == vectorTranslation);
+		CAL_TEST_CHECK(vectorCacheRotation == vectorRotation);
+	}
+	CAL_TEST_CHECK(poseCache.getNumHits() > 0);
+
+	return CalTest::result();
+}
+
+//****************************************************************************//
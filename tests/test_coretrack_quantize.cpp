@@ -0,0 +1,132 @@
+//****************************************************************************//
+// test_coretrack_quantize.cpp                                                //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Quantizes a track and checks that the decoded states stay within the
+// animation tolerances of the loader, that the track only keeps the keyframe
+// times and the packed keyframes, and that expanding it restores the floats.
+
+#include "test.h"
+#include "cal3d/coretrack.h"
+#include "cal3d/corekeyframe.h"
+#include "cal3d/loader.h"
+
+using namespace cal3d;
+
+namespace
+{
+	const float Rate = 30.0f;
+	const float Duration = 4.0f;
+
+	void buildTrack(CalCoreTrack& coreTrack)
+	{
+		int keyframeCount = (int)(Duration * Rate) + 1;
+		coreTrack.reserve(keyframeCount);
+
+		int keyframeId;
+		for(keyframeId = 0; keyframeId < keyframeCount; ++keyframeId)
+		{
+			float time = keyframeId / Rate;
+
+			// the z translation is constant, so its range is empty
+			CalVector translation(20.0f * std::sin(2.0f * time), 5.0f * std::cos(time), 1.0f);
+			CalVector axis(std::sin(time), std::cos(3.0f * time), 0.5f);
+			axis.normalize();
+			float angle = 2.0f * std::sin(0.7f * time);
+			CalQuaternion rotation(axis.x * std::sin(0.5f * angle), axis.y * std::sin(0.5f * angle), axis.z * std::sin(0.5f * angle), std::cos(0.5f * angle));
+			coreTrack.addCoreKeyframe(time, translation, rotation);
+		}
+
+		coreTrack.updateKeyframeRate();
+	}
+}
+
+int main()
+{
+	const float translationTolerance = (float)CalLoader::getAnimationTranslationTolerance();
+	const float rotationToleranceDegrees = (float)CalLoader::getAnimationRotationToleranceDegrees();
+
+	CalCoreTrack originalTrack;
+	buildTrack(originalTrack);
+	const int keyframeCount = originalTrack.getCoreKeyframeCount();
+
+	CalCoreTrack quantizedTrack(originalTrack);
+	const unsigned int originalSize = quantizedTrack.size();
+	quantizedTrack.quantize();
+	CAL_TEST_CHECK(quantizedTrack.isQuantized());
+	CAL_TEST_CHECK(quantizedTrack.getCoreKeyframeCount() == keyframeCount);
+
+	// a float time and six shorts per keyframe
+	const unsigned int quantizedSize = quantizedTrack.size();
+	CAL_TEST_CHECK(quantizedSize < originalSize);
+	CAL_TEST_CHECK(quantizedSize - sizeof(CalCoreTrack) == keyframeCount * (sizeof(float) + 6 * sizeof(unsigned short)));
+
+	// the decoded states are within the tolerances of the loader, which only
+	// keeps a quantized track if they are
+	float translationError, rotationErrorDegrees;
+	quantizedTrack.getStateError(originalTrack, Duration, translationError, rotationErrorDegrees);
+	if(!CAL_TEST_CHECK(translationError <= translationTolerance) || !CAL_TEST_CHECK(rotationErrorDegrees <= rotationToleranceDegrees))
+	{
+		std::fprintf(stderr, "error %g (tolerance %g), %g degrees (tolerance %g)\n",
+		             translationError, translationTolerance, rotationErrorDegrees, rotationToleranceDegrees);
+	}
+
+	// each translation is within half a step of the 16 bit grid over its range
+	CAL_TEST_CHECK(translationError <= 40.0f / 65535.0f);
+
+	// the empty range decodes exactly, and the keyframe times are not touched
+	int keyframeId;
+	for(keyframeId = 0; keyframeId < keyframeCount; ++keyframeId)
+	{
+		CAL_TEST_CHECK(quantizedTrack.getKeyframeTime(keyframeId) == originalTrack.getKeyframeTime(keyframeId));
+		CAL_TEST_CHECK(quantizedTrack.getKeyframeTranslation(keyframeId).z == 1.0f);
+	}
+
+	// the cursor and the direct index decode the same states
+	CalVector translation, cursorTranslation;
+	CalQuaternion rotation, cursorRotation;
+	int keyframeCursor = -1;
+	int sampleId;
+	for(sampleId = 0; sampleId <= 1000; ++sampleId)
+	{
+		float time = Duration * sampleId / 1000.0f;
+		quantizedTrack.getState(time, translation, rotation);
+		quantizedTrack.getState(time, cursorTranslation, cursorRotation, keyframeCursor);
+		CAL_TEST_CHECK(translation == cursorTranslation);
+		CAL_TEST_CHECK(rotation.x == cursorRotation.x && rotation.y == cursorRotation.y && rotation.z == cursorRotation.z && rotation.w == cursorRotation.w);
+	}
+
+	// a copy of the quantized track stays quantized, with the same states
+	CalCoreTrack copiedTrack(quantizedTrack);
+	CAL_TEST_CHECK(copiedTrack.isQuantized());
+	CAL_TEST_CHECK(copiedTrack.size() == quantizedSize);
+	copiedTrack.getStateError(quantizedTrack, Duration, translationError, rotationErrorDegrees);
+	CAL_TEST_CHECK(translationError == 0.0f);
+
+	// keyframe objects decode the keyframe they stand for; only the linked
+	// ones are kept by the track
+	const CalCoreTrack& constQuantizedTrack = quantizedTrack;
+	CalCoreKeyframe keyframe = constQuantizedTrack.getCoreKeyframe(5);
+	CAL_TEST_CHECK(keyframe.getTranslation() == quantizedTrack.getKeyframeTranslation(5));
+	CAL_TEST_CHECK(copiedTrack.getCoreKeyframe(5)->getTranslation() == quantizedTrack.getKeyframeTranslation(5));
+	CAL_TEST_CHECK(copiedTrack.size() > quantizedSize);
+
+	// expanding keeps the decoded states
+	CalCoreTrack expandedTrack(quantizedTrack);
+	expandedTrack.expand();
+	CAL_TEST_CHECK(!expandedTrack.isQuantized());
+	CAL_TEST_CHECK(expandedTrack.size() == originalSize);
+	expandedTrack.getStateError(quantizedTrack, Duration, translationError, rotationErrorDegrees);
+	CAL_TEST_CHECK(translationError < 1.0e-5f);
+	CAL_TEST_CHECK(rotationErrorDegrees < 1.0e-2f);
+
+	return CalTest::result();
+}
+
+//****************************************************************************//
@@ -0,0 +1,154 @@
+//****************************************************************************//
+// test_coretrack_resample.cpp                                                //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Resamples a smooth track with jittered keyframe times and checks the error
+// reported by CalCoreTrack::getStateError against the interpolation bound and
+// against a dense comparison of the two tracks.
+
+#include "test.h"
+#include "cal3d/coretrack.h"
+
+#include <cstdlib>
+
+using namespace cal3d;
+
+namespace
+{
+	const float Pi = 3.14159265f;
+	const float SourceRate = 30.0f;
+	const float Duration = 4.0f;
+
+	// the sampled curve: a sine translation and a sine rotation about z
+	void getCurve(float time, CalVector& translation, CalQuaternion& rotation)
+	{
+		translation.set(std::sin(2.0f * time), 0.5f * std::cos(time), 1.0f);
+		float angle = 0.5f * std::sin(time);
+		rotation = CalQuaternion(0.0f, 0.0f, std::sin(0.5f * angle), std::cos(0.5f * angle));
+	}
+
+	void buildJitteredTrack(CalCoreTrack& coreTrack)
+	{
+		std::srand(7);
+
+		int keyframeCount = (int)(Duration * SourceRate) + 1;
+		int keyframeId;
+		for(keyframeId = 0; keyframeId < keyframeCount; ++keyframeId)
+		{
+			float time = keyframeId / SourceRate;
+			if(keyframeId > 0 && keyframeId < keyframeCount - 1)
+			{
+				time += (0.6f * std::rand() / RAND_MAX - 0.3f) / SourceRate;
+			}
+
+			CalVector translation;
+			CalQuaternion rotation;
+			getCurve(time, translation, rotation);
+			coreTrack.addCoreKeyframe(time, translation, rotation);
+		}
+
+		coreTrack.updateKeyframeRate();
+	}
+
+	// largest difference between two tracks, sampled every millisecond
+	void getDenseError(const CalCoreTrack& a, const CalCoreTrack& b, float& maxTranslationError, float& maxRotationErrorDegrees)
+	{
+		maxTranslationError = 0.0f;
+		maxRotationErrorDegrees = 0.0f;
+
+		int sampleId;
+		for(sampleId = 0; sampleId <= (int)(Duration * 1000.0f); ++sampleId)
+		{
+			float time = sampleId / 1000.0f;
+
+			CalVector translationA, translationB;
+			CalQuaternion rotationA, rotationB;
+			a.getState(time, translationA, rotationA);
+			b.getState(time, translationB, rotationB);
+
+			float translationError = (translationA - translationB).length();
+			if(translationError > maxTranslationError) maxTranslationError = translationError;
+
+			// angle of the relative rotation, without the loss of precision
+			// of acos for small angles
+			CalQuaternion relativeRotation = rotationA;
+			relativeRotation.invert();
+			relativeRotation *= rotationB;
+			float sinHalfAngle = std::sqrt(relativeRotation.x * relativeRotation.x + relativeRotation.y * relativeRotation.y + relativeRotation.z * relativeRotation.z);
+			float rotationErrorDegrees = 2.0f * std::atan2(sinHalfAngle, std::fabs(relativeRotation.w)) * 180.0f / Pi;
+			if(rotationErrorDegrees > maxRotationErrorDegrees) maxRotationErrorDegrees = rotationErrorDegrees;
+		}
+	}
+}
+
+int main()
+{
+	CalCoreTrack originalTrack;
+	buildJitteredTrack(originalTrack);
+	CAL_TEST_CHECK(originalTrack.getKeyframeRate() == 0.0f);
+
+	float translationError, rotationErrorDegrees;
+
+	// a track does not differ from itself
+	originalTrack.getStateError(originalTrack, Duration, translationError, rotationErrorDegrees);
+	CAL_TEST_CHECK(translationError == 0.0f);
+	CAL_TEST_CHECK(rotationErrorDegrees < 1.0e-4f);
+
+	// 7 keyframes per second do not divide the duration, so the rate is raised
+	static const float keyframeRate[] = { 60.0f, 30.0f, 7.0f };
+	float previousTranslationError = 0.0f;
+	for(size_t rateId = 0; rateId < sizeof(keyframeRate) / sizeof(keyframeRate[0]); ++rateId)
+	{
+		CalCoreTrack resampledTrack(originalTrack);
+		CAL_TEST_CHECK(resampledTrack.resample(keyframeRate[rateId], Duration));
+
+		int keyframeCount = resampledTrack.getCoreKeyframeCount();
+		CAL_TEST_CHECK(keyframeCount >= (int)(Duration * keyframeRate[rateId]) + 1);
+		CAL_TEST_CHECK(resampledTrack.getKeyframeTime(0) == 0.0f);
+		CAL_TEST_CHECK(std::fabs(resampledTrack.getKeyframeTime(keyframeCount - 1) - Duration) < 1.0e-5f);
+		CAL_TEST_CHECK(resampledTrack.getKeyframeRate() >= keyframeRate[rateId] * 0.9999f);
+
+		resampledTrack.getStateError(originalTrack, Duration, translationError, rotationErrorDegrees);
+
+		// both tracks interpolate the curve linearly, so each is within
+		// h^2/8 max|f''| of it, with h the largest keyframe interval
+		float sourceInterval = 1.3f / SourceRate;
+		float resampledInterval = 1.0f / resampledTrack.getKeyframeRate();
+		float translationBound = (sourceInterval * sourceInterval + resampledInterval * resampledInterval) / 8.0f * 4.0f * 1.01f;
+		float rotationBoundDegrees = (sourceInterval * sourceInterval + resampledInterval * resampledInterval) / 8.0f * 0.5f * 180.0f / Pi * 1.01f;
+
+		if(!CAL_TEST_CHECK(translationError <= translationBound) || !CAL_TEST_CHECK(rotationErrorDegrees <= rotationBoundDegrees))
+		{
+			std::fprintf(stderr, "%g keyframes/s: error %g (bound %g), %g degrees (bound %g)\n", keyframeRate[rateId],
+			             translationError, translationBound, rotationErrorDegrees, rotationBoundDegrees);
+		}
+
+		// the two tracks are piecewise linear, so the largest difference is at
+		// a keyframe of either track, where getStateError looks
+		float denseTranslationError, denseRotationErrorDegrees;
+		getDenseError(resampledTrack, originalTrack, denseTranslationError, denseRotationErrorDegrees);
+		CAL_TEST_CHECK(denseTranslationError <= translationError + 1.0e-5f);
+		CAL_TEST_CHECK(denseRotationErrorDegrees <= rotationErrorDegrees + 1.0e-3f);
+
+		// coarser tracks are further away
+		CAL_TEST_CHECK(translationError >= previousTranslationError);
+		previousTranslationError = translationError;
+	}
+
+	// resampling rejects bad arguments and leaves the track alone
+	CalCoreTrack track(originalTrack);
+	CAL_TEST_CHECK(!track.resample(0.0f, Duration));
+	CAL_TEST_CHECK(!track.resample(30.0f, -1.0f));
+	track.getStateError(originalTrack, Duration, translationError, rotationErrorDegrees);
+	CAL_TEST_CHECK(translationError == 0.0f);
+
+	return CalTest::result();
+}
+
+//****************************************************************************//
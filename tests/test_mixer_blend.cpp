@@ -0,0 +1,423 @@
+//****************************************************************************//
+// test_mixer_blend.cpp                                                       //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Checks that CalMixer blending through its pose buffers gives the skeleton
+// the same pose as the former blending through the bones did. The reference
+// below replays, bone by bone, what CalBone::blendState and CalBone::lockState
+// used to do when CalMixer::updateSkeleton called them for every track: bone
+// adjustments first, then the actions, newest first, locked as one layer, then
+// the cycles, locked as a second layer. The schedule covers fading cycles,
+// replace actions with a ramp value and a scale, an auto-locked action that
+// holds its last frame, and ramped bone adjustments. It also checks the bone
+// adjustment table: adjustments set in one batch, one removed from the middle,
+// and the skeleton blended from the remaining ones.
+
+#include "test.h"
+#include "cal3d/coretrack.h"
+
+#include <algorithm>
+
+using namespace cal3d;
+
+namespace
+{
+	const int FrameCount = 240;
+	const float FrameTime = 1.0f / 30.0f;
+	const double Tolerance = 1e-4;
+
+	// the state the bones used to blend the animations in
+	struct ReferenceBone
+	{
+		CalVector translation;
+		CalQuaternion rotation;
+		CalVector translationAbsolute;
+		CalQuaternion rotationAbsolute;
+		float accumulatedWeight;
+		float accumulatedWeightAbsolute;
+		float accumulatedReplacementAttenuation;
+		float firstBlendScale;
+	};
+
+	void clearReferenceBone(ReferenceBone& bone, const CalCoreBone *pCoreBone)
+	{
+		bone.translation = pCoreBone->getTranslation();
+		bone.rotation = pCoreBone->getRotation();
+		bone.accumulatedWeight = 0.0f;
+		bone.accumulatedWeightAbsolute = 0.0f;
+		bone.accumulatedReplacementAttenuation = 1.0f;
+		bone.firstBlendScale = 1.0f;
+	}
+
+	void blendReferenceBone(ReferenceBone& bone, float unrampedWeight, const CalVector& translation, const CalQuaternion& rotation,
+	                        float scale, bool replace, float rampValue, bool absoluteTranslation)
+	{
+		float attenuatedWeight = unrampedWeight * rampValue * bone.accumulatedReplacementAttenuation;
+
+		if(scale < 0.0f) scale = 0.0f;
+		if(scale > 1.0f) scale = 1.0f;
+
+		if(bone.accumulatedWeightAbsolute == 0.0f)
+		{
+			bone.accumulatedWeightAbsolute = attenuatedWeight;
+			bone.translationAbsolute = absoluteTranslation ? translation : bone.translation + translation;
+			bone.rotationAbsolute = rotation;
+			bone.firstBlendScale = scale;
+		}
+		else
+		{
+			float factor = scale * attenuatedWeight / (bone.accumulatedWeightAbsolute + attenuatedWeight);
+			factor = 1.0f - bone.firstBlendScale * (1.0f - factor);
+			CalVector newTranslation(absoluteTranslation ? translation : bone.translation + translation);
+			bone.translationAbsolute.blend(factor, newTranslation);
+			bone.rotationAbsolute.blend(factor, rotation);
+			bone.accumulatedWeightAbsolute += attenuatedWeight;
+			bone.firstBlendScale = 1.0f;
+		}
+		if(replace)
+		{
+			bone.accumulatedReplacementAttenuation *= (1.0f - rampValue);
+		}
+	}
+
+	void lockReferenceBones(std::vector<ReferenceBone>& vectorBone)
+	{
+		for(size_t boneId = 0; boneId < vectorBone.size(); ++boneId)
+		{
+			ReferenceBone& bone = vectorBone[boneId];
+			if(bone.accumulatedWeightAbsolute > 1.0f - bone.accumulatedWeight)
+			{
+				bone.accumulatedWeightAbsolute = 1.0f - bone.accumulatedWeight;
+			}
+			if(bone.accumulatedWeightAbsolute > 0.0f)
+			{
+				if(bone.accumulatedWeight == 0.0f)
+				{
+					bone.translation = bone.translationAbsolute;
+					bone.rotation = bone.rotationAbsolute;
+					bone.accumulatedWeight = bone.accumulatedWeightAbsolute;
+				}
+				else
+				{
+					float factor = bone.accumulatedWeightAbsolute / (bone.accumulatedWeight + bone.accumulatedWeightAbsolute);
+					bone.translation.blend(factor, bone.translationAbsolute);
+					bone.rotation.blend(factor, bone.rotationAbsolute);
+					bone.accumulatedWeight += bone.accumulatedWeightAbsolute;
+				}
+				bone.accumulatedWeightAbsolute = 0.0f;
+			}
+		}
+	}
+
+	void blendReferenceAnimation(std::vector<ReferenceBone>& vectorBone, const CalCoreAnimation *pCoreAnimation, float time,
+	                             float weight, float scale, bool replace, float rampValue)
+	{
+		const std::vector<CalCoreTrack *>& vectorCoreTrack = pCoreAnimation->getVectorCoreTrack();
+		for(size_t trackId = 0; trackId < vectorCoreTrack.size(); ++trackId)
+		{
+			CalCoreTrack *pCoreTrack = vectorCoreTrack[trackId];
+			CalVector translation;
+			CalQuaternion rotation;
+			pCoreTrack->getState(time, translation, rotation);
+			blendReferenceBone(vectorBone[pCoreTrack->getCoreBoneId()], weight, translation, rotation,
+			                   scale, replace, rampValue, pCoreTrack->getTranslationRequired());
+		}
+	}
+
+	// blends the animations of the mixer into the reference bones the way
+	// CalMixer::updateSkeleton used to blend them into the bones
+	void blendReference(CalMixer *pMixer, const CalCoreSkeleton *pCoreSkeleton, std::vector<ReferenceBone>& vectorBone)
+	{
+		const std::vector<CalCoreBone *>& vectorCoreBone = pCoreSkeleton->getVectorCoreBone();
+		vectorBone.resize(vectorCoreBone.size());
+
+		int boneId;
+		for(boneId = 0; boneId < (int)vectorBone.size(); ++boneId)
+		{
+			clearReferenceBone(vectorBone[boneId], vectorCoreBone[boneId]);
+		}
+
+		for(boneId = 0; boneId < (int)vectorBone.size(); ++boneId)
+		{
+			const BoneAdjustment *pBoneAdjustment = pMixer->getBoneAdjustment(boneId);
+			if(pBoneAdjustment != 0 && (pBoneAdjustment->flags_ & BoneAdjustment::FlagPosRot))
+			{
+				blendReferenceBone(vectorBone[boneId], 1.0f, vectorCoreBone[boneId]->getTranslation(), pBoneAdjustment->localOri_,
+				                   1.0f, true, pBoneAdjustment->rampValue_, true);
+			}
+		}
+
+		std::list<CalAnimationAction *> listAction = pMixer->getCurrentOneShotActions();
+		std::list<CalAnimationAction *>::iterator iteratorAction;
+		for(iteratorAction = listAction.begin(); iteratorAction != listAction.end(); ++iteratorAction)
+		{
+			// the schedule has no manual actions, so all the actions are on
+			CalAnimationAction *pAction = *iteratorAction;
+
+			CalAnimation::CompositionFunction compositionFunction = pAction->getCompositionFunction();
+			bool replace = compositionFunction != CalAnimation::CompositionFunctionAverage
+				&& compositionFunction != CalAnimation::CompositionFunctionNull;
+			blendReferenceAnimation(vectorBone, pAction->getCoreAnimation(), pAction->getTime(),
+			                        pAction->getWeight(), pAction->getScale(), replace, pAction->getRampValue());
+		}
+		lockReferenceBones(vectorBone);
+
+		std::list<CalAnimationCycle *> listCycle = pMixer->getCurrentCycleActions();
+		std::list<CalAnimationCycle *>::iterator iteratorCycle;
+		for(iteratorCycle = listCycle.begin(); iteratorCycle != listCycle.end(); ++iteratorCycle)
+		{
+			CalAnimationCycle *pCycle = *iteratorCycle;
+			CalCoreAnimation *pCoreAnimation = pCycle->getCoreAnimation();
+
+			float time = pCycle->getTime();
+			if(pCycle->getState() == CalAnimation::STATE_SYNC)
+			{
+				time = (pMixer->getAnimationDuration() == 0.0f) ? 0.0f
+					: pMixer->getAnimationTime() * pCoreAnimation->getDuration() / pMixer->getAnimationDuration();
+			}
+			blendReferenceAnimation(vectorBone, pCoreAnimation, time, pCycle->getWeight(), 1.0f, false, 1.0f);
+		}
+		lockReferenceBones(vectorBone);
+	}
+
+	// the absolute state of a reference bone and of its children
+	void calculateReferenceBone(std::vector<ReferenceBone>& vectorBone, const CalCoreSkeleton *pCoreSkeleton, int boneId)
+	{
+		const CalCoreBone *pCoreBone = pCoreSkeleton->getVectorCoreBone()[boneId];
+		ReferenceBone& bone = vectorBone[boneId];
+
+		bone.translationAbsolute = bone.translation;
+		bone.rotationAbsolute = bone.rotation;
+		if(pCoreBone->getParentId() != -1)
+		{
+			const ReferenceBone& parent = vectorBone[pCoreBone->getParentId()];
+			bone.translationAbsolute *= parent.rotationAbsolute;
+			bone.translationAbsolute += parent.translationAbsolute;
+			bone.rotationAbsolute *= parent.rotationAbsolute;
+		}
+
+		std::list<int>::const_iterator iteratorChildId;
+		for(iteratorChildId = pCoreBone->getListChildId().begin(); iteratorChildId != pCoreBone->getListChildId().end(); ++iteratorChildId)
+		{
+			calculateReferenceBone(vectorBone, pCoreSkeleton, *iteratorChildId);
+		}
+	}
+
+	double vectorError(const CalVector& a, const CalVector& b)
+	{
+		double error = std::fabs((double)a.x - b.x) + std::fabs((double)a.y - b.y) + std::fabs((double)a.z - b.z);
+		return error / (1.0 + b.length());
+	}
+
+	double quaternionError(const CalQuaternion& a, const CalQuaternion& b)
+	{
+		// q and -q are the same rotation
+		double dot = (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z + (double)a.w * b.w;
+		return 1.0 - std::fabs(dot);
+	}
+
+	// schedules the animations and the bone adjustments of a frame
+	void scheduleFrame(CalMixer *pMixer, int frameId, int adjustedBoneId)
+	{
+		switch(frameId)
+		{
+		case 0:
+			pMixer->blendCycle(CalTest::CALLY_IDLE, 1.0f, 0.0f);
+			pMixer->blendCycle(CalTest::CALLY_WALK, 0.6f, 0.5f);
+			break;
+		case 20:
+			pMixer->executeAction(CalTest::CALLY_WAVE, 0.3f, 0.3f);
+			pMixer->getCurrentOneShotActions().front()->setCompositionFunction(CalAnimation::CompositionFunctionReplace);
+			pMixer->getCurrentOneShotActions().front()->setRampValue(0.7f);
+			pMixer->getCurrentOneShotActions().front()->setScale(0.8f);
+			break;
+		case 40:
+			pMixer->executeAction(CalTest::CALLY_SHOOT_ARROW, 0.2f, 0.2f, 0.8f, true);
+			break;
+		case 60:
+			pMixer->blendCycle(CalTest::CALLY_JOG, 0.8f, 0.4f);
+			pMixer->clearCycle(CalTest::CALLY_IDLE, 0.6f);
+			break;
+		case 90:
+			pMixer->executeAction(CalTest::CALLY_STRUT, 0.1f, 0.1f);
+			pMixer->getCurrentOneShotActions().front()->setCompositionFunction(CalAnimation::CompositionFunctionCrossFade);
+			break;
+		case 200:
+			pMixer->removeAllBoneAdjustments();
+			break;
+		}
+
+		// ramp a replace adjustment in and out of one bone, and scale another one
+		if(frameId >= 30 && frameId < 200)
+		{
+			BoneAdjustment boneAdjustment;
+			boneAdjustment.flags_ = BoneAdjustment::FlagPosRot;
+			boneAdjustment.localOri_ = CalQuaternion(0.0f, 0.0f, std::sin(0.01f * frameId), std::cos(0.01f * frameId));
+			boneAdjustment.rampValue_ = 0.5f + 0.5f * std::sin(0.05f * frameId);
+			pMixer->addBoneAdjustment(adjustedBoneId, boneAdjustment);
+
+			boneAdjustment.flags_ = BoneAdjustment::FlagMeshScale;
+			boneAdjustment.meshScaleAbsolute_ = CalVector(1.0f, 1.0f + 0.002f * frameId, 1.0f);
+			pMixer->addBoneAdjustment(0, boneAdjustment);
+		}
+	}
+
+	// checks that the mixer holds exactly the given adjustments, and that the
+	// skeleton of a model without animations is the core pose with the
+	// adjusted bones replaced by their adjustments
+	bool checkBoneAdjustments(CalModel& model, const std::vector<int>& vectorBoneId, const std::vector<BoneAdjustment>& vectorBoneAdjustment)
+	{
+		CalMixer *pMixer = model.getMixer();
+		if(!CAL_TEST_CHECK(pMixer->getBoneAdjustmentCount() == (int)vectorBoneId.size())) return false;
+
+		model.update(FrameTime);
+
+		const std::vector<CalCoreBone *>& vectorCoreBone = model.getCoreModel()->getCoreSkeleton()->getVectorCoreBone();
+		for(int boneId = 0; boneId < (int)vectorCoreBone.size(); ++boneId)
+		{
+			const CalBone *pBone = model.getSkeleton()->getBone(boneId);
+			const BoneAdjustment *pBoneAdjustment = pMixer->getBoneAdjustment(boneId);
+
+			std::vector<int>::const_iterator iteratorBoneId = std::find(vectorBoneId.begin(), vectorBoneId.end(), boneId);
+			if(iteratorBoneId == vectorBoneId.end())
+			{
+				if(!CAL_TEST_CHECK(pBoneAdjustment == 0)) return false;
+				if(!CAL_TEST_CHECK(quaternionError(pBone->getRotation(), vectorCoreBone[boneId]->getRotation()) < Tolerance)) return false;
+				continue;
+			}
+
+			const BoneAdjustment& boneAdjustment = vectorBoneAdjustment[iteratorBoneId - vectorBoneId.begin()];
+			if(!CAL_TEST_CHECK(pBoneAdjustment != 0)) return false;
+			if(!CAL_TEST_CHECK(pBoneAdjustment->localOri_ == boneAdjustment.localOri_)) return false;
+			if(!CAL_TEST_CHECK(pBoneAdjustment->rampValue_ == boneAdjustment.rampValue_)) return false;
+			if(!CAL_TEST_CHECK(quaternionError(pBone->getRotation(), boneAdjustment.localOri_) < Tolerance)) return false;
+			if(!CAL_TEST_CHECK(vectorError(pBone->getTranslation(), vectorCoreBone[boneId]->getTranslation()) < Tolerance)) return false;
+		}
+		return true;
+	}
+
+	// sets several bone adjustments in one batch, then removes some of them
+	void testBoneAdjustmentTable(CalCoreModel& coreModel)
+	{
+		CalModel model(&coreModel);
+		CalMixer *pMixer = model.getMixer();
+		const int boneCount = (int)model.getSkeleton()->getVectorBone().size();
+
+		std::vector<int> vectorBoneId;
+		std::vector<BoneAdjustment> vectorBoneAdjustment;
+		for(int adjustmentId = 0; adjustmentId < 5; ++adjustmentId)
+		{
+			BoneAdjustment boneAdjustment;
+			boneAdjustment.flags_ = BoneAdjustment::FlagPosRot;
+			float angle = 0.2f * (adjustmentId + 1);
+			boneAdjustment.localOri_ = CalQuaternion(std::sin(angle), 0.0f, 0.0f, std::cos(angle));
+			boneAdjustment.rampValue_ = 1.0f;
+			vectorBoneId.push_back((7 * adjustmentId + 3) % boneCount);
+			vectorBoneAdjustment.push_back(boneAdjustment);
+		}
+
+		CAL_TEST_CHECK(pMixer->setBoneAdjustments(&vectorBoneId[0], &vectorBoneAdjustment[0], (int)vectorBoneId.size()));
+		CAL_TEST_CHECK(checkBoneAdjustments(model, vectorBoneId, vectorBoneAdjustment));
+
+		// a batch with an invalid bone id changes nothing
+		std::vector<int> vectorInvalidBoneId(vectorBoneId);
+		vectorInvalidBoneId[3] = boneCount;
+		std::vector<BoneAdjustment> vectorOtherBoneAdjustment(vectorBoneAdjustment.size(), vectorBoneAdjustment[4]);
+		CAL_TEST_CHECK(!pMixer->setBoneAdjustments(&vectorInvalidBoneId[0], &vectorOtherBoneAdjustment[0], (int)vectorInvalidBoneId.size()));
+		CAL_TEST_CHECK(checkBoneAdjustments(model, vectorBoneId, vectorBoneAdjustment));
+
+		// removing one from the middle moves the last one into its place
+		CAL_TEST_CHECK(pMixer->removeBoneAdjustment(vectorBoneId[1]));
+		CAL_TEST_CHECK(!pMixer->removeBoneAdjustment(vectorBoneId[1]));
+		vectorBoneId.erase(vectorBoneId.begin() + 1);
+		vectorBoneAdjustment.erase(vectorBoneAdjustment.begin() + 1);
+		CAL_TEST_CHECK(checkBoneAdjustments(model, vectorBoneId, vectorBoneAdjustment));
+
+		// the moved one can still be replaced and removed
+		vectorBoneAdjustment.back().localOri_ = CalQuaternion(0.0f, 0.3f, 0.0f, std::sqrt(1.0f - 0.09f));
+		CAL_TEST_CHECK(pMixer->addBoneAdjustment(vectorBoneId.back(), vectorBoneAdjustment.back()));
+		CAL_TEST_CHECK(checkBoneAdjustments(model, vectorBoneId, vectorBoneAdjustment));
+
+		CAL_TEST_CHECK(pMixer->removeBoneAdjustment(vectorBoneId.back()));
+		vectorBoneId.pop_back();
+		vectorBoneAdjustment.pop_back();
+		CAL_TEST_CHECK(pMixer->removeBoneAdjustment(vectorBoneId.front()));
+		vectorBoneId.erase(vectorBoneId.begin());
+		vectorBoneAdjustment.erase(vectorBoneAdjustment.begin());
+		CAL_TEST_CHECK(checkBoneAdjustments(model, vectorBoneId, vectorBoneAdjustment));
+
+		pMixer->removeAllBoneAdjustments();
+		vectorBoneId.clear();
+		vectorBoneAdjustment.clear();
+		CAL_TEST_CHECK(checkBoneAdjustments(model, vectorBoneId, vectorBoneAdjustment));
+	}
+}
+
+int main()
+{
+	CalCoreModel coreModel("cally");
+	if(!CalTest::loadCally(coreModel)) return 1;
+
+	CalCoreSkeleton *pCoreSkeleton = coreModel.getCoreSkeleton();
+	const int adjustedBoneId = pCoreSkeleton->getCoreBoneId("Cally Head");
+	if(!CAL_TEST_CHECK(adjustedBoneId != -1)) return CalTest::result();
+
+	CalModel model(&coreModel);
+	CalMixer *pMixer = model.getMixer();
+	CalSkeleton *pSkeleton = model.getSkeleton();
+
+	std::vector<ReferenceBone> vectorReferenceBone;
+	double maxTranslationError = 0.0;
+	double maxRotationError = 0.0;
+
+	int frameId;
+	for(frameId = 0; frameId < FrameCount; ++frameId)
+	{
+		scheduleFrame(pMixer, frameId, adjustedBoneId);
+		model.update(FrameTime);
+
+		blendReference(pMixer, pCoreSkeleton, vectorReferenceBone);
+		const std::vector<int>& vectorRootCoreBoneId = pCoreSkeleton->getVectorRootCoreBoneId();
+		for(size_t rootId = 0; rootId < vectorRootCoreBoneId.size(); ++rootId)
+		{
+			calculateReferenceBone(vectorReferenceBone, pCoreSkeleton, vectorRootCoreBoneId[rootId]);
+		}
+
+		for(size_t boneId = 0; boneId < vectorReferenceBone.size(); ++boneId)
+		{
+			const CalBone *pBone = pSkeleton->getBone((int)boneId);
+			const ReferenceBone& bone = vectorReferenceBone[boneId];
+
+			double translationError = vectorError(pBone->getTranslation(), bone.translation);
+			translationError = std::max(translationError, vectorError(pBone->getTranslationAbsolute(), bone.translationAbsolute));
+			double rotationError = quaternionError(pBone->getRotation(), bone.rotation);
+			rotationError = std::max(rotationError, quaternionError(pBone->getRotationAbsolute(), bone.rotationAbsolute));
+
+			if(translationError > maxTranslationError) maxTranslationError = translationError;
+			if(rotationError > maxRotationError) maxRotationError = rotationError;
+
+			if(!CAL_TEST_CHECK(translationError < Tolerance && rotationError < Tolerance))
+			{
+				std::fprintf(stderr, "frame %d bone %d: translation error %g, rotation error %g\n",
+				             frameId, (int)boneId, translationError, rotationError);
+				return CalTest::result();
+			}
+		}
+	}
+
+	// the schedule must actually have kept the auto-locked action around
+	CAL_TEST_CHECK(!pMixer->getCurrentOneShotActions().empty());
+
+	testBoneAdjustmentTable(coreModel);
+
+	std::printf("max translation error %g, max rotation error %g\n", maxTranslationError, maxRotationError);
+	return CalTest::result();
+}
+
+//****************************************************************************//
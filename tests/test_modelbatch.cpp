@@ -0,0 +1,114 @@
+//****************************************************************************//
+// test_modelbatch.cpp                                                        //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Updates the same crowd with CalModelBatch on one thread and on several
+// threads and checks that every model ends up in exactly the same pose.
+
+#include "test.h"
+
+using namespace cal3d;
+
+namespace
+{
+	const int ModelCount = 24;
+	const int FrameCount = 50;
+
+	void setupCrowd(CalCoreModel& coreModel, std::vector<CalModel *>& vectorModel)
+	{
+		static const int cycle[] = { CalTest::CALLY_IDLE, CalTest::CALLY_WALK, CalTest::CALLY_JOG, CalTest::CALLY_STRUT };
+
+		int modelId;
+		for(modelId = 0; modelId < ModelCount; ++modelId)
+		{
+			CalModel *pModel = new CalModel(&coreModel);
+			CalTest::attachAllMeshes(*pModel);
+			pModel->getMixer()->blendCycle(cycle[modelId % 4], 1.0f, 0.0f);
+			pModel->getMixer()->blendCycle(cycle[(modelId + 1) % 4], 0.3f, 0.2f);
+			vectorModel.push_back(pModel);
+		}
+	}
+
+	void runCrowd(CalModelBatch& batch, std::vector<CalModel *>& vectorModel, std::vector<float>& vectorResult)
+	{
+		std::vector<float> vectorPosition;
+
+		vectorResult.clear();
+
+		int frameId;
+		for(frameId = 0; frameId < FrameCount; ++frameId)
+		{
+			// start actions on some of the models while the batch runs
+			if(frameId % 10 == 5)
+			{
+				int modelId;
+				for(modelId = frameId % 3; modelId < ModelCount; modelId += 3)
+				{
+					vectorModel[modelId]->getMixer()->executeAction(CalTest::CALLY_WAVE, 0.1f, 0.1f, 1.0f, modelId % 2 == 0);
+				}
+			}
+
+			batch.update(vectorModel, 0.02f + 0.005f * (frameId % 4));
+		}
+
+		size_t modelId;
+		for(modelId = 0; modelId < vectorModel.size(); ++modelId)
+		{
+			CalTest::calculateModelVertices(*vectorModel[modelId], vectorPosition);
+			vectorResult.insert(vectorResult.end(), vectorPosition.begin(), vectorPosition.end());
+		}
+	}
+
+	void deleteCrowd(std::vector<CalModel *>& vectorModel)
+	{
+		for(size_t modelId = 0; modelId < vectorModel.size(); ++modelId)
+		{
+			delete vectorModel[modelId];
+		}
+		vectorModel.clear();
+	}
+}
+
+int main()
+{
+	CalCoreModel coreModel("cally");
+	if(!CalTest::loadCally(coreModel)) return 1;
+
+	std::vector<CalModel *> vectorModel;
+	std::vector<float> vectorSerial;
+
+	CalModelBatch serialBatch(1);
+	CAL_TEST_CHECK(serialBatch.getThreadCount() == 1);
+	setupCrowd(coreModel, vectorModel);
+	runCrowd(serialBatch, vectorModel, vectorSerial);
+	deleteCrowd(vectorModel);
+	CAL_TEST_CHECK(!vectorSerial.empty());
+
+	static const int threadCount[] = { 2, 3, 4, 8, 0 };
+	for(size_t id = 0; id < sizeof(threadCount) / sizeof(threadCount[0]); ++id)
+	{
+		CalModelBatch batch(threadCount[id]);
+		CAL_TEST_CHECK(batch.getThreadCount() >= 1);
+
+		std::vector<float> vectorThreaded;
+		setupCrowd(coreModel, vectorModel);
+		runCrowd(batch, vectorModel, vectorThreaded);
+		deleteCrowd(vectorModel);
+
+		if(!CAL_TEST_CHECK(vectorThreaded == vectorSerial))
+		{
+			std::fprintf(stderr, "%d threads: max relative error %g\n", batch.getThreadCount(),
+			             CalTest::maxRelativeError(vectorThreaded, vectorSerial));
+		}
+	}
+
+	return CalTest::result();
+}
+
+//****************************************************************************//
@@ -0,0 +1,294 @@
+//****************************************************************************//
+// test_morph_compress.cpp                                                    //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Compresses sub morph targets and difference maps and checks that the blend
+// vertices read back within the documented error bound, that getBlendVertex
+// hands out copies, and that scaling the submesh scales the compressed blend
+// vertices like the full-precision ones.
+
+#include "test.h"
+#include "cal3d/coresubmorphtarget.h"
+
+using namespace cal3d;
+
+namespace
+{
+	const int VertexCount = 300;
+
+	// every third vertex is left in place, the others move
+	bool isMoved(int vertexId)
+	{
+		return vertexId % 3 != 0;
+	}
+
+	CalCoreSubMorphTarget::BlendVertex getBlendVertex(int vertexId)
+	{
+		CalCoreSubMorphTarget::BlendVertex blendVertex;
+		blendVertex.position.set(0.0f, 0.0f, 0.0f);
+		blendVertex.normal.set(0.0f, 0.0f, 0.0f);
+		if(isMoved(vertexId))
+		{
+			blendVertex.position.set(std::sin(0.1f * vertexId), 3.0f * std::cos(0.07f * vertexId), 0.25f);
+			blendVertex.normal.set(0.0f, 0.1f * std::sin(0.3f * vertexId), -0.05f);
+			CalCoreSubmesh::TextureCoordinate textureCoordinate;
+			textureCoordinate.u = 0.001f * vertexId;
+			textureCoordinate.v = 1.0f / (vertexId + 1);
+			blendVertex.textureCoords.push_back(textureCoordinate);
+		}
+		return blendVertex;
+	}
+
+	CalCoreSubMorphTarget *createMorphTarget()
+	{
+		CalCoreSubMorphTarget *pMorphTarget = new CalCoreSubMorphTarget();
+		pMorphTarget->reserve(VertexCount);
+		int vertexId;
+		for(vertexId = 0; vertexId < VertexCount; ++vertexId)
+		{
+			pMorphTarget->setBlendVertex(vertexId, getBlendVertex(vertexId));
+		}
+		return pMorphTarget;
+	}
+
+	CalCoreSubMorphTargetDiffMap *createDiffMapMorphTarget()
+	{
+		CalCoreSubMorphTargetDiffMap *pMorphTarget = new CalCoreSubMorphTargetDiffMap();
+		pMorphTarget->reserve(VertexCount);
+		int vertexId;
+		for(vertexId = 0; vertexId < VertexCount; ++vertexId)
+		{
+			if(isMoved(vertexId)) pMorphTarget->appendBlendVertex(vertexId, getBlendVertex(vertexId));
+		}
+		return pMorphTarget;
+	}
+
+	CalCoreSubmesh *createSubmesh()
+	{
+		CalCoreSubmesh *pCoreSubmesh = new CalCoreSubmesh();
+		pCoreSubmesh->reserve(VertexCount, 0, 0, 0);
+
+		int vertexId;
+		for(vertexId = 0; vertexId < VertexCount; ++vertexId)
+		{
+			CalCoreSubmesh::Vertex vertex;
+			vertex.position.set(0.01f * vertexId, 1.0f, -2.0f);
+			vertex.normal.set(0.0f, 0.0f, 1.0f);
+			vertex.collapseId = -1;
+			vertex.faceCollapseCount = 0;
+			pCoreSubmesh->setVertex(vertexId, vertex);
+		}
+		return pCoreSubmesh;
+	}
+
+	// the error bound of CompressedBlendVertices::compress: half the range of
+	// a component divided by 32767, over the moved blend vertices
+	void getErrorBound(CalVector& positionBound, CalVector& normalBound)
+	{
+		CalVector positionMinimum, positionMaximum, normalMinimum, normalMaximum;
+		bool first = true;
+		int vertexId;
+		for(vertexId = 0; vertexId < VertexCount; ++vertexId)
+		{
+			if(!isMoved(vertexId)) continue;
+
+			CalCoreSubMorphTarget::BlendVertex blendVertex = getBlendVertex(vertexId);
+			for(int axis = 0; axis < 3; ++axis)
+			{
+				if(first || blendVertex.position[axis] < positionMinimum[axis]) positionMinimum[axis] = blendVertex.position[axis];
+				if(first || blendVertex.position[axis] > positionMaximum[axis]) positionMaximum[axis] = blendVertex.position[axis];
+				if(first || blendVertex.normal[axis] < normalMinimum[axis]) normalMinimum[axis] = blendVertex.normal[axis];
+				if(first || blendVertex.normal[axis] > normalMaximum[axis]) normalMaximum[axis] = blendVertex.normal[axis];
+			}
+			first = false;
+		}
+
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			// plus the rounding of the float arithmetic
+			positionBound[axis] = 0.5f * (positionMaximum[axis] - positionMinimum[axis]) / 32767.0f + 1.0e-6f;
+			normalBound[axis] = 0.5f * (normalMaximum[axis] - normalMinimum[axis]) / 32767.0f + 1.0e-6f;
+		}
+	}
+
+	bool isWithin(const CalVector& a, const CalVector& b, const CalVector& bound)
+	{
+		return std::fabs(a.x - b.x) <= bound.x && std::fabs(a.y - b.y) <= bound.y && std::fabs(a.z - b.z) <= bound.z;
+	}
+
+	bool isSameTextureCoordinates(const CalCoreSubMorphTarget::BlendVertex& a, const CalCoreSubMorphTarget::BlendVertex& b)
+	{
+		if(a.textureCoords.size() != b.textureCoords.size()) return false;
+		for(size_t textureCoordinateId = 0; textureCoordinateId < a.textureCoords.size(); ++textureCoordinateId)
+		{
+			if(a.textureCoords[textureCoordinateId].u != b.textureCoords[textureCoordinateId].u
+				|| a.textureCoords[textureCoordinateId].v != b.textureCoords[textureCoordinateId].v) return false;
+		}
+		return true;
+	}
+
+	// fills a blend vertex with values that getBlendVertex must overwrite
+	void fillBlendVertex(CalCoreSubMorphTarget::BlendVertex& blendVertex)
+	{
+		blendVertex.position.set(-7.0f, -7.0f, -7.0f);
+		blendVertex.normal.set(-7.0f, -7.0f, -7.0f);
+		blendVertex.textureCoords.resize(3);
+	}
+}
+
+int main()
+{
+	CalVector positionBound, normalBound;
+	getErrorBound(positionBound, normalBound);
+	const CalVector zero(0.0f, 0.0f, 0.0f);
+
+	// a compressed morph target reads back within the bound, the texture
+	// coordinates exactly, and the blend vertices left in place as zero
+	CalCoreSubMorphTarget *pMorphTarget = createMorphTarget();
+	const unsigned int uncompressedSize = pMorphTarget->size();
+	CAL_TEST_CHECK(pMorphTarget->compress());
+	CAL_TEST_CHECK(pMorphTarget->isCompressed());
+	CAL_TEST_CHECK(pMorphTarget->size() < uncompressedSize);
+	CAL_TEST_CHECK(pMorphTarget->getBlendVertexCount() == VertexCount);
+	CAL_TEST_CHECK(pMorphTarget->getBlendVertex(1) == 0);
+	CAL_TEST_CHECK(!pMorphTarget->setBlendVertex(1, getBlendVertex(1)));
+
+	int vertexId;
+	for(vertexId = 0; vertexId < VertexCount; ++vertexId)
+	{
+		CalCoreSubMorphTarget::BlendVertex expectedVertex = getBlendVertex(vertexId);
+		CalCoreSubMorphTarget::BlendVertex blendVertex;
+		fillBlendVertex(blendVertex);
+		pMorphTarget->getBlendVertex(vertexId, blendVertex);
+		if(!CAL_TEST_CHECK(isWithin(blendVertex.position, expectedVertex.position, positionBound))
+			|| !CAL_TEST_CHECK(isWithin(blendVertex.normal, expectedVertex.normal, normalBound))
+			|| !CAL_TEST_CHECK(isSameTextureCoordinates(blendVertex, expectedVertex)))
+		{
+			std::fprintf(stderr, "morph target vertex %d\n", vertexId);
+			break;
+		}
+		if(!isMoved(vertexId))
+		{
+			CAL_TEST_CHECK(blendVertex.position == zero && blendVertex.normal == zero);
+		}
+	}
+
+	// getBlendVertex hands out copies: changing one does not change the morph
+	// target, compressed or not
+	CalCoreSubMorphTarget *pUncompressedMorphTarget = createMorphTarget();
+	CalCoreSubMorphTarget *pMorphTargets[2] = { pUncompressedMorphTarget, pMorphTarget };
+	for(int morphTargetId = 0; morphTargetId < 2; ++morphTargetId)
+	{
+		CalCoreSubMorphTarget::BlendVertex blendVertex, otherBlendVertex;
+		pMorphTargets[morphTargetId]->getBlendVertex(4, blendVertex);
+		CalVector position = blendVertex.position;
+		blendVertex.position += CalVector(1.0f, 1.0f, 1.0f);
+		blendVertex.textureCoords[0].u += 1.0f;
+		pMorphTargets[morphTargetId]->getBlendVertex(4, otherBlendVertex);
+		CAL_TEST_CHECK(otherBlendVertex.position == position);
+		CAL_TEST_CHECK(isSameTextureCoordinates(otherBlendVertex, getBlendVertex(4)));
+	}
+	delete pUncompressedMorphTarget;
+	delete pMorphTarget;
+
+	// the same for a compressed difference map, which has no blend vertex for
+	// the vertices left in place
+	CalCoreSubMorphTargetDiffMap *pDiffMapMorphTarget = createDiffMapMorphTarget();
+	CAL_TEST_CHECK(pDiffMapMorphTarget->compressDifferenceMap());
+	const CalSharedDifferenceMap *pDifferenceMap = pDiffMapMorphTarget->getDifferenceMap();
+	CAL_TEST_CHECK(pDifferenceMap->isCompressed());
+	CAL_TEST_CHECK(pDifferenceMap->getVectorBlendVertex().empty());
+	for(vertexId = 0; vertexId < VertexCount; ++vertexId)
+	{
+		CalCoreSubMorphTarget::BlendVertex expectedVertex = getBlendVertex(vertexId);
+		CalCoreSubMorphTarget::BlendVertex blendVertex;
+		fillBlendVertex(blendVertex);
+		bool found = pDifferenceMap->getBlendVertex(vertexId, blendVertex);
+		if(!CAL_TEST_CHECK(found == isMoved(vertexId))) break;
+		if(!found) continue;
+
+		if(!CAL_TEST_CHECK(isWithin(blendVertex.position, expectedVertex.position, positionBound))
+			|| !CAL_TEST_CHECK(isWithin(blendVertex.normal, expectedVertex.normal, normalBound))
+			|| !CAL_TEST_CHECK(isSameTextureCoordinates(blendVertex, expectedVertex)))
+		{
+			std::fprintf(stderr, "difference map vertex %d\n", vertexId);
+			break;
+		}
+	}
+	delete pDiffMapMorphTarget;
+
+	// scaling a submesh scales its compressed morph targets and difference
+	// maps like the full-precision ones
+	const float factor = 2.5f;
+	CalCoreSubmesh *pCoreSubmesh = createSubmesh();
+	pCoreSubmesh->addCoreSubMorphTarget(createMorphTarget());
+	CalCoreSubMorphTarget *pCompressedMorphTarget = createMorphTarget();
+	CAL_TEST_CHECK(pCompressedMorphTarget->compress());
+	pCoreSubmesh->addCoreSubMorphTarget(pCompressedMorphTarget);
+	pCoreSubmesh->addCoreSubMorphTarget(createDiffMapMorphTarget());
+	CalCoreSubMorphTargetDiffMap *pCompressedDiffMapMorphTarget = createDiffMapMorphTarget();
+	CAL_TEST_CHECK(pCompressedDiffMapMorphTarget->compressDifferenceMap());
+	pCoreSubmesh->addCoreSubMorphTarget(pCompressedDiffMapMorphTarget);
+
+	// a copy sharing the difference map, in another submesh, keeps its scale
+	CalCoreSubMorphTargetDiffMap *pSharedMorphTarget = new CalCoreSubMorphTargetDiffMap(*pCompressedDiffMapMorphTarget);
+	CAL_TEST_CHECK(pSharedMorphTarget->getDifferenceMap() == pCompressedDiffMapMorphTarget->getDifferenceMap());
+
+	pCoreSubmesh->scale(factor);
+
+	const std::vector<CalCoreSubMorphTarget *>& vectorMorphTarget = pCoreSubmesh->getVectorCoreSubMorphTarget();
+	CalVector scaledPositionBound = positionBound * factor;
+	for(vertexId = 0; vertexId < VertexCount; ++vertexId)
+	{
+		CalCoreSubMorphTarget::BlendVertex expectedVertex, blendVertex;
+		vectorMorphTarget[0]->getBlendVertex(vertexId, expectedVertex);
+		CAL_TEST_CHECK(expectedVertex.position == getBlendVertex(vertexId).position * factor);
+
+		vectorMorphTarget[1]->getBlendVertex(vertexId, blendVertex);
+		if(!CAL_TEST_CHECK(isWithin(blendVertex.position, expectedVertex.position, scaledPositionBound))
+			|| !CAL_TEST_CHECK(isWithin(blendVertex.normal, expectedVertex.normal, normalBound)))
+		{
+			std::fprintf(stderr, "scaled morph target vertex %d\n", vertexId);
+			break;
+		}
+
+		// the difference maps hold offsets from the scaled vertices
+		CalCoreSubMorphTarget::BlendVertex expectedOffset;
+		bool found = static_cast<CalCoreSubMorphTargetDiffMap *>(vectorMorphTarget[2])->getDifferenceMap()->getBlendVertex(vertexId, expectedOffset);
+		CAL_TEST_CHECK(found == isMoved(vertexId));
+		if(!found) continue;
+
+		CalCoreSubMorphTarget::BlendVertex offset;
+		CAL_TEST_CHECK(pCompressedDiffMapMorphTarget->getDifferenceMap()->getBlendVertex(vertexId, offset));
+		if(!CAL_TEST_CHECK(isWithin(offset.position, expectedOffset.position, scaledPositionBound)))
+		{
+			std::fprintf(stderr, "scaled difference map vertex %d\n", vertexId);
+			break;
+		}
+
+		CAL_TEST_CHECK(pSharedMorphTarget->getDifferenceMap()->getBlendVertex(vertexId, offset));
+		CAL_TEST_CHECK(isWithin(offset.position, getBlendVertex(vertexId).position, positionBound));
+	}
+
+	// the blend vertices cached by the difference map morph targets follow
+	for(int morphTargetId = 2; morphTargetId < 4; ++morphTargetId)
+	{
+		CalCoreSubMorphTarget::BlendVertex blendVertex;
+		vectorMorphTarget[morphTargetId]->getBlendVertex(1, blendVertex);
+		CalVector expectedPosition = pCoreSubmesh->getVectorVertex()[1].position + getBlendVertex(1).position * factor;
+		CAL_TEST_CHECK(isWithin(blendVertex.position, expectedPosition, scaledPositionBound + CalVector(1.0e-5f, 1.0e-5f, 1.0e-5f)));
+	}
+
+	delete pSharedMorphTarget;
+	delete pCoreSubmesh;
+
+	return CalTest::result();
+}
+
+//****************************************************************************//
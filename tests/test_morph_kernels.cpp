@@ -0,0 +1,103 @@
+//****************************************************************************//
+// test_morph_kernels.cpp                                                     //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Checks that the SSE2 and AVX2 kernels selected by CalPlatform::setSimdLevel
+// blend morph targets and skin vertices like the scalar code, on a face mesh
+// with an odd vertex count and on the animated cally model with morph targets
+// on its head.
+
+#include "test.h"
+
+using namespace cal3d;
+
+namespace
+{
+	const float tolerance = 1e-5f;
+
+	// the vertices and normals of the face at the current SIMD level
+	void calculateFace(CalModel& model, CalSubmesh *pSubmesh, std::vector<float>& vectorVertex, std::vector<float>& vectorNormal)
+	{
+		vectorVertex.assign(pSubmesh->getVertexCount() * 3, 0.0f);
+		vectorNormal.assign(pSubmesh->getVertexCount() * 3, 0.0f);
+		model.getPhysique()->calculateVertices(pSubmesh, &vectorVertex[0]);
+		model.getPhysique()->calculateNormals(pSubmesh, &vectorNormal[0]);
+	}
+}
+
+int main()
+{
+	CalCoreModel faceCoreModel("face");
+	const int faceMeshId = CalTest::addFaceMesh(faceCoreModel, 2003, 20);
+	CalModel faceModel(&faceCoreModel);
+	faceModel.attachMesh(faceMeshId);
+	faceModel.update(0.0f);
+	CalSubmesh *pFaceSubmesh = faceModel.getMesh(faceMeshId)->getSubmesh(0);
+	CalTest::setMorphTargetWeights(pFaceSubmesh, true);
+
+	CalCoreModel coreModel("cally");
+	if(!CalTest::loadCally(coreModel)) return 1;
+	CalTest::addMorphTargets(coreModel.getCoreMesh(7)->getCoreSubmesh(0), 4, 3);
+
+	// adding the morph targets builds their spans, so the span kernels are the
+	// ones compared below
+	const CalCoreSubmesh *pCoreSubmeshes[2] = { faceCoreModel.getCoreMesh(faceMeshId)->getCoreSubmesh(0), coreModel.getCoreMesh(7)->getCoreSubmesh(0) };
+	for(int submeshId = 0; submeshId < 2; ++submeshId)
+	{
+		const std::vector<CalCoreSubMorphTarget *>& vectorMorphTarget = pCoreSubmeshes[submeshId]->getVectorCoreSubMorphTarget();
+		for(size_t morphTargetId = 0; morphTargetId < vectorMorphTarget.size(); ++morphTargetId)
+		{
+			CAL_TEST_CHECK(vectorMorphTarget[morphTargetId]->getVectorBlendVertexSpan() != 0);
+		}
+	}
+	CalModel model(&coreModel);
+	CalTest::attachAllMeshes(model);
+	CalSubmesh *pHeadSubmesh = model.getMesh(7)->getSubmesh(0);
+	for(int morphTargetId = 0; morphTargetId < 4; ++morphTargetId)
+	{
+		pHeadSubmesh->setMorphTargetWeight(morphTargetId, 0.1f * (morphTargetId + 1));
+	}
+	model.getMixer()->blendCycle(CalTest::CALLY_WALK, 1.0f, 0.0f);
+	model.update(0.3f);
+
+	const CalSimdLevel supportedLevel = CalPlatform::getSimdLevel();
+
+	// the scalar reference
+	CalPlatform::setSimdLevel(CAL_SIMD_SCALAR);
+	std::vector<float> vectorFaceVertex, vectorFaceNormal, vectorModelVertex;
+	calculateFace(faceModel, pFaceSubmesh, vectorFaceVertex, vectorFaceNormal);
+	CalTest::calculateModelVertices(model, vectorModelVertex);
+
+	static const CalSimdLevel level[] = { CAL_SIMD_SSE2, CAL_SIMD_AVX2 };
+	for(int levelId = 0; levelId < 2; ++levelId)
+	{
+		if(level[levelId] > supportedLevel) break;
+		CalPlatform::setSimdLevel(level[levelId]);
+		CAL_TEST_CHECK(CalPlatform::getSimdLevel() == level[levelId]);
+
+		std::vector<float> vectorVertex, vectorNormal;
+		calculateFace(faceModel, pFaceSubmesh, vectorVertex, vectorNormal);
+		CAL_TEST_CHECK(CalTest::maxRelativeError(vectorVertex, vectorFaceVertex) < tolerance);
+		CAL_TEST_CHECK(CalTest::maxRelativeError(vectorNormal, vectorFaceNormal) < tolerance);
+
+		CalTest::calculateModelVertices(model, vectorVertex);
+		CAL_TEST_CHECK(CalTest::maxRelativeError(vectorVertex, vectorModelVertex) < tolerance);
+	}
+	CalPlatform::setSimdLevel(supportedLevel);
+
+	// the morph targets do move the face
+	std::vector<float> vectorVertex, vectorNormal;
+	CalTest::setMorphTargetWeights(pFaceSubmesh, false);
+	calculateFace(faceModel, pFaceSubmesh, vectorVertex, vectorNormal);
+	CAL_TEST_CHECK(CalTest::maxRelativeError(vectorVertex, vectorFaceVertex) > tolerance);
+
+	return CalTest::result();
+}
+
+//****************************************************************************//
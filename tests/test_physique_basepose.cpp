@@ -0,0 +1,165 @@
+//****************************************************************************//
+// test_physique_basepose.cpp                                                 //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Checks that CalPhysique skins the vertices of a submesh with sparse morph
+// targets on top of its cached base pose like the full skinning path while
+// the bones stay still, and that moving the bones, changing the physique
+// settings, changing the level of detail or editing the morph targets drops
+// the cached base pose.
+
+#include "test.h"
+
+using namespace cal3d;
+
+namespace
+{
+	const float tolerance = 1e-5f;
+
+	// a physique exposing the two skinning paths
+	class TestPhysique : public CalPhysique
+	{
+	public:
+		TestPhysique(CalModel *pModel)
+			: CalPhysique(pModel)
+		{
+		}
+
+		bool calculateFromBasePose(CalSubmesh *pSubmesh, std::vector<float>& vectorVertex, int floatStride)
+		{
+			vectorVertex.assign(pSubmesh->getVertexCount() * floatStride + 3, 0.0f);
+			return calculateVerticesFromBasePose(pSubmesh, &vectorVertex[0], floatStride * sizeof(float));
+		}
+
+		void calculateSkinned(CalSubmesh *pSubmesh, std::vector<float>& vectorVertex, int floatStride)
+		{
+			vectorVertex.assign(pSubmesh->getVertexCount() * floatStride + 3, 0.0f);
+			calculateSkinnedVertices(pSubmesh, &vectorVertex[0], floatStride * sizeof(float), true);
+		}
+	};
+
+	// adds morph targets moving every ninth run of seven vertices, each target
+	// a different run
+	void addSparseMorphTargets(CalCoreSubmesh *pCoreSubmesh, int morphTargetCount)
+	{
+		const int vertexCount = pCoreSubmesh->getVertexCount();
+		for(int morphTargetId = 0; morphTargetId < morphTargetCount; ++morphTargetId)
+		{
+			CalCoreSubMorphTarget *pMorphTarget = new CalCoreSubMorphTarget();
+			pMorphTarget->reserve(vertexCount);
+			for(int vertexId = 0; vertexId < vertexCount; ++vertexId)
+			{
+				CalCoreSubMorphTarget::BlendVertex blendVertex;
+				blendVertex.position.set(0.0f, 0.0f, 0.0f);
+				blendVertex.normal.set(0.0f, 0.0f, 0.0f);
+				if((vertexId / 7 + morphTargetId) % 9 == 0)
+				{
+					blendVertex.position.set(0.5f * morphTargetId + 1.0f, 0.02f * vertexId, -0.3f);
+				}
+				pMorphTarget->setBlendVertex(vertexId, blendVertex);
+			}
+			pCoreSubmesh->addCoreSubMorphTarget(pMorphTarget);
+		}
+	}
+
+	// checks that the cached base pose gives the vertices of the full path
+	bool matchesSkinned(TestPhysique& physique, CalSubmesh *pSubmesh)
+	{
+		static const int floatStride[] = { 3, 8 };
+		for(int strideId = 0; strideId < 2; ++strideId)
+		{
+			std::vector<float> vectorVertex, vectorSkinnedVertex;
+			if(!physique.calculateFromBasePose(pSubmesh, vectorVertex, floatStride[strideId])) return false;
+			physique.calculateSkinned(pSubmesh, vectorSkinnedVertex, floatStride[strideId]);
+			if(CalTest::maxRelativeError(vectorVertex, vectorSkinnedVertex) > tolerance) return false;
+		}
+		return true;
+	}
+
+	// checks that the base pose is dropped, and skinned again by the call after
+	bool dropsBasePose(TestPhysique& physique, CalSubmesh *pSubmesh)
+	{
+		std::vector<float> vectorVertex;
+		if(physique.calculateFromBasePose(pSubmesh, vectorVertex, 3)) return false;
+		if(!pSubmesh->getBasePoseCache().vectorPosition.empty()) return false;
+		return matchesSkinned(physique, pSubmesh);
+	}
+}
+
+int main()
+{
+	CalCoreModel coreModel("cally");
+	if(!CalTest::loadCally(coreModel)) return 1;
+
+	// the chest
+	const int meshId = 2;
+	const int morphTargetCount = 4;
+	addSparseMorphTargets(coreModel.getCoreMesh(meshId)->getCoreSubmesh(0), morphTargetCount);
+
+	CalModel model(&coreModel);
+	model.attachMesh(meshId);
+	model.getMixer()->blendCycle(CalTest::CALLY_WALK, 1.0f, 0.0f);
+	model.update(0.1f);
+
+	CalSubmesh *pSubmesh = model.getMesh(meshId)->getSubmesh(0);
+	TestPhysique physique(&model);
+
+	// the first call only remembers the bones, the next ones use the base pose
+	std::vector<float> vectorVertex;
+	CAL_TEST_CHECK(!physique.calculateFromBasePose(pSubmesh, vectorVertex, 3));
+
+	static const float weight[][morphTargetCount] =
+	{
+		{ 0.5f, 0.0f, 0.0f, 0.0f },
+		{ 0.2f, -0.3f, 0.7f, 0.0f },
+		{ 0.0f, 0.0f, 0.0f, 0.0f },
+		{ 1.0f, 1.0f, 1.0f, 1.0f }
+	};
+	for(int weightId = 0; weightId < 4; ++weightId)
+	{
+		for(int morphTargetId = 0; morphTargetId < morphTargetCount; ++morphTargetId)
+		{
+			pSubmesh->setMorphTargetWeight(morphTargetId, weight[weightId][morphTargetId]);
+		}
+		CAL_TEST_CHECK(matchesSkinned(physique, pSubmesh));
+	}
+	CAL_TEST_CHECK(!pSubmesh->getBasePoseCache().vectorPosition.empty());
+
+	// an update that leaves the bones alone keeps the base pose
+	model.update(0.0f);
+	CAL_TEST_CHECK(matchesSkinned(physique, pSubmesh));
+
+	// moving the bones drops it
+	model.update(0.3f);
+	CAL_TEST_CHECK(dropsBasePose(physique, pSubmesh));
+
+	// so does changing a setting of the physique
+	physique.setNormalization(false);
+	CAL_TEST_CHECK(dropsBasePose(physique, pSubmesh));
+
+	// or the level of detail
+	const int vertexCount = pSubmesh->getVertexCount();
+	model.setLodLevel(0.5f);
+	if(CAL_TEST_CHECK(pSubmesh->getVertexCount() < vertexCount))
+	{
+		CAL_TEST_CHECK(dropsBasePose(physique, pSubmesh));
+	}
+	model.setLodLevel(1.0f);
+	CAL_TEST_CHECK(dropsBasePose(physique, pSubmesh));
+
+	// morph targets edited since their spans were built go the full path
+	pSubmesh->getCoreSubmesh()->getVectorCoreSubMorphTarget()[0]->getVectorBlendVertex();
+	CAL_TEST_CHECK(!physique.calculateFromBasePose(pSubmesh, vectorVertex, 3));
+	pSubmesh->getCoreSubmesh()->getVectorCoreSubMorphTarget()[0]->updateSparseBlendVertices();
+	CAL_TEST_CHECK(matchesSkinned(physique, pSubmesh));
+
+	return CalTest::result();
+}
+
+//****************************************************************************//
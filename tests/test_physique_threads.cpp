@@ -0,0 +1,147 @@
+//****************************************************************************//
+// test_physique_threads.cpp                                                  //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Skins independent models that share one core model on several threads and
+// checks that every thread produces exactly what a serial run produces. The
+// models play different cycles, hold still on some frames and blend sparse
+// morph targets, so that the per-submesh caches written by calculateVertices
+// are exercised as well.
+
+#include "test.h"
+
+#ifdef CAL3D_THREADS
+#include <thread>
+#endif
+
+using namespace cal3d;
+
+namespace
+{
+	const int ModelCount = 16;
+	const int FrameCount = 60;
+	const int ThreadCount = 4;
+	const int RoundCount = 5;
+
+	const int HeadMeshId = 7;
+	const int MorphTargetCount = 6;
+
+	void setupModel(CalModel& model, int modelId)
+	{
+		static const int cycle[] = { CalTest::CALLY_IDLE, CalTest::CALLY_WALK, CalTest::CALLY_JOG, CalTest::CALLY_STRUT };
+
+		CalTest::attachAllMeshes(model);
+		model.getMixer()->blendCycle(cycle[modelId % 4], 1.0f, 0.0f);
+		if(modelId % 3 == 0)
+		{
+			model.getMixer()->blendCycle(cycle[(modelId + 1) % 4], 0.5f, 0.0f);
+		}
+	}
+
+	void runModel(CalModel& model, int modelId, std::vector<float>& vectorResult)
+	{
+		CalSubmesh *pHead = model.getMesh(HeadMeshId)->getSubmesh(0);
+		std::vector<float> vectorPosition;
+
+		vectorResult.clear();
+
+		int frameId;
+		for(frameId = 0; frameId < FrameCount; ++frameId)
+		{
+			// every third frame holds the pose, so the cached paths kick in
+			model.update((frameId % 3 == 2) ? 0.0f : 0.033f + 0.001f * modelId);
+
+			int morphTargetId;
+			for(morphTargetId = 0; morphTargetId < MorphTargetCount; ++morphTargetId)
+			{
+				bool active = ((frameId / 4 + morphTargetId + modelId) % 3) == 0;
+				pHead->setMorphTargetWeight(morphTargetId, active ? 0.1f * (morphTargetId + 1) : 0.0f);
+			}
+
+			// skin twice: the second call may be served from the caches
+			CalTest::calculateModelVertices(model, vectorPosition);
+			vectorResult.insert(vectorResult.end(), vectorPosition.begin(), vectorPosition.end());
+			CalTest::calculateModelVertices(model, vectorPosition);
+			vectorResult.insert(vectorResult.end(), vectorPosition.begin(), vectorPosition.end());
+		}
+	}
+
+#ifdef CAL3D_THREADS
+	void runThread(CalModel **ppModel, std::vector<float> *pvectorResult, int threadId)
+	{
+		int modelId;
+		for(modelId = threadId; modelId < ModelCount; modelId += ThreadCount)
+		{
+			runModel(*ppModel[modelId], modelId, pvectorResult[modelId]);
+		}
+	}
+#endif
+}
+
+int main()
+{
+#ifndef CAL3D_THREADS
+	std::printf("built without thread support, skipping\n");
+	return CAL_TEST_SKIP;
+#else
+	CalCoreModel coreModel("cally");
+	if(!CalTest::loadCally(coreModel)) return 1;
+
+	CalCoreMesh *pCoreHead = coreModel.getCoreMesh(HeadMeshId);
+	CalTest::addMorphTargets(pCoreHead->getCoreSubmesh(0), MorphTargetCount, 5);
+
+	// serial reference
+	std::vector<float> vectorSerial[ModelCount];
+	int modelId;
+	for(modelId = 0; modelId < ModelCount; ++modelId)
+	{
+		CalModel model(&coreModel);
+		setupModel(model, modelId);
+		runModel(model, modelId, vectorSerial[modelId]);
+		CAL_TEST_CHECK(!vectorSerial[modelId].empty());
+	}
+
+	int roundId;
+	for(roundId = 0; roundId < RoundCount; ++roundId)
+	{
+		CalModel *pModel[ModelCount];
+		for(modelId = 0; modelId < ModelCount; ++modelId)
+		{
+			pModel[modelId] = new CalModel(&coreModel);
+			setupModel(*pModel[modelId], modelId);
+		}
+
+		std::vector<float> vectorThreaded[ModelCount];
+		std::vector<std::thread> vectorThread;
+		int threadId;
+		for(threadId = 0; threadId < ThreadCount; ++threadId)
+		{
+			vectorThread.push_back(std::thread(runThread, pModel, vectorThreaded, threadId));
+		}
+		for(threadId = 0; threadId < ThreadCount; ++threadId)
+		{
+			vectorThread[threadId].join();
+		}
+
+		for(modelId = 0; modelId < ModelCount; ++modelId)
+		{
+			if(!CAL_TEST_CHECK(vectorThreaded[modelId] == vectorSerial[modelId]))
+			{
+				std::fprintf(stderr, "round %d model %d: max relative error %g\n", roundId, modelId,
+				             CalTest::maxRelativeError(vectorThreaded[modelId], vectorSerial[modelId]));
+			}
+			delete pModel[modelId];
+		}
+	}
+
+	return CalTest::result();
+#endif
+}
+
+//****************************************************************************//
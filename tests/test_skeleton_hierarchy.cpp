@@ -0,0 +1,74 @@
+//****************************************************************************//
+// test_skeleton_hierarchy.cpp                                                //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Moves a bone of a loaded skeleton to another parent and checks that the
+// skeleton follows the new hierarchy, both before and after the bone order of
+// the core skeleton is calculated again.
+
+#include "test.h"
+
+using namespace cal3d;
+
+namespace
+{
+	// checks that a bone sits where its relative state puts it below its parent
+	bool checkBone(const CalSkeleton *pSkeleton, int boneId)
+	{
+		const CalBone *pBone = pSkeleton->getBone(boneId);
+		const CalBone *pParent = pSkeleton->getBone(pBone->getCoreBone()->getParentId());
+
+		CalVector translation = pBone->getTranslation();
+		translation *= pParent->getRotationAbsolute();
+		translation += pParent->getTranslationAbsolute();
+
+		CalVector difference = translation - pBone->getTranslationAbsolute();
+		return difference.length() < 1e-3f * (1.0f + translation.length());
+	}
+}
+
+int main()
+{
+	CalCoreModel coreModel("cally");
+	if(!CalTest::loadCally(coreModel)) return 1;
+
+	CalCoreSkeleton *pCoreSkeleton = coreModel.getCoreSkeleton();
+	const int boneId = pCoreSkeleton->getCoreBoneId("Cally Ponytail1");
+	const int newParentId = pCoreSkeleton->getCoreBoneId("Cally Pelvis");
+	if(!CAL_TEST_CHECK(boneId != -1 && newParentId != -1)) return CalTest::result();
+
+	CalModel model(&coreModel);
+	model.getMixer()->blendCycle(CalTest::CALLY_WALK, 1.0f, 0.0f);
+	model.update(0.1f);
+	CAL_TEST_CHECK(checkBone(model.getSkeleton(), boneId));
+	CAL_TEST_CHECK(pCoreSkeleton->getVectorParentId().size() == pCoreSkeleton->getVectorCoreBone().size());
+
+	// move the bone below the pelvis
+	CalCoreBone *pCoreBone = pCoreSkeleton->getCoreBone(boneId);
+	CAL_TEST_CHECK(pCoreSkeleton->getCoreBone(pCoreBone->getParentId())->removeChildId(boneId));
+	pCoreSkeleton->getCoreBone(newParentId)->addChildId(boneId);
+	pCoreBone->setParentId(newParentId);
+	CAL_TEST_CHECK(pCoreSkeleton->getVectorBoneOrder().empty());
+
+	model.getMixer()->invalidateSkeleton();
+	model.update(0.1f);
+	CAL_TEST_CHECK(checkBone(model.getSkeleton(), boneId));
+
+	// the bone order is back after calculating the core skeleton again
+	pCoreSkeleton->calculateState();
+	CAL_TEST_CHECK(pCoreSkeleton->getVectorParentId()[boneId] == newParentId);
+
+	model.getMixer()->invalidateSkeleton();
+	model.update(0.1f);
+	CAL_TEST_CHECK(checkBone(model.getSkeleton(), boneId));
+
+	return CalTest::result();
+}
+
+//****************************************************************************//
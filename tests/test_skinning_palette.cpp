@@ -0,0 +1,121 @@
+//****************************************************************************//
+// test_skinning_palette.cpp                                                  //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Checks the skinning palettes written by CalSkeleton::getSkinningPalette, for
+// all bones and for a list of bones, in both layouts, against the transform
+// matrix and the bone space translation of every bone, and that an invalid
+// bone id is rejected.
+
+#include "test.h"
+
+#include <algorithm>
+
+using namespace cal3d;
+
+namespace
+{
+	// checks one palette entry against the state of a bone
+	bool checkEntry(const float *pEntry, const CalBone *pBone, CalSkinningPaletteLayout layout)
+	{
+		const CalMatrix& m = pBone->getTransformMatrix();
+		const CalVector& t = pBone->getTranslationBoneSpace();
+
+		if(layout == CAL_SKINNING_PALETTE_ROW_MAJOR_3X4)
+		{
+			const float expected[12] =
+			{
+				m.dxdx, m.dxdy, m.dxdz, t.x,
+				m.dydx, m.dydy, m.dydz, t.y,
+				m.dzdx, m.dzdy, m.dzdz, t.z
+			};
+			return std::equal(expected, expected + 12, pEntry);
+		}
+
+		const float expected[12] =
+		{
+			m.dxdx, m.dydx, m.dzdx,
+			m.dxdy, m.dydy, m.dzdy,
+			m.dxdz, m.dydz, m.dzdz,
+			t.x,    t.y,    t.z
+		};
+		return std::equal(expected, expected + 12, pEntry);
+	}
+}
+
+int main()
+{
+	CalCoreModel coreModel("cally");
+	if(!CalTest::loadCally(coreModel)) return 1;
+
+	CalModel model(&coreModel);
+	model.getMixer()->blendCycle(CalTest::CALLY_WALK, 1.0f, 0.0f);
+	model.update(0.4f);
+
+	const CalSkeleton *pSkeleton = model.getSkeleton();
+	const int boneCount = (int)pSkeleton->getVectorBone().size();
+
+	// a bone list out of order, with a repeated bone
+	std::vector<int> vectorBoneId;
+	vectorBoneId.push_back(boneCount - 1);
+	vectorBoneId.push_back(0);
+	vectorBoneId.push_back(boneCount / 2);
+	vectorBoneId.push_back(0);
+
+	static const CalSkinningPaletteLayout layout[] = { CAL_SKINNING_PALETTE_ROW_MAJOR_3X4, CAL_SKINNING_PALETTE_COLUMN_MAJOR_3X4 };
+	for(int layoutId = 0; layoutId < 2; ++layoutId)
+	{
+		// all bones, in bone id order
+		std::vector<float> vectorPalette(12 * boneCount, -1.0f);
+		CAL_TEST_CHECK(pSkeleton->getSkinningPalette(&vectorPalette[0], layout[layoutId]) == boneCount);
+		for(int boneId = 0; boneId < boneCount; ++boneId)
+		{
+			if(!CAL_TEST_CHECK(checkEntry(&vectorPalette[12 * boneId], pSkeleton->getBone(boneId), layout[layoutId])))
+			{
+				std::fprintf(stderr, "layout %d, bone %d\n", layoutId, boneId);
+				break;
+			}
+		}
+
+		// a list of bones, through both overloads
+		std::vector<float> vectorListPalette(12 * vectorBoneId.size(), -1.0f);
+		CAL_TEST_CHECK(pSkeleton->getSkinningPalette(&vectorListPalette[0], vectorBoneId, layout[layoutId]) == (int)vectorBoneId.size());
+		std::vector<float> vectorPointerPalette(12 * vectorBoneId.size(), -1.0f);
+		CAL_TEST_CHECK(pSkeleton->getSkinningPalette(&vectorPointerPalette[0], &vectorBoneId[0], (int)vectorBoneId.size(), layout[layoutId]) == (int)vectorBoneId.size());
+		CAL_TEST_CHECK(vectorPointerPalette == vectorListPalette);
+		for(size_t entryId = 0; entryId < vectorBoneId.size(); ++entryId)
+		{
+			CAL_TEST_CHECK(checkEntry(&vectorListPalette[12 * entryId], pSkeleton->getBone(vectorBoneId[entryId]), layout[layoutId]));
+		}
+	}
+
+	// the default layout is row-major
+	std::vector<float> vectorPalette(12 * boneCount), vectorRowMajorPalette(12 * boneCount);
+	pSkeleton->getSkinningPalette(&vectorPalette[0]);
+	pSkeleton->getSkinningPalette(&vectorRowMajorPalette[0], CAL_SKINNING_PALETTE_ROW_MAJOR_3X4);
+	CAL_TEST_CHECK(vectorPalette == vectorRowMajorPalette);
+
+	// an invalid bone id fails the whole list
+	const int invalidBoneId[] = { -1, boneCount };
+	for(int invalidId = 0; invalidId < 2; ++invalidId)
+	{
+		std::vector<int> vectorInvalidBoneId(vectorBoneId);
+		vectorInvalidBoneId[2] = invalidBoneId[invalidId];
+		std::vector<float> vectorListPalette(12 * vectorInvalidBoneId.size());
+		CAL_TEST_CHECK(pSkeleton->getSkinningPalette(&vectorListPalette[0], vectorInvalidBoneId) == -1);
+		CAL_TEST_CHECK(CalError::getLastErrorCode() == CalError::INVALID_HANDLE);
+	}
+
+	// an empty list writes nothing
+	CAL_TEST_CHECK(pSkeleton->getSkinningPalette(&vectorPalette[0], std::vector<int>()) == 0);
+
+	return CalTest::result();
+}
+
+//****************************************************************************//
@@ -0,0 +1,172 @@
+//****************************************************************************//
+// test_update_rate.cpp                                                       //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Checks the update-rate LOD of CalModel against a model updated at the full
+// rate: the pose is interpolated between the last two evaluated poses, one
+// interval behind the animations, pausing the model does not move it, and a
+// pose that holds still leaves the skeleton state version alone.
+
+#include "test.h"
+
+using namespace cal3d;
+
+namespace
+{
+	// the relative bone states of a skeleton
+	struct Pose
+	{
+		std::vector<CalVector> vectorTranslation;
+		std::vector<CalQuaternion> vectorRotation;
+	};
+
+	void getPose(const CalSkeleton *pSkeleton, Pose& pose)
+	{
+		const CalBoneStateArrays& boneState = pSkeleton->getBoneState();
+		pose.vectorTranslation.assign(boneState.pTranslation, boneState.pTranslation + boneState.getBoneCount());
+		pose.vectorRotation.assign(boneState.pRotation, boneState.pRotation + boneState.getBoneCount());
+	}
+
+	bool samePose(const Pose& pose, const Pose& referencePose)
+	{
+		return pose.vectorTranslation == referencePose.vectorTranslation && pose.vectorRotation == referencePose.vectorRotation;
+	}
+
+	// the pose a factor of the way from one pose to another, as the model blends it
+	void blendPose(const Pose& pose, const Pose& otherPose, float factor, Pose& blendedPose)
+	{
+		blendedPose = pose;
+		for(size_t boneId = 0; boneId < pose.vectorTranslation.size(); ++boneId)
+		{
+			blendedPose.vectorTranslation[boneId].blend(factor, otherPose.vectorTranslation[boneId]);
+			blendedPose.vectorRotation[boneId].blend(factor, otherPose.vectorRotation[boneId]);
+		}
+	}
+
+	bool isNear(float value, float referenceValue)
+	{
+		return std::fabs(value - referenceValue) <= 1.0e-4f * (1.0f + std::fabs(referenceValue));
+	}
+
+	bool nearPose(const Pose& pose, const Pose& referencePose)
+	{
+		for(size_t boneId = 0; boneId < pose.vectorTranslation.size(); ++boneId)
+		{
+			const CalVector& translation = pose.vectorTranslation[boneId];
+			const CalVector& referenceTranslation = referencePose.vectorTranslation[boneId];
+			const CalQuaternion& rotation = pose.vectorRotation[boneId];
+			const CalQuaternion& referenceRotation = referencePose.vectorRotation[boneId];
+			if(!isNear(translation.x, referenceTranslation.x) || !isNear(translation.y, referenceTranslation.y)
+				|| !isNear(translation.z, referenceTranslation.z)) return false;
+			if(!isNear(rotation.x, referenceRotation.x) || !isNear(rotation.y, referenceRotation.y)
+				|| !isNear(rotation.z, referenceRotation.z) || !isNear(rotation.w, referenceRotation.w)) return false;
+		}
+		return true;
+	}
+}
+
+int main()
+{
+	CalCoreModel coreModel("cally");
+	if(!CalTest::loadCally(coreModel)) return 1;
+
+	CalModel model(&coreModel);
+	CalModel referenceModel(&coreModel);
+	model.setUpdateInterval(3);
+	model.getMixer()->blendCycle(CalTest::CALLY_WALK, 1.0f, 0.0f);
+	referenceModel.getMixer()->blendCycle(CalTest::CALLY_WALK, 1.0f, 0.0f);
+
+	// every third update is evaluated; the model shows the pose evaluated one
+	// interval before, and moves towards the last evaluated one in between
+	const float deltaTime = 1.0f / 30.0f;
+	std::vector<Pose> vectorReferencePose;
+	Pose pose, expectedPose;
+	int frame;
+	for(frame = 0; frame < 60; ++frame)
+	{
+		model.update(deltaTime);
+		referenceModel.update(deltaTime);
+		getPose(model.getSkeleton(), pose);
+		vectorReferencePose.push_back(Pose());
+		getPose(referenceModel.getSkeleton(), vectorReferencePose.back());
+
+		const int evaluationFrame = frame - frame % 3;
+		if(evaluationFrame == 0)
+		{
+			// nothing to interpolate from yet
+			CAL_TEST_CHECK(samePose(pose, vectorReferencePose[0]));
+		}
+		else if(frame == evaluationFrame)
+		{
+			CAL_TEST_CHECK(samePose(pose, vectorReferencePose[frame - 3]));
+		}
+		else
+		{
+			blendPose(vectorReferencePose[evaluationFrame - 3], vectorReferencePose[evaluationFrame], (frame % 3) / 3.0f, expectedPose);
+			if(!CAL_TEST_CHECK(nearPose(pose, expectedPose)))
+			{
+				std::fprintf(stderr, "frame %d\n", frame);
+			}
+		}
+	}
+
+	// pausing the model between two evaluations neither moves the pose nor
+	// touches the skeleton, however many updates pass
+	model.update(deltaTime);
+	referenceModel.update(deltaTime);
+	getPose(model.getSkeleton(), expectedPose);
+	const unsigned int stateVersion = model.getSkeleton()->getStateVersion();
+	for(frame = 0; frame < 10; ++frame)
+	{
+		model.update(0.0f);
+		getPose(model.getSkeleton(), pose);
+		CAL_TEST_CHECK(samePose(pose, expectedPose));
+		CAL_TEST_CHECK(model.getSkeleton()->getStateVersion() == stateVersion);
+	}
+
+	// a pose holding still is only set once it stops moving
+	CalModel stillModel(&coreModel);
+	stillModel.setUpdateInterval(2);
+	for(frame = 0; frame < 4; ++frame)
+	{
+		stillModel.update(deltaTime);
+	}
+	const unsigned int stillStateVersion = stillModel.getSkeleton()->getStateVersion();
+	for(frame = 0; frame < 6; ++frame)
+	{
+		stillModel.update(deltaTime);
+		if(frame % 2 == 1) continue;
+		CAL_TEST_CHECK(stillModel.getSkeleton()->getStateVersion() == stillStateVersion);
+	}
+
+	// the frequency counts animation time
+	model.setUpdateFrequency(10.0f);
+	vectorReferencePose.clear();
+	for(frame = 0; frame < 20; ++frame)
+	{
+		model.update(0.05f);
+		referenceModel.update(0.05f);
+		getPose(model.getSkeleton(), pose);
+		vectorReferencePose.push_back(Pose());
+		getPose(referenceModel.getSkeleton(), vectorReferencePose.back());
+		if(frame >= 2 && frame % 2 == 0)
+		{
+			CAL_TEST_CHECK(samePose(pose, vectorReferencePose[frame - 2]));
+		}
+		else if(frame >= 2)
+		{
+			blendPose(vectorReferencePose[frame - 3], vectorReferencePose[frame - 1], 0.5f, expectedPose);
+			CAL_TEST_CHECK(nearPose(pose, expectedPose));
+		}
+	}
+
+	return CalTest::result();
+}
+
+//****************************************************************************//
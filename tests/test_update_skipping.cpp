@@ -0,0 +1,314 @@
+//****************************************************************************//
+// test_update_skipping.cpp                                                   //
+// Copyright (C) 2001, 2002 Bruno 'Beosil' Heidelberger                       //
+//****************************************************************************//
+// This library is free software; you can redistribute it and/or modify it    //
+// under the terms of the GNU Lesser General Public License as published by   //
+// the Free Software Foundation; either version 2.1 of the License, or (at    //
+// your option) any later version.                                            //
+//****************************************************************************//
+
+// Checks the work CalMixer::updateSkeleton and the vertex cache of CalRenderer
+// skip when their inputs did not change. A model that skips is run next to a
+// model that never does, and their skeletons and vertices must stay exactly
+// the same: across paused frames, weight changes, bone adjustments, bone
+// masks, direct edits of the bones, morph target weights, physique settings
+// and LOD changes.
+
+#include "test.h"
+
+using namespace cal3d;
+
+namespace
+{
+	const int HeadMeshId = 7;
+	const int MorphTargetCount = 4;
+
+	// a mixer whose bone adjustments read state the mixer cannot see
+	class TiltMixer : public CalMixer
+	{
+	public:
+		TiltMixer(CalModel *pModel, int boneId)
+			: CalMixer(pModel)
+			, m_boneId(boneId)
+			, m_tiltWeight(0.0f)
+		{
+		}
+
+		void setTilt(const CalQuaternion& tilt, float weight)
+		{
+			m_tilt = tilt;
+			m_tiltWeight = weight;
+		}
+
+	protected:
+		virtual void applyBoneAdjustments()
+		{
+			CalMixer::applyBoneAdjustments();
+			if(m_tiltWeight > 0.0f)
+			{
+				const CalCoreBone *pCoreBone = m_pModel->getSkeleton()->getBone(m_boneId)->getCoreBone();
+				blendBoneState(m_boneId, 1.0f, pCoreBone->getTranslation(), m_tilt, 1.0f, true, m_tiltWeight, true);
+			}
+		}
+
+	private:
+		int m_boneId;
+		CalQuaternion m_tilt;
+		float m_tiltWeight;
+	};
+
+	TiltMixer *setTiltMixer(CalModel& model, int boneId)
+	{
+		CalMixer *pDefaultMixer = model.getMixer();
+		TiltMixer *pMixer = new TiltMixer(&model, boneId);
+		model.setAbstractMixer(pMixer);
+		delete pDefaultMixer;
+		return pMixer;
+	}
+
+	bool sameSkeleton(const CalSkeleton *pSkeleton, const CalSkeleton *pReferenceSkeleton)
+	{
+		const std::vector<CalBone *>& vectorBone = pSkeleton->getVectorBone();
+		for(size_t boneId = 0; boneId < vectorBone.size(); ++boneId)
+		{
+			const CalBone *pBone = vectorBone[boneId];
+			const CalBone *pReferenceBone = pReferenceSkeleton->getBone((int)boneId);
+			if(!(pBone->getTranslation() == pReferenceBone->getTranslation())
+				|| !(pBone->getRotation() == pReferenceBone->getRotation())
+				|| !(pBone->getTranslationAbsolute() == pReferenceBone->getTranslationAbsolute())
+				|| !(pBone->getRotationAbsolute() == pReferenceBone->getRotationAbsolute()))
+			{
+				std::fprintf(stderr, "bone %d differs\n", (int)boneId);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// updates both models, the reference without skipping, and checks whether
+	// the model skipped its skeleton update
+	bool update(CalModel& model, CalModel& referenceModel, float deltaTime, bool skipExpected)
+	{
+		CalMixer *pMixer = model.getMixer();
+		int skippedUpdateCount = pMixer->getNumSkippedSkeletonUpdates();
+
+		model.update(deltaTime);
+		referenceModel.getMixer()->invalidateSkeleton();
+		referenceModel.update(deltaTime);
+
+		bool skipped = pMixer->getNumSkippedSkeletonUpdates() != skippedUpdateCount;
+		bool sameState = CAL_TEST_CHECK(sameSkeleton(model.getSkeleton(), referenceModel.getSkeleton()));
+		return CAL_TEST_CHECK(skipped == skipExpected) && sameState;
+	}
+
+	void testSkeletonSkipping(CalCoreModel& coreModel)
+	{
+		CalCoreSkeleton *pCoreSkeleton = coreModel.getCoreSkeleton();
+		const int headBoneId = pCoreSkeleton->getCoreBoneId("Cally Head");
+		const int neckBoneId = pCoreSkeleton->getCoreBoneId("Cally Neck");
+		const int spineBoneId = pCoreSkeleton->getCoreBoneId("Cally Spine2");
+		if(!CAL_TEST_CHECK(headBoneId != -1 && neckBoneId != -1 && spineBoneId != -1)) return;
+
+		CalModel model(&coreModel);
+		CalModel referenceModel(&coreModel);
+		TiltMixer *pMixer = setTiltMixer(model, neckBoneId);
+		TiltMixer *pReferenceMixer = setTiltMixer(referenceModel, neckBoneId);
+
+		// a paused model keeps its skeleton
+		pMixer->blendCycle(CalTest::CALLY_IDLE, 1.0f, 0.0f);
+		pReferenceMixer->blendCycle(CalTest::CALLY_IDLE, 1.0f, 0.0f);
+		update(model, referenceModel, 0.05f, false);
+		update(model, referenceModel, 0.0f, true);
+		update(model, referenceModel, 0.0f, true);
+
+		// a cycle fading in changes the weights while the time runs
+		pMixer->blendCycle(CalTest::CALLY_WALK, 0.5f, 0.2f);
+		pReferenceMixer->blendCycle(CalTest::CALLY_WALK, 0.5f, 0.2f);
+		update(model, referenceModel, 0.1f, false);
+		update(model, referenceModel, 0.0f, true);
+		update(model, referenceModel, 0.1f, false);
+
+		// bone adjustments
+		BoneAdjustment boneAdjustment;
+		boneAdjustment.flags_ = BoneAdjustment::FlagPosRot;
+		boneAdjustment.localOri_ = CalQuaternion(0.0f, 0.0f, 0.2f, 0.98f);
+		boneAdjustment.rampValue_ = 0.5f;
+		pMixer->addBoneAdjustment(headBoneId, boneAdjustment);
+		pReferenceMixer->addBoneAdjustment(headBoneId, boneAdjustment);
+		update(model, referenceModel, 0.0f, false);
+		update(model, referenceModel, 0.0f, true);
+		pMixer->removeBoneAdjustment(headBoneId);
+		pReferenceMixer->removeBoneAdjustment(headBoneId);
+		update(model, referenceModel, 0.0f, false);
+
+		// bone masks
+		std::vector<std::string> vectorRootName(1, "Cally Spine1");
+		std::vector<float> vectorBoneWeight;
+		pCoreSkeleton->calculateBoneMaskBySubtree(vectorRootName, 0.5f, vectorBoneWeight);
+		pMixer->setBoneMask(CalTest::CALLY_WALK, vectorBoneWeight);
+		pReferenceMixer->setBoneMask(CalTest::CALLY_WALK, vectorBoneWeight);
+		update(model, referenceModel, 0.0f, false);
+		update(model, referenceModel, 0.0f, true);
+		pMixer->clearBoneMask(CalTest::CALLY_WALK);
+		pReferenceMixer->clearBoneMask(CalTest::CALLY_WALK);
+		update(model, referenceModel, 0.0f, false);
+
+		// a direct edit of a bone is noticed and blended over
+		model.getSkeleton()->getBone(spineBoneId)->setRotation(CalQuaternion(0.3f, 0.0f, 0.0f, 0.95f));
+		model.getSkeleton()->calculateState();
+		update(model, referenceModel, 0.0f, false);
+		update(model, referenceModel, 0.0f, true);
+
+		// what an override of applyBoneAdjustments reads is not seen by the
+		// mixer: the skeleton only follows after invalidateSkeleton
+		CalQuaternion tilt(0.0f, 0.25f, 0.0f, 0.97f);
+		pMixer->setTilt(tilt, 0.8f);
+		pReferenceMixer->setTilt(tilt, 0.8f);
+		int skippedUpdateCount = pMixer->getNumSkippedSkeletonUpdates();
+		model.update(0.0f);
+		CAL_TEST_CHECK(pMixer->getNumSkippedSkeletonUpdates() == skippedUpdateCount + 1);
+		pMixer->invalidateSkeleton();
+		update(model, referenceModel, 0.0f, false);
+		update(model, referenceModel, 0.0f, true);
+
+		// the time runs again
+		update(model, referenceModel, 0.05f, false);
+	}
+
+	// fetches the vertex data of every submesh through the renderer
+	void fetchVertexData(CalModel& model, std::vector<float>& vectorData)
+	{
+		CalRenderer *pRenderer = model.getRenderer();
+		vectorData.clear();
+
+		pRenderer->beginRendering();
+		int meshId;
+		for(meshId = 0; meshId < pRenderer->getMeshCount(); ++meshId)
+		{
+			int submeshId;
+			for(submeshId = 0; submeshId < pRenderer->getSubmeshCount(meshId); ++submeshId)
+			{
+				pRenderer->selectMeshSubmesh(meshId, submeshId);
+				int vertexCount = pRenderer->getVertexCount();
+				std::vector<float> vectorBuffer(vertexCount * 8 + 8);
+
+				// packed vertices, normals with a stride, then both interleaved
+				int count = pRenderer->getVertices(&vectorBuffer[0]);
+				vectorData.insert(vectorData.end(), vectorBuffer.begin(), vectorBuffer.begin() + count * 3);
+				count = pRenderer->getNormals(&vectorBuffer[0], 8 * sizeof(float));
+				for(int vertexId = 0; vertexId < count; ++vertexId)
+				{
+					vectorData.insert(vectorData.end(), vectorBuffer.begin() + vertexId * 8, vectorBuffer.begin() + vertexId * 8 + 3);
+				}
+				count = pRenderer->getVerticesAndNormals(&vectorBuffer[0]);
+				vectorData.insert(vectorData.end(), vectorBuffer.begin(), vectorBuffer.begin() + count * 6);
+			}
+		}
+		pRenderer->endRendering();
+	}
+
+	void testVertexCache(CalCoreModel& coreModel)
+	{
+		CalModel model(&coreModel);
+		CalModel referenceModel(&coreModel);
+		CalTest::attachAllMeshes(model);
+		CalTest::attachAllMeshes(referenceModel);
+		model.getRenderer()->setVertexCacheOn(true);
+
+		model.getMixer()->blendCycle(CalTest::CALLY_JOG, 1.0f, 0.0f);
+		referenceModel.getMixer()->blendCycle(CalTest::CALLY_JOG, 1.0f, 0.0f);
+
+		CalSubmesh *pHead = model.getMesh(HeadMeshId)->getSubmesh(0);
+		CalSubmesh *pReferenceHead = referenceModel.getMesh(HeadMeshId)->getSubmesh(0);
+
+		std::vector<float> vectorData;
+		std::vector<float> vectorReferenceData;
+
+		const int FrameCount = 12;
+		int frameId;
+		for(frameId = 0; frameId < FrameCount; ++frameId)
+		{
+			bool paused = (frameId % 2 == 1);
+			bool changed = !paused;
+
+			model.update(paused ? 0.0f : 0.04f);
+			referenceModel.update(paused ? 0.0f : 0.04f);
+
+			switch(frameId)
+			{
+			case 3:
+				pHead->setMorphTargetWeight(1, 0.6f);
+				pReferenceHead->setMorphTargetWeight(1, 0.6f);
+				break;
+			case 5:
+				model.getPhysique()->setNormalization(false);
+				referenceModel.getPhysique()->setNormalization(false);
+				changed = true;
+				break;
+			case 7:
+				model.setLodLevel(0.5f);
+				referenceModel.setLodLevel(0.5f);
+				break;
+			case 9:
+				model.setLodLevel(1.0f);
+				referenceModel.setLodLevel(1.0f);
+				break;
+			}
+
+			model.getRenderer()->resetVertexCacheStatistics();
+			fetchVertexData(model, vectorData);
+			fetchVertexData(referenceModel, vectorReferenceData);
+
+			if(!CAL_TEST_CHECK(vectorData == vectorReferenceData))
+			{
+				std::fprintf(stderr, "frame %d: max relative error %g\n", frameId,
+				             CalTest::maxRelativeError(vectorData, vectorReferenceData));
+			}
+
+			CalRenderer *pRenderer = model.getRenderer();
+			if(changed)
+			{
+				CAL_TEST_CHECK(pRenderer->getNumCachedVertexFetches() == 0);
+			}
+			else if(frameId == 3)
+			{
+				// only the head was morphed
+				CAL_TEST_CHECK(pRenderer->getNumCachedVertexFetches() == pRenderer->getNumVertexFetches() - 3);
+			}
+			else if(frameId == 1)
+			{
+				CAL_TEST_CHECK(pRenderer->getNumCachedVertexFetches() == pRenderer->getNumVertexFetches());
+			}
+			else
+			{
+				CAL_TEST_CHECK(pRenderer->getNumCachedVertexFetches() <= pRenderer->getNumVertexFetches());
+			}
+
+			// the data is served from the cache when asked for again
+			pRenderer->resetVertexCacheStatistics();
+			fetchVertexData(model, vectorData);
+			CAL_TEST_CHECK(vectorData == vectorReferenceData);
+			CAL_TEST_CHECK(pRenderer->getNumCachedVertexFetches() == pRenderer->getNumVertexFetches());
+		}
+
+		// turning the cache off hands out the data of the physique again
+		model.getRenderer()->setVertexCacheOn(false);
+		fetchVertexData(model, vectorData);
+		CAL_TEST_CHECK(vectorData == vectorReferenceData);
+	}
+}
+
+int main()
+{
+	CalCoreModel coreModel("cally");
+	if(!CalTest::loadCally(coreModel)) return 1;
+	CalTest::addMorphTargets(coreModel.getCoreMesh(HeadMeshId)->getCoreSubmesh(0), MorphTargetCount, 3);
+
+	testSkeletonSkipping(coreModel);
+	testVertexCache(coreModel);
+
+	return CalTest::result();
+}
+
+//****************************************************************************//